@@ -20,13 +20,45 @@ uniform vec3 uCameraPosition; // Uniform for the camera position
  layout(location = 4) uniform vec3 uSceneAmbient; // Scene ambient illumination
  uniform sampler2D uTexture; // Texture sampler uniform
 
+// Virtual texturing (see VirtualTexture in main/virtual_texture.hpp). When
+// enabled, uTexture is ignored and texels come from the tile atlas instead.
+layout( location = 8 ) uniform int uVtEnabled;
+layout( location = 9 ) uniform vec4 uVtSize; // xy: level 0 size, z: tile size, w: tile border
+layout( location = 10 ) uniform vec2 uVtAtlasSize;
+layout( location = 11 ) uniform float uVtMaxLevel;
+layout( binding = 1 ) uniform usampler2D uVtIndirection;
+layout( binding = 2 ) uniform sampler2D uVtAtlas;
+
+vec3 sample_virtual_( vec2 aUV )
+{
+    // Level selection must match vt_feedback.frag
+    vec2 texel0 = aUV * uVtSize.xy;
+    vec2 dx = dFdx( texel0 ), dy = dFdy( texel0 );
+    int level = int( clamp( 0.5 * log2( max( dot( dx, dx ), dot( dy, dy ) ) ), 0.0, uVtMaxLevel ) );
+
+    vec2 size = max( floor( uVtSize.xy / exp2( float(level) ) ), vec2( 1.0 ) );
+    vec2 tile = clamp( floor( aUV * size / uVtSize.z ), vec2( 0.0 ), ceil( size / uVtSize.z ) - 1.0 );
+
+    // Finest resident tile covering this one: xy = atlas slot, z = its level
+    uvec4 entry = texelFetch( uVtIndirection, ivec2( tile ), level );
+
+    vec2 residentSize = max( floor( uVtSize.xy / exp2( float(entry.z) ) ), vec2( 1.0 ) );
+    vec2 texel = clamp( aUV * residentSize, vec2( 0.0 ), residentSize );
+    vec2 residentTile = min( floor( texel / uVtSize.z ), ceil( residentSize / uVtSize.z ) - 1.0 );
+
+    vec2 atlas = vec2( entry.xy ) * (uVtSize.z + 2.0 * uVtSize.w) + uVtSize.w + (texel - residentTile * uVtSize.z);
+    return textureLod( uVtAtlas, atlas / uVtAtlasSize, 0.0 ).rgb;
+}
+
 void main() {
     vec3 normal = normalize(v2fNormal);
     vec3 lightDir = normalize(uLightDir);
     // Compute clamped dot product of normal and light direction
     float nDotL = max(0.0, dot(normal, lightDir));
     // Sample the texture using texture coordinates
-    vec3 textureColor = texture(uTexture, v2fTexCoord).rgb; // Sample the texture
+    vec3 textureColor = 0 != uVtEnabled
+        ? sample_virtual_(v2fTexCoord)
+        : texture(uTexture, v2fTexCoord).rgb; // Sample the texture
     // Calculate final color using simplified Blinn-Phong model and texture
     oColor = (uSceneAmbient + nDotL * uLightDiffuse) * textureColor * v2fColor;
 
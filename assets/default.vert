@@ -10,8 +10,20 @@ layout( location = 2 ) in vec3 iNormal;
 
 layout(location = 0) uniform mat4 uProjCameraWorld ;
 layout( location = 1 ) uniform mat3 uNormalMatrix;
+
+// Dequantization of packed meshes (see PackedMesh in main/packed_mesh.hpp).
+// Float meshes set these to scale 1, bias 0.
+layout( location = 5 ) uniform vec3 uPositionScale;
+layout( location = 6 ) uniform vec3 uPositionBias;
+layout( location = 7 ) uniform float uColorScale;
 layout(location = 3) in vec2 iTexCoord; // Add texture coordinates
 
+// Per-instance model-to-world transform and color (see InstanceBuffer in
+// main/instancing.hpp). The transform takes locations 4 to 7. Meshes drawn
+// without instancing get the identity and white.
+layout( location = 4 ) in mat4 iModel2World;
+layout( location = 8 ) in vec4 iInstanceColor;
+
 
 out vec3 v2fPosition;
 out vec3 v2fColor;
@@ -24,11 +36,18 @@ out vec3 v2fWorldPosition;
 
 void main()
 {	
-    v2fColor = iColor; 
-    gl_Position = uProjCameraWorld * vec4(iPosition, 1.0);
-    v2fNormal = normalize(uNormalMatrix * iNormal);
+    vec4 position = iModel2World * vec4(uPositionBias + uPositionScale * iPosition, 1.0);
+
+    // Normals transform with the inverse transpose, which is the cofactor
+    // matrix up to a scale factor that normalize() removes.
+    mat3 model = mat3(iModel2World);
+    mat3 cofactor = mat3(cross(model[1], model[2]), cross(model[2], model[0]), cross(model[0], model[1]));
+
+    v2fColor = uColorScale * iColor * iInstanceColor.rgb; 
+    gl_Position = uProjCameraWorld * position;
+    v2fNormal = normalize(uNormalMatrix * cofactor * iNormal);
     v2fTexCoord = iTexCoord; // Pass texture coordinates to fragment shader
     // task 1.6
     // Transform vertex position to world space and store in v2fWorldPosition
-    v2fWorldPosition = (uProjCameraWorld * vec4(iPosition, 1.0)).xyz;
+    v2fWorldPosition = (uProjCameraWorld * position).xyz;
 }
\ No newline at end of file
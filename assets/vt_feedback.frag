@@ -0,0 +1,26 @@
+#version 430
+
+// Virtual texture feedback pass (see VirtualTexture in
+// main/virtual_texture.hpp). Outputs the tile that the main pass would
+// sample: (tile x, tile y, level, 1). The level selection must match
+// sample_virtual_() in default.frag.
+
+in vec2 v2fTexCoord;
+
+layout( location = 0 ) out uvec4 oFeedback;
+
+layout( location = 9 ) uniform vec4 uVtSize; // xy: level 0 size, z: tile size, w: tile border
+layout( location = 11 ) uniform float uVtMaxLevel;
+layout( location = 12 ) uniform float uVtFeedbackBias; // compensates for the reduced resolution
+
+void main()
+{
+	vec2 texel = v2fTexCoord * uVtSize.xy;
+	vec2 dx = dFdx( texel ), dy = dFdy( texel );
+	int level = int( clamp( 0.5 * log2( max( dot( dx, dx ), dot( dy, dy ) ) ) + uVtFeedbackBias, 0.0, uVtMaxLevel ) );
+
+	vec2 size = max( floor( uVtSize.xy / exp2( float(level) ) ), vec2( 1.0 ) );
+	vec2 tile = clamp( floor( v2fTexCoord * size / uVtSize.z ), vec2( 0.0 ), ceil( size / uVtSize.z ) - 1.0 );
+
+	oFeedback = uvec4( uvec2( tile ), uint(level), 1u );
+}
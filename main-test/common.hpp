@@ -0,0 +1,59 @@
+#ifndef COMMON_HPP_473607D7_C440_4B44_84B1_832FC7675C9F
+#define COMMON_HPP_473607D7_C440_4B44_84B1_832FC7675C9F
+
+#include <cmath>
+#include <cstdint>
+
+#include "../main/simple_mesh.hpp"
+
+#include "../vmlib/vec2.hpp"
+#include "../vmlib/vec3.hpp"
+
+// Shared by the main tests.
+
+// Indexed grid of aSize x aSize vertices over the unit square (x, y in
+// [0, 1]), facing +z, with height z = aHeight( x, y ). Normals are +z and
+// texture coordinates are (x, y).
+template< typename tHeight >
+SimpleMeshData make_grid( std::uint32_t aSize, tHeight&& aHeight )
+{
+	SimpleMeshData ret;
+	for( std::uint32_t y = 0; y < aSize; ++y )
+	{
+		for( std::uint32_t x = 0; x < aSize; ++x )
+		{
+			auto const u = float(x) / float(aSize-1), v = float(y) / float(aSize-1);
+			ret.positions.emplace_back( Vec3f{ u, v, aHeight( u, v ) } );
+			ret.normals.emplace_back( Vec3f{ 0.f, 0.f, 1.f } );
+			ret.texcoords.emplace_back( Vec2f{ u, v } );
+		}
+	}
+
+	for( std::uint32_t y = 0; y+1 < aSize; ++y )
+	{
+		for( std::uint32_t x = 0; x+1 < aSize; ++x )
+		{
+			auto const i = y*aSize + x;
+			ret.indices.insert( ret.indices.end(), { i, i+1, i+aSize+1, i, i+aSize+1, i+aSize } );
+		}
+	}
+
+	return ret;
+}
+
+inline
+SimpleMeshData make_flat_grid( std::uint32_t aSize )
+{
+	return make_grid( aSize, [] (float, float) { return 0.f; } );
+}
+
+// Smooth hills, up to 0.05 high
+inline
+SimpleMeshData make_bumpy_grid( std::uint32_t aSize )
+{
+	return make_grid( aSize, [] (float aU, float aV) {
+		return 0.05f * std::sin( 6.f * aU ) * std::cos( 5.f * aV );
+	} );
+}
+
+#endif // COMMON_HPP_473607D7_C440_4B44_84B1_832FC7675C9F
@@ -0,0 +1,162 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <array>
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
+#include <cmath>
+#include <cstdint>
+
+#include "common.hpp"
+
+#include "../main/mesh_chunks.hpp"
+
+#include "../vmlib/vec3.hpp"
+
+namespace
+{
+	constexpr std::size_t kChunkTriangles_ = 1024;
+
+	// Triangles by their positions, rotated such that the smallest position
+	// comes first (which keeps the winding), in sorted order
+	using Triangle_ = std::array<std::array<float, 3>, 3>;
+
+	void append_triangles_( std::vector<Triangle_>& aOut, SimpleMeshData const& aMesh, std::size_t aFirstIndex, std::size_t aIndexCount )
+	{
+		for( auto i = aFirstIndex; i < aFirstIndex + aIndexCount; i += 3 )
+		{
+			Triangle_ tri;
+			for( std::size_t j = 0; j < 3; ++j )
+			{
+				auto const& p = aMesh.positions[aMesh.indices[i+j]];
+				tri[j] = { p.x, p.y, p.z };
+			}
+
+			std::rotate( tri.begin(), std::min_element( tri.begin(), tri.end() ), tri.end() );
+			aOut.emplace_back( tri );
+		}
+	}
+
+	bool on_outer_border_( Vec3f aPoint )
+	{
+		return 0.f == aPoint.x || 1.f == aPoint.x || 0.f == aPoint.y || 1.f == aPoint.y;
+	}
+
+	// Every edge is shared by two triangles, except on the sides of the unit
+	// square.
+	void require_watertight_( SimpleMeshData const& aMesh, std::vector<std::uint32_t> const& aIndices )
+	{
+		auto const key = [] (std::uint32_t aFrom, std::uint32_t aTo) {
+			return (std::uint64_t(aFrom) << 32) | aTo;
+		};
+
+		std::unordered_set<std::uint64_t> edges;
+		for( std::size_t i = 0; i < aIndices.size(); i += 3 )
+		{
+			for( std::size_t j = 0; j < 3; ++j )
+				edges.insert( key( aIndices[i+j], aIndices[i+(j+1)%3] ) );
+		}
+
+		for( auto const edge : edges )
+		{
+			auto const from = std::uint32_t(edge >> 32), to = std::uint32_t(edge);
+			if( edges.count( key( to, from ) ) )
+				continue;
+
+			REQUIRE( on_outer_border_( aMesh.positions[from] ) );
+			REQUIRE( on_outer_border_( aMesh.positions[to] ) );
+		}
+	}
+}
+
+TEST_CASE( "Mesh chunks cover the mesh", "[mesh_chunks]" )
+{
+	auto const original = make_bumpy_grid( 65 );
+
+	auto mesh = original;
+	auto const chunked = make_chunked_mesh( mesh, kChunkTriangles_ );
+
+	REQUIRE( chunked.chunks.size() >= 8 );
+
+	std::vector<Triangle_> expected, finest;
+	append_triangles_( expected, original, 0, original.indices.size() );
+
+	for( auto const& chunk : chunked.chunks )
+	{
+		REQUIRE( chunk.lodCount > 0 );
+		REQUIRE( chunk.firstLod + chunk.lodCount <= chunked.lods.size() );
+
+		auto const& lod0 = chunked.lods[chunk.firstLod];
+		REQUIRE( lod0.indexCount / 3 <= kChunkTriangles_ );
+		append_triangles_( finest, mesh, lod0.firstIndex, lod0.indexCount );
+	}
+
+	// Level 0 of all chunks is the original mesh
+	std::sort( expected.begin(), expected.end() );
+	std::sort( finest.begin(), finest.end() );
+	REQUIRE( expected == finest );
+}
+
+TEST_CASE( "Mesh chunk bounds contain all of their triangles", "[mesh_chunks]" )
+{
+	auto mesh = make_bumpy_grid( 65 );
+	auto const chunked = make_chunked_mesh( mesh, kChunkTriangles_ );
+
+	for( auto const& chunk : chunked.chunks )
+	{
+		for( auto l = chunk.firstLod; l < chunk.firstLod + chunk.lodCount; ++l )
+		{
+			auto const& lod = chunked.lods[l];
+			for( auto i = lod.firstIndex; i < lod.firstIndex + lod.indexCount; ++i )
+			{
+				auto const& p = mesh.positions[mesh.indices[i]];
+				REQUIRE( chunk.boundsMin.x <= p.x );
+				REQUIRE( chunk.boundsMin.y <= p.y );
+				REQUIRE( chunk.boundsMin.z <= p.z );
+				REQUIRE( p.x <= chunk.boundsMax.x );
+				REQUIRE( p.y <= chunk.boundsMax.y );
+				REQUIRE( p.z <= chunk.boundsMax.z );
+			}
+
+			// Meshlets partition the level, and their spheres contain their
+			// vertices.
+			REQUIRE( lod.meshletCount > 0 );
+			auto next = lod.firstIndex;
+			for( auto m = lod.firstMeshlet; m < lod.firstMeshlet + lod.meshletCount; ++m )
+			{
+				auto const& meshlet = chunked.meshlets[m];
+				REQUIRE( next == meshlet.firstIndex );
+				next += meshlet.indexCount;
+
+				for( auto i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; ++i )
+				{
+					auto const d = length( mesh.positions[mesh.indices[i]] - meshlet.center );
+					REQUIRE( d <= meshlet.radius * (1.f + 1e-5f) + 1e-6f );
+				}
+			}
+			REQUIRE( lod.firstIndex + lod.indexCount == next );
+		}
+	}
+}
+
+TEST_CASE( "Mesh chunks fit together at any level of detail", "[mesh_chunks]" )
+{
+	auto mesh = make_bumpy_grid( 65 );
+	auto const chunked = make_chunked_mesh( mesh, kChunkTriangles_ );
+
+	// Neighbouring chunks at different levels, or all at their coarsest
+	auto const mixed = GENERATE( true, false );
+
+	std::vector<std::uint32_t> indices;
+	for( std::uint32_t c = 0; c < chunked.chunks.size(); ++c )
+	{
+		auto const& chunk = chunked.chunks[c];
+		auto const level = mixed ? std::min( c % 3, chunk.lodCount-1 ) : chunk.lodCount-1;
+		auto const& lod = chunked.lods[chunk.firstLod + level];
+
+		indices.insert( indices.end(), mesh.indices.begin() + lod.firstIndex, mesh.indices.begin() + lod.firstIndex + lod.indexCount );
+	}
+
+	require_watertight_( mesh, indices );
+}
@@ -0,0 +1,117 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <array>
+#include <random>
+#include <algorithm>
+#include <vector>
+
+#include <cstdint>
+
+#include "common.hpp"
+
+#include "../main/mesh_optimize.hpp"
+
+namespace
+{
+	// Triangles rotated such that the smallest index comes first (which
+	// keeps the winding), in sorted order
+	std::vector<std::array<std::uint32_t, 3>> triangle_set_( std::vector<std::uint32_t> const& aIndices )
+	{
+		std::vector<std::array<std::uint32_t, 3>> ret;
+		for( std::size_t i = 0; i < aIndices.size(); i += 3 )
+		{
+			std::array<std::uint32_t, 3> tri{ aIndices[i+0], aIndices[i+1], aIndices[i+2] };
+			std::rotate( tri.begin(), std::min_element( tri.begin(), tri.end() ), tri.end() );
+			ret.emplace_back( tri );
+		}
+
+		std::sort( ret.begin(), ret.end() );
+		return ret;
+	}
+
+	// The grid's triangles in random order
+	SimpleMeshData make_shuffled_grid_( std::uint32_t aSize, unsigned aSeed )
+	{
+		auto ret = make_bumpy_grid( aSize );
+
+		std::vector<std::uint32_t> order( ret.indices.size() / 3 );
+		for( std::size_t i = 0; i < order.size(); ++i )
+			order[i] = std::uint32_t(i);
+
+		std::mt19937 rng( aSeed );
+		std::shuffle( order.begin(), order.end(), rng );
+
+		std::vector<std::uint32_t> indices;
+		for( auto const t : order )
+			indices.insert( indices.end(), ret.indices.begin() + t*3, ret.indices.begin() + t*3 + 3 );
+
+		ret.indices = std::move(indices);
+		return ret;
+	}
+}
+
+TEST_CASE( "Vertex cache optimization lowers the ACMR", "[mesh_optimize]" )
+{
+	auto const grid = make_shuffled_grid_( 65, 1 );
+	auto const vertexCount = grid.positions.size();
+
+	auto const before = analyze_vertex_cache( grid.indices, vertexCount );
+	auto const optimized = optimize_vertex_cache( grid.indices, vertexCount );
+	auto const after = analyze_vertex_cache( optimized, vertexCount );
+
+	REQUIRE( before.triangles == after.triangles );
+	REQUIRE( before.vertices == after.vertices );
+
+	// Random order reuses almost nothing. A regular grid can get close to
+	// 0.5 with a large cache; allow some slack for the FIFO model.
+	REQUIRE( before.acmr > 2.f );
+	REQUIRE( after.acmr < 0.8f );
+	REQUIRE( after.atvr < 1.5f );
+
+	// Same triangles, same winding
+	REQUIRE( triangle_set_( grid.indices ) == triangle_set_( optimized ) );
+
+	SECTION( "Overdraw" )
+	{
+		auto const sorted = optimize_overdraw( optimized, grid.positions );
+		auto const stats = analyze_vertex_cache( sorted, vertexCount );
+
+		// About 5% by default (see optimize_overdraw())
+		REQUIRE( stats.acmr <= 1.1f * after.acmr );
+		REQUIRE( triangle_set_( grid.indices ) == triangle_set_( sorted ) );
+	}
+}
+
+TEST_CASE( "Vertex fetch optimization orders vertices by first use", "[mesh_optimize]" )
+{
+	auto grid = make_shuffled_grid_( 17, 2 );
+
+	// An unreferenced vertex, which is removed
+	grid.positions.emplace_back( Vec3f{ 2.f, 2.f, 2.f } );
+	grid.normals.emplace_back( Vec3f{ 0.f, 0.f, 1.f } );
+	grid.texcoords.emplace_back( Vec2f{ 2.f, 2.f } );
+
+	auto const mesh = optimize_vertex_fetch( grid );
+
+	REQUIRE( grid.positions.size()-1 == mesh.positions.size() );
+	REQUIRE( mesh.positions.size() == mesh.normals.size() );
+	REQUIRE( mesh.positions.size() == mesh.texcoords.size() );
+	REQUIRE( grid.indices.size() == mesh.indices.size() );
+
+	std::uint32_t next = 0;
+	for( std::size_t i = 0; i < mesh.indices.size(); ++i )
+	{
+		auto const idx = mesh.indices[i];
+		REQUIRE( idx <= next );
+		if( idx == next )
+			++next;
+
+		// Same vertex as before
+		auto const& p = mesh.positions[idx];
+		auto const& q = grid.positions[grid.indices[i]];
+		REQUIRE( (p.x == q.x && p.y == q.y && p.z == q.z) );
+		REQUIRE( mesh.texcoords[idx].x == grid.texcoords[grid.indices[i]].x );
+	}
+
+	REQUIRE( mesh.positions.size() == next );
+}
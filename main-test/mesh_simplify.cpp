@@ -0,0 +1,134 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <map>
+#include <utility>
+
+#include <cstdint>
+
+#include "common.hpp"
+
+#include "../main/mesh_lod.hpp"
+#include "../main/mesh_simplify.hpp"
+
+#include "../vmlib/vec3.hpp"
+
+namespace
+{
+	// Which sides of the unit square a point is on (bit mask)
+	unsigned sides_( Vec3f aPoint )
+	{
+		return (0.f == aPoint.x ? 1u : 0u)
+			| (1.f == aPoint.x ? 2u : 0u)
+			| (0.f == aPoint.y ? 4u : 0u)
+			| (1.f == aPoint.y ? 8u : 0u)
+		;
+	}
+}
+
+TEST_CASE( "Simplification hits the target triangle count", "[mesh_simplify]" )
+{
+	auto const target = GENERATE( std::size_t(1500), std::size_t(200), std::size_t(20) );
+
+	auto const grid = make_flat_grid( 33 );
+	REQUIRE( 2048 == grid.indices.size() / 3 );
+
+	float error = -1.f;
+	auto const indices = simplify_mesh( grid, target, 1.f, &error );
+
+	// A collapse removes one (on the border) or two triangles
+	REQUIRE( 0 == indices.size() % 3 );
+	REQUIRE( indices.size() / 3 <= target );
+	REQUIRE( indices.size() / 3 + 1 >= target );
+
+	// The grid is flat
+	REQUIRE( error >= 0.f );
+	REQUIRE( error < 1e-5f );
+}
+
+TEST_CASE( "Simplification keeps the border in place", "[mesh_simplify]" )
+{
+	auto const grid = make_flat_grid( 33 );
+	auto const indices = simplify_mesh( grid, 50, 1.f );
+
+	// Triangles still cover the unit square exactly once: same area, and
+	// none are flipped.
+	float area = 0.f;
+	std::map<std::pair<std::uint32_t, std::uint32_t>, int> edges;
+	for( std::size_t i = 0; i < indices.size(); i += 3 )
+	{
+		auto const& a = grid.positions[indices[i+0]];
+		auto const& b = grid.positions[indices[i+1]];
+		auto const& c = grid.positions[indices[i+2]];
+
+		auto const ab = b - a, ac = c - a;
+		auto const doubleArea = ab.x*ac.y - ab.y*ac.x;
+		REQUIRE( doubleArea > 0.f );
+		area += 0.5f * doubleArea;
+
+		for( std::size_t j = 0; j < 3; ++j )
+		{
+			auto const from = indices[i+j], to = indices[i+(j+1)%3];
+			++edges[{ std::min( from, to ), std::max( from, to ) }];
+		}
+	}
+
+	REQUIRE( area == Catch::Approx( 1.f ) );
+
+	// Open edges run along the sides of the square, and the corners remain.
+	std::size_t corners = 0;
+	for( auto const& [edge, count] : edges )
+	{
+		REQUIRE( count <= 2 );
+		if( 2 == count )
+			continue;
+
+		auto const& a = grid.positions[edge.first];
+		auto const& b = grid.positions[edge.second];
+		REQUIRE( 0 != (sides_( a ) & sides_( b )) );
+
+		for( auto const& p : { a, b } )
+		{
+			if( (sides_( p ) & 3u) && (sides_( p ) & 12u) )
+				++corners;
+		}
+	}
+
+	REQUIRE( 8 == corners ); // each corner is on two open edges
+}
+
+TEST_CASE( "Simplification respects the error bound", "[mesh_simplify]" )
+{
+	auto const grid = make_bumpy_grid( 33 );
+
+	float error = -1.f;
+	auto const indices = simplify_mesh( grid, 0, 1e-3f, &error );
+
+	REQUIRE( !indices.empty() );
+	REQUIRE( indices.size() < grid.indices.size() );
+	REQUIRE( error >= 0.f );
+	REQUIRE( error <= 1e-3f );
+}
+
+TEST_CASE( "Levels of detail get coarser", "[mesh_lod]" )
+{
+	auto grid = make_bumpy_grid( 65 );
+
+	auto const triangles = grid.indices.size() / 3;
+	auto const lods = make_lod_chain( grid );
+
+	REQUIRE( lods.size() > 1 );
+	REQUIRE( 0 == lods[0].firstIndex );
+	REQUIRE( triangles*3 == lods[0].indexCount );
+	REQUIRE( 0.f == lods[0].error );
+
+	for( std::size_t i = 1; i < lods.size(); ++i )
+	{
+		REQUIRE( lods[i-1].firstIndex + lods[i-1].indexCount == lods[i].firstIndex );
+		REQUIRE( lods[i].indexCount < lods[i-1].indexCount );
+		REQUIRE( lods[i].error >= lods[i-1].error );
+	}
+
+	REQUIRE( lods.back().firstIndex + lods.back().indexCount == grid.indices.size() );
+	for( auto const index : grid.indices )
+		REQUIRE( index < grid.positions.size() );
+}
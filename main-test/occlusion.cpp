@@ -0,0 +1,194 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <random>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <cmath>
+#include <cstdint>
+
+#include "../main/jobs.hpp"
+#include "../main/occlusion.hpp"
+
+#include "../vmlib/mat44.hpp"
+
+namespace
+{
+	// Camera at the origin, looking down -z
+	Mat44f const kProjection_ = make_perspective_projection( 1.f, 16.f / 9.f, 0.1f, 100.f );
+
+	// Square in the plane z = aZ, facing the camera
+	void add_square_( OcclusionBuffer& aBuffer, Mat44f const& aClipFromObject, float aHalfSize, float aZ )
+	{
+		Vec3f const positions[] = {
+			{ -aHalfSize, -aHalfSize, aZ },
+			{ aHalfSize, -aHalfSize, aZ },
+			{ aHalfSize, aHalfSize, aZ },
+			{ -aHalfSize, aHalfSize, aZ }
+		};
+		std::uint32_t const indices[] = { 0, 1, 2, 0, 2, 3 };
+
+		aBuffer.add_occluder( aClipFromObject, positions, 4, indices, 6 );
+	}
+}
+
+TEST_CASE( "Occluders hide what is behind them", "[occlusion]" )
+{
+	// Slightly off center: pixel centers exactly on the shared diagonal are
+	// covered by neither triangle (see rasterize_()).
+	auto const place = kProjection_ * make_translation( { 0.01f, 0.03f, 0.f } );
+
+	OcclusionBuffer buffer;
+	buffer.clear();
+	add_square_( buffer, place, 2.f, -5.f );
+	buffer.render();
+
+	REQUIRE( 2 == buffer.triangle_count() );
+
+	SECTION( "Behind" )
+	{
+		REQUIRE( !buffer.test_box( kProjection_, { -0.5f, -0.5f, -10.f }, { 0.5f, 0.5f, -9.f } ) );
+	}
+
+	SECTION( "Beside" )
+	{
+		REQUIRE( buffer.test_box( kProjection_, { 6.f, -0.5f, -10.f }, { 7.f, 0.5f, -9.f } ) );
+	}
+
+	SECTION( "Partially behind" )
+	{
+		// Sticks out over the square's right edge
+		REQUIRE( buffer.test_box( kProjection_, { 3.f, -0.5f, -10.f }, { 5.f, 0.5f, -9.f } ) );
+	}
+
+	SECTION( "In front" )
+	{
+		REQUIRE( buffer.test_box( kProjection_, { -0.5f, -0.5f, -3.f }, { 0.5f, 0.5f, -2.f } ) );
+	}
+
+	SECTION( "Back faces" )
+	{
+		// Seen from behind, the square is culled and hides nothing
+		auto const behind = kProjection_ * make_rotation_y( 3.1415926f );
+
+		buffer.clear();
+		add_square_( buffer, behind, 2.f, 5.f );
+		buffer.render();
+
+		REQUIRE( 0 == buffer.triangle_count() );
+		REQUIRE( buffer.test_box( kProjection_, { -0.5f, -0.5f, -10.f }, { 0.5f, 0.5f, -9.f } ) );
+	}
+}
+
+TEST_CASE( "Occluders only cover pixels inside of them", "[occlusion]" )
+{
+	OcclusionBuffer buffer;
+
+	// Given in clip space (w = 1), such that the edges of the rectangle run
+	// exactly through pixel centers: x = 100.5 ... 155.5, y = 40.5 ... 103.5.
+	Vec3f const positions[] = {
+		{ -0.21484375f, -0.4375f, 0.5f },
+		{ 0.21484375f, -0.4375f, 0.5f },
+		{ 0.21484375f, 0.4375f, 0.5f },
+		{ -0.21484375f, 0.4375f, 0.5f }
+	};
+	std::uint32_t const indices[] = { 0, 1, 2, 0, 2, 3 };
+
+	buffer.clear();
+	buffer.add_occluder( kIdentity44f, positions, 4, indices, 6 );
+	buffer.render();
+
+	std::size_t covered = 0;
+	for( std::size_t y = 0; y < buffer.height(); ++y )
+	{
+		for( std::size_t x = 0; x < buffer.width(); ++x )
+		{
+			float const cx = float(x) + 0.5f, cy = float(y) + 0.5f;
+			bool const inside = cx > 100.5f && cx < 155.5f && cy > 40.5f && cy < 103.5f;
+
+			if( buffer.depth( x, y ) < 1.f )
+			{
+				++covered;
+				REQUIRE( inside );
+			}
+		}
+	}
+
+	// All but (at most) the pixels on the diagonal
+	REQUIRE( covered >= 54*62 - 62 );
+}
+
+TEST_CASE( "Occlusion depth pyramid is conservative", "[occlusion]" )
+{
+	// Odd sizes at some levels: the last row and column must still count
+	auto const [width, height] = GENERATE( std::pair<std::size_t, std::size_t>{ 36, 27 }, std::pair<std::size_t, std::size_t>{ 100, 45 }, std::pair<std::size_t, std::size_t>{ 4, 1 } );
+
+	OcclusionBuffer buffer( width, height );
+
+	// Random squares at random depths and positions
+	std::mt19937 rng( 1 );
+	std::uniform_real_distribution<float> offset( -3.f, 3.f ), depth( -20.f, -2.f ), size( 0.2f, 2.f );
+
+	buffer.clear();
+	for( std::size_t i = 0; i < 20; ++i )
+	{
+		auto const place = kProjection_ * make_translation( { offset( rng ), offset( rng ), 0.f } );
+		add_square_( buffer, place, size( rng ), depth( rng ) );
+	}
+	buffer.render();
+
+	REQUIRE( 1 == buffer.level_width( buffer.level_count()-1 ) );
+	REQUIRE( 1 == buffer.level_height( buffer.level_count()-1 ) );
+
+	// Each texel is at least as far as all of the pixels below it
+	for( std::size_t l = 1; l < buffer.level_count(); ++l )
+	{
+		for( std::size_t y = 0; y < buffer.level_height( l ); ++y )
+		{
+			for( std::size_t x = 0; x < buffer.level_width( l ); ++x )
+			{
+				auto const texel = buffer.depth( l, x, y );
+
+				for( auto py = y << l; py < std::min( (y+1) << l, height ); ++py )
+				{
+					for( auto px = x << l; px < std::min( (x+1) << l, width ); ++px )
+						REQUIRE( buffer.depth( px, py ) <= texel );
+				}
+			}
+		}
+	}
+}
+
+TEST_CASE( "Occlusion rasterizes the same in parallel", "[occlusion]" )
+{
+	std::mt19937 rng( 2 );
+	std::uniform_real_distribution<float> offset( -3.f, 3.f ), depth( -20.f, -2.f ), size( 0.2f, 2.f );
+
+	std::vector<Mat44f> places;
+	std::vector<float> sizes, depths;
+	for( std::size_t i = 0; i < 50; ++i )
+	{
+		places.emplace_back( kProjection_ * make_translation( { offset( rng ), offset( rng ), 0.f } ) );
+		sizes.emplace_back( size( rng ) );
+		depths.emplace_back( depth( rng ) );
+	}
+
+	OcclusionBuffer single, parallel;
+	for( auto* buffer : { &single, &parallel } )
+	{
+		buffer->clear();
+		for( std::size_t i = 0; i < places.size(); ++i )
+			add_square_( *buffer, places[i], sizes[i], depths[i] );
+	}
+
+	ThreadPool pool( 3 );
+	single.render();
+	parallel.render( &pool );
+
+	for( std::size_t y = 0; y < single.height(); ++y )
+	{
+		for( std::size_t x = 0; x < single.width(); ++x )
+			REQUIRE( single.depth( x, y ) == parallel.depth( x, y ) );
+	}
+}
@@ -0,0 +1,145 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <cstddef>
+
+#include "../main/cone.hpp"
+#include "../main/cube.hpp"
+#include "../main/cylinder.hpp"
+#include "../main/simple_mesh.hpp"
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/vec4.hpp"
+#include "../vmlib/mat44.hpp"
+
+namespace
+{
+	Vec3f cross_( Vec3f aLeft, Vec3f aRight )
+	{
+		return Vec3f{
+			aLeft.y*aRight.z - aLeft.z*aRight.y,
+			aLeft.z*aRight.x - aLeft.x*aRight.z,
+			aLeft.x*aRight.y - aLeft.y*aRight.x
+		};
+	}
+
+	Vec3f transform_point_( Mat44f const& aM, Vec3f aP )
+	{
+		auto const p = aM * Vec4f{ aP.x, aP.y, aP.z, 1.f };
+		return Vec3f{ p.x, p.y, p.z } / p.w;
+	}
+
+	// The shapes are convex: seen from a point inside, every triangle winds
+	// counter-clockwise around its outward normal. Vertex normals point to
+	// the same side.
+	void require_outward_( SimpleMeshData const& aMesh, Vec3f aInside )
+	{
+		REQUIRE( aMesh.normals.size() == aMesh.positions.size() );
+		REQUIRE( 0 == aMesh.indices.size() % 3 );
+
+		for( std::size_t i = 0; i < aMesh.indices.size(); i += 3 )
+		{
+			auto const a = aMesh.indices[i+0], b = aMesh.indices[i+1], c = aMesh.indices[i+2];
+			auto const& pa = aMesh.positions[a];
+			auto const& pb = aMesh.positions[b];
+			auto const& pc = aMesh.positions[c];
+
+			auto const n = cross_( pb - pa, pc - pa );
+			auto const centroid = (pa + pb + pc) / 3.f;
+			REQUIRE( dot( n, centroid - aInside ) > 0.f );
+
+			for( auto const v : { a, b, c } )
+				REQUIRE( dot( aMesh.normals[v], n ) > 0.f );
+		}
+	}
+
+	// Vertices that make_indexed() would merge (same position, color and
+	// normal) are already shared
+	void require_welded_( SimpleMeshData const& aMesh )
+	{
+		SimpleMeshData soup;
+		for( auto const idx : aMesh.indices )
+		{
+			soup.positions.emplace_back( aMesh.positions[idx] );
+			soup.colors.emplace_back( aMesh.colors[idx] );
+			soup.normals.emplace_back( aMesh.normals[idx] );
+		}
+
+		REQUIRE( make_indexed( soup ).positions.size() == aMesh.positions.size() );
+	}
+}
+
+TEST_CASE( "Shapes face outwards", "[shapes]" )
+{
+	auto const subdivs = GENERATE( std::size_t(3), std::size_t(16), std::size_t(128) );
+
+	SECTION( "Cylinder" )
+	{
+		require_outward_( make_cylinder( true, subdivs ), { 0.5f, 0.f, 0.f } );
+		require_outward_( make_cylinder( false, subdivs ), { 0.5f, 0.f, 0.f } );
+	}
+
+	SECTION( "Cone" )
+	{
+		require_outward_( make_cone( true, subdivs ), { 0.75f, 0.f, 0.f } );
+		require_outward_( make_cone( false, subdivs ), { 0.75f, 0.f, 0.f } );
+	}
+
+	SECTION( "Cube" )
+	{
+		require_outward_( make_cube( true, subdivs ), { 0.f, 0.f, 0.f } );
+	}
+
+	SECTION( "Pre-transformed" )
+	{
+		auto const transform = make_translation( { 2.f, -1.f, 3.f } )
+			* make_rotation_z( 0.7f )
+			* make_scaling( 0.5f, 2.f, 1.5f );
+
+		require_outward_( make_cylinder( true, subdivs, { 1.f, 1.f, 1.f }, transform ), transform_point_( transform, { 0.5f, 0.f, 0.f } ) );
+		require_outward_( make_cone( true, subdivs, { 1.f, 1.f, 1.f }, transform ), transform_point_( transform, { 0.75f, 0.f, 0.f } ) );
+		require_outward_( make_cube( true, subdivs, { 1.f, 1.f, 1.f }, transform ), transform_point_( transform, { 0.f, 0.f, 0.f } ) );
+	}
+}
+
+TEST_CASE( "Shapes keep their vertex counts", "[shapes]" )
+{
+	auto const n = GENERATE( std::size_t(3), std::size_t(16), std::size_t(128) );
+
+	SECTION( "Cylinder" )
+	{
+		// Same triangles as the old triangle soups (12n and 6n vertices), and
+		// the vertices that make_indexed() left of them.
+		auto const capped = make_cylinder( true, n );
+		REQUIRE( 12*n == capped.indices.size() );
+		REQUIRE( 4*n + 2 == capped.positions.size() );
+		require_welded_( capped );
+
+		auto const open = make_cylinder( false, n );
+		REQUIRE( 6*n == open.indices.size() );
+		REQUIRE( 2*n == open.positions.size() );
+		require_welded_( open );
+	}
+
+	SECTION( "Cone" )
+	{
+		// One tip vertex per segment (their normals differ); the cap has its
+		// own ring and center.
+		auto const capped = make_cone( true, n );
+		REQUIRE( 6*n == capped.indices.size() );
+		REQUIRE( 3*n + 1 == capped.positions.size() );
+		require_welded_( capped );
+
+		auto const open = make_cone( false, n );
+		REQUIRE( 3*n == open.indices.size() );
+		REQUIRE( 2*n == open.positions.size() );
+		require_welded_( open );
+	}
+
+	SECTION( "Cube" )
+	{
+		auto const cube = make_cube( true, n );
+		REQUIRE( 6 * n*n * 6 == cube.indices.size() );
+		REQUIRE( 6 * (n+1)*(n+1) == cube.positions.size() );
+		require_welded_( cube );
+	}
+}
@@ -1,74 +1,84 @@
 #include "cone.hpp"
 
+#include <cassert>
+#include <cmath>
 
-#include "../vmlib/mat33.hpp"
-
+#include "shape_common.hpp"
 
+/*
+	The cone's tip is at the origin, and its base is the unit circle in the
+	plane x = 1. The shell is a fan of aSubdivs triangles. The base ring is
+	shared between neighbouring triangles, but each triangle has its own tip
+	vertex: the shell normal depends on the direction around the axis, and
+	at the tip that's the direction of the triangle's middle. The cap is a
+	fan around the base's center.
+*/
 SimpleMeshData make_cone(bool aCapped, std::size_t aSubdivs, Vec3f aColor, Mat44f aPreTransform)
 {
-    // initialize 'pos' for containing the vertex positions of the cone's shell.
-    std::vector<Vec3f> pos;
-    std::vector<Vec3f> nor;
-    // initialize previous YZ Coordinates to hold the cosine and sine value
-    float prevY = std::cos(0.f);
-    float prevZ = std::sin(0.f);
-    // loop over subdivisions
-    for (std::size_t i = 0; i < aSubdivs; ++i)
-    {
-        // calculate current angle
-        float const angle = (i + 1) / float(aSubdivs) * 2.f * 3.1415926f;
-        // calculate current YZ Coordinates
-        float y = std::cos(angle);
-        float z = std::sin(angle);
-        // create triangle for one shell segment
-        // one triangle (= 3 positions) create one segment of the cone's shell.
-        // emplace_back (=push back) -> different point is inserted directly into vec without copying
-        pos.emplace_back(Vec3f{ 0.f, 0.f, 0.f }); // Apex of the cone
-        nor.emplace_back(Vec3f{ 0.f, 0.f, 0.f });
-        pos.emplace_back(Vec3f{ 1.f, y, z });
-        nor.emplace_back(Vec3f{ 1.f, y, z });
-        pos.emplace_back(Vec3f{ 1.f, prevY, prevZ });
-        nor.emplace_back(Vec3f{ 1.f, prevY, prevZ });
-
-
-        // update previous YZ coordinates
-        prevY = y;
-        prevZ = z;
-    }
-
-    if (aCapped)
-    {
-        // Add bottom cap
-        pos.emplace_back(Vec3f{ 0.f, 0.f, 0.f });
-        nor.emplace_back(Vec3f{ 0.f, 0.f, 0.f });
-        pos.emplace_back(Vec3f{ 1.f, 0.f, 0.f });
-        nor.emplace_back(Vec3f{ 1.f, 0.f, 0.f });
-        pos.emplace_back(Vec3f{ 0.5f, 0.f, 0.5f });
-        nor.emplace_back(Vec3f{ 0.5f, 0.f, 0.5f });
-    }
-
-    // pre-compute N once by extracting the 3x3 submatrix of inverse-transpose of M
-    Mat33f const N = mat44_to_mat33(transpose(invert(aPreTransform)));
-
-    // Transform the positions with the aPreTransform matrix
-    for (auto& p : pos)
-    {
-        Vec4f p4{ p.x, p.y, p.z, 1.f };
-        Vec4f t = aPreTransform * p4;
-        t /= t.w;
-
-        p = Vec3f{ t.x, t.y, t.z };
-    }
-
-    for (auto& n : nor)
-    {
-        Vec3f p4{ n.x, n.y, n.z };
-        Vec3f t = N * p4;
-
-        n = Vec3f{ t.x, t.y, t.z };
-    }
-    std::vector col(pos.size(), aColor);
-
-    return SimpleMeshData{ std::move(pos), std::move(col), std::move(nor) };
+	assert( aSubdivs >= 3 );
+
+	auto const& circle = unit_circle( aSubdivs );
+	auto const n = aSubdivs;
+
+	std::size_t const vertexCount = aCapped ? 3*n + 1 : 2*n;
+	std::size_t const indexCount = aCapped ? 6*n : 3*n;
+
+	SimpleMeshData ret;
+	ret.positions.resize( vertexCount );
+	ret.normals.resize( vertexCount );
+	ret.colors.assign( vertexCount, aColor );
+	ret.indices.resize( indexCount );
+
+	// The shell leans back by 45 degrees: its normal at angle a is
+	// ( -1, cos a, sin a ) / sqrt(2).
+	float const k = 1.f / std::sqrt( 2.f );
+
+	// Tips are [0,n), the base ring is [n,2n)
+	for( std::size_t i = 0; i < n; ++i )
+	{
+		auto const c = circle[i];
+		auto const d = circle[(i+1) % n];
+
+		float const my = c.x + d.x, mz = c.y + d.y;
+		float const ml = std::sqrt( my*my + mz*mz );
+
+		ret.positions[i] = Vec3f{ 0.f, 0.f, 0.f };
+		ret.normals[i] = Vec3f{ -k, k * my / ml, k * mz / ml };
+
+		ret.positions[n+i] = Vec3f{ 1.f, c.x, c.y };
+		ret.normals[n+i] = Vec3f{ -k, k * c.x, k * c.y };
+	}
+
+	auto* idx = ret.indices.data();
+	for( std::size_t i = 0; i < n; ++i )
+	{
+		auto const j = (i+1) % n;
+		*idx++ = std::uint32_t(i); *idx++ = std::uint32_t(n+j); *idx++ = std::uint32_t(n+i);
+	}
+
+	if( aCapped )
+	{
+		// Cap (normal +x) is [2n,3n) with its center at 3n
+		auto const base = 2*n, center = 3*n;
+		for( std::size_t i = 0; i < n; ++i )
+		{
+			auto const c = circle[i];
+			ret.positions[base+i] = Vec3f{ 1.f, c.x, c.y };
+			ret.normals[base+i] = Vec3f{ 1.f, 0.f, 0.f };
+		}
+
+		ret.positions[center] = Vec3f{ 1.f, 0.f, 0.f };
+		ret.normals[center] = Vec3f{ 1.f, 0.f, 0.f };
+
+		for( std::size_t i = 0; i < n; ++i )
+		{
+			auto const j = (i+1) % n;
+			*idx++ = std::uint32_t(base+i); *idx++ = std::uint32_t(base+j); *idx++ = std::uint32_t(center);
+		}
+	}
+
+	assert( idx == ret.indices.data() + indexCount );
 
+	apply_pre_transform( ret, aPreTransform );
+	return ret;
 }
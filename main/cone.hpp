@@ -10,6 +10,8 @@
 #include "../vmlib/vec3.hpp"
 #include "../vmlib/mat44.hpp"
 
+// Indexed cone around the x axis, with its tip at the origin and a base of
+// radius 1 at x = 1, with aSubdivs segments (and a cap, if aCapped).
 SimpleMeshData make_cone(
 	bool aCapped = true,
 	std::size_t aSubdivs = 16,
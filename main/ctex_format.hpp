@@ -0,0 +1,45 @@
+#ifndef CTEX_FORMAT_HPP_61F0B2D8_94C3_4E7A_A1D5_0C8E3B7F2A96
+#define CTEX_FORMAT_HPP_61F0B2D8_94C3_4E7A_A1D5_0C8E3B7F2A96
+
+#include <cstddef>
+#include <cstdint>
+
+/* Compressed texture container (.ctex), written by texconv and read by
+ * load_compressed_image() in texture.cpp.
+ *
+ * Layout (all values little endian):
+ *   CtexHeader
+ *   CtexLevel[header.levelCount]
+ *   level data, each level starting at a multiple of kCtexAlign
+ *
+ * Level 0 is the full-resolution image. Each level is stored as-is for
+ * glCompressedTexSubImage2D(), i.e., as rows of 4x4 blocks, bottom row first
+ * (matching OpenGL's texture coordinate convention). Levels are complete
+ * down to 1x1, and were filtered in linear space when the format is sRGB.
+ */
+
+constexpr char kCtexMagic[8] = { '\0', 'C', 'O', 'M', 'P', 't', 'e', 'x' };
+constexpr std::uint32_t kCtexVersion = 1;
+constexpr std::size_t kCtexAlign = 16;
+
+struct CtexHeader
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t glInternalFormat; // e.g. GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+	std::uint32_t width, height;
+	std::uint32_t blockBytes; // bytes per 4x4 block
+	std::uint32_t levelCount;
+};
+
+struct CtexLevel
+{
+	std::uint32_t width, height;
+	std::uint64_t offset; // from start of file
+	std::uint64_t bytes;
+};
+
+static_assert( sizeof(CtexHeader) == 32 );
+static_assert( sizeof(CtexLevel) == 24 );
+
+#endif // CTEX_FORMAT_HPP_61F0B2D8_94C3_4E7A_A1D5_0C8E3B7F2A96
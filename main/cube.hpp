@@ -10,7 +10,8 @@
 #include "../vmlib/vec3.hpp"
 #include "../vmlib/mat44.hpp"
 
-
+// Indexed cube from -0.5 to 0.5 along each axis. Each face is a grid of
+// aSubdivs x aSubdivs quads. (aCapped is ignored.)
 SimpleMeshData make_cube(
 	bool aCapped = true,
 	std::size_t aSubdivs = 16,
@@ -0,0 +1,229 @@
+#include "culling.hpp"
+
+#include <limits>
+#include <numeric>
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+namespace
+{
+	Vec4f row_( Mat44f const& aM, std::size_t aRow ) noexcept
+	{
+		return Vec4f{ aM(aRow,0), aM(aRow,1), aM(aRow,2), aM(aRow,3) };
+	}
+
+	Vec4f normalize_plane_( Vec4f aPlane ) noexcept
+	{
+		float const len = std::sqrt( aPlane.x*aPlane.x + aPlane.y*aPlane.y + aPlane.z*aPlane.z );
+		if( len > 0.f )
+			return Vec4f{ aPlane.x/len, aPlane.y/len, aPlane.z/len, aPlane.w/len };
+		return aPlane;
+	}
+
+	Vec3f chunk_center_( MeshChunk const& aChunk ) noexcept
+	{
+		return (aChunk.boundsMin + aChunk.boundsMax) * 0.5f;
+	}
+}
+
+Frustum make_frustum( Mat44f const& aM ) noexcept
+{
+	// A point p is inside if -w <= x,y,z <= w for (x,y,z,w) = M p. Each of
+	// the six inequalities is a plane: e.g. x >= -w  <=>  (row3 + row0).p >= 0.
+	auto const r0 = row_( aM, 0 ), r1 = row_( aM, 1 ), r2 = row_( aM, 2 ), r3 = row_( aM, 3 );
+
+	Frustum ret;
+	ret.planes[0] = normalize_plane_( r3 + r0 ); // left
+	ret.planes[1] = normalize_plane_( r3 - r0 ); // right
+	ret.planes[2] = normalize_plane_( r3 + r1 ); // bottom
+	ret.planes[3] = normalize_plane_( r3 - r1 ); // top
+	ret.planes[4] = normalize_plane_( r3 + r2 ); // near
+	ret.planes[5] = normalize_plane_( r3 - r2 ); // far
+	return ret;
+}
+
+CullResult test_box( Frustum const& aFrustum, Vec3f aMin, Vec3f aMax ) noexcept
+{
+	auto ret = CullResult::inside;
+	for( auto const& plane : aFrustum.planes )
+	{
+		// Corner furthest along the plane normal (p) and the opposite one (n)
+		Vec3f const p{
+			plane.x >= 0.f ? aMax.x : aMin.x,
+			plane.y >= 0.f ? aMax.y : aMin.y,
+			plane.z >= 0.f ? aMax.z : aMin.z
+		};
+		Vec3f const n{
+			plane.x >= 0.f ? aMin.x : aMax.x,
+			plane.y >= 0.f ? aMin.y : aMax.y,
+			plane.z >= 0.f ? aMin.z : aMax.z
+		};
+
+		if( plane.x*p.x + plane.y*p.y + plane.z*p.z + plane.w < 0.f )
+			return CullResult::outside;
+		if( plane.x*n.x + plane.y*n.y + plane.z*n.z + plane.w < 0.f )
+			ret = CullResult::intersecting;
+	}
+	return ret;
+}
+
+bool test_sphere( Frustum const& aFrustum, Vec3f aCenter, float aRadius ) noexcept
+{
+	for( auto const& plane : aFrustum.planes )
+	{
+		if( plane.x*aCenter.x + plane.y*aCenter.y + plane.z*aCenter.z + plane.w < -aRadius )
+			return false;
+	}
+	return true;
+}
+
+bool is_backfacing( Meshlet const& aMeshlet, Vec3f aEye ) noexcept
+{
+	// See meshlets.hpp
+	auto const view = aMeshlet.center - aEye;
+	float const distance = length( view );
+	return dot( view, aMeshlet.coneAxis ) >= aMeshlet.coneCutoff * (distance + aMeshlet.radius) + aMeshlet.radius;
+}
+
+void cull_meshlets( Meshlet const* aMeshlets, std::size_t aMeshletCount, Frustum const& aFrustum, Vec3f aEye, std::vector<IndexRange>& aOut, CullStats& aStats )
+{
+	aStats.meshletsTested += aMeshletCount;
+
+	for( std::size_t i = 0; i < aMeshletCount; ++i )
+	{
+		auto const& meshlet = aMeshlets[i];
+		if( !test_sphere( aFrustum, meshlet.center, meshlet.radius ) || is_backfacing( meshlet, aEye ) )
+			continue;
+
+		++aStats.meshletsVisible;
+
+		if( !aOut.empty() && aOut.back().firstIndex + aOut.back().indexCount == meshlet.firstIndex )
+			aOut.back().indexCount += meshlet.indexCount;
+		else
+			aOut.emplace_back( IndexRange{ meshlet.firstIndex, meshlet.indexCount } );
+	}
+}
+
+
+ChunkBvh::ChunkBvh( MeshChunk const* aChunks, std::size_t aChunkCount )
+{
+	if( 0 == aChunkCount )
+		return;
+
+	std::vector<std::uint32_t> chunks( aChunkCount );
+	std::iota( chunks.begin(), chunks.end(), std::uint32_t(0) );
+
+	mNodes.reserve( 2*aChunkCount - 1 );
+	mNodes.emplace_back(); // root
+	build_( aChunks, 0, chunks, 0, aChunkCount );
+}
+
+void ChunkBvh::cull( Frustum const& aFrustum, std::vector<std::uint32_t>& aVisible, CullStats& aStats ) const
+{
+	if( mNodes.empty() )
+		return;
+
+	// Explicit stack. The tree is balanced, so 64 entries are plenty.
+	std::uint32_t stack[64];
+	std::size_t top = 0;
+	stack[top++] = 0;
+
+	while( top > 0 )
+	{
+		auto const index = stack[--top];
+		auto const& node = mNodes[index];
+
+		++aStats.nodesTested;
+		if( node.leaf )
+			++aStats.chunksTested;
+
+		auto const result = test_box( aFrustum, node.boundsMin, node.boundsMax );
+		if( CullResult::outside == result )
+			continue;
+
+		if( CullResult::inside == result || node.leaf )
+		{
+			auto const before = aVisible.size();
+			collect_( index, aVisible );
+			aStats.chunksVisible += aVisible.size() - before;
+			continue;
+		}
+
+		assert( top+2 <= sizeof(stack)/sizeof(stack[0]) );
+		stack[top++] = node.child+1;
+		stack[top++] = node.child;
+	}
+}
+
+std::size_t ChunkBvh::node_count() const noexcept
+{
+	return mNodes.size();
+}
+
+void ChunkBvh::build_( MeshChunk const* aChunks, std::uint32_t aNode, std::vector<std::uint32_t>& aIndices, std::size_t aBegin, std::size_t aEnd )
+{
+	assert( aEnd > aBegin );
+
+	Vec3f bmin{ std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+	Vec3f bmax = -bmin;
+	Vec3f cmin = bmin, cmax = bmax;
+	for( auto i = aBegin; i < aEnd; ++i )
+	{
+		auto const& chunk = aChunks[aIndices[i]];
+		bmin = Vec3f{ std::min( bmin.x, chunk.boundsMin.x ), std::min( bmin.y, chunk.boundsMin.y ), std::min( bmin.z, chunk.boundsMin.z ) };
+		bmax = Vec3f{ std::max( bmax.x, chunk.boundsMax.x ), std::max( bmax.y, chunk.boundsMax.y ), std::max( bmax.z, chunk.boundsMax.z ) };
+
+		auto const c = chunk_center_( chunk );
+		cmin = Vec3f{ std::min( cmin.x, c.x ), std::min( cmin.y, c.y ), std::min( cmin.z, c.z ) };
+		cmax = Vec3f{ std::max( cmax.x, c.x ), std::max( cmax.y, c.y ), std::max( cmax.z, c.z ) };
+	}
+
+	mNodes[aNode].boundsMin = bmin;
+	mNodes[aNode].boundsMax = bmax;
+
+	if( 1 == aEnd - aBegin )
+	{
+		mNodes[aNode].child = aIndices[aBegin];
+		mNodes[aNode].leaf = true;
+		return;
+	}
+
+	// Median split of the chunk centers along the longest axis
+	auto const extent = cmax - cmin;
+	float Vec3f::* axis = &Vec3f::x;
+	if( extent.y > extent.x && extent.y >= extent.z )
+		axis = &Vec3f::y;
+	else if( extent.z > extent.x && extent.z > extent.y )
+		axis = &Vec3f::z;
+
+	auto const mid = aBegin + (aEnd - aBegin) / 2;
+	std::nth_element( aIndices.begin() + aBegin, aIndices.begin() + mid, aIndices.begin() + aEnd, [&] (std::uint32_t aA, std::uint32_t aB) {
+		return chunk_center_( aChunks[aA] ).*axis < chunk_center_( aChunks[aB] ).*axis;
+	} );
+
+	// Children are stored next to each other
+	auto const left = std::uint32_t(mNodes.size());
+	mNodes.emplace_back();
+	mNodes.emplace_back();
+
+	mNodes[aNode].child = left;
+	mNodes[aNode].leaf = false;
+
+	build_( aChunks, left, aIndices, aBegin, mid );
+	build_( aChunks, left+1, aIndices, mid, aEnd );
+}
+
+void ChunkBvh::collect_( std::uint32_t aNode, std::vector<std::uint32_t>& aOut ) const
+{
+	auto const& node = mNodes[aNode];
+	if( node.leaf )
+	{
+		aOut.emplace_back( node.child );
+		return;
+	}
+
+	collect_( node.child, aOut );
+	collect_( node.child+1, aOut );
+}
@@ -0,0 +1,113 @@
+#ifndef CULLING_HPP_46C1B8E3_0F2D_4A97_8E5B_C3D9A1F07264
+#define CULLING_HPP_46C1B8E3_0F2D_4A97_8E5B_C3D9A1F07264
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "meshlets.hpp"
+#include "mesh_chunks.hpp"
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/vec4.hpp"
+#include "../vmlib/mat44.hpp"
+
+/* View frustum, as six planes (a,b,c,d) with a*x + b*y + c*z + d >= 0 for
+ * points inside.
+ *
+ * The planes are extracted from a clip-space transform (Gribb & Hartmann,
+ * Fast Extraction of Viewing Frustum Planes from the World-View-Projection
+ * Matrix). They live in whatever space the transform's input is in: pass
+ * projCameraWorld to get world-space planes, or projCameraWorld * model2world
+ * to get planes in the model's object space.
+ */
+struct Frustum
+{
+	Vec4f planes[6];
+};
+
+Frustum make_frustum( Mat44f const& aClipFromSpace ) noexcept;
+
+enum class CullResult
+{
+	outside,
+	intersecting,
+	inside
+};
+
+CullResult test_box( Frustum const&, Vec3f aMin, Vec3f aMax ) noexcept;
+
+// True if the sphere is (at least partially) inside the frustum
+bool test_sphere( Frustum const&, Vec3f aCenter, float aRadius ) noexcept;
+
+// True if all triangles of the meshlet face away from a viewer at aEye (in
+// the same space as the meshlet).
+bool is_backfacing( Meshlet const&, Vec3f aEye ) noexcept;
+
+// Per-frame culling statistics
+struct CullStats
+{
+	std::size_t nodesTested;        // BVH nodes tested against the frustum
+	std::size_t chunksTested;       // chunks tested individually (BVH leaves)
+	std::size_t chunksVisible;      // in the frustum
+	std::size_t chunksOccluded;     // in the frustum, but hidden (see occlusion.hpp)
+	std::size_t meshletsTested;
+	std::size_t meshletsVisible;
+	std::size_t trianglesSubmitted;
+	std::size_t drawCalls;
+	std::size_t indirectDraws;      // glMultiDrawElementsIndirect() calls (GPU culling)
+};
+
+/* ChunkBvh: bounding volume hierarchy over the chunks of a mesh.
+ *
+ * Binary tree, built with median splits along the longest axis, with one
+ * chunk per leaf. Subtrees that are entirely outside the frustum are
+ * skipped; subtrees that are entirely inside are accepted without further
+ * tests.
+ */
+class ChunkBvh final
+{
+	public:
+		ChunkBvh() = default;
+		ChunkBvh( MeshChunk const*, std::size_t aChunkCount );
+
+	public:
+		// Appends the indices of visible chunks to aVisible.
+		void cull( Frustum const&, std::vector<std::uint32_t>& aVisible, CullStats& ) const;
+
+		std::size_t node_count() const noexcept;
+
+	private:
+		struct Node_
+		{
+			Vec3f boundsMin, boundsMax;
+			std::uint32_t child; // inner: left child (right = child+1); leaf: chunk index
+			bool leaf;
+		};
+
+		void build_( MeshChunk const*, std::uint32_t aNode, std::vector<std::uint32_t>& aChunks, std::size_t aBegin, std::size_t aEnd );
+		void collect_( std::uint32_t aNode, std::vector<std::uint32_t>& ) const;
+
+	private:
+		std::vector<Node_> mNodes;
+};
+
+
+// Range of a mesh's index buffer
+struct IndexRange
+{
+	std::uint32_t firstIndex;
+	std::uint32_t indexCount;
+};
+
+// Tests meshlets against the frustum and their normal cones against the eye
+// position, and appends the index ranges of those that survive to aOut.
+// Ranges of meshlets that are adjacent in the index buffer are merged.
+void cull_meshlets(
+	Meshlet const*, std::size_t aMeshletCount,
+	Frustum const&, Vec3f aEye,
+	std::vector<IndexRange>& aOut, CullStats&
+);
+
+#endif // CULLING_HPP_46C1B8E3_0F2D_4A97_8E5B_C3D9A1F07264
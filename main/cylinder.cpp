@@ -1,94 +1,84 @@
 #include "cylinder.hpp"
 
-#include "../vmlib/mat33.hpp"
+#include <cassert>
+
+#include "shape_common.hpp"
+
 /*
-	Generating the vertex positions of the cylinder's outer shell by walking around a circle
-	in the YZ-plane and creating triangles for each segment
+	The cylinder's shell is a ring of aSubdivs quads between two rings of
+	vertices, at x = 0 and x = 1, walking around the unit circle in the YZ
+	plane. Neighbouring quads share their vertices. Each cap is a fan around
+	a center vertex; caps have their own vertices, as their normals differ
+	from the shell's.
 */
 SimpleMeshData make_cylinder(bool aCapped, std::size_t aSubdivs, Vec3f aColor, Mat44f aPreTransform)
 {
-	//TODO: implement me
-
-	// initialize 'pos' for containg the vertex positions of the cylinder's shell. 
-	std::vector<Vec3f> pos;
-	// initialize 'nor' for storing normal vec postitions for each generated vertex.
-	std::vector<Vec3f> nor;
-	// initialize previous YZ Coordinates to hold the cosine and sine value 
-	float prevY = std::cos(0.f);
-	float prevZ = std::sin(0.f);
-	// loop over subdivisions 
-	for (std::size_t i = 0; i < aSubdivs; ++i) {
-		// calculate current angle 
-		float const angle = (i + 1) / float(aSubdivs) * 2.f * 3.1415926f;
-		// calculate current YZ Coordinates 
-		float y = std::cos(angle);
-		float z = std::sin(angle);
-		// create 2 triangles(forming a quad) for one shell segment	
-		// Two triangles (= 3*2 positions) create one segment of the cylinder's shell. 
-		// emplace_back (=push back) -> �ٸ� ���� ��Ұ� ������� �ʰ� �ٷ� vec�� ���� 
-		pos.emplace_back(Vec3f{ 0.f, prevY, prevZ });
-		// compute normals for each generated vertex as well 
-		nor.emplace_back(Vec3f{ 0.f,prevY, prevZ });
-		pos.emplace_back(Vec3f{ 0.f, y, z });
-		nor.emplace_back(Vec3f{ 0.f,y, z });
-		pos.emplace_back(Vec3f{ 1.f, prevY, prevZ });
-		nor.emplace_back(Vec3f{ 0.f,prevY, prevZ });
-
-		pos.emplace_back(Vec3f{ 0.f, y, z });
-		nor.emplace_back(Vec3f{ 0.f,y, z });
-		pos.emplace_back(Vec3f{ 1.f, y, z });
-		nor.emplace_back(Vec3f{ 0.f,y, z });
-		pos.emplace_back(Vec3f{ 1.f, prevY, prevZ });
-		nor.emplace_back(Vec3f{ 0.f,prevY, prevZ });
-		// cap on 
-		if (aCapped) {
-			// Add top cap
-			// (-1; 0; 0) if point on cap at x = 0
-			pos.emplace_back(Vec3f{ 0.f, y, z });
-nor.emplace_back(Vec3f{ -1, 0, 0 }); // Assuming the normal for the top cap is along -x axis
-
-pos.emplace_back(Vec3f{ 0.f, prevY, prevZ });
-nor.emplace_back(Vec3f{ -1, 0, 0 });
-
-pos.emplace_back(Vec3f{ 0.f, 0, 0 });
-nor.emplace_back(Vec3f{ -1, 0, 0 });
-
-			// Add bottom cap
-			//(1; 0; 0); if point on cap at x = 1.
-pos.emplace_back(Vec3f{ 1.f, prevY, prevZ });
-nor.emplace_back(Vec3f{ 1, 0, 0 }); // Assuming the normal for the bottom cap is along +x axis
-
-pos.emplace_back(Vec3f{ 1.f, y, z });
-nor.emplace_back(Vec3f{ 1, 0, 0 });
-
-pos.emplace_back(Vec3f{ 1.f, 0, 0 });
-nor.emplace_back(Vec3f{ 1, 0, 0 });
-		}
+	assert( aSubdivs >= 3 );
+
+	auto const& circle = unit_circle( aSubdivs );
+	auto const n = aSubdivs;
 
-		// update previous YZ coordinates 
-		prevY = y;
-		prevZ = z;
+	std::size_t const vertexCount = aCapped ? 4*n + 2 : 2*n;
+	std::size_t const indexCount = aCapped ? 12*n : 6*n;
+
+	SimpleMeshData ret;
+	ret.positions.resize( vertexCount );
+	ret.normals.resize( vertexCount );
+	ret.colors.assign( vertexCount, aColor );
+	ret.indices.resize( indexCount );
+
+	// Shell: ring at x = 0 is [0,n), ring at x = 1 is [n,2n)
+	for( std::size_t i = 0; i < n; ++i )
+	{
+		auto const c = circle[i];
+		ret.positions[i] = Vec3f{ 0.f, c.x, c.y };
+		ret.positions[n+i] = Vec3f{ 1.f, c.x, c.y };
+		ret.normals[i] = ret.normals[n+i] = Vec3f{ 0.f, c.x, c.y };
 	}
-	// pre-compute N once by extracting the 3x3 submatrix of inverse-transpose of M
-	Mat33f const N = mat44_to_mat33(transpose(invert(aPreTransform)));
 
-	// Transform the positions with the aPreTransform matrix
-	for (auto& p : pos) {
-		Vec4f p4{ p.x, p.y, p.z, 1.f };
-		Vec4f t = aPreTransform * p4;
-		t /= t.w;
+	auto* idx = ret.indices.data();
+	for( std::size_t i = 0; i < n; ++i )
+	{
+		auto const j = (i+1) % n;
+		auto const a0 = std::uint32_t(i), a1 = std::uint32_t(j);
+		auto const b0 = std::uint32_t(n+i), b1 = std::uint32_t(n+j);
 
-		p = Vec3f{ t.x, t.y, t.z };
+		*idx++ = a0; *idx++ = a1; *idx++ = b0;
+		*idx++ = a1; *idx++ = b1; *idx++ = b0;
 	}
-	for (auto& n : nor)
+
+	if( aCapped )
 	{
-		Vec3f p4{ n.x, n.y, n.z };
-		Vec3f t = N * p4;
+		// Cap at x = 0 (normal -x) is [2n,3n) with its center at 3n, the cap
+		// at x = 1 (normal +x) is [3n+1,4n+1) with its center at 4n+1.
+		auto const base0 = 2*n, center0 = 3*n;
+		auto const base1 = 3*n + 1, center1 = 4*n + 1;
+
+		for( std::size_t i = 0; i < n; ++i )
+		{
+			auto const c = circle[i];
+			ret.positions[base0+i] = Vec3f{ 0.f, c.x, c.y };
+			ret.normals[base0+i] = Vec3f{ -1.f, 0.f, 0.f };
+			ret.positions[base1+i] = Vec3f{ 1.f, c.x, c.y };
+			ret.normals[base1+i] = Vec3f{ 1.f, 0.f, 0.f };
+		}
 
-		n = Vec3f{ t.x, t.y, t.z };
+		ret.positions[center0] = Vec3f{ 0.f, 0.f, 0.f };
+		ret.normals[center0] = Vec3f{ -1.f, 0.f, 0.f };
+		ret.positions[center1] = Vec3f{ 1.f, 0.f, 0.f };
+		ret.normals[center1] = Vec3f{ 1.f, 0.f, 0.f };
+
+		for( std::size_t i = 0; i < n; ++i )
+		{
+			auto const j = (i+1) % n;
+
+			*idx++ = std::uint32_t(base0+j); *idx++ = std::uint32_t(base0+i); *idx++ = std::uint32_t(center0);
+			*idx++ = std::uint32_t(base1+i); *idx++ = std::uint32_t(base1+j); *idx++ = std::uint32_t(center1);
+		}
 	}
 
-	std::vector col(pos.size(), aColor);
-	return SimpleMeshData{ std::move(pos), std::move(col), std::move(nor) };
+	assert( idx == ret.indices.data() + indexCount );
 
+	apply_pre_transform( ret, aPreTransform );
+	return ret;
 }
@@ -10,7 +10,8 @@
 #include "../vmlib/vec3.hpp"
 #include "../vmlib/mat44.hpp"
 
-
+// Indexed cylinder of radius 1 around the x axis, from x = 0 to x = 1,
+// with aSubdivs segments (and caps at both ends, if aCapped).
 SimpleMeshData make_cylinder(
 	bool aCapped = true,
 	std::size_t aSubdivs = 16,
@@ -0,0 +1,160 @@
+#include "gpu_culling.hpp"
+
+#include <vector>
+
+#include <algorithm>
+
+#include "culling.hpp"
+#include "instancing.hpp"
+#include "loadcustom.hpp"
+
+namespace
+{
+	// Must match local_size_x in assets/cull_chunks.comp
+	constexpr GLuint kWorkGroupSize_ = 64;
+
+	GLuint create_storage_buffer_( void const* aData, std::size_t aBytes, GLenum aUsage )
+	{
+		GLuint ret = 0;
+		glGenBuffers( 1, &ret );
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, ret );
+		glBufferData( GL_SHADER_STORAGE_BUFFER, GLsizeiptr(aBytes), aData, aUsage );
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+		return ret;
+	}
+}
+
+GpuCullMesh::GpuCullMesh( StaticMesh const& aMesh )
+	: mChunkCount( aMesh.chunks.size() )
+{
+	static_assert( sizeof(MeshChunk) == 32, "cull_chunks.comp expects 32 byte chunks" );
+	static_assert( sizeof(MeshLod) == 20, "cull_chunks.comp expects 20 byte levels of detail" );
+
+	mChunks = create_storage_buffer_( aMesh.chunks.data(), aMesh.chunks.size() * sizeof(MeshChunk), GL_STATIC_DRAW );
+	mLods = create_storage_buffer_( aMesh.lods.data(), aMesh.lods.size() * sizeof(MeshLod), GL_STATIC_DRAW );
+}
+
+GpuCullMesh::~GpuCullMesh()
+{
+	glDeleteBuffers( 1, &mLods );
+	glDeleteBuffers( 1, &mChunks );
+}
+
+std::size_t GpuCullMesh::chunk_count() const noexcept
+{
+	return mChunkCount;
+}
+
+
+GpuDrawList::GpuDrawList( GpuCullMesh const& aMesh, std::size_t aMaxInstances )
+	: mChunkCount( aMesh.chunk_count() )
+	, mMaxInstances( std::max( aMaxInstances, std::size_t(1) ) )
+	, mInstanceCount( 1 )
+{
+	// Start out empty, in case the list is drawn before it is culled
+	std::vector<DrawElementsIndirectCommand> const empty( mChunkCount * mMaxInstances, DrawElementsIndirectCommand{} );
+	mCommands = create_storage_buffer_( empty.data(), empty.size() * sizeof(DrawElementsIndirectCommand), GL_DYNAMIC_DRAW );
+}
+
+GpuDrawList::~GpuDrawList()
+{
+	glDeleteBuffers( 1, &mCommands );
+}
+
+void GpuDrawList::draw() const
+{
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, mCommands );
+	glMultiDrawElementsIndirect( GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, GLsizei(mChunkCount * mInstanceCount), 0 );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+}
+
+std::vector<DrawElementsIndirectCommand> GpuDrawList::commands() const
+{
+	std::vector<DrawElementsIndirectCommand> ret( mChunkCount * mInstanceCount );
+	glMemoryBarrier( GL_BUFFER_UPDATE_BARRIER_BIT );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mCommands );
+	glGetBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, GLsizeiptr(ret.size() * sizeof(DrawElementsIndirectCommand)), ret.data() );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+	return ret;
+}
+
+
+GpuCuller::GpuCuller( char const* aShaderPath )
+	: mProgram( { { GL_COMPUTE_SHADER, aShaderPath } } )
+{
+	Stats const zero{};
+	mStats = create_storage_buffer_( &zero, sizeof(zero), GL_DYNAMIC_READ );
+}
+
+GpuCuller::~GpuCuller()
+{
+	glDeleteBuffers( 1, &mStats );
+}
+
+void GpuCuller::begin_frame()
+{
+	// The previous frame's dispatches incremented the counters with atomics.
+	// Those writes must land before the reset does.
+	glMemoryBarrier( GL_BUFFER_UPDATE_BARRIER_BIT );
+
+	Stats const zero{};
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mStats );
+	glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), &zero );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+}
+
+void GpuCuller::cull( GpuCullMesh const& aMesh, GpuDrawList& aList, Mat44f const& aClipFromObject, Vec3f aEye, float aLodErrorScale )
+{
+	dispatch_( aMesh, aList, aClipFromObject, aEye, aLodErrorScale, 0, 1 );
+}
+
+void GpuCuller::cull( GpuCullMesh const& aMesh, InstanceBuffer const& aInstances, GpuDrawList& aList, Mat44f const& aClipFromWorld, Vec3f aEye, float aLodErrorScale )
+{
+	auto const count = std::min( aInstances.count(), aList.mMaxInstances );
+	dispatch_( aMesh, aList, aClipFromWorld, aEye, aLodErrorScale, aInstances.buffer(), count );
+}
+
+void GpuCuller::dispatch_( GpuCullMesh const& aMesh, GpuDrawList& aList, Mat44f const& aClipFromSpace, Vec3f aEye, float aLodErrorScale, GLuint aInstances, std::size_t aInstanceCount )
+{
+	aList.mInstanceCount = aInstanceCount;
+	if( 0 == aMesh.mChunkCount || 0 == aInstanceCount )
+		return;
+
+	auto const frustum = make_frustum( aClipFromSpace );
+
+	glUseProgram( mProgram.programId() );
+	glUniform4fv( kCullPlanesLocation, 6, &frustum.planes[0].x );
+	glUniform3f( kCullEyeLocation, aEye.x, aEye.y, aEye.z );
+	glUniform1f( kCullLodErrorScaleLocation, aLodErrorScale );
+	glUniform1ui( kCullChunkCountLocation, GLuint(aMesh.mChunkCount) );
+	glUniform1i( kCullInstancedLocation, 0 != aInstances );
+
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kCullChunksBinding, aMesh.mChunks );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kCullLodsBinding, aMesh.mLods );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kCullCommandsBinding, aList.mCommands );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kCullStatsBinding, mStats );
+	if( aInstances )
+		glBindBufferBase( GL_SHADER_STORAGE_BUFFER, kCullInstancesBinding, aInstances );
+
+	glDispatchCompute( GLuint((aMesh.mChunkCount + kWorkGroupSize_ - 1) / kWorkGroupSize_), GLuint(aInstanceCount), 1 );
+}
+
+void GpuCuller::finish()
+{
+	glMemoryBarrier( GL_COMMAND_BARRIER_BIT );
+}
+
+GpuCuller::Stats GpuCuller::stats() const
+{
+	Stats ret{};
+	glMemoryBarrier( GL_BUFFER_UPDATE_BARRIER_BIT );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, mStats );
+	glGetBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, sizeof(ret), &ret );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+	return ret;
+}
+
+void GpuCuller::reload()
+{
+	mProgram.reload();
+}
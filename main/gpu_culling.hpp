@@ -0,0 +1,172 @@
+#ifndef GPU_CULLING_HPP_E41B7A3D_6C28_4F95_A0D7_2B9C5E81F346
+#define GPU_CULLING_HPP_E41B7A3D_6C28_4F95_A0D7_2B9C5E81F346
+
+#include <glad.h>
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../support/program.hpp"
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/mat44.hpp"
+
+struct StaticMesh;
+class InstanceBuffer;
+
+// Uniform locations and buffer bindings used by assets/cull_chunks.comp
+constexpr GLint kCullPlanesLocation = 0; // vec4[6], locations 0 to 5
+constexpr GLint kCullEyeLocation = 6;
+constexpr GLint kCullLodErrorScaleLocation = 7;
+constexpr GLint kCullChunkCountLocation = 8;
+constexpr GLint kCullInstancedLocation = 9;
+
+constexpr GLuint kCullChunksBinding = 0;
+constexpr GLuint kCullLodsBinding = 1;
+constexpr GLuint kCullCommandsBinding = 2;
+constexpr GLuint kCullStatsBinding = 3;
+constexpr GLuint kCullInstancesBinding = 4;
+
+// Layout of the records read by glMultiDrawElementsIndirect()
+struct DrawElementsIndirectCommand
+{
+	std::uint32_t count;
+	std::uint32_t instanceCount;
+	std::uint32_t firstIndex;
+	std::int32_t baseVertex;
+	std::uint32_t baseInstance;
+};
+
+static_assert( sizeof(DrawElementsIndirectCommand) == 20 );
+
+/* GPU-side copy of the chunks and levels of detail of a StaticMesh.
+ *
+ * The MeshChunk and MeshLod arrays are uploaded as they are to shader
+ * storage buffers; assets/cull_chunks.comp declares matching std430
+ * structs. Shared by all instances of the mesh.
+ */
+class GpuCullMesh final
+{
+	public:
+		explicit GpuCullMesh( StaticMesh const& );
+		~GpuCullMesh();
+
+		GpuCullMesh( GpuCullMesh const& ) = delete;
+		GpuCullMesh& operator= (GpuCullMesh const&) = delete;
+
+	public:
+		std::size_t chunk_count() const noexcept;
+
+	private:
+		friend class GpuCuller;
+
+		GLuint mChunks, mLods;
+		std::size_t mChunkCount;
+};
+
+/* Indirect draw commands of a mesh: one command per chunk and instance,
+ * written by GpuCuller::cull(). Culled chunks get an empty command, so the
+ * whole list is always submitted with a single glMultiDrawElementsIndirect().
+ * Each command's baseInstance selects the instance's transform (see
+ * InstanceBuffer).
+ */
+class GpuDrawList final
+{
+	public:
+		explicit GpuDrawList( GpuCullMesh const&, std::size_t aMaxInstances = 1 );
+		~GpuDrawList();
+
+		GpuDrawList( GpuDrawList const& ) = delete;
+		GpuDrawList& operator= (GpuDrawList const&) = delete;
+
+	public:
+		// Draws with the mesh's VAO and element buffer, which must be bound.
+		void draw() const;
+
+		// Reads the commands back from the GPU (one per chunk and instance,
+		// as of the last cull). Waits for the culling to complete; meant for
+		// checks (see --check-gpu-culling), not for every frame.
+		std::vector<DrawElementsIndirectCommand> commands() const;
+
+	private:
+		friend class GpuCuller;
+
+		GLuint mCommands;
+		std::size_t mChunkCount;
+		std::size_t mMaxInstances;
+		std::size_t mInstanceCount;
+};
+
+/* GpuCuller: frustum culling and level of detail selection in a compute
+ * shader (assets/cull_chunks.comp).
+ *
+ * One invocation per chunk tests the chunk's bounds against the frustum
+ * and, if visible, selects its level of detail the same way as
+ * select_lod() in mesh_lod.hpp. It then writes the chunk's draw command.
+ * This replaces the per-chunk CPU work of the CPU path (see
+ * cull_chunks_()/build_draws_() in main.cpp), but doesn't do occlusion or
+ * meshlet culling.
+ *
+ * Each frame: begin_frame(), cull() each instance, then finish() before
+ * drawing the lists.
+ *
+ * Requires OpenGL 4.3 (compute shaders, shader storage buffers and
+ * glMultiDrawElementsIndirect()). The constructor throws if the shader
+ * can't be built, so that callers can fall back to the CPU path.
+ */
+class GpuCuller final
+{
+	public:
+		struct Stats
+		{
+			std::uint32_t chunksVisible;
+			std::uint32_t trianglesSubmitted;
+		};
+
+	public:
+		explicit GpuCuller( char const* aShaderPath = "assets/cull_chunks.comp" );
+		~GpuCuller();
+
+		GpuCuller( GpuCuller const& ) = delete;
+		GpuCuller& operator= (GpuCuller const&) = delete;
+
+	public:
+		// Resets the counters returned by stats()
+		void begin_frame();
+
+		// aEye is the camera position in the mesh's object space
+		void cull(
+			GpuCullMesh const&, GpuDrawList&,
+			Mat44f const& aClipFromObject, Vec3f aEye,
+			float aLodErrorScale
+		);
+
+		// Culls each instance of aInstances (at most the list's
+		// aMaxInstances). aEye is the camera position in world space.
+		void cull(
+			GpuCullMesh const&, InstanceBuffer const&, GpuDrawList&,
+			Mat44f const& aClipFromWorld, Vec3f aEye,
+			float aLodErrorScale
+		);
+
+		// Makes the commands visible to the indirect draws
+		void finish();
+
+		// Counters of the frame so far. Reads back from the GPU, which waits
+		// for the culling to complete, so avoid calling this every frame.
+		Stats stats() const;
+
+		// Recompiles the shader (keeps the old one on failure)
+		void reload();
+
+	private:
+		void dispatch_( GpuCullMesh const&, GpuDrawList&, Mat44f const&, Vec3f, float, GLuint aInstances, std::size_t aInstanceCount );
+
+	private:
+		ShaderProgram mProgram;
+		GLuint mStats;
+};
+
+#endif // GPU_CULLING_HPP_E41B7A3D_6C28_4F95_A0D7_2B9C5E81F346
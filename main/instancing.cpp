@@ -0,0 +1,122 @@
+#include "instancing.hpp"
+
+#include <cstdint>
+
+namespace
+{
+	// Column-major mat4, then a vec4 color
+	constexpr std::size_t kInstanceFloats_ = 16 + 4;
+	constexpr std::size_t kInstanceBytes_ = kInstanceFloats_ * sizeof(float);
+}
+
+InstanceBuffer::InstanceBuffer( std::size_t aCapacity )
+	: mBuffer( 0 )
+	, mCapacity( aCapacity > 0 ? aCapacity : 1 )
+	, mCount( 0 )
+{
+	glGenBuffers( 1, &mBuffer );
+	glBindBuffer( GL_ARRAY_BUFFER, mBuffer );
+	glBufferData( GL_ARRAY_BUFFER, GLsizeiptr(mCapacity * kInstanceBytes_), nullptr, GL_DYNAMIC_DRAW );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+	glDeleteBuffers( 1, &mBuffer );
+}
+
+void InstanceBuffer::attach( GLuint aVao ) const
+{
+	glBindVertexArray( aVao );
+	glBindBuffer( GL_ARRAY_BUFFER, mBuffer );
+
+	for( GLuint column = 0; column < 4; ++column )
+	{
+		auto const location = kInstanceTransformLocation + column;
+		glVertexAttribPointer(
+			location,
+			4, GL_FLOAT, GL_FALSE,
+			GLsizei(kInstanceBytes_),
+			reinterpret_cast<void const*>(std::uintptr_t(column * 4 * sizeof(float)))
+		);
+		glVertexAttribDivisor( location, 1 );
+		glEnableVertexAttribArray( location );
+	}
+
+	glVertexAttribPointer(
+		kInstanceColorLocation,
+		4, GL_FLOAT, GL_FALSE,
+		GLsizei(kInstanceBytes_),
+		reinterpret_cast<void const*>(std::uintptr_t(16 * sizeof(float)))
+	);
+	glVertexAttribDivisor( kInstanceColorLocation, 1 );
+	glEnableVertexAttribArray( kInstanceColorLocation );
+
+	glBindVertexArray( 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+}
+
+void InstanceBuffer::update( Mat44f const* aModel2World, std::size_t aCount )
+{
+	update( aModel2World, nullptr, aCount );
+}
+
+void InstanceBuffer::update( Mat44f const* aModel2World, Vec3f const* aColors, std::size_t aCount )
+{
+	// Mat44f is row-major, GLSL matrices are column-major
+	mScratch.resize( aCount * kInstanceFloats_ );
+	for( std::size_t i = 0; i < aCount; ++i )
+	{
+		float* out = mScratch.data() + i * kInstanceFloats_;
+		for( std::size_t column = 0; column < 4; ++column )
+		{
+			for( std::size_t row = 0; row < 4; ++row )
+				out[column*4 + row] = aModel2World[i]( row, column );
+		}
+
+		Vec3f const color = aColors ? aColors[i] : Vec3f{ 1.f, 1.f, 1.f };
+		out[16] = color.x;
+		out[17] = color.y;
+		out[18] = color.z;
+		out[19] = 1.f;
+	}
+
+	glBindBuffer( GL_ARRAY_BUFFER, mBuffer );
+	if( aCount > mCapacity )
+	{
+		while( mCapacity < aCount )
+			mCapacity *= 2;
+
+		glBufferData( GL_ARRAY_BUFFER, GLsizeiptr(mCapacity * kInstanceBytes_), nullptr, GL_DYNAMIC_DRAW );
+	}
+
+	if( aCount )
+		glBufferSubData( GL_ARRAY_BUFFER, 0, GLsizeiptr(aCount * kInstanceBytes_), mScratch.data() );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	mCount = aCount;
+}
+
+void InstanceBuffer::update( std::vector<Mat44f> const& aModel2World )
+{
+	update( aModel2World.data(), aModel2World.size() );
+}
+
+std::size_t InstanceBuffer::count() const noexcept
+{
+	return mCount;
+}
+
+GLuint InstanceBuffer::buffer() const noexcept
+{
+	return mBuffer;
+}
+
+void InstanceBuffer::use_default_instance()
+{
+	glVertexAttrib4f( kInstanceTransformLocation+0, 1.f, 0.f, 0.f, 0.f );
+	glVertexAttrib4f( kInstanceTransformLocation+1, 0.f, 1.f, 0.f, 0.f );
+	glVertexAttrib4f( kInstanceTransformLocation+2, 0.f, 0.f, 1.f, 0.f );
+	glVertexAttrib4f( kInstanceTransformLocation+3, 0.f, 0.f, 0.f, 1.f );
+	glVertexAttrib4f( kInstanceColorLocation, 1.f, 1.f, 1.f, 1.f );
+}
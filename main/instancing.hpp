@@ -0,0 +1,70 @@
+#ifndef INSTANCING_HPP_2D8F6A51_B3C7_4E09_91A4_7E5C0B3D26F8
+#define INSTANCING_HPP_2D8F6A51_B3C7_4E09_91A4_7E5C0B3D26F8
+
+#include <glad.h>
+
+#include <vector>
+
+#include <cstddef>
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/mat44.hpp"
+
+// Per-instance attributes in assets/default.vert: the model-to-world
+// transform (a mat4 takes four consecutive locations, one per column, 4 to
+// 7) and a color that multiplies the vertex colors.
+constexpr GLuint kInstanceTransformLocation = 4;
+constexpr GLuint kInstanceColorLocation = 8;
+
+/* InstanceBuffer: per-instance transforms and colors for instanced drawing.
+ *
+ * attach() adds the buffer to a VAO as attributes with a divisor of one, so
+ * that each instance of a glDraw*Instanced() call (or of an indirect draw
+ * command, via its baseInstance) gets its own transform and color. The same
+ * mesh can then be placed many times with a single draw call instead of one
+ * uniform update and draw call per copy.
+ *
+ * Each instance is a column-major mat4 followed by a vec4 color (80 bytes;
+ * the std430 layout of struct { mat4; vec4; }, so that compute shaders can
+ * read the buffer as well).
+ *
+ * VAOs without an instance buffer read the attributes' current generic
+ * values instead, which use_default_instance() sets to the identity and
+ * white. Call it once after creating the context.
+ */
+class InstanceBuffer final
+{
+	public:
+		explicit InstanceBuffer( std::size_t aCapacity = 16 );
+		~InstanceBuffer();
+
+		InstanceBuffer( InstanceBuffer const& ) = delete;
+		InstanceBuffer& operator= (InstanceBuffer const&) = delete;
+
+	public:
+		// Sets up the instance transform attribute of aVao. The buffer must
+		// outlive the VAO's use.
+		void attach( GLuint aVao ) const;
+
+		// Replaces the instances, growing the buffer if needed (the buffer
+		// object stays the same, so attached VAOs remain valid). Without
+		// colors, instances are white.
+		void update( Mat44f const* aModel2World, std::size_t aCount );
+		void update( Mat44f const* aModel2World, Vec3f const* aColors, std::size_t aCount );
+		void update( std::vector<Mat44f> const& );
+
+		std::size_t count() const noexcept;
+		GLuint buffer() const noexcept;
+
+	public:
+		static void use_default_instance();
+
+	private:
+		GLuint mBuffer;
+		std::size_t mCapacity;
+		std::size_t mCount;
+
+		std::vector<float> mScratch; // packed instances
+};
+
+#endif // INSTANCING_HPP_2D8F6A51_B3C7_4E09_91A4_7E5C0B3D26F8
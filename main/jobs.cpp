@@ -0,0 +1,63 @@
+#include "jobs.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool( unsigned aThreads )
+	: mStopping( false )
+{
+	if( 0 == aThreads )
+		aThreads = std::max( 2u, std::thread::hardware_concurrency() ) - 1;
+
+	mThreads.reserve( aThreads );
+	for( unsigned i = 0; i < aThreads; ++i )
+		mThreads.emplace_back( [this] { worker_(); } );
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mStopping = true;
+	}
+	mCond.notify_all();
+
+	for( auto& thread : mThreads )
+		thread.join();
+}
+
+unsigned ThreadPool::thread_count() const noexcept
+{
+	return unsigned(mThreads.size());
+}
+
+void ThreadPool::enqueue_( std::function<void()> aJob )
+{
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mQueue.emplace_back( std::move(aJob) );
+	}
+	mCond.notify_one();
+}
+
+void ThreadPool::worker_()
+{
+	for( ;; )
+	{
+		std::function<void()> job;
+
+		{
+			std::unique_lock<std::mutex> lock( mMutex );
+			mCond.wait( lock, [this] { return mStopping || !mQueue.empty(); } );
+
+			// Drain the queue before stopping
+			if( mQueue.empty() )
+				return;
+
+			job = std::move(mQueue.front());
+			mQueue.pop_front();
+		}
+
+		// packaged_task captures exceptions in the future
+		job();
+	}
+}
@@ -0,0 +1,74 @@
+#ifndef JOBS_HPP_7F3A2C91_5D4E_4B16_8E0A_C2B9D61F4E38
+#define JOBS_HPP_7F3A2C91_5D4E_4B16_8E0A_C2B9D61F4E38
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <future>
+#include <functional>
+#include <type_traits>
+#include <condition_variable>
+
+/* ThreadPool: a fixed set of worker threads that run submitted jobs in FIFO
+ * order.
+ *
+ * submit() returns a std::future for the job's result. Exceptions thrown by
+ * a job are captured and rethrown by future::get(). Example:
+ *
+ *   ThreadPool pool;
+ *   auto mesh = pool.submit( [] { return load_wavefront_obj( "foo.obj" ); } );
+ *   ...
+ *   SimpleMeshData data = mesh.get(); // waits if necessary
+ *
+ * Jobs must not make OpenGL calls; the GL context is only current on the
+ * main thread.
+ *
+ * The destructor finishes all jobs that have already been submitted.
+ */
+class ThreadPool final
+{
+	public:
+		// aThreads == 0 selects one thread per hardware thread, minus one for
+		// the main thread (but at least one).
+		explicit ThreadPool( unsigned aThreads = 0 );
+		~ThreadPool();
+
+		ThreadPool( ThreadPool const& ) = delete;
+		ThreadPool& operator= (ThreadPool const&) = delete;
+
+	public:
+		template< typename tFunc >
+		auto submit( tFunc&& aFunc ) -> std::future<std::invoke_result_t<std::decay_t<tFunc>>>;
+
+		unsigned thread_count() const noexcept;
+
+	private:
+		void enqueue_( std::function<void()> );
+		void worker_();
+
+	private:
+		std::vector<std::thread> mThreads;
+
+		std::mutex mMutex;
+		std::condition_variable mCond;
+		std::deque<std::function<void()>> mQueue;
+		bool mStopping;
+};
+
+template< typename tFunc > inline
+auto ThreadPool::submit( tFunc&& aFunc ) -> std::future<std::invoke_result_t<std::decay_t<tFunc>>>
+{
+	using Result_ = std::invoke_result_t<std::decay_t<tFunc>>;
+
+	// std::function requires copyable callables, but std::packaged_task is
+	// move-only. Share it instead.
+	auto task = std::make_shared<std::packaged_task<Result_()>>( std::forward<tFunc>(aFunc) );
+	auto future = task->get_future();
+
+	enqueue_( [task] { (*task)(); } );
+	return future;
+}
+
+#endif // JOBS_HPP_7F3A2C91_5D4E_4B16_8E0A_C2B9D61F4E38
@@ -1,12 +1,34 @@
 #include "loadcustom.hpp"
 
+#include <chrono>
+#include <limits>
+#include <utility>
+#include <filesystem>
+
 #include <cstdio>
 #include <cstddef>
 #include <cstring>
 #include <vector>
 
+#if defined(_WIN32)
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+
 #include "../support/error.hpp"
 
+#include "loadobj.hpp"
+#include "defaults.hpp"
+#include "mesh_lod.hpp"
+#include "mesh_chunks.hpp"
+#include "mesh_optimize.hpp"
+
 namespace
 {
 	// See readme.md for a description of the file structure!
@@ -29,7 +51,81 @@ namespace
 	// is less-than-optimal).
 	char kFileMagic[16] = "\0COMP3811mesh00";
 
+	// Version 01 of the format. The file is laid out such that it can be
+	// memory mapped and handed to OpenGL as-is:
+	//
+	//   offset  size  contents
+	//        0    16  file magic "\0COMP3811mesh01"
+	//       16   240  MeshHeader01_ (see below)
+	//      256   4*I  uint32 indices (I = indexCount)
+	//        -     -  padding to a multiple of 16 bytes
+	//        V   S*N  interleaved vertices (N = vertexCount, S = stride),
+	//                 described by the attribute records in the header
+	//        -     -  padding to a multiple of 16 bytes
+	//        L  20*C  levels of detail (MeshLod, C = lodCount; optional)
+	//        -     -  padding to a multiple of 16 bytes
+	//        K  32*M  chunks (MeshChunk, M = chunkCount; optional)
+	//        -     -  padding to a multiple of 16 bytes
+	//        T  40*T  meshlets (Meshlet, T = meshletCount; optional)
+	//
+	// All values are stored in native (little endian) byte order.
+	char kFileMagic01[16] = "\0COMP3811mesh01";
+
+	struct AttribRecord01_
+	{
+		std::uint32_t location;
+		std::uint32_t components;
+		std::uint32_t type;
+		std::uint32_t normalized;
+		std::uint32_t offset;
+	};
+
+	struct MeshHeader01_
+	{
+		std::uint32_t vertexCount;
+		std::uint32_t indexCount;
+		std::uint32_t stride;
+		std::uint32_t attribCount;
+
+		std::uint64_t sourceSize;
+		std::int64_t sourceModified;
+
+		float positionScale[3];
+		float positionBias[3];
+		float colorScale;
+		std::uint32_t sourcePipeline; // was reserved (always zero)
+
+		AttribRecord01_ attribs[kMaxVertexAttribs];
+		std::uint32_t lodCount;     // was padding (always zero)
+		std::uint32_t chunkCount;   // was padding (always zero)
+		std::uint32_t meshletCount; // was padding (always zero)
+		std::uint8_t padding[4];
+	};
+
+	static_assert( sizeof(MeshHeader01_) + sizeof(kFileMagic01) == 256 );
+
+	constexpr std::size_t kIndexOffset01_ = 256;
+
+	static_assert( sizeof(MeshLod) == 20 );
+	static_assert( sizeof(MeshChunk) == 32 );
+	static_assert( sizeof(Meshlet) == 40 );
+
+	constexpr std::size_t align16_( std::size_t aX ) noexcept
+	{
+		return (aX + 15) & ~std::size_t(15);
+	}
+
+	// Maximum simplification error of occluders, relative to the diagonal
+	// of their chunk
+	constexpr float kOccluderMaxError_ = 0.01f;
+
+	// Levels of detail and chunks of a mesh, with defaults for files that
+	// don't have them (a single level, and a single chunk with all levels)
+	std::vector<MeshLod> lods_of_( PackedMeshView const& );
+	std::vector<MeshChunk> chunks_of_( PackedMeshView const&, std::vector<MeshLod> const& );
+
 	void fread_( void* aPtr, std::size_t, std::FILE* );
+	void fwrite_( void const* aPtr, std::size_t, std::FILE* );
 
 	struct FileDeleter
 	{
@@ -57,35 +153,26 @@ SimpleMeshData load_simple_binary_mesh( char const* aPath )
 		std::uint32_t meta[2];
 		fread_( meta, sizeof(meta), fin );
 
-		// Indices
-		std::vector<std::uint32_t> indices( meta[1] );
-		fread_( indices.data(), sizeof(std::uint32_t)*meta[1], fin );
-
-		// Allocate space for the results
-		// Note: that the SimpleMeshData is not indexed, so we have to unwrap
-		// the mesh.
+		// SimpleMeshData supports indices, so the data is read straight into
+		// the result without unwrapping.
 		SimpleMeshData ret;
-		ret.positions.reserve( meta[1] );
-		ret.colors.reserve( meta[1] );
-		ret.normals.reserve( meta[1] );
+		ret.indices.resize( meta[1] );
+		fread_( ret.indices.data(), sizeof(std::uint32_t)*meta[1], fin );
 
-		// Temporary buffer for reading
-		std::vector<Vec3f> temp( meta[0] );
+		ret.positions.resize( meta[0] );
+		fread_( ret.positions.data(), sizeof(Vec3f)*meta[0], fin );
 
-		// Read positions
-		fread_( temp.data(), sizeof(Vec3f)*meta[0], fin );
-		for( auto const idx : indices )
-			ret.positions.emplace_back( temp[idx] );
+		ret.colors.resize( meta[0] );
+		fread_( ret.colors.data(), sizeof(Vec3f)*meta[0], fin );
 
-		// Read colors
-		fread_( temp.data(), sizeof(Vec3f)*meta[0], fin );
-		for( auto const idx : indices )
-			ret.colors.emplace_back( temp[idx] );
+		ret.normals.resize( meta[0] );
+		fread_( ret.normals.data(), sizeof(Vec3f)*meta[0], fin );
 
-		// Read normals
-		fread_( temp.data(), sizeof(Vec3f)*meta[0], fin );
-		for( auto const idx : indices )
-			ret.normals.emplace_back( temp[idx] );
+		for( auto const idx : ret.indices )
+		{
+			if( idx >= meta[0] )
+				throw Error( "'%s': index %u out of range (%u vertices)", aPath, idx, meta[0] );
+		}
 
 		return ret;
 	}
@@ -94,6 +181,462 @@ SimpleMeshData load_simple_binary_mesh( char const* aPath )
 }
 
 
+MeshSourceStamp make_source_stamp( char const* aSourcePath )
+{
+	namespace fs = std::filesystem;
+
+	std::error_code ec;
+	auto const size = fs::file_size( aSourcePath, ec );
+	if( ec )
+		throw Error( "make_source_stamp(): unable to stat '%s': %s", aSourcePath, ec.message().c_str() );
+
+	auto const time = fs::last_write_time( aSourcePath, ec );
+	if( ec )
+		throw Error( "make_source_stamp(): unable to stat '%s': %s", aSourcePath, ec.message().c_str() );
+
+	return MeshSourceStamp{
+		std::uint64_t(size),
+		std::int64_t(time.time_since_epoch().count()),
+		kMeshPipelineVersion
+	};
+}
+
+void write_packed_binary_mesh( char const* aPath, PackedMesh const& aMesh, MeshSourceStamp const& aSource )
+{
+	MeshHeader01_ header{};
+	header.vertexCount = std::uint32_t(aMesh.vertexCount);
+	header.indexCount = std::uint32_t(aMesh.indices.size());
+	header.stride = aMesh.layout.stride;
+	header.attribCount = aMesh.layout.attribCount;
+	header.sourceSize = aSource.size;
+	header.sourceModified = aSource.modified;
+	header.sourcePipeline = aSource.pipeline;
+
+	header.positionScale[0] = aMesh.dequant.positionScale.x;
+	header.positionScale[1] = aMesh.dequant.positionScale.y;
+	header.positionScale[2] = aMesh.dequant.positionScale.z;
+	header.positionBias[0] = aMesh.dequant.positionBias.x;
+	header.positionBias[1] = aMesh.dequant.positionBias.y;
+	header.positionBias[2] = aMesh.dequant.positionBias.z;
+	header.colorScale = aMesh.dequant.colorScale;
+	header.lodCount = std::uint32_t(aMesh.lods.size());
+	header.chunkCount = std::uint32_t(aMesh.chunks.size());
+	header.meshletCount = std::uint32_t(aMesh.meshlets.size());
+
+	for( std::uint32_t i = 0; i < aMesh.layout.attribCount; ++i )
+	{
+		auto const& attrib = aMesh.layout.attribs[i];
+		header.attribs[i] = AttribRecord01_{
+			attrib.location,
+			std::uint32_t(attrib.components),
+			attrib.type,
+			attrib.normalized,
+			attrib.offset
+		};
+	}
+
+	// Write to a temporary file first and move it into place once complete.
+	// This way, an interrupted write never leaves a truncated cache behind.
+	std::string const tempPath = std::string(aPath) + ".tmp";
+
+	{
+		std::FILE* fout = std::fopen( tempPath.c_str(), "wb" );
+		if( !fout )
+			throw Error( "write_packed_binary_mesh(): Unable to open '%s' for writing", tempPath.c_str() );
+
+		FileDeleter fd{ fout };
+
+		fwrite_( kFileMagic01, sizeof(kFileMagic01), fout );
+		fwrite_( &header, sizeof(header), fout );
+
+		std::size_t const indexBytes = aMesh.indices.size() * sizeof(std::uint32_t);
+		fwrite_( aMesh.indices.data(), indexBytes, fout );
+
+		static constexpr char kZeros[16] = {};
+		fwrite_( kZeros, align16_( indexBytes ) - indexBytes, fout );
+
+		fwrite_( aMesh.vertices.data(), aMesh.vertices.size(), fout );
+
+		// Optional tables, each aligned to 16 bytes. Empty tables take no
+		// space (other than padding).
+		std::size_t offset = kIndexOffset01_ + align16_( indexBytes ) + aMesh.vertices.size();
+		auto const write_table = [&] (void const* aData, std::size_t aBytes) {
+			fwrite_( kZeros, align16_( offset ) - offset, fout );
+			fwrite_( aData, aBytes, fout );
+			offset = align16_( offset ) + aBytes;
+		};
+
+		write_table( aMesh.lods.data(), aMesh.lods.size() * sizeof(MeshLod) );
+		write_table( aMesh.chunks.data(), aMesh.chunks.size() * sizeof(MeshChunk) );
+		write_table( aMesh.meshlets.data(), aMesh.meshlets.size() * sizeof(Meshlet) );
+
+		if( 0 != std::fflush( fout ) )
+			throw Error( "write_packed_binary_mesh(): unable to flush '%s'", tempPath.c_str() );
+	}
+
+	std::error_code ec;
+	std::filesystem::rename( tempPath, aPath, ec );
+	if( ec )
+	{
+		std::filesystem::remove( tempPath, ec );
+		throw Error( "write_packed_binary_mesh(): unable to move cache into place at '%s'", aPath );
+	}
+}
+
+
+MappedBinaryMesh::MappedBinaryMesh( char const* aPath )
+	: mData( nullptr )
+	, mBytes( 0 )
+	, mView{}
+	, mSource{}
+{
+#	if defined(_WIN32)
+	HANDLE file = CreateFileA( aPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+	if( INVALID_HANDLE_VALUE == file )
+		throw Error( "MappedBinaryMesh: Unable to open '%s' for reading", aPath );
+
+	LARGE_INTEGER size{};
+	if( !GetFileSizeEx( file, &size ) || 0 == size.QuadPart )
+	{
+		CloseHandle( file );
+		throw Error( "MappedBinaryMesh: Unable to determine size of '%s'", aPath );
+	}
+
+	HANDLE mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	CloseHandle( file );
+	if( !mapping )
+		throw Error( "MappedBinaryMesh: Unable to map '%s'", aPath );
+
+	mData = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	CloseHandle( mapping ); // the view keeps the mapping alive
+	if( !mData )
+		throw Error( "MappedBinaryMesh: Unable to map '%s'", aPath );
+
+	mBytes = std::size_t(size.QuadPart);
+#	else
+	int const fd = ::open( aPath, O_RDONLY );
+	if( -1 == fd )
+		throw Error( "MappedBinaryMesh: Unable to open '%s' for reading", aPath );
+
+	struct stat st{};
+	if( -1 == ::fstat( fd, &st ) || 0 == st.st_size )
+	{
+		::close( fd );
+		throw Error( "MappedBinaryMesh: Unable to determine size of '%s'", aPath );
+	}
+
+	void* ptr = ::mmap( nullptr, std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0 );
+	::close( fd ); // the mapping stays valid
+	if( MAP_FAILED == ptr )
+		throw Error( "MappedBinaryMesh: Unable to map '%s'", aPath );
+
+	// The whole file is going to be read (and uploaded) right away.
+	::madvise( ptr, std::size_t(st.st_size), MADV_WILLNEED );
+
+	mData = ptr;
+	mBytes = std::size_t(st.st_size);
+#	endif
+
+	// From here on, the destructor takes care of unmapping.
+	MappedBinaryMesh guard( std::move(*this) );
+
+	auto const* bytes = static_cast<std::byte const*>(guard.mData);
+	if( guard.mBytes < kIndexOffset01_ || 0 != std::memcmp( bytes, kFileMagic01, sizeof(kFileMagic01) ) )
+		throw Error( "'%s': not a version 01 COMP3811 mesh", aPath );
+
+	MeshHeader01_ header;
+	std::memcpy( &header, bytes + sizeof(kFileMagic01), sizeof(header) );
+
+	std::size_t const indexBytes = std::size_t(header.indexCount) * sizeof(std::uint32_t);
+	std::size_t const vertexOffset = kIndexOffset01_ + align16_( indexBytes );
+	std::size_t const vertexBytes = std::size_t(header.vertexCount) * header.stride;
+	std::size_t const lodOffset = align16_( vertexOffset + vertexBytes );
+	std::size_t const lodBytes = std::size_t(header.lodCount) * sizeof(MeshLod);
+	std::size_t const chunkOffset = align16_( lodOffset + lodBytes );
+	std::size_t const chunkBytes = std::size_t(header.chunkCount) * sizeof(MeshChunk);
+	std::size_t const meshletOffset = align16_( chunkOffset + chunkBytes );
+	std::size_t const meshletBytes = std::size_t(header.meshletCount) * sizeof(Meshlet);
+
+	if( header.attribCount > kMaxVertexAttribs || guard.mBytes < vertexOffset + vertexBytes )
+		throw Error( "'%s': corrupt COMP3811 mesh (header doesn't match file size)", aPath );
+	if( header.lodCount && guard.mBytes < lodOffset + lodBytes )
+		throw Error( "'%s': corrupt COMP3811 mesh (header doesn't match file size)", aPath );
+	if( header.chunkCount && guard.mBytes < chunkOffset + chunkBytes )
+		throw Error( "'%s': corrupt COMP3811 mesh (header doesn't match file size)", aPath );
+	if( header.meshletCount && guard.mBytes < meshletOffset + meshletBytes )
+		throw Error( "'%s': corrupt COMP3811 mesh (header doesn't match file size)", aPath );
+
+	auto& view = guard.mView;
+	view.layout.stride = header.stride;
+	view.layout.attribCount = header.attribCount;
+	for( std::uint32_t i = 0; i < header.attribCount; ++i )
+	{
+		auto const& rec = header.attribs[i];
+		view.layout.attribs[i] = VertexAttrib{
+			rec.location,
+			GLint(rec.components),
+			GLenum(rec.type),
+			GLboolean(rec.normalized),
+			rec.offset
+		};
+	}
+
+	view.vertexCount = header.vertexCount;
+	view.vertices = bytes + vertexOffset;
+	view.indexCount = header.indexCount;
+	view.indices = reinterpret_cast<std::uint32_t const*>(bytes + kIndexOffset01_);
+	view.lodCount = header.lodCount;
+	view.lods = header.lodCount ? reinterpret_cast<MeshLod const*>(bytes + lodOffset) : nullptr;
+
+	for( std::size_t i = 0; i < view.lodCount; ++i )
+	{
+		auto const& lod = view.lods[i];
+		if( std::uint64_t(lod.firstIndex) + lod.indexCount > header.indexCount
+			|| std::uint64_t(lod.firstMeshlet) + lod.meshletCount > header.meshletCount )
+			throw Error( "'%s': corrupt COMP3811 mesh (level of detail %zu out of range)", aPath, i );
+	}
+
+	view.meshletCount = header.meshletCount;
+	view.meshlets = header.meshletCount ? reinterpret_cast<Meshlet const*>(bytes + meshletOffset) : nullptr;
+
+	for( std::size_t i = 0; i < view.meshletCount; ++i )
+	{
+		auto const& meshlet = view.meshlets[i];
+		if( std::uint64_t(meshlet.firstIndex) + meshlet.indexCount > header.indexCount )
+			throw Error( "'%s': corrupt COMP3811 mesh (meshlet %zu out of range)", aPath, i );
+	}
+
+	view.chunkCount = header.chunkCount;
+	view.chunks = header.chunkCount ? reinterpret_cast<MeshChunk const*>(bytes + chunkOffset) : nullptr;
+
+	for( std::size_t i = 0; i < view.chunkCount; ++i )
+	{
+		auto const& chunk = view.chunks[i];
+		if( 0 == chunk.lodCount || std::uint64_t(chunk.firstLod) + chunk.lodCount > header.lodCount )
+			throw Error( "'%s': corrupt COMP3811 mesh (chunk %zu out of range)", aPath, i );
+	}
+
+	view.dequant.positionScale = Vec3f{ header.positionScale[0], header.positionScale[1], header.positionScale[2] };
+	view.dequant.positionBias = Vec3f{ header.positionBias[0], header.positionBias[1], header.positionBias[2] };
+	view.dequant.colorScale = header.colorScale;
+
+	guard.mSource = MeshSourceStamp{ header.sourceSize, header.sourceModified, header.sourcePipeline };
+
+	*this = std::move(guard);
+}
+
+MappedBinaryMesh::~MappedBinaryMesh()
+{
+	if( mData )
+	{
+#		if defined(_WIN32)
+		UnmapViewOfFile( mData );
+#		else
+		::munmap( mData, mBytes );
+#		endif
+	}
+}
+
+MappedBinaryMesh::MappedBinaryMesh( MappedBinaryMesh&& aOther ) noexcept
+	: mData( std::exchange( aOther.mData, nullptr ) )
+	, mBytes( std::exchange( aOther.mBytes, 0 ) )
+	, mView( aOther.mView )
+	, mSource( aOther.mSource )
+{}
+
+MappedBinaryMesh& MappedBinaryMesh::operator=( MappedBinaryMesh&& aOther ) noexcept
+{
+	std::swap( mData, aOther.mData );
+	std::swap( mBytes, aOther.mBytes );
+	std::swap( mView, aOther.mView );
+	std::swap( mSource, aOther.mSource );
+	return *this;
+}
+
+PackedMeshView const& MappedBinaryMesh::view() const noexcept
+{
+	return mView;
+}
+MeshSourceStamp const& MappedBinaryMesh::source() const noexcept
+{
+	return mSource;
+}
+
+
+std::string mesh_cache_path( char const* aObjPath )
+{
+	std::filesystem::path path( aObjPath );
+	path.replace_extension( ".cmesh" );
+	return path.string();
+}
+
+PreparedMesh prepare_static_mesh( char const* aObjPath )
+{
+	auto const stamp = make_source_stamp( aObjPath );
+	auto const cachePath = mesh_cache_path( aObjPath );
+
+	PreparedMesh ret;
+
+	// Warm start: map the cache. The upload later reads straight from the
+	// mapping.
+	std::error_code ec;
+	if( std::filesystem::exists( cachePath, ec ) )
+	{
+		try
+		{
+			auto const start = Clock::now();
+
+			MappedBinaryMesh mapped( cachePath.c_str() );
+			auto const& source = mapped.source();
+			if( source.size == stamp.size && source.modified == stamp.modified && source.pipeline == stamp.pipeline )
+			{
+				ret.mapped.emplace( std::move(mapped) );
+
+				auto const ms = std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+				std::printf( "%s: mapped cache '%s' in %.2f ms\n", aObjPath, cachePath.c_str(), ms );
+				return ret;
+			}
+
+			std::printf( "%s: cache '%s' is out of date\n", aObjPath, cachePath.c_str() );
+		}
+		catch( std::exception const& eErr )
+		{
+			std::fprintf( stderr, "%s: ignoring cache: %s\n", aObjPath, eErr.what() );
+		}
+	}
+
+	// Cold start: parse the OBJ and (re-)create the cache.
+	auto mesh = make_indexed( load_wavefront_obj( aObjPath ) );
+
+	auto const before = analyze_vertex_cache( mesh.indices, mesh.positions.size() );
+	auto chunked = make_chunked_mesh( mesh );
+
+	// Statistics of the finest levels, as they would be drawn up close
+	std::vector<std::uint32_t> finest;
+	for( auto const& chunk : chunked.chunks )
+	{
+		auto const& lod = chunked.lods[chunk.firstLod];
+		finest.insert( finest.end(), mesh.indices.begin() + lod.firstIndex, mesh.indices.begin() + lod.firstIndex + lod.indexCount );
+	}
+	auto const after = analyze_vertex_cache( finest, mesh.positions.size() );
+
+	std::printf( "%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", aObjPath, before.acmr, after.acmr, before.atvr, after.atvr );
+
+	std::size_t coarsest = 0;
+	for( auto const& chunk : chunked.chunks )
+		coarsest += chunked.lods[chunk.firstLod+chunk.lodCount-1].indexCount / 3;
+
+	std::printf( "%s: %zu chunks, %zu levels of detail, %zu meshlets, %zu triangles at the finest and %zu at the coarsest levels\n", aObjPath, chunked.chunks.size(), chunked.lods.size(), chunked.meshlets.size(), finest.size()/3, coarsest );
+
+	ret.packed = pack_mesh( mesh );
+	ret.packed.lods = std::move(chunked.lods);
+	ret.packed.chunks = std::move(chunked.chunks);
+	ret.packed.meshlets = std::move(chunked.meshlets);
+
+	try
+	{
+		write_packed_binary_mesh( cachePath.c_str(), ret.packed, stamp );
+	}
+	catch( std::exception const& eErr )
+	{
+		// Not fatal. We'll just have to parse the OBJ again next time.
+		std::fprintf( stderr, "%s: unable to write cache: %s\n", aObjPath, eErr.what() );
+	}
+
+	return ret;
+}
+
+PackedMeshView PreparedMesh::view() const
+{
+	if( mapped )
+		return mapped->view();
+
+	return make_view( packed );
+}
+
+StaticMesh upload_static_mesh( PreparedMesh const& aMesh )
+{
+	auto const view = aMesh.view();
+
+	auto lods = lods_of_( view );
+	auto chunks = chunks_of_( view, lods );
+
+	std::size_t indexCount = 0;
+	for( auto const& chunk : chunks )
+		indexCount += lods[chunk.firstLod].indexCount;
+
+	std::vector<Meshlet> meshlets( view.meshlets, view.meshlets + view.meshletCount );
+
+	auto occluder = make_occluder( view );
+
+	ChunkBvh bvh( chunks.data(), chunks.size() );
+	return StaticMesh{ create_vao( view ), view.vertexCount, indexCount, view.dequant, std::move(lods), std::move(chunks), std::move(bvh), std::move(meshlets), std::move(occluder) };
+}
+
+StaticMesh load_static_mesh( char const* aObjPath )
+{
+	return upload_static_mesh( prepare_static_mesh( aObjPath ) );
+}
+
+OccluderMesh make_occluder( PackedMeshView const& aView )
+{
+	auto const lods = lods_of_( aView );
+	auto const chunks = chunks_of_( aView, lods );
+
+	OccluderMesh ret;
+	ret.chunks.reserve( chunks.size() );
+
+	constexpr auto kUnused = std::numeric_limits<std::uint32_t>::max();
+	std::vector<std::uint32_t> remap( aView.vertexCount, kUnused );
+	std::vector<std::uint32_t> used;
+
+	for( auto const& chunk : chunks )
+	{
+		// Coarsest level that is still close to the real surface. A coarse
+		// occluder may stick out of the surface and hide things that
+		// should be visible, so the error is limited relative to the size
+		// of the chunk.
+		auto const diagonal = length( chunk.boundsMax - chunk.boundsMin );
+
+		auto level = chunk.firstLod;
+		for( auto l = chunk.firstLod; l < chunk.firstLod + chunk.lodCount; ++l )
+		{
+			if( lods[l].error <= kOccluderMaxError_ * diagonal )
+				level = l;
+		}
+
+		auto const& lod = lods[level];
+
+		OccluderChunk occ{};
+		occ.firstVertex = std::uint32_t(ret.positions.size());
+		occ.firstIndex = std::uint32_t(ret.indices.size());
+
+		used.clear();
+		for( auto i = lod.firstIndex; i < lod.firstIndex + lod.indexCount; ++i )
+		{
+			auto const idx = aView.indices[i];
+			if( kUnused == remap[idx] )
+			{
+				remap[idx] = std::uint32_t(used.size());
+				used.emplace_back( idx );
+				ret.positions.emplace_back( unpack_position( aView, idx ) );
+			}
+
+			ret.indices.emplace_back( remap[idx] );
+		}
+
+		for( auto const idx : used )
+			remap[idx] = kUnused;
+
+		occ.vertexCount = std::uint32_t(used.size());
+		occ.indexCount = lod.indexCount;
+		ret.chunks.emplace_back( occ );
+	}
+
+	return ret;
+}
+
+
 namespace
 {
 	void fread_( void* aPtr, std::size_t aBytes, std::FILE* aFile )
@@ -115,6 +658,32 @@ namespace
 		}
 	}
 
+	std::vector<MeshLod> lods_of_( PackedMeshView const& aView )
+	{
+		std::vector<MeshLod> ret( aView.lods, aView.lods + aView.lodCount );
+		if( ret.empty() )
+			ret.emplace_back( MeshLod{ 0, std::uint32_t(aView.indexCount), 0.f, 0, 0 } );
+		return ret;
+	}
+
+	std::vector<MeshChunk> chunks_of_( PackedMeshView const& aView, std::vector<MeshLod> const& aLods )
+	{
+		std::vector<MeshChunk> ret( aView.chunks, aView.chunks + aView.chunkCount );
+		if( ret.empty() )
+		{
+			// Single chunk covering the quantization box, i.e., the whole mesh
+			auto const& dq = aView.dequant;
+			ret.emplace_back( MeshChunk{ dq.positionBias, dq.positionBias + dq.positionScale, 0, std::uint32_t(aLods.size()) } );
+		}
+		return ret;
+	}
+
+	void fwrite_( void const* aPtr, std::size_t aBytes, std::FILE* aFile )
+	{
+		if( aBytes && 1 != std::fwrite( aPtr, aBytes, 1, aFile ) )
+			throw Error( "fwrite_(): error while writing %zu bytes", aBytes );
+	}
+
 	FileDeleter::~FileDeleter()
 	{
 		if( file ) std::fclose( file );
@@ -1,10 +1,127 @@
 #ifndef LOADCUSTOM_HPP_B5136A37_FFDC_4A15_9547_095EF203B009
 #define LOADCUSTOM_HPP_B5136A37_FFDC_4A15_9547_095EF203B009
 
+#include <glad.h>
+
+#include <string>
+#include <vector>
+#include <optional>
+
+#include <cstddef>
+#include <cstdint>
+
 #include "simple_mesh.hpp"
+#include "culling.hpp"
+#include "occlusion.hpp"
+#include "packed_mesh.hpp"
 
+// Load a version 00 COMP3811 mesh (positions, colors, normals + indices).
+// The result is indexed.
 SimpleMeshData load_simple_binary_mesh( char const* aPath );
 
 
+/* Version 01 of the COMP3811 mesh format stores a PackedMesh exactly as it
+ * is uploaded to the GPU (see loadcustom.cpp for the file structure). It is
+ * used as a cache for parsed OBJ files, and is designed to be memory mapped.
+ */
+
+// Identifies the source file that a cache was created from, and the version
+// of the processing (indexing, optimization) that was applied to it. A cache
+// is only used if the stamp still matches.
+struct MeshSourceStamp
+{
+	std::uint64_t size;
+	std::int64_t modified;
+	std::uint32_t pipeline;
+};
+
+// Bump whenever the processing of OBJ files changes, to invalidate existing
+// caches.
+constexpr std::uint32_t kMeshPipelineVersion = 4;
+
+MeshSourceStamp make_source_stamp( char const* aSourcePath );
+
+void write_packed_binary_mesh( char const* aPath, PackedMesh const&, MeshSourceStamp const& );
+
+// Read-only memory mapping of a version 01 mesh file. The view() points
+// directly into the mapping and stays valid as long as the object lives.
+class MappedBinaryMesh final
+{
+	public:
+		explicit MappedBinaryMesh( char const* aPath );
+		~MappedBinaryMesh();
+
+		MappedBinaryMesh( MappedBinaryMesh const& ) = delete;
+		MappedBinaryMesh& operator= (MappedBinaryMesh const&) = delete;
+
+		MappedBinaryMesh( MappedBinaryMesh&& ) noexcept;
+		MappedBinaryMesh& operator= (MappedBinaryMesh&&) noexcept;
+
+	public:
+		PackedMeshView const& view() const noexcept;
+		MeshSourceStamp const& source() const noexcept;
+
+	private:
+		void* mData;
+		std::size_t mBytes;
+
+		PackedMeshView mView;
+		MeshSourceStamp mSource;
+};
+
+// Path of the cache file for an OBJ file, placed next to it:
+// "assets/foo.obj" -> "assets/foo.cmesh"
+std::string mesh_cache_path( char const* aObjPath );
+
+
+// GPU resources of a static (non-animated) mesh.
+struct StaticMesh
+{
+	GLuint vao;
+	std::size_t vertexCount;
+	std::size_t indexCount; // finest levels of all chunks
+	MeshDequant dequant;
+
+	// Levels of detail, finest first (at least one per chunk)
+	std::vector<MeshLod> lods;
+
+	// Spatial chunks (at least one) and the hierarchy used to cull them
+	std::vector<MeshChunk> chunks;
+	ChunkBvh bvh;
+
+	// Meshlets of the levels of detail (possibly none)
+	std::vector<Meshlet> meshlets;
+
+	// Coarse geometry of each chunk, for occlusion culling
+	OccluderMesh occluder;
+};
+
+// CPU-side half of loading a static mesh: either a mapped cache file or a
+// freshly packed mesh. Preparing does not touch OpenGL, so it may run on a
+// worker thread; the upload must happen on the thread that owns the context.
+struct PreparedMesh
+{
+	std::optional<MappedBinaryMesh> mapped;
+	PackedMesh packed;
+
+	PackedMeshView view() const;
+};
+
+PreparedMesh prepare_static_mesh( char const* aObjPath );
+StaticMesh upload_static_mesh( PreparedMesh const& );
+
+// Load an OBJ file for rendering. If an up-to-date cache file exists next to
+// the OBJ, it is memory mapped and uploaded directly, skipping OBJ parsing
+// entirely. Otherwise the OBJ is parsed, indexed, split into chunks that are
+// optimized (see mesh_optimize.hpp) and reduced to chains of levels of detail
+// (see mesh_chunks.hpp), and packed, and the cache is (re-)written for the
+// next run. Same as
+// upload_static_mesh( prepare_static_mesh( aObjPath ) ).
+StaticMesh load_static_mesh( char const* aObjPath );
+
+// Coarse geometry of each chunk of a mesh, for occlusion culling: for each
+// chunk, the coarsest level of detail whose error is at most 1% of the
+// chunk's size. Doesn't use OpenGL.
+OccluderMesh make_occluder( PackedMeshView const& );
 
 #endif // LOADCUSTOM_HPP_B5136A37_FFDC_4A15_9547_095EF203B009
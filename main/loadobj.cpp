@@ -2,14 +2,32 @@
 
 #include <rapidobj/rapidobj.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
 #include <cstdio>
 #include <cstddef>
 #include <cstring>
-#include <vector>
 
 #include "../support/error.hpp"
+
+#include "defaults.hpp"
+
 namespace
 {
+	// Number of OBJ indices (= output vertices) converted per work item.
+	constexpr std::size_t kBatchSize_ = 64 * 1024;
+
+	struct Batch_
+	{
+		std::size_t shape;
+		std::size_t begin, end; // range of indices in the shape's mesh
+		std::size_t output;     // first output vertex
+	};
+
 	// See readme.md for a description of the file structure!
 
 	// The "file magic" occurs at the very start of the file and serves as an
@@ -44,6 +62,8 @@ namespace
 
 SimpleMeshData load_wavefront_obj(char const* aPath)
 {
+	auto const parseStart = Clock::now();
+
 	// Ask rapidobj to load the requested file
 	auto result = rapidobj::ParseFile(aPath);
 	if (result.error)
@@ -52,65 +72,120 @@ SimpleMeshData load_wavefront_obj(char const* aPath)
 	// and points), so we must triangulate any faces that are not already triangles. Fortunately, rapidobj can do
 	// this for us.
 	rapidobj::Triangulate(result);
-	// Convert the OBJ data into a SimpleMeshData structure. For now, we simply turn the object into a triangle14g
-	// soup, ignoring the indexing information that the OBJ file contains.
+
+	auto const convertStart = Clock::now();
+
+	// Convert the OBJ data into a SimpleMeshData structure. For now, we simply turn the object into a triangle
+	// soup, ignoring the indexing information that the OBJ file contains (see make_indexed()).
+	//
+	// The output is sized up front, and each shape is split into batches of indices that are converted in
+	// parallel. Every output vertex depends only on its own index, so workers never write to the same element.
+	std::vector<Batch_> batches;
+	std::size_t total = 0;
+	for (std::size_t s = 0; s < result.shapes.size(); ++s)
+	{
+		std::size_t const count = result.shapes[s].mesh.indices.size();
+		for (std::size_t i = 0; i < count; i += kBatchSize_)
+			batches.emplace_back(Batch_{ s, i, std::min(count, i + kBatchSize_), total + i });
+
+		total += count;
+	}
+
+	bool const hasTexcoords = !result.attributes.texcoords.empty();
+
 	SimpleMeshData ret;
-	for (auto const& shape : result.shapes)
+	ret.positions.resize(total);
+	ret.normals.resize(total);
+	ret.colors.resize(total);
+	if (hasTexcoords)
+		ret.texcoords.resize(total);
+
+	// Resolve material colors once, instead of looking up the material for every vertex. Faces without a
+	// material (id -1) are white.
+	std::vector<Vec3f> materialColors;
+	materialColors.reserve(result.materials.size());
+	for (auto const& mat : result.materials)
 	{
-		for (std::size_t i = 0; i < shape.mesh.indices.size(); ++i)
+		// Just replicate the material ambient color for each vertex...
+		materialColors.emplace_back(Vec3f{ mat.ambient[0], mat.ambient[1], mat.ambient[2] });
+	}
+
+	auto const& attribs = result.attributes;
+	auto const convert = [&] (Batch_ const& aBatch) {
+		auto const& mesh = result.shapes[aBatch.shape].mesh;
+		for (std::size_t i = aBatch.begin; i < aBatch.end; ++i)
 		{
-			auto const& idx = shape.mesh.indices[i];
+			auto const& idx = mesh.indices[i];
+			std::size_t const out = aBatch.output + (i - aBatch.begin);
 
-			ret.positions.emplace_back(Vec3f{
-				result.attributes.positions[idx.position_index * 3 + 0],
-				result.attributes.positions[idx.position_index * 3 + 1],
-				result.attributes.positions[idx.position_index * 3 + 2]
-				});
+			ret.positions[out] = Vec3f{
+				attribs.positions[idx.position_index * 3 + 0],
+				attribs.positions[idx.position_index * 3 + 1],
+				attribs.positions[idx.position_index * 3 + 2]
+			};
 
 			// Add vertex normals
-			ret.normals.emplace_back(Vec3f{
-				result.attributes.normals[idx.normal_index * 3 + 0],
-				result.attributes.normals[idx.normal_index * 3 + 1],
-				result.attributes.normals[idx.normal_index * 3 + 2]
-				});
+			if (idx.normal_index >= 0)
+			{
+				ret.normals[out] = Vec3f{
+					attribs.normals[idx.normal_index * 3 + 0],
+					attribs.normals[idx.normal_index * 3 + 1],
+					attribs.normals[idx.normal_index * 3 + 2]
+				};
+			}
+			else
+				ret.normals[out] = Vec3f{ 0.f, 0.f, 0.f };
 
 			// Extract texture coordinates if available
-			if (!result.attributes.texcoords.empty()) 
-			{             
-				ret.texcoords.emplace_back(Vec2f
-				{                 
-					result.attributes.texcoords[idx.texcoord_index * 2 + 0],                 
-					result.attributes.texcoords[idx.texcoord_index * 2 + 1]             
-				});         
+			if (hasTexcoords)
+			{
+				if (idx.texcoord_index >= 0)
+				{
+					ret.texcoords[out] = Vec2f{
+						attribs.texcoords[idx.texcoord_index * 2 + 0],
+						attribs.texcoords[idx.texcoord_index * 2 + 1]
+					};
+				}
+				else
+					ret.texcoords[out] = Vec2f{ 0.f, 0.f };
 			}
 
 			// Always triangles, so we can find the face index by dividing the vertex index by three
-			auto const& mat = result.materials[shape.mesh.material_ids[i / 3]];
-
-			// Just replicate the material ambient color for each vertex...
-			ret.colors.emplace_back(Vec3f{
-				mat.ambient[0],
-				mat.ambient[1],
-				mat.ambient[2]
-				});
-
-			Vec3f diffuseColor{
-			   mat.diffuse[0],
-			   mat.diffuse[1],
-			   mat.diffuse[2]
-			};
+			auto const matId = mesh.material_ids[i / 3];
+			ret.colors[out] = matId >= 0 ? materialColors[matId] : Vec3f{ 1.f, 1.f, 1.f };
+		}
+	};
 
-			// Use the light direction (0, 1, -1) and normalize it
-			//Vec3f lightDirection{ 0.0f, 1.0f, -1.0f };
-			//Vec3f finalAmbientColor, finalDiffuseColor;
+	// Small meshes aren't worth the thread start-up cost.
+	unsigned const workerCount = batches.size() < 2 ? 0 : std::min<unsigned>(
+		std::max(1u, std::thread::hardware_concurrency()) - 1,
+		unsigned(batches.size() - 1)
+	);
 
-			//calculateLighting(finalAmbientColor, finalDiffuseColor, lightDirection, ret.normals.back());
+	std::atomic<std::size_t> next{ 0 };
+	auto const work = [&] {
+		for (std::size_t b = next++; b < batches.size(); b = next++)
+			convert(batches[b]);
+	};
 
-			// Just replicate the material ambient and diffuse colors for each vertex...
-			//ret.colors.emplace_back(finalAmbientColor + finalDiffuseColor);
+	std::vector<std::thread> workers;
+	workers.reserve(workerCount);
+	for (unsigned i = 0; i < workerCount; ++i)
+		workers.emplace_back(work);
 
-		}
-	}
+	work(); // this thread helps as well
+
+	for (auto& worker : workers)
+		worker.join();
+
+	auto const end = Clock::now();
+
+	using Ms_ = std::chrono::duration<double, std::milli>;
+	std::printf("%s: parse %.2f ms, convert %.2f ms (%zu vertices, %u threads)\n", aPath,
+		Ms_(convertStart - parseStart).count(),
+		Ms_(end - convertStart).count(),
+		total, workerCount + 1
+	);
 
 	return ret;
 }
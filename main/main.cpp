@@ -4,8 +4,10 @@
 #include <typeinfo>
 #include <stdexcept>
 
+#include <cassert>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
 #include "../support/error.hpp"
 #include "../support/program.hpp"
@@ -15,6 +17,9 @@
 #include "../vmlib/vec4.hpp"
 #include "../vmlib/mat44.hpp"
 #include "../vmlib/mat33.hpp"
+#include "../vmlib/affine34.hpp"
+#include "../vmlib/typed_transform.hpp"
+#include "../vmlib/scene_graph.hpp"
 
 #include "defaults.hpp"
 #include "loadobj.hpp"
@@ -23,8 +28,27 @@
 #include "cube.hpp"
 #include "cylinder.hpp"
 #include "loadcustom.hpp"
+#include "perf.hpp"
+#include "packed_mesh.hpp"
+#include "jobs.hpp"
+#include "texture_stream.hpp"
+#include "virtual_texture.hpp"
+#include "mesh_optimize.hpp"
+#include "mesh_lod.hpp"
+#include "mesh_chunks.hpp"
+#include "culling.hpp"
+#include "occlusion.hpp"
+#include "gpu_culling.hpp"
+#include "instancing.hpp"
+#include "parts.hpp"
+#include "ship.hpp"
+#include "mesh_builder.hpp"
 #include <chrono>
+#include <limits>
+#include <algorithm>
 #include <vector>
+#include <optional>
+#include <filesystem>
 
 // Query objects for GPU timing
 GLuint queryStart, queryEnd;
@@ -77,8 +101,112 @@ namespace
 		double curveStartTime = 0.0;
 		bool isHorizontalFlight = false;
 		float horizontalFlightSpeed = 0.1f;
+
+		// The vehicle moved outside of the animation (initially, and when
+		// the F and R keys reset it); its scene node needs an update.
+		bool vehicleMoved = true;
+
+		// G-key switches between GPU and CPU culling
+		bool gpuCulling = false;
 	};
 	
+	// Command line options
+	struct Options_
+	{
+		// --bench-vertex-layout: compare vertex layouts on the terrain and exit
+		bool benchVertexLayout = false;
+
+		// --mesh-stats: print vertex cache statistics of the meshes and exit
+		bool meshStats = false;
+
+		// --bench-occlusion: time the occlusion buffer on the terrain and exit
+		bool benchOcclusion = false;
+
+		// --cpu-culling: start with CPU culling instead of GPU culling
+		bool cpuCulling = false;
+
+		// --bench-mesh-builder: time assembling many-part meshes and exit
+		bool benchMeshBuilder = false;
+
+		// --check-gpu-culling: compare GPU with CPU culling of the terrain
+		// on fixed views and exit (non-zero if they differ)
+		bool checkGpuCulling = false;
+	};
+
+	Options_ parse_options_( int, char* [] );
+
+	void print_mesh_stats_( char const* aObjPath );
+	void bench_occlusion_( char const* aObjPath );
+	void bench_mesh_builder_( std::size_t aPartCount );
+
+	// Cameras circling the terrain just above its center, looking outwards
+	// and slightly down, where hills hide much of the terrain. Used by the
+	// benchmarks and checks above.
+	struct TerrainView_
+	{
+		Mat44f clipFromWorld;
+		Vec3f eye;
+	};
+
+	std::vector<TerrainView_> terrain_views_( Vec3f aMin, Vec3f aMax, std::size_t aCount );
+
+	// Visible parts of a static mesh: the surviving meshlets of the visible
+	// chunks, each at its selected level of detail, ready for
+	// glMultiDrawElements().
+	struct DrawList_
+	{
+		std::vector<std::uint32_t> visible;
+		std::vector<IndexRange> ranges;
+		std::vector<GLsizei> counts;
+		std::vector<void const*> offsets;
+	};
+
+	// Culling happens in three steps: chunks outside of the frustum are
+	// culled first, the remaining chunks' occluders are rendered, and then
+	// the chunks are tested for occlusion and their draws are built.
+	void cull_chunks_( StaticMesh const&, Mat44f const& aClipFromObject, DrawList_&, CullStats& );
+	void add_occluders_( StaticMesh const&, Mat44f const& aClipFromObject, DrawList_ const&, OcclusionBuffer& );
+	void build_draws_( StaticMesh const&, Mat44f const& aProjCameraWorld, Mat44f const& aModel2World, Vec4f aEye, float aLodErrorScale, OcclusionBuffer const&, DrawList_&, CullStats& );
+	void draw_list_( DrawList_ const&, CullStats& );
+
+	// Visible instances of an instanced static mesh, and the parts of the
+	// mesh drawn for all of them: every chunk, at the level of detail needed
+	// by the nearest visible instance.
+	struct InstanceList_
+	{
+		std::vector<std::uint32_t> visible; // indices of the instances
+		std::vector<Mat44f> clipFromObject; // of all instances
+		std::vector<Mat44f> transforms; // of the visible instances
+		DrawList_ draws;
+	};
+
+	// Same steps as for single meshes (see above), per instance.
+	void cull_instances_( StaticMesh const&, std::vector<Mat44f> const& aInstances, Mat44f const& aProjCameraWorld, InstanceList_&, CullStats& );
+	void add_instance_occluders_( StaticMesh const&, InstanceList_ const&, OcclusionBuffer& );
+	void build_instanced_draws_( StaticMesh const&, std::vector<Mat44f> const& aInstances, Vec4f aEye, float aLodErrorScale, OcclusionBuffer const&, InstanceList_&, CullStats& );
+
+	void draw_instanced_( InstanceList_ const&, CullStats& );
+
+	// GPU culling state of the static meshes (see gpu_culling.hpp)
+	struct GpuScene_
+	{
+		GpuCuller culler;
+		GpuCullMesh parlahti, landingPad;
+		GpuDrawList parlahtiDraws, landingPadDraws;
+
+		GpuScene_( StaticMesh const& aParlahti, StaticMesh const& aLandingPad, std::size_t aLandingPadInstances )
+			: parlahti( aParlahti )
+			, landingPad( aLandingPad )
+			, parlahtiDraws( parlahti )
+			, landingPadDraws( landingPad, aLandingPadInstances )
+		{}
+	};
+
+	Vec3f object_eye_( Mat44f const& aModel2World, Vec4f aEye );
+
+	// See --check-gpu-culling
+	bool check_gpu_culling_( StaticMesh const& aTerrain, GpuScene_& );
+
 	void glfw_callback_error_( int, char const* );
 
 	void glfw_callback_key_( GLFWwindow*, int, int, int, int );
@@ -107,8 +235,87 @@ namespace
 
 }
 
-int main() try
+int main( int aArgc, char* aArgv[] ) try
 {
+	auto const options = parse_options_( aArgc, aArgv );
+
+	// Doesn't need OpenGL, so this runs before creating the window.
+	if( options.meshStats )
+	{
+		print_mesh_stats_( "assets/parlahti.obj" );
+		print_mesh_stats_( "assets/landingpad.obj" );
+		return 0;
+	}
+	if( options.benchOcclusion )
+	{
+		bench_occlusion_( "assets/parlahti.obj" );
+		return 0;
+	}
+	if( options.benchMeshBuilder )
+	{
+		bench_mesh_builder_( 1000 );
+		return 0;
+	}
+
+	auto const startupBegin = Clock::now();
+
+	// Start loading assets right away. None of this requires OpenGL, so it
+	// runs on worker threads while the window and GL context are created.
+	// Results are collected (and uploaded) further down.
+	ThreadPool pool;
+
+	auto parlahtiJob = pool.submit( [] { return prepare_static_mesh( "assets/parlahti.obj" ); } );
+	auto landingPadJob = pool.submit( [] { return prepare_static_mesh( "assets/landingpad.obj" ); } );
+
+	// The map texture is used in one of three forms, in order of preference:
+	// as a virtual texture (texconv --virtual), pre-compressed (texconv), or
+	// by decoding the JPEG.
+	bool const mapVirtual = std::filesystem::exists( "assets/L4343A-4k.vtex" );
+	bool const mapCompressed = !mapVirtual && std::filesystem::exists( "assets/L4343A-4k.ctex" );
+	std::future<CompressedImage> mapCompressedJob;
+	std::future<ImageRGBA8> mapImageJob;
+	if( mapCompressed )
+		mapCompressedJob = pool.submit( [] { return load_compressed_image( "assets/L4343A-4k.ctex" ); } );
+	else if( !mapVirtual )
+		mapImageJob = pool.submit( [] { return load_image_rgba8( "assets/L4343A-4k.jpeg" ); } );
+
+	auto whiteImageJob = pool.submit( [] { return load_image_rgba8( "assets/white.png" ); } );
+
+	// Example values for landing pad instances
+	float x1 = 0.0f, y1 = -0.90f, z1 = 0.0f, angle1 = 0.0f;
+	float x2 = 1.0f, y2 = -0.90f, z2 = -25.0f, angle2 = 45.0f;  // Adjust as needed
+
+//// Generate different shapes for testing
+	auto testCylinderJob = pool.submit( [] {
+		return make_cylinder(true, 128, { 0.4f, 0.4f, 0.4f }, 
+			make_rotation_z(3.141592f / 2.f) 
+			* make_scaling(8.f, 2.f, 2.f) 
+		);
+	} );
+	// cone on top of spaceship
+	auto topConeTJob = pool.submit( [] {
+		return make_cone(true, 128, { 20.0f, 20.0f, 20.0f },
+			make_rotation_z(-3.141592f / 2.f)
+			* make_scaling(1.f, 0.5f, 0.5f)
+			* make_translation({ 0.f, 4.f, 0.f })
+		);
+	} );
+	//cube on the right
+	auto cubeTJob = pool.submit( [] {
+		return make_cube(true, 20, { 1.0f, 1.0f, 0.0f },
+			make_rotation_z(-3.141592f / 2.f)
+			* make_scaling(0.5f, 0.6f, 0.6f)
+			* make_translation({ 0.f, 4.9f, 0.f })
+		);
+	} );
+//// Generate different shapes for testing
+
+	// Task 1.5
+	// The space ship is a hierarchy of parts (see ship.hpp), drawn as
+	// instances of a few unit primitives. Only the primitives are meshes.
+	auto primitivesJob = pool.submit( [] { return make_primitive_meshes(); } );
+
+
 	glQueryCounter(queryStart, GL_TIMESTAMP);
 	// Initialize GLFW
 	if( GLFW_TRUE != glfwInit() )
@@ -199,6 +406,9 @@ InitializeQueryObjects();
 	//glEnable(GL_CULL_FACE);
 	glClearColor(0.2f, 0.2f, 0.2f, 0.2f);
 
+	// Meshes without an instance buffer are drawn with an identity transform
+	InstanceBuffer::use_default_instance();
+
 	glEnable(GL_DEPTH_TEST);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -260,14 +470,50 @@ glQueryCounter(sectionQueries[0], GL_TIMESTAMP);
 
 glQueryCounter(sectionQueries[1], GL_TIMESTAMP);
 
+	if( options.benchVertexLayout )
+	{
+		glUseProgram( prog.programId() );
+		benchmark_vertex_layouts( "parlahti", make_indexed(load_wavefront_obj("assets/parlahti.obj")) );
+		return 0;
+	}
+
 	// Load the parlahti object
-	auto parlahti = load_wavefront_obj("assets/parlahti.obj");
-	auto parlahtiVao = create_vao(parlahti);
-	std::size_t parlahtiVertexCount = parlahti.positions.size();
+	// Static meshes are welded (indexed) and uploaded in the compact packed
+	// vertex format. The result is cached next to the OBJ file, so that
+	// subsequent runs can skip OBJ parsing entirely.
+	auto parlahti = upload_static_mesh(parlahtiJob.get());
+	auto parlahtiVao = parlahti.vao;
+	std::size_t parlahtiIndexCount = parlahti.indexCount;
+	std::printf( "parlahti: %zu vertices, %zu indices\n", parlahti.vertexCount, parlahtiIndexCount );
+
 	// Load texture
-	auto mapTexture = load_texture_2d("assets/L4343A-4k.jpeg");
+	// The 4k map texture is streamed in over a few frames. A neutral gray
+	// placeholder (owned by the streamer) is used until it has arrived.
+	TextureStreamer textureStreamer;
+	TextureStreamer::Handle mapTextureHandle = 0;
+	if( !mapVirtual )
+	{
+		auto const mapPlaceholder = create_placeholder_texture_2d( 128, 128, 128 );
+		mapTextureHandle = mapCompressed
+			? textureStreamer.request( std::move(mapCompressedJob), mapPlaceholder )
+			: textureStreamer.request( std::move(mapImageJob), mapPlaceholder )
+		;
+	}
+
+	// A virtual texture only keeps the visible tiles in memory. Which tiles
+	// are visible is determined by a low-resolution feedback pass.
+	std::optional<VirtualTexture> mapVirtualTexture;
+	std::optional<ShaderProgram> feedbackProg;
+	if( mapVirtual )
+	{
+		mapVirtualTexture.emplace( "assets/L4343A-4k.vtex", pool );
+		feedbackProg.emplace( std::vector<ShaderProgram::ShaderSource>{
+			{ GL_VERTEX_SHADER, "assets/default.vert" },
+			{ GL_FRAGMENT_SHADER, "assets/vt_feedback.frag" }
+		} );
+	}
 	//setting texture for launch pad
-	auto whiteTexture = load_texture_2d("assets/white.png");
+	auto whiteTexture = create_texture_2d(whiteImageJob.get());
 
 // Extract the texture coordinates from the loaded data
 // std::vector<Vec2f> textureCoords = parlahti.v2fTexCoord;
@@ -277,19 +523,55 @@ glQueryCounter(sectionQueries[2], GL_TIMESTAMP);
 
 	// task 1.4
 // Load the landingpad object
-	auto landingPad = load_wavefront_obj("assets/landingpad.obj");
-	auto landingPadVao = create_vao(landingPad);
-	std::size_t landingPadVertexCount = landingPad.positions.size();
+	auto landingPad = upload_static_mesh(landingPadJob.get());
+	auto landingPadVao = landingPad.vao;
+	std::size_t landingPadIndexCount = landingPad.indexCount;
+	std::printf( "landingpad: %zu vertices, %zu indices\n", landingPad.vertexCount, landingPadIndexCount );
 
-	// Example values for landing pad instances
-	float x1 = 0.0f, y1 = -0.90f, z1 = 0.0f, angle1 = 0.0f;
-	float x2 = 1.0f, y2 = -0.90f, z2 = -25.0f, angle2 = 45.0f;  // Adjust as needed
+	// Everything that moves (or could) is a node of the scene graph. Each
+	// frame only recomputes the world transforms of nodes that changed, and
+	// only those are passed on (see "Scene graph" in the main loop).
+	SceneGraph scene;
+
+	// Instance data for the landing pads (consecutive nodes)
+	SceneNode const firstLandingPadNode = scene.add(kNoSceneNode, translation({ x1, y1, z1 }) * rotation_y(angle1));
+	scene.add(kNoSceneNode, translation({ x2, y2, z2 }) * rotation_y(angle2));
+	std::size_t const landingPadCount = 2;
 
-	// Instance data for the first landing pad
-	Mat44f instanceTransform1 = make_translation({ x1, y1, z1 }) * make_rotation_y(angle1);
+	SceneNode const vehicleNode = scene.add(kNoSceneNode);
 
-	// Instance data for the second landing pad
-	Mat44f instanceTransform2 = make_translation({ x2, y2, z2 }) * make_rotation_y(angle2);
+	///task 1.6
+	// The point lights are placed relative to completeShip.
+	float completeShipX = 1.0f;
+	float completeShipY = -0.5f;
+	float completeShipZ = -3.0f;
+
+	SceneNode const completeShipNode = scene.add(kNoSceneNode, to_affine(translation({ completeShipX, completeShipY, completeShipZ })));
+	// I made this to set the spaceship's position. But i dont know why, nothing changed :(
+
+	SceneNode const firstLightNode = scene.add(completeShipNode, to_affine(translation({ 4.0f, 18.0f, 0.0f }))); // Position relative to the completeShip
+	scene.add(completeShipNode, to_affine(translation({ 0.0f, 22.0f, 0.0f })));
+	scene.add(completeShipNode, to_affine(translation({ 0.0f, 1.0f, 4.0f })));
+
+	scene.update();
+
+	// All landing pads are drawn with a single instanced draw call. More pads
+	// only need more nodes above.
+	std::vector<Mat44f> landingPadInstances( landingPadCount );
+	for( std::size_t i = 0; i < landingPadCount; ++i )
+		landingPadInstances[i] = to_mat44(scene.world(firstLandingPadNode + SceneNode(i)));
+
+	InstanceBuffer landingPadInstanceBuffer( landingPadInstances.size() );
+	landingPadInstanceBuffer.attach( landingPadVao );
+
+	// GPU culling reads all landing pads from the instance buffer, CPU culling
+	// only writes the visible ones to it. Upload all of them only when this
+	// is out of date.
+	bool landingPadBufferCurrent = false;
+
+	Vec3f pointLightPositions[3];
+	for (int i = 0; i < 3; ++i)
+		pointLightPositions[i] = transform_point(scene.world(firstLightNode + SceneNode(i)), Vec3f{ 0.f, 0.f, 0.f });
 
 // End GPU time query for Section 1.4
 glQueryCounter(sectionQueries[3], GL_TIMESTAMP);
@@ -299,129 +581,59 @@ glQueryCounter(sectionQueries[3], GL_TIMESTAMP);
 glQueryCounter(sectionQueries[4], GL_TIMESTAMP);
 
 //// Generate different shapes for testing
-	 auto testCylinder = make_cylinder(true, 128, { 0.4f, 0.4f, 0.4f }, 
-	 	make_rotation_z(3.141592f / 2.f) 
-	 	* make_scaling(8.f, 2.f, 2.f) 
-	 );
-	 GLuint vaoCylinder = create_vao(testCylinder);
-	 std::size_t vertexCountCylinder = testCylinder.positions.size();
-
-	 // cone on top of spaceship
-	 auto topConeT = make_cone(true, 128, { 20.0f, 20.0f, 20.0f },
-		 make_rotation_z(-3.141592f / 2.f)
-		 * make_scaling(1.f, 0.5f, 0.5f)
-		 * make_translation({ 0.f, 4.f, 0.f })
-	 );
-	 GLuint vaoCone = create_vao(topConeT);
-	 std::size_t vertexCountCone = topConeT.positions.size();
-
-	 //cube on the right
-	 auto cubeT = make_cube(true, 20, { 1.0f, 1.0f, 0.0f },
-		 make_rotation_z(-3.141592f / 2.f)
-		 * make_scaling(0.5f, 0.6f, 0.6f)
-		 * make_translation({ 0.f, 4.9f, 0.f })
-	 );
-	 GLuint vaoCube = create_vao(cubeT);
-	 std::size_t vertexCountCube = cubeT.positions.size();
-//// Generate different shapes for testing
-
-	 // general observations for possitioning the spaceship
-	//  * make_scaling(a.f, b.f, c.f)
-	//  a.f vertical size of the object(how long it is)
-	//	b.f horizontal size of the object( how wide it is), to the left
-	//	c.f horizontal size of the object(how wide it is), to the right
-
-	//  *make_translation({ a.f, b.f, c.f })
-	//	  a.f moves the object up and down on the axis coord
-	//	  b.f moves the objectd right and left on the axis coord
-	//	  c.f moves the object forward and back on the axis coord
-
-	// Task 1.5 
-	// by sandra
-	// main cylinder of the spaceship
-	//a mock cube that sets the complete body of the spaceship on top of the platform
-	auto cube0 = make_cube(true, 20, { 0.4f, 0.4f, 0.4f },
-		make_rotation_z(-3.141592f / 2.f)
-		* make_scaling(0.0f, 0.0f, 0.0f)
-		* make_translation({ x1, y1, z1 })//platform coords
-	);
+	auto testCylinder = testCylinderJob.get();
+	GLuint vaoCylinder = create_vao(testCylinder);
+	std::size_t indexCountCylinder = testCylinder.indices.size();
 
+	auto topConeT = topConeTJob.get();
+	GLuint vaoCone = create_vao(topConeT);
+	std::size_t indexCountCone = topConeT.indices.size();
 
-	auto mainCylinder = make_cylinder(true, 128, { 3.4f, 0.4f, 0.4f },
-		make_rotation_z(3.141592f / 2.f)
-		* make_scaling(3.f, 0.5f, 0.5f)
-		* make_translation({ 0.1f })//lifting the main body a bit
-	);
-
-	// Adjustments
-	// Increase the X scale factor to make the cylinder longer
-	//float scaleX = 1.0f * 3.5f; // Adjust this multiplier as needed for length
-	//cylinder on the left
-	auto smallCylinder1 = make_cylinder(true, 128, { 0.0f, 0.6f, 0.7f },
-		make_rotation_z(3.141592f / 2.f)
-		* make_scaling(0.9f, 0.3f, 0.4f) // Updated scaling for length
-		* make_translation({ 1.3f, 2.5f, 0.f })
-	);
-	//cylinder on the right
-	auto smallCylinder2 = make_cylinder(true, 128, { 0.0f, 0.6f, 0.7f },
-		make_rotation_z(3.141592f / 2.f)
-		* make_scaling(0.9f, 0.3f, 0.4f) // Updated scaling for length
-		* make_translation({ 1.3f, -2.5f, 0.0f })
-	);
+	auto cubeT = cubeTJob.get();
+	GLuint vaoCube = create_vao(cubeT);
+	std::size_t indexCountCube = cubeT.indices.size();
+//// Generate different shapes for testing
 
-	// cone on top of spaceship
-	auto topCone = make_cone(true, 128, { 1.0f, 1.0f, 0.0f },
-		make_rotation_z(-3.141592f / 2.f)
-		* make_scaling(1.f, 0.5f, 0.5f)
-		* make_translation({ -4.3f, 0.f, 0.f })
-	);
+	PartRenderer partRenderer(primitivesJob.get());
+	auto const ship = make_ship();
 
-	//putting together the small cylinders on the side of the main body of the spaceship
-	auto smallCylinders = concatenate(std::move(smallCylinder1), smallCylinder2);
-	auto mainShip = concatenate(std::move(mainCylinder), smallCylinders);
+// End GPU time query for Section 1.5
+glQueryCounter(sectionQueries[5], GL_TIMESTAMP);
 
-	//set the possition on top of the platform
-	auto setPos = concatenate(std::move(mainShip), cube0);
-	//merge the rest of the ship with the mock cube
-	auto shipBody = concatenate(std::move(setPos), topCone);
+	OGL_CHECKPOINT_ALWAYS();
 
-	//cube in the middle
-	auto cube1 = make_cube(true, 2, { 0.4f, 0.4f, 0.4f },
-		make_rotation_z(-3.141592f / 2.f)
-		* make_scaling(0.75f, 0.5f, 0.5f)
-		* make_translation({ 0.1f, 0.f, 0.f })
-	);
-	//cube on the right
-	auto cube2 = make_cube(true, 2, { 0.4f, 0.4f, 0.4f },
-		make_rotation_z(-3.141592f / 2.f)
-		* make_scaling(0.5f, 0.6f, 0.6f)
-		* make_translation({ -0.6f, 0.9f, 0.f })
-	);
+	bool firstFrame = true;
 
-	//merging 2 of the cubes
-	auto cubesA = concatenate(std::move(cube1), cube2);
+	DrawList_ parlahtiDraws;
+	InstanceList_ landingPadDraws;
+	OcclusionBuffer occlusion;
 
-	//cube on the left
-	auto cube3 = make_cube(true, 2, { 0.4f, 0.4f, 0.4f },
-		make_rotation_z(-3.141592f / 2.f)
-		* make_scaling(0.5f, 0.6f, 0.6f)
-		* make_translation({ -0.6f, -0.9f, 0.f })
-	);
-	//merging all 3 cubes
-	auto cubes = concatenate(std::move(cubesA), cube3);
-	//GLuint vaoCube = create_vao(cubes);
-	//std::size_t  vertexCountCube = cubes.positions.size();
+	// Occlusion rasterizes on threads of its own. On the loader pool, its
+	// bands would wait behind texture streaming jobs (see occlusion.hpp).
+	ThreadPool occlusionPool;
 
-	auto completeShip = concatenate(std::move(shipBody), cubes);
+	// Cull on the GPU where possible. The CPU path remains as a fallback,
+	// and does more (occlusion and meshlet culling).
+	std::optional<GpuScene_> gpuScene;
+	try
+	{
+		gpuScene.emplace( parlahti, landingPad, landingPadInstances.size() );
+	}
+	catch( std::exception const& eErr )
+	{
+		std::fprintf( stderr, "GPU culling unavailable, culling on the CPU:\n%s\n", eErr.what() );
+	}
+	state.gpuCulling = gpuScene && !options.cpuCulling;
 
-	//spaceship without cube base is done
-	GLuint vaoShip = create_vao(completeShip);
-	std::size_t vertexCountShipBody = completeShip.positions.size();
+	if( options.checkGpuCulling )
+	{
+		if( !gpuScene )
+			return 1;
 
-// End GPU time query for Section 1.5
-glQueryCounter(sectionQueries[5], GL_TIMESTAMP);
+		return check_gpu_culling_( parlahti, *gpuScene ) ? 0 : 1;
+	}
 
-	OGL_CHECKPOINT_ALWAYS();
+	auto titleUpdated = Clock::now();
 
 	// Main loop
 	while( !glfwWindowShouldClose( window ) )
@@ -430,6 +642,11 @@ glQueryCounter(sectionQueries[5], GL_TIMESTAMP);
 
 		// Let GLFW process events
 		glfwPollEvents();
+
+		// Continue streaming textures
+		textureStreamer.update();
+		if( mapVirtualTexture )
+			mapVirtualTexture->update();
 		
 		// Check if window was resized.
 		float fbwidth, fbheight;
@@ -529,23 +746,86 @@ glQueryCounter(sectionQueries[5], GL_TIMESTAMP);
 		// step1) model to world
 		//Mat44f model2world = kIdentity44f;
 		// Task for arc ball 
-		Mat44f T = make_translation(-state.camControl.position); // Translate to camera position
-		Mat44f Rx = make_rotation_x(state.camControl.theta);     // Rotate around X-axis
-		Mat44f Ry = make_rotation_y(state.camControl.phi);       // Rotate around Y-axis
+		// Typed transforms (see typed_transform.hpp), so that the product
+		// only computes the entries that aren't 0 or 1.
+		Translation T = translation(-state.camControl.position); // Translate to camera position
+		RotationX Rx = rotation_x(state.camControl.theta);     // Rotate around X-axis
+		RotationY Ry = rotation_y(state.camControl.phi);       // Rotate around Y-axis
 
 		// Combine all together -> new world2camera
-		Mat44f world2camera = T * Ry * Rx;
+		Affine34f world2camera = T * Ry * Rx;
 
 		// define projection, 
+		float const fovY = 60.f * 3.1415926f / 180.f; // Yes, a proper pie would be useful. ( C++20: mathematical constants) 
 		Mat44f projection = make_perspective_projection(
-			60.f * 3.1415926f / 180.f, // Yes, a proper pie would be useful. ( C++20: mathematical constants) 
+			fovY,
 			fbwidth / float(fbheight),
 			0.1f, 100.0f
 		);
 		// concatenate the defined matrices  
 		Mat44f projCameraWorld = projection * world2camera;
 		// compute normal matrix from the model-to-world transform that we have defined previously
-		Mat33f normalMatrix = mat44_to_mat33(transpose(invert(Ry)));
+		Mat33f normalMatrix = normal_matrix(to_affine(Ry));
+
+		// Culling and levels of detail: drop chunks outside of the view
+		// frustum, and draw each remaining chunk with the coarsest level whose
+		// simplification error projects to at most one pixel.
+		float const lodErrorScale = lod_error_scale(fovY, float(fbheight));
+		Vec4f const eye = invert(world2camera) * Vec4f{ 0.f, 0.f, 0.f, 1.f };
+
+		CullStats cullStats{};
+		bool const gpuCulling = gpuScene && state.gpuCulling;
+		if( gpuCulling )
+		{
+			auto& culler = gpuScene->culler;
+			culler.begin_frame();
+			culler.cull(gpuScene->parlahti, gpuScene->parlahtiDraws, projCameraWorld, object_eye_(kIdentity44f, eye), lodErrorScale);
+			if( !landingPadBufferCurrent )
+			{
+				landingPadInstanceBuffer.update(landingPadInstances);
+				landingPadBufferCurrent = true;
+			}
+			culler.cull(gpuScene->landingPad, landingPadInstanceBuffer, gpuScene->landingPadDraws, projCameraWorld, object_eye_(kIdentity44f, eye), lodErrorScale);
+			culler.finish();
+		}
+		else
+		{
+			cull_chunks_(parlahti, projCameraWorld, parlahtiDraws, cullStats);
+			cull_instances_(landingPad, landingPadInstances, projCameraWorld, landingPadDraws, cullStats);
+
+			// The terrain and landing pads also occlude each other
+			occlusion.clear();
+			add_occluders_(parlahti, projCameraWorld, parlahtiDraws, occlusion);
+			add_instance_occluders_(landingPad, landingPadDraws, occlusion);
+			occlusion.render(&occlusionPool);
+
+			build_draws_(parlahti, projCameraWorld, kIdentity44f, eye, lodErrorScale, occlusion, parlahtiDraws, cullStats);
+			build_instanced_draws_(landingPad, landingPadInstances, eye, lodErrorScale, occlusion, landingPadDraws, cullStats);
+			landingPadInstanceBuffer.update(landingPadDraws.transforms);
+			landingPadBufferCurrent = false;
+		}
+
+		// Virtual texture feedback pass: which tiles of the map are visible?
+		if( mapVirtualTexture )
+		{
+			glUseProgram(feedbackProg->programId());
+			mapVirtualTexture->begin_feedback(int(fbwidth), int(fbheight));
+			mapVirtualTexture->bind_feedback();
+
+			glUniformMatrix4fv(0, 1, GL_TRUE, projCameraWorld.v);
+			glUniform3fv(kPositionScaleLocation, 1, &parlahti.dequant.positionScale.x);
+			glUniform3fv(kPositionBiasLocation, 1, &parlahti.dequant.positionBias.x);
+
+			glBindVertexArray(parlahtiVao);
+			CullStats feedbackStats{};
+			if( gpuCulling )
+				gpuScene->parlahtiDraws.draw();
+			else
+				draw_list_(parlahtiDraws, feedbackStats);
+
+			mapVirtualTexture->end_feedback();
+			glViewport(0, 0, GLsizei(fbwidth), GLsizei(fbheight));
+		}
 
 		// Draw scene
 		OGL_CHECKPOINT_DEBUG();
@@ -580,36 +860,44 @@ glQueryCounter(sectionQueries[5], GL_TIMESTAMP);
 
 		// step 3) set input data 
 		glBindVertexArray(parlahtiVao);	// source input as defined in our VAO 
+		apply_dequant(parlahti.dequant);
 		//Bind textures
 		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, mapTexture);
+		if( mapVirtualTexture )
+			mapVirtualTexture->bind();
+		else
+			glBindTexture(GL_TEXTURE_2D, textureStreamer.texture(mapTextureHandle));
 glUniform1i(glGetUniformLocation(prog.programId(), "uTexture"), 0); // Set the sampler uniform to the texture unit index
 
 		// step 4) issue Drawing commands 
-		glDrawArrays(GL_TRIANGLES, 0, parlahtiVertexCount);
+		if( gpuCulling )
+		{
+			gpuScene->parlahtiDraws.draw();
+			++cullStats.indirectDraws;
+		}
+		else
+			draw_list_(parlahtiDraws, cullStats);
+		glUniform1i(kVtEnabledLocation, 0);
 
 		// task 1.4
-		// Draw the first instance of the landingpad
-		glUniformMatrix4fv(
-			0, // location in shaders
-			1, GL_TRUE, (projCameraWorld * instanceTransform1).v
-		);
-		glBindVertexArray(landingPadVao);
-		//Bind textures
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, whiteTexture);
-		glDrawArrays(GL_TRIANGLES, 0, landingPadVertexCount);
-
-		// Draw the second instance of the landing pad
+		// Draw all instances of the landingpad. The model-to-world transforms
+		// come from the instance buffer.
 		glUniformMatrix4fv(
 			0, // location in shaders
-			1, GL_TRUE, (projCameraWorld * instanceTransform2).v
+			1, GL_TRUE, projCameraWorld.v
 		);
 		glBindVertexArray(landingPadVao);
+		apply_dequant(landingPad.dequant);
 		//Bind textures
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, whiteTexture);
-		glDrawArrays(GL_TRIANGLES, 0, landingPadVertexCount);
+		if( gpuCulling )
+		{
+			gpuScene->landingPadDraws.draw();
+			++cullStats.indirectDraws;
+		}
+		else
+			draw_instanced_(landingPadDraws, cullStats);
 
 		const float initialSpeed = 0.01f;       // Initial speed of the spaceship when horizontal
 		const float accelerationRate = 0.001f; // Rate of acceleration
@@ -655,71 +943,71 @@ glUniform1i(glGetUniformLocation(prog.programId(), "uTexture"), 0); // Set the s
 			}
 		}
 
-		Mat44f vehicleTransform = make_translation(state.vehiclePosition);
+		if (state.isAnimating || state.vehicleMoved) {
+			Affine34f vehicleTransform = to_affine(translation(state.vehiclePosition));
 
-		if (state.isCurving) {
-			// Calculate the tilt angle for the curving phase
-			float tiltAngle = state.vehicleAngle;
+			if (state.isCurving) {
+				// Calculate the tilt angle for the curving phase
+				float tiltAngle = state.vehicleAngle;
 
-			// Apply a rotation around the Z-axis (or change to another axis if needed)
-			vehicleTransform = vehicleTransform * make_rotation_z(-tiltAngle); // Note the negative sign for reverse direction
-		}
-		else if (state.isHorizontalFlight) {
-			// Fully horizontal, rotate -90 degrees around the Z-axis
-			vehicleTransform = vehicleTransform * make_rotation_z(-kPi / 2);
+				// Apply a rotation around the Z-axis (or change to another axis if needed)
+				vehicleTransform = vehicleTransform * rotation_z(-tiltAngle); // Note the negative sign for reverse direction
+			}
+			else if (state.isHorizontalFlight) {
+				// Fully horizontal, rotate -90 degrees around the Z-axis
+				vehicleTransform = vehicleTransform * rotation_z(-kPi / 2);
+			}
+			if (!state.isLiftingOff) {
+				float rotationAngle = atan2(state.vehicleDirection.z, state.vehicleDirection.x);
+				vehicleTransform = vehicleTransform * rotation_y(rotationAngle);
+			}
+
+			scene.set_local(vehicleNode, vehicleTransform);
+			state.vehicleMoved = false;
 		}
-		if (!state.isLiftingOff) {
-			float rotationAngle = atan2(state.vehicleDirection.z, state.vehicleDirection.x);
-			vehicleTransform = vehicleTransform * make_rotation_y(rotationAngle);
+
+		// Scene graph: recompute the world transforms of the nodes that
+		// changed, and pass on only those.
+		scene.update();
+		for (SceneNode const node : scene.changed()) {
+			if (node >= firstLandingPadNode && node < firstLandingPadNode + landingPadCount) {
+				// Uploaded by the next frame's culling
+				landingPadInstances[node - firstLandingPadNode] = to_mat44(scene.world(node));
+				landingPadBufferCurrent = false;
+			}
+			else if (node >= firstLightNode && node < firstLightNode + 3) {
+				pointLightPositions[node - firstLightNode] = transform_point(scene.world(node), Vec3f{ 0.f, 0.f, 0.f });
+			}
 		}
 
 		glUniformMatrix4fv(
 			0, // location in shaders
-			1, GL_TRUE, (projCameraWorld * vehicleTransform).v
+			1, GL_TRUE, projCameraWorld.v
 		);
 
 		//// Generate different shapes for testing
 		//glBindVertexArray(vaoCube);	// source input as defined in our VAO 
-		//glDrawArrays(GL_TRIANGLES, 0, vertexCountCube);
+		//glDrawElements(GL_TRIANGLES, GLsizei(indexCountCube), GL_UNSIGNED_INT, nullptr);
 		//OGL_CHECKPOINT_DEBUG();
 //		glBindVertexArray(vaoCone);	// source input as defined in our VAO 
-//		glDrawArrays(GL_TRIANGLES, 0, vertexCountCone);
+//		glDrawElements(GL_TRIANGLES, GLsizei(indexCountCone), GL_UNSIGNED_INT, nullptr);
 //		OGL_CHECKPOINT_DEBUG();
 ///		glBindVertexArray(vaoCylinder);	// source input as defined in our VAO 
-//		glDrawArrays(GL_TRIANGLES, 0, vertexCountCylinder);
+//		glDrawElements(GL_TRIANGLES, GLsizei(indexCountCylinder), GL_UNSIGNED_INT, nullptr);
 //		OGL_CHECKPOINT_DEBUG();
 		//// Generate different shapes for testing
 
 
 		// Task 1.5 display the body of the ship
-		glBindVertexArray(vaoShip);	// source input as defined in our VAO 
+		// One instanced draw per primitive; the vehicle transform is the
+		// root of the part hierarchy.
 		//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		glDrawArrays(GL_TRIANGLES, 0, vertexCountShipBody);
+		partRenderer.draw(ship, to_mat44(scene.world(vehicleNode)));
+		cullStats.drawCalls += partRenderer.draw_calls();
 
 
 		///task 1.6
-		// Ensure these variables are declared and properly assigned
-		float completeShipX = 1.0f;
-		float completeShipY = -0.5f;
-		float completeShipZ = -3.0f;
-
-		Mat44f completeShipTransform = make_translation({ completeShipX, completeShipY, completeShipZ });
-		// I made this to set the spaceship's position. But i dont know why, nothing changed :(
-
-		Vec3f localLightPositions[3] = {
-		Vec3f{4.0f, 18.0f, 0.0f}, // Position relative to the completeShip
-		Vec3f{0.0f, 22.0f, 0.0f},
-		Vec3f{0.0f, 1.0f, 4.0f}
-		};
-		// I think when i change Vec3f y-axis, the lights' position is changed.
-
-		Vec3f pointLightPositions[3];
-		for (int i = 0; i < 3; ++i) {
-			// Transform each local position to world space based on the spaceship's transformation
-			Vec4f transformedPosition = completeShipTransform * Vec4f{ localLightPositions[i].x, localLightPositions[i].y, localLightPositions[i].z, 1.0f };
-			pointLightPositions[i] = Vec3f{ transformedPosition.x, transformedPosition.y, transformedPosition.z };
-		}
-
+		// The light positions come from the scene graph (see above).
 		Vec3f pointLightColors[3];
 		pointLightColors[0].x = 1.0f; pointLightColors[0].y = 0.0f; pointLightColors[0].z = 0.0f; // Red
 		pointLightColors[1].x = 0.0f; pointLightColors[1].y = 0.0f; pointLightColors[1].z = 1.0f; // Blue
@@ -740,12 +1028,49 @@ auto cpuElapsedTime = std::chrono::duration_cast<std::chrono::nanoseconds>(cpuEn
 
 		// Display results
 		glfwSwapBuffers(window);
+
+		// Culling statistics, a few times per second
+		if( Clock::now() - titleUpdated > std::chrono::milliseconds(250) )
+		{
+			auto const chunkCount = parlahti.chunks.size() + landingPadInstances.size()*landingPad.chunks.size();
+
+			char title[256];
+			if( gpuCulling )
+			{
+				auto const gpuStats = gpuScene->culler.stats();
+				std::snprintf( title, sizeof(title), "%s - GPU culling: chunks %u/%zu visible, %u triangles, %zu indirect draws, %zu draws",
+					kWindowTitle, gpuStats.chunksVisible, chunkCount, gpuStats.trianglesSubmitted, cullStats.indirectDraws, cullStats.drawCalls
+				);
+			}
+			else
+			{
+				std::snprintf( title, sizeof(title), "%s - chunks %zu/%zu visible (%zu tested, %zu BVH nodes, %zu occluded), meshlets %zu/%zu, %zu triangles, %zu draws",
+					kWindowTitle, cullStats.chunksVisible - cullStats.chunksOccluded, chunkCount, cullStats.chunksTested, cullStats.nodesTested, cullStats.chunksOccluded,
+					cullStats.meshletsVisible, cullStats.meshletsTested, cullStats.trianglesSubmitted, cullStats.drawCalls
+				);
+			}
+			glfwSetWindowTitle(window, title);
+			titleUpdated = Clock::now();
+		}
+
+		if( firstFrame )
+		{
+			auto const ms = std::chrono::duration<double, std::milli>( Clock::now() - startupBegin ).count();
+			std::printf( "Time to first frame: %.2f ms (%u loader threads)\n", ms, pool.thread_count() );
+			firstFrame = false;
+		}
 	}
 
 	// Cleanup.
 	//TODO: additional cleanup
 	state.prog = nullptr;
 
+	if( mapVirtualTexture )
+	{
+		auto const& stats = mapVirtualTexture->stats();
+		std::printf( "Virtual texture: %zu tiles resident, %zu uploaded, %zu evicted\n", stats.resident, stats.uploaded, stats.evicted );
+	}
+
 	GLint available = 0;
 while (!available) {
     glGetQueryObjectiv(queryEnd, GL_QUERY_RESULT_AVAILABLE, &available);
@@ -769,6 +1094,484 @@ catch( std::exception const& eErr )
 
 namespace
 {
+	Options_ parse_options_( int aArgc, char* aArgv[] )
+	{
+		Options_ ret;
+		for( int i = 1; i < aArgc; ++i )
+		{
+			if( 0 == std::strcmp( aArgv[i], "--bench-vertex-layout" ) )
+				ret.benchVertexLayout = true;
+			else if( 0 == std::strcmp( aArgv[i], "--mesh-stats" ) )
+				ret.meshStats = true;
+			else if( 0 == std::strcmp( aArgv[i], "--bench-occlusion" ) )
+				ret.benchOcclusion = true;
+			else if( 0 == std::strcmp( aArgv[i], "--cpu-culling" ) )
+				ret.cpuCulling = true;
+			else if( 0 == std::strcmp( aArgv[i], "--bench-mesh-builder" ) )
+				ret.benchMeshBuilder = true;
+			else if( 0 == std::strcmp( aArgv[i], "--check-gpu-culling" ) )
+				ret.checkGpuCulling = true;
+			else
+				throw Error( "Unknown command line option '%s'", aArgv[i] );
+		}
+		return ret;
+	}
+
+	void print_mesh_stats_( char const* aObjPath )
+	{
+		auto const print = [] (char const* aStage, SimpleMeshData const& aMesh) {
+			auto const stats = analyze_vertex_cache( aMesh.indices, aMesh.positions.size() );
+			std::printf( "  %-14s ACMR %.3f  ATVR %.3f  (%zu transforms)\n", aStage, stats.acmr, stats.atvr, stats.transforms );
+		};
+
+		auto mesh = make_indexed( load_wavefront_obj( aObjPath ) );
+		std::printf( "%s: %zu vertices, %zu triangles, FIFO cache of %u\n", aObjPath, mesh.positions.size(), mesh.indices.size()/3, kDefaultVertexCacheSize );
+		print( "original", mesh );
+
+		mesh.indices = optimize_vertex_cache( mesh.indices, mesh.positions.size() );
+		print( "vertex cache", mesh );
+
+		mesh.indices = optimize_overdraw( mesh.indices, mesh.positions );
+		print( "overdraw", mesh );
+
+		auto const lods = make_lod_chain( mesh );
+		for( std::size_t i = 0; i < lods.size(); ++i )
+			std::printf( "  LOD %zu %8u triangles, error %g\n", i, lods[i].indexCount/3, double(lods[i].error) );
+
+		auto chunkedMesh = make_indexed( load_wavefront_obj( aObjPath ) );
+		auto const chunked = make_chunked_mesh( chunkedMesh );
+		std::printf( "  %zu chunks of at most %zu triangles, %zu levels of detail\n", chunked.chunks.size(), kDefaultChunkTriangles, chunked.lods.size() );
+	}
+
+	void bench_occlusion_( char const* aObjPath )
+	{
+		auto const prepared = prepare_static_mesh( aObjPath );
+		auto const view = prepared.view();
+		auto const occluder = make_occluder( view );
+
+		std::size_t occluderTriangles = 0;
+		Vec3f bmin = view.chunks[0].boundsMin, bmax = view.chunks[0].boundsMax;
+		for( std::size_t i = 0; i < view.chunkCount; ++i )
+		{
+			occluderTriangles += occluder.chunks[i].indexCount / 3;
+			bmin = Vec3f{ std::min( bmin.x, view.chunks[i].boundsMin.x ), std::min( bmin.y, view.chunks[i].boundsMin.y ), std::min( bmin.z, view.chunks[i].boundsMin.z ) };
+			bmax = Vec3f{ std::max( bmax.x, view.chunks[i].boundsMax.x ), std::max( bmax.y, view.chunks[i].boundsMax.y ), std::max( bmax.z, view.chunks[i].boundsMax.z ) };
+		}
+
+		std::printf( "%s: %zu chunks, %zu occluder triangles (of %zu), %zux%zu buffer\n", aObjPath, view.chunkCount, occluderTriangles, view.indexCount/3, OcclusionBuffer::kDefaultWidth, OcclusionBuffer::kDefaultHeight );
+
+		constexpr std::size_t kRepeats = 20;
+		auto const cameras = terrain_views_( bmin, bmax, 8 );
+
+		ThreadPool pool;
+		OcclusionBuffer occlusion;
+
+		auto const run = [&] (ThreadPool* aPool, char const* aLabel) {
+			double setupMs = 0.0, renderMs = 0.0;
+			std::size_t visible = 0, occluded = 0;
+
+			for( std::size_t r = 0; r < kRepeats; ++r )
+			{
+				for( auto const& camera : cameras )
+				{
+					auto const& clipFromObject = camera.clipFromWorld;
+					auto const frustum = make_frustum( clipFromObject );
+
+					auto const t0 = Clock::now();
+					occlusion.clear();
+					for( std::size_t i = 0; i < view.chunkCount; ++i )
+					{
+						if( CullResult::outside != test_box( frustum, view.chunks[i].boundsMin, view.chunks[i].boundsMax ) )
+							occlusion.add_occluder( clipFromObject, occluder, occluder.chunks[i] );
+					}
+					auto const t1 = Clock::now();
+					occlusion.render( aPool );
+					auto const t2 = Clock::now();
+
+					setupMs += std::chrono::duration<double, std::milli>( t1 - t0 ).count();
+					renderMs += std::chrono::duration<double, std::milli>( t2 - t1 ).count();
+
+					for( std::size_t i = 0; i < view.chunkCount; ++i )
+					{
+						auto const& chunk = view.chunks[i];
+						if( CullResult::outside == test_box( frustum, chunk.boundsMin, chunk.boundsMax ) )
+							continue;
+
+						++visible;
+						if( !occlusion.test_box( clipFromObject, chunk.boundsMin, chunk.boundsMax ) )
+							++occluded;
+					}
+				}
+			}
+
+			auto const frames = double(kRepeats * cameras.size());
+			std::printf( "  %-22s setup %.3f ms, raster %.3f ms per frame; %.1f%% of the chunks in the frustum occluded\n",
+				aLabel, setupMs / frames, renderMs / frames, visible ? 100.0 * double(occluded) / double(visible) : 0.0
+			);
+		};
+
+		run( nullptr, "single threaded" );
+		char label[64];
+		std::snprintf( label, sizeof(label), "%u worker threads", pool.thread_count() );
+		run( &pool, label );
+	}
+
+	void bench_mesh_builder_( std::size_t aPartCount )
+	{
+		// A model of many small parts, each generated separately (like the
+		// ship used to be). Generating the parts isn't timed.
+		std::vector<SimpleMeshData> parts;
+		parts.reserve( aPartCount );
+		for( std::size_t i = 0; i < aPartCount; ++i )
+		{
+			auto const place = make_translation( { float(i % 10), float(i / 10 % 10), float(i / 100) } )
+				* make_rotation_y( 0.1f * float(i) )
+				* make_scaling( 0.5f, 0.3f, 0.3f );
+
+			switch( i % 3 )
+			{
+				case 0: parts.emplace_back( make_cylinder( true, 16, { 1.f, 0.f, 0.f }, place ) ); break;
+				case 1: parts.emplace_back( make_cone( true, 16, { 0.f, 1.f, 0.f }, place ) ); break;
+				case 2: parts.emplace_back( make_cube( true, 2, { 0.f, 0.f, 1.f }, place ) ); break;
+			}
+		}
+
+		std::size_t indices = 0;
+		for( auto const& part : parts )
+			indices += part.indices.size();
+
+		std::printf( "%zu parts, %zu triangles\n", aPartCount, indices / 3 );
+
+		auto const time = [] (char const* aLabel, std::size_t aRepeats, auto&& aBuild) {
+			std::size_t check = 0;
+			auto const t0 = Clock::now();
+			for( std::size_t r = 0; r < aRepeats; ++r )
+				check += aBuild().indices.size();
+			auto const t1 = Clock::now();
+
+			std::printf( "  %-26s %9.3f ms  (%zu indices)\n", aLabel,
+				std::chrono::duration<double, std::milli>( t1 - t0 ).count() / double(aRepeats),
+				check / aRepeats
+			);
+		};
+
+		// concatenate() with the model so far as a named value copies it for
+		// each part. Moving it in avoids the copy, and the model then grows
+		// geometrically, but still reallocates a few times.
+		time( "concatenate (copy)", 1, [&] {
+			SimpleMeshData ret;
+			for( auto const& part : parts )
+				ret = concatenate( ret, part );
+			return ret;
+		} );
+		time( "concatenate (move)", 5, [&] {
+			SimpleMeshData ret;
+			for( auto const& part : parts )
+				ret = concatenate( std::move(ret), part );
+			return ret;
+		} );
+
+		time( "MeshBuilder", 20, [&] {
+			MeshBuilder builder;
+			for( auto const& part : parts )
+				builder.plan( part );
+			for( auto const& part : parts )
+				builder.append( part );
+			return builder.take();
+		} );
+
+		// Rebuilding into the same arena reuses its storage.
+		SimpleMeshData arena;
+		time( "MeshBuilder (arena)", 20, [&] () -> SimpleMeshData const& {
+			arena.positions.clear();
+			arena.colors.clear();
+			arena.normals.clear();
+			arena.texcoords.clear();
+			arena.indices.clear();
+
+			MeshBuilder builder( arena );
+			for( auto const& part : parts )
+				builder.plan( part );
+			for( auto const& part : parts )
+				builder.append( part );
+			return arena;
+		} );
+	}
+
+	std::vector<TerrainView_> terrain_views_( Vec3f aMin, Vec3f aMax, std::size_t aCount )
+	{
+		auto const center = (aMin + aMax) * 0.5f;
+		auto const projection = make_perspective_projection( 60.f * kPi_ / 180.f, 16.f / 9.f, 0.1f, 100.f );
+
+		Vec3f const eye{ center.x, aMax.y * 0.6f + center.y * 0.4f, center.z };
+
+		std::vector<TerrainView_> ret( aCount );
+		for( std::size_t i = 0; i < aCount; ++i )
+		{
+			float const phi = 2.f * kPi_ * float(i) / float(aCount);
+			ret[i].clipFromWorld = projection * make_rotation_x( 0.15f ) * make_rotation_y( phi ) * make_translation( -eye );
+			ret[i].eye = eye;
+		}
+		return ret;
+	}
+
+	bool check_gpu_culling_( StaticMesh const& aTerrain, GpuScene_& aGpu )
+	{
+		Vec3f bmin = aTerrain.chunks[0].boundsMin, bmax = aTerrain.chunks[0].boundsMax;
+		for( auto const& chunk : aTerrain.chunks )
+		{
+			bmin = Vec3f{ std::min( bmin.x, chunk.boundsMin.x ), std::min( bmin.y, chunk.boundsMin.y ), std::min( bmin.z, chunk.boundsMin.z ) };
+			bmax = Vec3f{ std::max( bmax.x, chunk.boundsMax.x ), std::max( bmax.y, chunk.boundsMax.y ), std::max( bmax.z, chunk.boundsMax.z ) };
+		}
+
+		// As in the main loop, for a 1280x720 framebuffer. The terrain's
+		// object space is world space.
+		float const lodErrorScale = lod_error_scale( 60.f * kPi_ / 180.f, 720.f );
+
+		std::printf( "Comparing GPU with CPU culling of %zu terrain chunks\n", aTerrain.chunks.size() );
+
+		std::size_t failures = 0;
+		std::size_t viewIndex = 0;
+		for( auto const& view : terrain_views_( bmin, bmax, 8 ) )
+		{
+			// CPU: visible chunks (as cull_chunks_()) and their levels of
+			// detail (as build_draws_(), without occlusion)
+			std::vector<std::uint32_t> visible;
+			CullStats stats{};
+			aTerrain.bvh.cull( make_frustum( view.clipFromWorld ), visible, stats );
+
+			auto const none = std::numeric_limits<std::size_t>::max();
+			std::vector<std::size_t> cpuLevels( aTerrain.chunks.size(), none );
+			for( auto const index : visible )
+			{
+				auto const& chunk = aTerrain.chunks[index];
+				auto const distance = distance_to_box( view.eye, chunk.boundsMin, chunk.boundsMax );
+				cpuLevels[index] = select_lod( aTerrain.lods.data() + chunk.firstLod, chunk.lodCount, distance, lodErrorScale );
+			}
+
+			// GPU: the level of a command is found by its first index
+			aGpu.culler.begin_frame();
+			aGpu.culler.cull( aGpu.parlahti, aGpu.parlahtiDraws, view.clipFromWorld, view.eye, lodErrorScale );
+			aGpu.culler.finish();
+
+			auto const commands = aGpu.parlahtiDraws.commands();
+			assert( commands.size() == aTerrain.chunks.size() );
+
+			std::size_t gpuVisible = 0, visibilityDiffers = 0, levelDiffers = 0;
+			for( std::size_t i = 0; i < aTerrain.chunks.size(); ++i )
+			{
+				auto const& chunk = aTerrain.chunks[i];
+				auto const& command = commands[i];
+
+				if( command.instanceCount )
+					++gpuVisible;
+
+				if( (none != cpuLevels[i]) != (0 != command.instanceCount) )
+				{
+					++visibilityDiffers;
+					continue;
+				}
+				if( 0 == command.instanceCount )
+					continue;
+
+				std::size_t gpuLevel = none;
+				for( std::size_t l = 0; l < chunk.lodCount; ++l )
+				{
+					if( aTerrain.lods[chunk.firstLod + l].firstIndex == command.firstIndex )
+						gpuLevel = l;
+				}
+
+				if( gpuLevel != cpuLevels[i] )
+					++levelDiffers;
+			}
+
+			std::printf( "  view %zu: %zu chunks visible on the CPU, %zu on the GPU; %zu differ in visibility, %zu in level of detail\n",
+				viewIndex, visible.size(), gpuVisible, visibilityDiffers, levelDiffers
+			);
+
+			failures += visibilityDiffers + levelDiffers;
+			++viewIndex;
+		}
+
+		std::printf( "%s\n", 0 == failures ? "GPU culling matches" : "GPU culling DIFFERS" );
+		return 0 == failures;
+	}
+
+	void cull_chunks_( StaticMesh const& aMesh, Mat44f const& aClipFromObject, DrawList_& aList, CullStats& aStats )
+	{
+		aList.visible.clear();
+
+		// Chunk bounds are in object space, so cull there.
+		aMesh.bvh.cull( make_frustum( aClipFromObject ), aList.visible, aStats );
+	}
+
+	void add_occluders_( StaticMesh const& aMesh, Mat44f const& aClipFromObject, DrawList_ const& aList, OcclusionBuffer& aOcclusion )
+	{
+		for( auto const index : aList.visible )
+			aOcclusion.add_occluder( aClipFromObject, aMesh.occluder, aMesh.occluder.chunks[index] );
+	}
+
+	void build_draws_( StaticMesh const& aMesh, Mat44f const& aProjCameraWorld, Mat44f const& aModel2World, Vec4f aEye, float aLodErrorScale, OcclusionBuffer const& aOcclusion, DrawList_& aList, CullStats& aStats )
+	{
+		aList.ranges.clear();
+		aList.counts.clear();
+		aList.offsets.clear();
+
+		auto const clipFromObject = aProjCameraWorld * aModel2World;
+		auto const frustum = make_frustum( clipFromObject );
+
+		auto const eye = object_eye_( aModel2World, aEye );
+
+		for( auto const index : aList.visible )
+		{
+			auto const& chunk = aMesh.chunks[index];
+			if( !aOcclusion.test_box( clipFromObject, chunk.boundsMin, chunk.boundsMax ) )
+			{
+				++aStats.chunksOccluded;
+				continue;
+			}
+
+			auto const distance = distance_to_box( eye, chunk.boundsMin, chunk.boundsMax );
+			auto const level = select_lod( aMesh.lods.data() + chunk.firstLod, chunk.lodCount, distance, aLodErrorScale );
+			auto const& lod = aMesh.lods[chunk.firstLod + level];
+
+			if( lod.meshletCount )
+				cull_meshlets( aMesh.meshlets.data() + lod.firstMeshlet, lod.meshletCount, frustum, eye, aList.ranges, aStats );
+			else
+				aList.ranges.emplace_back( IndexRange{ lod.firstIndex, lod.indexCount } );
+		}
+
+		for( auto const& range : aList.ranges )
+		{
+			auto const offset = std::uintptr_t(range.firstIndex) * sizeof(std::uint32_t);
+			aList.counts.emplace_back( GLsizei(range.indexCount) );
+			aList.offsets.emplace_back( reinterpret_cast<void const*>(offset) );
+		}
+	}
+
+	void cull_instances_( StaticMesh const& aMesh, std::vector<Mat44f> const& aInstances, Mat44f const& aProjCameraWorld, InstanceList_& aList, CullStats& aStats )
+	{
+		aList.visible.clear();
+
+		// All later steps work in clip space; compute the transforms of all
+		// instances in one go.
+		aList.clipFromObject.resize( aInstances.size() );
+		multiply_many( aProjCameraWorld, aInstances.data(), aList.clipFromObject.data(), aInstances.size() );
+
+		// Instances are culled as a whole, by the bounds of the mesh
+		auto const bmin = aMesh.dequant.positionBias;
+		auto const bmax = aMesh.dequant.positionBias + aMesh.dequant.positionScale;
+
+		for( std::size_t i = 0; i < aInstances.size(); ++i )
+		{
+			aStats.chunksTested += aMesh.chunks.size();
+			if( CullResult::outside == test_box( make_frustum( aList.clipFromObject[i] ), bmin, bmax ) )
+				continue;
+
+			aStats.chunksVisible += aMesh.chunks.size();
+			aList.visible.emplace_back( std::uint32_t(i) );
+		}
+	}
+
+	void add_instance_occluders_( StaticMesh const& aMesh, InstanceList_ const& aList, OcclusionBuffer& aOcclusion )
+	{
+		for( auto const instance : aList.visible )
+		{
+			auto const& clipFromObject = aList.clipFromObject[instance];
+			for( auto const& chunk : aMesh.occluder.chunks )
+				aOcclusion.add_occluder( clipFromObject, aMesh.occluder, chunk );
+		}
+	}
+
+	void build_instanced_draws_( StaticMesh const& aMesh, std::vector<Mat44f> const& aInstances, Vec4f aEye, float aLodErrorScale, OcclusionBuffer const& aOcclusion, InstanceList_& aList, CullStats& aStats )
+	{
+		auto& draws = aList.draws;
+		draws.ranges.clear();
+		draws.counts.clear();
+		draws.offsets.clear();
+		aList.transforms.clear();
+
+		auto const bmin = aMesh.dequant.positionBias;
+		auto const bmax = aMesh.dequant.positionBias + aMesh.dequant.positionScale;
+
+		// Each chunk is drawn at the finest level that any of the visible
+		// instances needs. Meshlets are not culled, as their cones depend on
+		// the instance.
+		auto const maxLevel = std::numeric_limits<std::size_t>::max();
+		std::vector<std::size_t> levels( aMesh.chunks.size(), maxLevel );
+
+		for( auto const instance : aList.visible )
+		{
+			auto const& model2world = aInstances[instance];
+			if( !aOcclusion.test_box( aList.clipFromObject[instance], bmin, bmax ) )
+			{
+				aStats.chunksOccluded += aMesh.chunks.size();
+				continue;
+			}
+
+			aList.transforms.emplace_back( model2world );
+
+			auto const eye = object_eye_( model2world, aEye );
+			for( std::size_t i = 0; i < aMesh.chunks.size(); ++i )
+			{
+				auto const& chunk = aMesh.chunks[i];
+				auto const distance = distance_to_box( eye, chunk.boundsMin, chunk.boundsMax );
+				levels[i] = std::min( levels[i], select_lod( aMesh.lods.data() + chunk.firstLod, chunk.lodCount, distance, aLodErrorScale ) );
+			}
+		}
+
+		if( aList.transforms.empty() )
+			return;
+
+		for( std::size_t i = 0; i < aMesh.chunks.size(); ++i )
+		{
+			auto const& lod = aMesh.lods[aMesh.chunks[i].firstLod + levels[i]];
+			draws.ranges.emplace_back( IndexRange{ lod.firstIndex, lod.indexCount } );
+		}
+
+		for( auto const& range : draws.ranges )
+		{
+			auto const offset = std::uintptr_t(range.firstIndex) * sizeof(std::uint32_t);
+			draws.counts.emplace_back( GLsizei(range.indexCount) );
+			draws.offsets.emplace_back( reinterpret_cast<void const*>(offset) );
+		}
+	}
+
+	void draw_instanced_( InstanceList_ const& aList, CullStats& aStats )
+	{
+		auto const instances = GLsizei(aList.transforms.size());
+		if( 0 == instances )
+			return;
+
+		for( std::size_t i = 0; i < aList.draws.counts.size(); ++i )
+		{
+			glDrawElementsInstanced( GL_TRIANGLES, aList.draws.counts[i], GL_UNSIGNED_INT, aList.draws.offsets[i], instances );
+
+			++aStats.drawCalls;
+			aStats.trianglesSubmitted += std::size_t(aList.draws.counts[i]) / 3 * std::size_t(instances);
+		}
+	}
+
+	Vec3f object_eye_( Mat44f const& aModel2World, Vec4f aEye )
+	{
+		// Instance transforms are built from translations, rotations and
+		// scalings, so they are affine.
+		Vec4f const p = invert( make_affine( aModel2World ) ) * aEye;
+		return Vec3f{ p.x, p.y, p.z };
+	}
+
+	void draw_list_( DrawList_ const& aList, CullStats& aStats )
+	{
+		if( aList.counts.empty() )
+			return;
+
+		glMultiDrawElements( GL_TRIANGLES, aList.counts.data(), GL_UNSIGNED_INT, aList.offsets.data(), GLsizei(aList.counts.size()) );
+
+		++aStats.drawCalls;
+		for( auto const count : aList.counts )
+			aStats.trianglesSubmitted += std::size_t(count) / 3;
+	}
+
 	void glfw_callback_error_(int aErrNum, char const* aErrDesc)
 	{
 		std::fprintf(stderr, "GLFW error: %s (%d)\n", aErrDesc, aErrNum);
@@ -803,6 +1606,13 @@ namespace
 				}
 			}
 
+			// G-key switches between GPU and CPU culling
+			if (GLFW_KEY_G == aKey && GLFW_PRESS == aAction)
+			{
+				state->gpuCulling = !state->gpuCulling;
+				std::fprintf(stderr, "%s culling\n", state->gpuCulling ? "GPU" : "CPU");
+			}
+
 			// Space toggles camera
 			if (GLFW_KEY_SPACE == aKey && GLFW_PRESS == aAction)
 			{
@@ -890,6 +1700,7 @@ namespace
 					state->vehicleAngle = 0.0f; // Reset angle
 					state->isCurving = false; // Reset curving flag
 					state->isHorizontalFlight = false; // Reset horizontal flight flag
+					state->vehicleMoved = true;
 				}
 
 				if (GLFW_KEY_R == aKey && GLFW_PRESS == aAction)
@@ -902,6 +1713,7 @@ namespace
 					state->isLiftingOff = false; // Reset lift-off flag
 					state->isCurving = false; // Reset curving flag
 					state->isHorizontalFlight = false; // Reset horizontal flight flag
+					state->vehicleMoved = true;
 				}
 
 			}
@@ -0,0 +1,156 @@
+#include "mesh_builder.hpp"
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include <cassert>
+
+#include "../vmlib/affine34.hpp"
+#include "../vmlib/transform.hpp"
+
+namespace
+{
+	// An empty vector gets exactly the planned size. One that already holds
+	// data (e.g., concatenate() in a loop) grows geometrically instead:
+	// reserving exactly would reallocate it for every part.
+	template< typename tType >
+	void reserve_to_( std::vector<tType>& aVector, std::size_t aCount )
+	{
+		if( aCount <= aVector.capacity() )
+			return;
+
+		if( aVector.empty() )
+			aVector.reserve( aCount );
+		else
+			aVector.reserve( std::max( aCount, 2 * aVector.capacity() ) );
+	}
+}
+
+MeshBuilder::MeshBuilder()
+	: MeshBuilder( mOwned )
+{}
+
+MeshBuilder::MeshBuilder( SimpleMeshData& aTarget )
+	: mOut( &aTarget )
+	, mPositions( aTarget.positions.size() )
+	, mColors( aTarget.colors.size() )
+	, mNormals( aTarget.normals.size() )
+	, mTexcoords( aTarget.texcoords.size() )
+	, mIndices( aTarget.indices.empty() ? aTarget.positions.size() : aTarget.indices.size() )
+	, mIndexed( !aTarget.indices.empty() )
+	, mReserved( false )
+{}
+
+void MeshBuilder::plan( SimpleMeshData const& aPart )
+{
+	assert( !mReserved );
+
+	mPositions += aPart.positions.size();
+	mColors += aPart.colors.size();
+	mNormals += aPart.normals.size();
+	mTexcoords += aPart.texcoords.size();
+
+	if( aPart.indices.empty() )
+	{
+		mIndices += aPart.positions.size();
+	}
+	else
+	{
+		mIndices += aPart.indices.size();
+		mIndexed = true;
+	}
+}
+
+void MeshBuilder::append( SimpleMeshData const& aPart )
+{
+	begin_part_( aPart );
+
+	auto& out = *mOut;
+	out.positions.insert( out.positions.end(), aPart.positions.begin(), aPart.positions.end() );
+	out.colors.insert( out.colors.end(), aPart.colors.begin(), aPart.colors.end() );
+	out.normals.insert( out.normals.end(), aPart.normals.begin(), aPart.normals.end() );
+	out.texcoords.insert( out.texcoords.end(), aPart.texcoords.begin(), aPart.texcoords.end() );
+}
+
+void MeshBuilder::append( SimpleMeshData const& aPart, Mat44f const& aTransform )
+{
+	begin_part_( aPart );
+
+	auto& out = *mOut;
+	auto const positions = out.positions.size();
+	out.positions.resize( positions + aPart.positions.size() );
+	transform_points( aTransform, aPart.positions.data(), out.positions.data() + positions, aPart.positions.size() );
+
+	Mat33f const N = normal_matrix( aTransform );
+	auto const normals = out.normals.size();
+	out.normals.resize( normals + aPart.normals.size() );
+	transform_normals( N, aPart.normals.data(), out.normals.data() + normals, aPart.normals.size() );
+
+	out.colors.insert( out.colors.end(), aPart.colors.begin(), aPart.colors.end() );
+	out.texcoords.insert( out.texcoords.end(), aPart.texcoords.begin(), aPart.texcoords.end() );
+}
+
+SimpleMeshData const& MeshBuilder::mesh() const noexcept
+{
+	return *mOut;
+}
+
+SimpleMeshData MeshBuilder::take()
+{
+	assert( mOut == &mOwned );
+
+	auto ret = std::move(mOwned);
+	mOwned = SimpleMeshData{};
+
+	mPositions = mColors = mNormals = mTexcoords = mIndices = 0;
+	mIndexed = false;
+	mReserved = false;
+
+	return ret;
+}
+
+void MeshBuilder::reserve_()
+{
+	auto& out = *mOut;
+	reserve_to_( out.positions, mPositions );
+	reserve_to_( out.colors, mColors );
+	reserve_to_( out.normals, mNormals );
+	reserve_to_( out.texcoords, mTexcoords );
+	if( mIndexed )
+		reserve_to_( out.indices, mIndices );
+
+	mReserved = true;
+}
+
+void MeshBuilder::begin_part_( SimpleMeshData const& aPart )
+{
+	if( !mReserved )
+		reserve_();
+
+	auto& out = *mOut;
+	auto const base = std::uint32_t(out.positions.size());
+
+	if( !mIndexed && aPart.indices.empty() )
+		return;
+
+	// Switching to indices (the first indexed part, or an indexed target):
+	// whatever is in the mesh so far is a soup and needs trivial indices.
+	if( out.indices.empty() )
+	{
+		for( std::uint32_t i = 0; i < base; ++i )
+			out.indices.emplace_back( i );
+	}
+	mIndexed = true;
+
+	if( aPart.indices.empty() )
+	{
+		for( std::size_t i = 0; i < aPart.positions.size(); ++i )
+			out.indices.emplace_back( base + std::uint32_t(i) );
+	}
+	else
+	{
+		for( auto const idx : aPart.indices )
+			out.indices.emplace_back( base + idx );
+	}
+}
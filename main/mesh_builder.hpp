@@ -0,0 +1,76 @@
+#ifndef MESH_BUILDER_HPP_5D0E93A2_7C1F_4B86_A4E3_19F6B2C8D057
+#define MESH_BUILDER_HPP_5D0E93A2_7C1F_4B86_A4E3_19F6B2C8D057
+
+#include <cstddef>
+
+#include "simple_mesh.hpp"
+
+#include "../vmlib/mat44.hpp"
+
+/* Assembles a mesh from parts without reallocating along the way.
+ *
+ * Chaining concatenate() copies everything assembled so far for each part,
+ * so the cost grows with the square of the part count. A MeshBuilder is
+ * used in two passes instead: plan() each part (only counts), then append()
+ * them in the same order. The first append() reserves the final sizes once;
+ * the parts are then copied into place.
+ *
+ *   MeshBuilder builder;
+ *   for( auto const& part : parts ) builder.plan( part );
+ *   for( auto const& part : parts ) builder.append( part );
+ *   auto mesh = builder.take();
+ *
+ * Like concatenate(), the result is indexed if any part is indexed (soup
+ * parts then get trivial indices), and attributes that a part lacks are
+ * skipped.
+ *
+ * A builder can instead append to a caller-supplied mesh, which then serves
+ * as an arena: clearing it keeps its capacity, so rebuilding a model of the
+ * same size (or smaller) doesn't allocate at all. If that mesh already holds
+ * data, it grows geometrically rather than to the exact size, so that
+ * repeated one-part appends (as in concatenate()) stay amortized linear.
+ */
+class MeshBuilder final
+{
+	public:
+		MeshBuilder();
+
+		// Appends to aTarget, after any data that it already holds. aTarget
+		// must outlive the builder.
+		explicit MeshBuilder( SimpleMeshData& aTarget );
+
+		MeshBuilder( MeshBuilder const& ) = delete;
+		MeshBuilder& operator= (MeshBuilder const&) = delete;
+
+	public:
+		// First pass. All parts must be planned before the first append().
+		void plan( SimpleMeshData const& );
+
+		// Second pass. Parts that weren't planned still work, but may
+		// reallocate.
+		void append( SimpleMeshData const& );
+
+		// As above, transforming positions by aTransform and normals by its
+		// inverse transpose (like the aPreTransform of make_cylinder() etc).
+		void append( SimpleMeshData const&, Mat44f const& aTransform );
+
+		SimpleMeshData const& mesh() const noexcept;
+
+		// Moves the result out of the builder's own storage. (With a
+		// caller-supplied target, the result is already there.)
+		SimpleMeshData take();
+
+	private:
+		void reserve_();
+		void begin_part_( SimpleMeshData const& );
+
+	private:
+		SimpleMeshData mOwned;
+		SimpleMeshData* mOut;
+
+		std::size_t mPositions, mColors, mNormals, mTexcoords, mIndices;
+		bool mIndexed;
+		bool mReserved;
+};
+
+#endif // MESH_BUILDER_HPP_5D0E93A2_7C1F_4B86_A4E3_19F6B2C8D057
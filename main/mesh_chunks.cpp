@@ -0,0 +1,158 @@
+#include "mesh_chunks.hpp"
+
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <algorithm>
+
+#include <cassert>
+
+#include "mesh_optimize.hpp"
+
+namespace
+{
+	struct Range_
+	{
+		std::size_t begin, end;
+	};
+
+	// Splits the triangles aTriangles[begin,end) at the median of their
+	// centroids along the longest axis, until each part has at most
+	// aMaxTriangles triangles. The triangles of each part end up contiguous.
+	void partition_( std::vector<std::uint32_t>& aTriangles, std::vector<Vec3f> const& aCentroids, Range_ aRange, std::size_t aMaxTriangles, std::vector<Range_>& aOut )
+	{
+		if( aRange.end - aRange.begin <= aMaxTriangles )
+		{
+			aOut.emplace_back( aRange );
+			return;
+		}
+
+		Vec3f bmin{ std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+		Vec3f bmax = -bmin;
+		for( auto i = aRange.begin; i < aRange.end; ++i )
+		{
+			auto const& c = aCentroids[aTriangles[i]];
+			bmin = Vec3f{ std::min( bmin.x, c.x ), std::min( bmin.y, c.y ), std::min( bmin.z, c.z ) };
+			bmax = Vec3f{ std::max( bmax.x, c.x ), std::max( bmax.y, c.y ), std::max( bmax.z, c.z ) };
+		}
+
+		auto const extent = bmax - bmin;
+		float Vec3f::* axis = &Vec3f::x;
+		if( extent.y > extent.x && extent.y >= extent.z )
+			axis = &Vec3f::y;
+		else if( extent.z > extent.x && extent.z > extent.y )
+			axis = &Vec3f::z;
+
+		auto const mid = aRange.begin + (aRange.end - aRange.begin) / 2;
+		std::nth_element( aTriangles.begin() + aRange.begin, aTriangles.begin() + mid, aTriangles.begin() + aRange.end, [&] (std::uint32_t aA, std::uint32_t aB) {
+			return aCentroids[aA].*axis < aCentroids[aB].*axis;
+		} );
+
+		partition_( aTriangles, aCentroids, Range_{ aRange.begin, mid }, aMaxTriangles, aOut );
+		partition_( aTriangles, aCentroids, Range_{ mid, aRange.end }, aMaxTriangles, aOut );
+	}
+}
+
+ChunkedMesh make_chunked_mesh( SimpleMeshData& aMesh, std::size_t aMaxChunkTriangles )
+{
+	assert( aMaxChunkTriangles > 0 );
+
+	ChunkedMesh ret;
+	if( aMesh.indices.empty() )
+		return ret;
+
+	auto const vertexCount = aMesh.positions.size();
+	auto const triangleCount = aMesh.indices.size() / 3;
+
+	// Partition
+	std::vector<Vec3f> centroids( triangleCount );
+	for( std::size_t t = 0; t < triangleCount; ++t )
+	{
+		auto const& p0 = aMesh.positions[aMesh.indices[t*3+0]];
+		auto const& p1 = aMesh.positions[aMesh.indices[t*3+1]];
+		auto const& p2 = aMesh.positions[aMesh.indices[t*3+2]];
+		centroids[t] = (p0 + p1 + p2) / 3.f;
+	}
+
+	std::vector<std::uint32_t> triangles( triangleCount );
+	std::iota( triangles.begin(), triangles.end(), std::uint32_t(0) );
+
+	std::vector<Range_> ranges;
+	partition_( triangles, centroids, Range_{ 0, triangleCount }, aMaxChunkTriangles, ranges );
+
+	// Vertices used by more than one chunk must not be moved by the
+	// simplification, or gaps would open up between chunks.
+	constexpr auto kNoChunk = std::numeric_limits<std::uint32_t>::max();
+
+	std::vector<std::uint8_t> locked;
+	if( ranges.size() > 1 )
+	{
+		locked.assign( vertexCount, 0 );
+
+		std::vector<std::uint32_t> owner( vertexCount, kNoChunk );
+		for( std::size_t c = 0; c < ranges.size(); ++c )
+		{
+			for( auto i = ranges[c].begin; i < ranges[c].end; ++i )
+			{
+				for( std::size_t j = 0; j < 3; ++j )
+				{
+					auto const v = aMesh.indices[triangles[i]*3+j];
+					if( kNoChunk == owner[v] )
+						owner[v] = std::uint32_t(c);
+					else if( owner[v] != c )
+						locked[v] = 1;
+				}
+			}
+		}
+	}
+
+	// Optimize each chunk and generate its levels of detail
+	std::vector<std::uint32_t> all;
+	all.reserve( aMesh.indices.size() * 4 / 3 );
+
+	std::vector<std::uint32_t> indices;
+	for( auto const& range : ranges )
+	{
+		indices.clear();
+		for( auto i = range.begin; i < range.end; ++i )
+		{
+			auto const t = triangles[i];
+			indices.insert( indices.end(), aMesh.indices.begin() + t*3, aMesh.indices.begin() + t*3 + 3 );
+		}
+
+		indices = optimize_vertex_cache( indices, vertexCount );
+		indices = optimize_overdraw( indices, aMesh.positions );
+
+		MeshChunk chunk{};
+		chunk.boundsMin = Vec3f{ std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+		chunk.boundsMax = -chunk.boundsMin;
+		for( auto const idx : indices )
+		{
+			auto const& p = aMesh.positions[idx];
+			chunk.boundsMin = Vec3f{ std::min( chunk.boundsMin.x, p.x ), std::min( chunk.boundsMin.y, p.y ), std::min( chunk.boundsMin.z, p.z ) };
+			chunk.boundsMax = Vec3f{ std::max( chunk.boundsMax.x, p.x ), std::max( chunk.boundsMax.y, p.y ), std::max( chunk.boundsMax.z, p.z ) };
+		}
+
+		auto const lods = append_lod_chain( aMesh, indices, locked, all );
+
+		chunk.firstLod = std::uint32_t(ret.lods.size());
+		chunk.lodCount = std::uint32_t(lods.size());
+		ret.lods.insert( ret.lods.end(), lods.begin(), lods.end() );
+		ret.chunks.emplace_back( chunk );
+	}
+
+	// Meshlets follow the (already optimized) triangle order of each level
+	for( auto& lod : ret.lods )
+	{
+		lod.firstMeshlet = std::uint32_t(ret.meshlets.size());
+		append_meshlets( all, lod.firstIndex, lod.indexCount, aMesh.positions, ret.meshlets );
+		lod.meshletCount = std::uint32_t(ret.meshlets.size()) - lod.firstMeshlet;
+	}
+
+	// Vertex fetch order follows the finest levels, which come first in
+	// each chunk.
+	aMesh.indices = std::move(all);
+	aMesh = optimize_vertex_fetch( std::move(aMesh) );
+
+	return ret;
+}
@@ -0,0 +1,52 @@
+#ifndef MESH_CHUNKS_HPP_E2A94C07_81F3_4D5B_B6C8_0A7D3E9F51B2
+#define MESH_CHUNKS_HPP_E2A94C07_81F3_4D5B_B6C8_0A7D3E9F51B2
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "mesh_lod.hpp"
+#include "meshlets.hpp"
+#include "simple_mesh.hpp"
+
+#include "../vmlib/vec3.hpp"
+
+/* Spatial chunks of a mesh.
+ *
+ * Large meshes (the terrain) are split into chunks of nearby triangles, so
+ * that chunks outside of the view can be culled (see culling.hpp), and so
+ * that each chunk can use its own level of detail. Each chunk has its own
+ * chain of levels of detail (entries firstLod ... firstLod+lodCount-1 of
+ * the mesh's level table). Vertices shared with other chunks are kept in
+ * all levels, so neighbouring chunks always fit together without cracks.
+ *
+ * Each level of each chunk is further split into meshlets, which are culled
+ * individually (back-facing and outside of the view).
+ */
+struct MeshChunk
+{
+	Vec3f boundsMin, boundsMax; // object space
+	std::uint32_t firstLod, lodCount;
+};
+
+static_assert( sizeof(MeshChunk) == 32 );
+
+constexpr std::size_t kDefaultChunkTriangles = 8192;
+
+struct ChunkedMesh
+{
+	std::vector<MeshChunk> chunks;
+	std::vector<MeshLod> lods;
+	std::vector<Meshlet> meshlets;
+};
+
+// Splits an indexed mesh into chunks of at most aMaxChunkTriangles triangles
+// (median splits along the longest axis), optimizes each chunk (see
+// mesh_optimize.hpp), generates its levels of detail and splits each level
+// into meshlets. Replaces the mesh's
+// indices by the concatenated index lists of all levels of all chunks, and
+// reorders the vertices for fetch locality.
+ChunkedMesh make_chunked_mesh( SimpleMeshData&, std::size_t aMaxChunkTriangles = kDefaultChunkTriangles );
+
+#endif // MESH_CHUNKS_HPP_E2A94C07_81F3_4D5B_B6C8_0A7D3E9F51B2
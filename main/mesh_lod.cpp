@@ -0,0 +1,145 @@
+#include "mesh_lod.hpp"
+
+#include <limits>
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+#include "mesh_simplify.hpp"
+#include "mesh_optimize.hpp"
+
+namespace
+{
+	// Stop once a level has fewer triangles than this, or when a level
+	// doesn't reduce the triangle count by at least kMinReduction_.
+	constexpr std::size_t kMinTriangles_ = 64;
+	constexpr float kMinReduction_ = 0.75f;
+
+	// The vertices used by a part of a mesh, renumbered from zero.
+	struct MeshPart_
+	{
+		SimpleMeshData mesh; // with the part's indices
+		std::vector<std::uint8_t> locked;
+		std::vector<std::uint32_t> vertices; // local -> original index
+	};
+
+	MeshPart_ extract_part_( SimpleMeshData const& aMesh, std::vector<std::uint32_t> const& aIndices, std::vector<std::uint8_t> const& aLocked )
+	{
+		constexpr auto kUnused = std::numeric_limits<std::uint32_t>::max();
+
+		MeshPart_ ret;
+		std::vector<std::uint32_t> remap( aMesh.positions.size(), kUnused );
+
+		ret.mesh.indices.reserve( aIndices.size() );
+		for( auto const idx : aIndices )
+		{
+			if( kUnused == remap[idx] )
+			{
+				remap[idx] = std::uint32_t(ret.vertices.size());
+				ret.vertices.emplace_back( idx );
+			}
+			ret.mesh.indices.emplace_back( remap[idx] );
+		}
+
+		auto const gather = [&] (auto const& aIn, auto& aOut) {
+			if( aIn.empty() )
+				return;
+
+			aOut.reserve( ret.vertices.size() );
+			for( auto const idx : ret.vertices )
+				aOut.emplace_back( aIn[idx] );
+		};
+
+		gather( aMesh.positions, ret.mesh.positions );
+		gather( aMesh.colors, ret.mesh.colors );
+		gather( aMesh.normals, ret.mesh.normals );
+		gather( aMesh.texcoords, ret.mesh.texcoords );
+		gather( aLocked, ret.locked );
+
+		return ret;
+	}
+}
+
+std::vector<MeshLod> make_lod_chain( SimpleMeshData& aMesh, std::size_t aMaxLevels )
+{
+	std::vector<std::uint32_t> all;
+	auto ret = append_lod_chain( aMesh, aMesh.indices, {}, all, aMaxLevels );
+
+	aMesh.indices = std::move(all);
+	return ret;
+}
+
+std::vector<MeshLod> append_lod_chain( SimpleMeshData const& aMesh, std::vector<std::uint32_t> const& aIndices, std::vector<std::uint8_t> const& aLocked, std::vector<std::uint32_t>& aOut, std::size_t aMaxLevels )
+{
+	assert( aMaxLevels > 0 );
+
+	std::vector<MeshLod> ret;
+	if( aIndices.empty() )
+		return ret;
+
+	ret.emplace_back( MeshLod{ std::uint32_t(aOut.size()), std::uint32_t(aIndices.size()), 0.f, 0, 0 } );
+	aOut.insert( aOut.end(), aIndices.begin(), aIndices.end() );
+
+	// Simplify a compact copy of the vertices that aIndices uses. The cost
+	// of simplify_mesh() includes terms that scale with the number of
+	// vertices, which would otherwise dominate for small parts (chunks) of
+	// large meshes.
+	auto const local = extract_part_( aMesh, aIndices, aLocked );
+
+	// Each level is simplified from the previous one, which is much faster
+	// than starting over from the full mesh every time. The errors add up
+	// (at most) across levels.
+	std::vector<std::uint32_t> previous = local.mesh.indices;
+	float error = 0.f;
+	while( ret.size() < aMaxLevels && previous.size()/3 > kMinTriangles_ )
+	{
+		auto const triangles = previous.size() / 3;
+
+		float levelError = 0.f;
+		auto indices = simplify_mesh( local.mesh, previous, local.locked, triangles / 4, std::numeric_limits<float>::max(), &levelError );
+
+		if( indices.empty() || float(indices.size()/3) > kMinReduction_ * float(triangles) )
+			break;
+
+		indices = optimize_vertex_cache( indices, local.mesh.positions.size() );
+		previous = indices;
+
+		error += levelError;
+
+		ret.emplace_back( MeshLod{ std::uint32_t(aOut.size()), std::uint32_t(indices.size()), error, 0, 0 } );
+		for( auto const idx : indices )
+			aOut.emplace_back( local.vertices[idx] );
+	}
+
+	return ret;
+}
+
+float lod_error_scale( float aFovYInRadians, float aViewportHeight ) noexcept
+{
+	return aViewportHeight / (2.f * std::tan( 0.5f * aFovYInRadians ));
+}
+
+float distance_to_box( Vec3f aPoint, Vec3f aBoxMin, Vec3f aBoxMax ) noexcept
+{
+	Vec3f const d{
+		std::max( { 0.f, aBoxMin.x - aPoint.x, aPoint.x - aBoxMax.x } ),
+		std::max( { 0.f, aBoxMin.y - aPoint.y, aPoint.y - aBoxMax.y } ),
+		std::max( { 0.f, aBoxMin.z - aPoint.z, aPoint.z - aBoxMax.z } )
+	};
+	return length( d );
+}
+
+std::size_t select_lod( MeshLod const* aLods, std::size_t aLodCount, float aDistance, float aErrorScale, float aMaxPixelError ) noexcept
+{
+	// Errors grow with the level, so the last acceptable level is the
+	// coarsest one.
+	std::size_t ret = 0;
+	for( std::size_t i = 1; i < aLodCount; ++i )
+	{
+		if( aLods[i].error * aErrorScale > aMaxPixelError * aDistance )
+			break;
+		ret = i;
+	}
+	return ret;
+}
@@ -0,0 +1,80 @@
+#ifndef MESH_LOD_HPP_3B8E51D2_6F0A_4C79_A2D4_95E7C13B0F68
+#define MESH_LOD_HPP_3B8E51D2_6F0A_4C79_A2D4_95E7C13B0F68
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "simple_mesh.hpp"
+
+#include "../vmlib/vec3.hpp"
+
+/* Levels of detail of a mesh.
+ *
+ * All levels share the mesh's vertex buffer. Their index lists are stored
+ * one after the other in the mesh's index buffer, finest level first; a
+ * level is drawn with
+ *   glDrawElements( GL_TRIANGLES, indexCount, GL_UNSIGNED_INT,
+ *     (void*)(firstIndex * sizeof(std::uint32_t)) ).
+ *
+ * error is the geometric error of the level relative to the original mesh,
+ * in the mesh's units (see simplify_mesh()). It is zero for level 0.
+ *
+ * If the level has been split into meshlets (see meshlets.hpp), they are
+ * entries firstMeshlet ... firstMeshlet+meshletCount-1 of the mesh's meshlet
+ * table, and together cover the level's index range. meshletCount is zero
+ * otherwise.
+ */
+struct MeshLod
+{
+	std::uint32_t firstIndex;
+	std::uint32_t indexCount;
+	float error;
+
+	std::uint32_t firstMeshlet;
+	std::uint32_t meshletCount;
+};
+
+// Generates a chain of levels of detail for an indexed mesh, each with about
+// a quarter of the triangles of the previous one, and replaces the mesh's
+// indices by the concatenated index lists. Each level's triangle order is
+// optimized for the vertex cache. The chain ends when simplification stalls
+// (e.g. because most vertices are on attribute seams) or the levels become
+// tiny.
+std::vector<MeshLod> make_lod_chain( SimpleMeshData&, std::size_t aMaxLevels = 8 );
+
+// Same, for the part of a mesh formed by the triangles aIndices (whose order
+// should already be optimized). The levels' index lists are appended to
+// aOut, and the returned levels refer to positions in aOut. Vertices v with
+// aLocked[v] != 0 are kept in all levels (see simplify_mesh()).
+std::vector<MeshLod> append_lod_chain(
+	SimpleMeshData const&,
+	std::vector<std::uint32_t> const& aIndices,
+	std::vector<std::uint8_t> const& aLocked,
+	std::vector<std::uint32_t>& aOut,
+	std::size_t aMaxLevels = 8
+);
+
+// Converts geometric errors to pixels: an error e at distance d projects to
+// about e * scale / d pixels.
+float lod_error_scale( float aFovYInRadians, float aViewportHeight ) noexcept;
+
+// Distance from a point to an axis aligned box (0 inside the box).
+float distance_to_box( Vec3f aPoint, Vec3f aBoxMin, Vec3f aBoxMax ) noexcept;
+
+// Picks the coarsest level whose error projects to at most aMaxPixelError
+// pixels at distance aDistance.
+std::size_t select_lod(
+	MeshLod const*, std::size_t aLodCount,
+	float aDistance, float aErrorScale,
+	float aMaxPixelError = 1.f
+) noexcept;
+
+inline
+std::size_t select_lod( std::vector<MeshLod> const& aLods, float aDistance, float aErrorScale, float aMaxPixelError = 1.f ) noexcept
+{
+	return select_lod( aLods.data(), aLods.size(), aDistance, aErrorScale, aMaxPixelError );
+}
+
+#endif // MESH_LOD_HPP_3B8E51D2_6F0A_4C79_A2D4_95E7C13B0F68
@@ -0,0 +1,384 @@
+#include "mesh_optimize.hpp"
+
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <algorithm>
+
+#include <cassert>
+
+namespace
+{
+	// FIFO post-transform cache, simulated with timestamps: a vertex is in
+	// the cache if fewer than aCacheSize misses happened since it was last
+	// transformed.
+	class FifoCache_ final
+	{
+		public:
+			FifoCache_( std::size_t aVertexCount, unsigned aCacheSize )
+				: mStamps( aVertexCount, 0 )
+				, mTime( aCacheSize + 1 )
+				, mSize( aCacheSize )
+			{}
+
+			// Returns true on a miss.
+			bool access( std::uint32_t aVertex )
+			{
+				if( mTime - mStamps[aVertex] > mSize )
+				{
+					mStamps[aVertex] = mTime++;
+					return true;
+				}
+				return false;
+			}
+
+			unsigned access_triangle( std::uint32_t const* aTri )
+			{
+				return unsigned(access( aTri[0] )) + unsigned(access( aTri[1] )) + unsigned(access( aTri[2] ));
+			}
+
+			// Evict everything.
+			void flush()
+			{
+				mTime += mSize + 1;
+			}
+
+		private:
+			std::vector<std::size_t> mStamps;
+			std::size_t mTime;
+			std::size_t mSize;
+	};
+
+	// Vertex -> triangles adjacency in compressed form: the triangles using
+	// vertex v are triangles[offsets[v]] ... triangles[offsets[v+1]-1].
+	struct Adjacency_
+	{
+		std::vector<std::uint32_t> offsets;
+		std::vector<std::uint32_t> triangles;
+	};
+
+	Adjacency_ build_adjacency_( std::vector<std::uint32_t> const& aIndices, std::size_t aVertexCount )
+	{
+		Adjacency_ ret;
+		ret.offsets.assign( aVertexCount+1, 0 );
+		for( auto const idx : aIndices )
+			++ret.offsets[idx+1];
+
+		std::partial_sum( ret.offsets.begin(), ret.offsets.end(), ret.offsets.begin() );
+
+		ret.triangles.resize( aIndices.size() );
+		std::vector<std::uint32_t> fill( ret.offsets.begin(), ret.offsets.end()-1 );
+		for( std::size_t i = 0; i < aIndices.size(); ++i )
+			ret.triangles[fill[aIndices[i]]++] = std::uint32_t(i / 3);
+
+		return ret;
+	}
+
+	Vec3f cross_( Vec3f aLeft, Vec3f aRight ) noexcept
+	{
+		return Vec3f{
+			aLeft.y*aRight.z - aLeft.z*aRight.y,
+			aLeft.z*aRight.x - aLeft.x*aRight.z,
+			aLeft.x*aRight.y - aLeft.y*aRight.x
+		};
+	}
+
+	template< typename tType >
+	void remap_( std::vector<tType>& aValues, std::vector<std::uint32_t> const& aOrder )
+	{
+		if( aValues.empty() )
+			return;
+
+		std::vector<tType> ret;
+		ret.reserve( aOrder.size() );
+		for( auto const idx : aOrder )
+			ret.emplace_back( aValues[idx] );
+
+		aValues = std::move(ret);
+	}
+}
+
+VertexCacheStats analyze_vertex_cache( std::vector<std::uint32_t> const& aIndices, std::size_t aVertexCount, unsigned aCacheSize )
+{
+	assert( aIndices.size() % 3 == 0 );
+
+	VertexCacheStats ret{};
+	ret.triangles = aIndices.size() / 3;
+
+	FifoCache_ cache( aVertexCount, aCacheSize );
+	std::vector<bool> seen( aVertexCount, false );
+	for( auto const idx : aIndices )
+	{
+		if( cache.access( idx ) )
+			++ret.transforms;
+
+		if( !seen[idx] )
+		{
+			seen[idx] = true;
+			++ret.vertices;
+		}
+	}
+
+	ret.acmr = ret.triangles ? float(ret.transforms) / float(ret.triangles) : 0.f;
+	ret.atvr = ret.vertices ? float(ret.transforms) / float(ret.vertices) : 0.f;
+	return ret;
+}
+
+std::vector<std::uint32_t> optimize_vertex_cache( std::vector<std::uint32_t> const& aIndices, std::size_t aVertexCount, unsigned aCacheSize )
+{
+	assert( aIndices.size() % 3 == 0 );
+
+	auto const triangleCount = aIndices.size() / 3;
+	auto const adjacency = build_adjacency_( aIndices, aVertexCount );
+
+	// Tipsify: repeatedly "fan" around a vertex, emitting all of its
+	// remaining triangles, then pick the next fanning vertex among the ones
+	// just emitted, preferring vertices that will still be in the cache once
+	// their remaining triangles are emitted.
+	std::vector<std::uint32_t> live( aVertexCount );
+	for( std::size_t v = 0; v < aVertexCount; ++v )
+		live[v] = adjacency.offsets[v+1] - adjacency.offsets[v];
+
+	std::vector<std::size_t> stamps( aVertexCount, 0 );
+	std::vector<bool> emitted( triangleCount, false );
+	std::vector<std::uint32_t> deadEnds;
+	std::vector<std::uint32_t> candidates;
+
+	std::size_t const k = aCacheSize;
+	std::size_t time = k + 1;
+	std::size_t cursor = 0;
+
+	std::vector<std::uint32_t> ret;
+	ret.reserve( aIndices.size() );
+
+	auto skip_dead_end = [&] () -> std::int64_t {
+		// Recently used vertices with remaining triangles first...
+		while( !deadEnds.empty() )
+		{
+			auto const v = deadEnds.back();
+			deadEnds.pop_back();
+			if( live[v] > 0 )
+				return v;
+		}
+
+		// ... then the next vertex in input order.
+		for( ; cursor < aVertexCount; ++cursor )
+		{
+			if( live[cursor] > 0 )
+				return std::int64_t(cursor);
+		}
+
+		return -1;
+	};
+
+	std::int64_t fan = aVertexCount ? skip_dead_end() : -1;
+	while( fan >= 0 )
+	{
+		candidates.clear();
+
+		auto const f = std::uint32_t(fan);
+		for( auto i = adjacency.offsets[f]; i < adjacency.offsets[f+1]; ++i )
+		{
+			auto const t = adjacency.triangles[i];
+			if( emitted[t] )
+				continue;
+
+			for( std::size_t j = 0; j < 3; ++j )
+			{
+				auto const v = aIndices[t*3+j];
+				ret.emplace_back( v );
+				deadEnds.emplace_back( v );
+				candidates.emplace_back( v );
+				--live[v];
+
+				if( time - stamps[v] > k )
+					stamps[v] = time++;
+			}
+
+			emitted[t] = true;
+		}
+
+		// Next fanning vertex: the oldest candidate that stays in the cache
+		// while its remaining triangles are emitted (each of which may push
+		// up to two new vertices).
+		std::int64_t next = -1, best = -1;
+		for( auto const v : candidates )
+		{
+			if( 0 == live[v] )
+				continue;
+
+			std::int64_t priority = 0;
+			if( time - stamps[v] + 2*live[v] <= k )
+				priority = std::int64_t(time - stamps[v]);
+
+			if( priority > best )
+			{
+				best = priority;
+				next = v;
+			}
+		}
+
+		fan = next >= 0 ? next : skip_dead_end();
+	}
+
+	assert( ret.size() == aIndices.size() );
+	return ret;
+}
+
+std::vector<std::uint32_t> optimize_overdraw( std::vector<std::uint32_t> const& aIndices, std::vector<Vec3f> const& aPositions, float aThreshold, unsigned aCacheSize )
+{
+	assert( aIndices.size() % 3 == 0 );
+
+	auto const triangleCount = aIndices.size() / 3;
+	if( 0 == triangleCount )
+		return aIndices;
+
+	// Hard boundaries: triangles where all three vertices miss the cache.
+	// Starting a cluster there costs nothing.
+	std::vector<std::size_t> hard;
+	{
+		FifoCache_ cache( aPositions.size(), aCacheSize );
+		for( std::size_t t = 0; t < triangleCount; ++t )
+		{
+			if( 3 == cache.access_triangle( aIndices.data() + t*3 ) )
+				hard.emplace_back( t );
+		}
+	}
+	hard.emplace_back( triangleCount );
+
+	// Soft boundaries: split each hard cluster further wherever the ACMR
+	// since the start of the current cluster has reached the target (the
+	// cluster's own ACMR, relaxed by aThreshold). Starting a new cluster
+	// flushes the cache, which is where the extra misses come from.
+	std::vector<std::size_t> clusters;
+	{
+		FifoCache_ cache( aPositions.size(), aCacheSize );
+		for( std::size_t c = 0; c+1 < hard.size(); ++c )
+		{
+			auto const begin = hard[c], end = hard[c+1];
+
+			cache.flush();
+			std::size_t misses = 0;
+			for( auto t = begin; t < end; ++t )
+				misses += cache.access_triangle( aIndices.data() + t*3 );
+
+			auto const target = aThreshold * float(misses) / float(end-begin);
+
+			clusters.emplace_back( begin );
+			cache.flush();
+
+			std::size_t runningMisses = 0, runningTriangles = 0;
+			for( auto t = begin; t < end; ++t )
+			{
+				runningMisses += cache.access_triangle( aIndices.data() + t*3 );
+				++runningTriangles;
+
+				if( t+1 < end && float(runningMisses) / float(runningTriangles) <= target )
+				{
+					clusters.emplace_back( t+1 );
+					cache.flush();
+					runningMisses = runningTriangles = 0;
+				}
+			}
+		}
+	}
+	clusters.emplace_back( triangleCount );
+
+	// Sort key: how far the cluster faces away from the mesh's center.
+	// Clusters on the outside, facing outwards, are likely to occlude others
+	// and are drawn first.
+	auto const clusterCount = clusters.size()-1;
+
+	std::vector<Vec3f> centroids( clusterCount, Vec3f{ 0.f, 0.f, 0.f } );
+	std::vector<Vec3f> normals( clusterCount, Vec3f{ 0.f, 0.f, 0.f } );
+	std::vector<float> areas( clusterCount, 0.f );
+
+	Vec3f meshCentroid{ 0.f, 0.f, 0.f };
+	float meshArea = 0.f;
+
+	for( std::size_t c = 0; c < clusterCount; ++c )
+	{
+		for( auto t = clusters[c]; t < clusters[c+1]; ++t )
+		{
+			auto const& p0 = aPositions[aIndices[t*3+0]];
+			auto const& p1 = aPositions[aIndices[t*3+1]];
+			auto const& p2 = aPositions[aIndices[t*3+2]];
+
+			auto const n = cross_( p1 - p0, p2 - p0 ); // length = 2*area
+			auto const area = length( n );
+
+			centroids[c] += (p0 + p1 + p2) * (area / 3.f);
+			normals[c] += n;
+			areas[c] += area;
+		}
+
+		meshCentroid += centroids[c];
+		meshArea += areas[c];
+	}
+
+	if( meshArea > 0.f )
+		meshCentroid /= meshArea;
+
+	std::vector<float> keys( clusterCount, 0.f );
+	for( std::size_t c = 0; c < clusterCount; ++c )
+	{
+		if( areas[c] <= 0.f )
+			continue;
+
+		auto const normalLength = length( normals[c] );
+		if( normalLength > 0.f )
+			keys[c] = dot( centroids[c] / areas[c] - meshCentroid, normals[c] / normalLength );
+	}
+
+	std::vector<std::size_t> order( clusterCount );
+	std::iota( order.begin(), order.end(), std::size_t(0) );
+	std::stable_sort( order.begin(), order.end(), [&] (std::size_t aA, std::size_t aB) {
+		return keys[aA] > keys[aB];
+	} );
+
+	std::vector<std::uint32_t> ret;
+	ret.reserve( aIndices.size() );
+	for( auto const c : order )
+		ret.insert( ret.end(), aIndices.begin() + clusters[c]*3, aIndices.begin() + clusters[c+1]*3 );
+
+	return ret;
+}
+
+SimpleMeshData optimize_vertex_fetch( SimpleMeshData aMesh )
+{
+	constexpr auto kUnused = std::numeric_limits<std::uint32_t>::max();
+
+	std::vector<std::uint32_t> remap( aMesh.positions.size(), kUnused );
+	std::vector<std::uint32_t> order;
+	order.reserve( aMesh.positions.size() );
+
+	for( auto& idx : aMesh.indices )
+	{
+		if( kUnused == remap[idx] )
+		{
+			remap[idx] = std::uint32_t(order.size());
+			order.emplace_back( idx );
+		}
+
+		idx = remap[idx];
+	}
+
+	remap_( aMesh.positions, order );
+	remap_( aMesh.colors, order );
+	remap_( aMesh.normals, order );
+	remap_( aMesh.texcoords, order );
+
+	return aMesh;
+}
+
+SimpleMeshData optimize_mesh( SimpleMeshData aMesh, unsigned aCacheSize )
+{
+	if( aMesh.indices.empty() )
+		return aMesh;
+
+	auto const vertexCount = aMesh.positions.size();
+	aMesh.indices = optimize_vertex_cache( aMesh.indices, vertexCount, aCacheSize );
+	aMesh.indices = optimize_overdraw( aMesh.indices, aMesh.positions, 1.05f, aCacheSize );
+
+	return optimize_vertex_fetch( std::move(aMesh) );
+}
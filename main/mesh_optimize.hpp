@@ -0,0 +1,81 @@
+#ifndef MESH_OPTIMIZE_HPP_5E0B7C21_9A4D_4F36_8C1E_D2A7F3B6409C
+#define MESH_OPTIMIZE_HPP_5E0B7C21_9A4D_4F36_8C1E_D2A7F3B6409C
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "simple_mesh.hpp"
+
+#include "../vmlib/vec3.hpp"
+
+/* Optimization of indexed triangle lists for the GPU's vertex pipeline.
+ *
+ * - optimize_vertex_cache() reorders triangles such that vertices are reused
+ *   while they are still in the post-transform cache ("Tipsify", Sander et
+ *   al. 2007, Fast Triangle Reordering for Vertex Locality and Reduced
+ *   Overdraw).
+ * - optimize_overdraw() splits a cache-optimized triangle list into clusters
+ *   and sorts the clusters such that outward-facing ones are drawn first,
+ *   trading a bit of cache efficiency for less overdraw (same paper).
+ * - optimize_vertex_fetch() reorders vertices by first use, so that vertex
+ *   fetch walks the vertex buffer (mostly) linearly.
+ *
+ * The post-transform cache is modeled as a FIFO of aCacheSize entries. Real
+ * hardware differs in the details, but the model ranks orderings correctly.
+ */
+
+constexpr unsigned kDefaultVertexCacheSize = 16;
+
+// Statistics of an index buffer under the FIFO cache model. Lower is better
+// for both ratios:
+//  - ACMR (average cache miss ratio): vertex shader invocations per
+//    triangle. Ranges from 3 (no reuse) down to ~0.5 for large regular
+//    grids.
+//  - ATVR (average transformed vertex ratio): vertex shader invocations per
+//    unique vertex. 1 is optimal.
+struct VertexCacheStats
+{
+	std::size_t triangles;
+	std::size_t vertices;    // unique vertices referenced by the indices
+	std::size_t transforms;  // cache misses
+
+	float acmr;
+	float atvr;
+};
+
+VertexCacheStats analyze_vertex_cache(
+	std::vector<std::uint32_t> const& aIndices,
+	std::size_t aVertexCount,
+	unsigned aCacheSize = kDefaultVertexCacheSize
+);
+
+// Returns the reordered triangle list. Triangles are kept intact (including
+// their winding); only their order changes.
+std::vector<std::uint32_t> optimize_vertex_cache(
+	std::vector<std::uint32_t> const& aIndices,
+	std::size_t aVertexCount,
+	unsigned aCacheSize = kDefaultVertexCacheSize
+);
+
+// aIndices should be the result of optimize_vertex_cache(). aThreshold is the
+// tolerated ACMR increase; 1.05 lets the ACMR grow by about 5% in exchange
+// for finer clusters (and hence better sorting). The bound holds for each
+// cluster on its own; the reordered clusters see a different cache state at
+// their boundaries, so the total can end up slightly higher.
+std::vector<std::uint32_t> optimize_overdraw(
+	std::vector<std::uint32_t> const& aIndices,
+	std::vector<Vec3f> const& aPositions,
+	float aThreshold = 1.05f,
+	unsigned aCacheSize = kDefaultVertexCacheSize
+);
+
+// Reorders (and remaps) all vertex attributes of an indexed mesh by first
+// use in the index buffer. Vertices that aren't referenced are removed.
+SimpleMeshData optimize_vertex_fetch( SimpleMeshData );
+
+// All of the above, in order. Non-indexed meshes are returned unchanged.
+SimpleMeshData optimize_mesh( SimpleMeshData, unsigned aCacheSize = kDefaultVertexCacheSize );
+
+#endif // MESH_OPTIMIZE_HPP_5E0B7C21_9A4D_4F36_8C1E_D2A7F3B6409C
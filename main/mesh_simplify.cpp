@@ -0,0 +1,625 @@
+#include "mesh_simplify.hpp"
+
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+
+#include <cmath>
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+	// Relative weights of attribute errors. Positions are normalized to the
+	// unit cube first, so these are relative to the size of the mesh.
+	constexpr float kTexcoordWeight_ = 1.f;
+	constexpr float kNormalWeight_ = 0.05f;
+
+	// Weight of the planes through open edges, which keep borders in place.
+	constexpr float kBorderWeight_ = 10.f;
+
+	// Border vertices where the border turns by more than this (cosine of
+	// the angle between the two border edges) are corners, and are locked.
+	constexpr float kCornerCos_ = 0.5f;
+
+	constexpr std::size_t kMaxAttribs_ = 5; // 2 texcoord + 3 normal components
+
+	constexpr std::uint32_t kNone_ = std::numeric_limits<std::uint32_t>::max();
+
+	// Q(p) = (p^T A p + 2 b.p + c) / w, i.e., the weighted mean of squared
+	// distances to a set of planes.
+	struct Quadric_
+	{
+		float a00, a01, a02, a11, a12, a22;
+		float b0, b1, b2;
+		float c;
+		float w;
+	};
+
+	// Attribute error: sum over components k of the weighted mean of
+	//   (g_k.p + d_k - s_k)^2,
+	// where g_k and d_k describe how a triangle interpolates the attribute,
+	// and s_k is the attribute of the vertex placed at p. Expanding the
+	// square gives a quadric (the s-independent part) plus linear terms.
+	struct AttribQuadric_
+	{
+		Quadric_ q;
+		float linear[kMaxAttribs_][4]; // sum w g_k, sum w d_k
+	};
+
+	enum class VertexKind_ : std::uint8_t
+	{
+		manifold, // may collapse onto any neighbour
+		border,   // on a single open boundary; may only move along it
+		locked    // seams, non-manifold and complex vertices
+	};
+
+	// Topology of the mesh with vertices welded by position (attributes are
+	// ignored), so that attribute seams don't look like holes.
+	struct Topology_
+	{
+		std::vector<std::uint32_t> canonical; // first vertex with the same position
+		std::vector<VertexKind_> kinds;
+
+		// Border vertices: the (canonical) vertices at the other end of the
+		// outgoing and incoming open edges. Updated as the border is
+		// simplified (see collapse_border_()).
+		std::vector<std::uint32_t> borderNext, borderPrev;
+
+		std::unordered_map<std::uint64_t, std::uint32_t> edges; // directed, canonical
+	};
+
+	std::uint64_t edge_key_( std::uint32_t aFrom, std::uint32_t aTo ) noexcept
+	{
+		return (std::uint64_t(aFrom) << 32) | aTo;
+	}
+
+	struct PositionHash_
+	{
+		std::size_t operator()( Vec3f const& aP ) const noexcept
+		{
+			std::uint32_t words[3];
+			std::memcpy( words, &aP, sizeof(words) );
+			return std::size_t(words[0] * 73856093u ^ words[1] * 19349663u ^ words[2] * 83492791u);
+		}
+	};
+	struct PositionEqual_
+	{
+		bool operator()( Vec3f const& aA, Vec3f const& aB ) const noexcept
+		{
+			return 0 == std::memcmp( &aA, &aB, sizeof(Vec3f) );
+		}
+	};
+
+	Topology_ classify_( std::vector<Vec3f> const& aPositions, std::vector<std::uint32_t> const& aIndices, std::vector<std::uint8_t> const& aLocked )
+	{
+		auto const count = aPositions.size();
+
+		Topology_ ret;
+		ret.canonical.resize( count );
+		std::iota( ret.canonical.begin(), ret.canonical.end(), std::uint32_t(0) );
+
+		// Only vertices that are referenced can form seams.
+		std::vector<std::uint8_t> used( count, 0 );
+		for( auto const idx : aIndices )
+			used[idx] = 1;
+
+		std::vector<std::uint32_t> wedges( count, 0 );
+		{
+			std::unordered_map<Vec3f, std::uint32_t, PositionHash_, PositionEqual_> first;
+			first.reserve( count );
+			for( std::size_t v = 0; v < count; ++v )
+			{
+				if( !used[v] )
+					continue;
+
+				auto const it = first.emplace( aPositions[v], std::uint32_t(v) ).first;
+				ret.canonical[v] = it->second;
+				++wedges[it->second];
+			}
+		}
+
+		ret.edges.reserve( aIndices.size() );
+		for( std::size_t i = 0; i < aIndices.size(); i += 3 )
+		{
+			for( std::size_t j = 0; j < 3; ++j )
+			{
+				auto const a = ret.canonical[aIndices[i+j]];
+				auto const b = ret.canonical[aIndices[i+(j+1)%3]];
+				++ret.edges[edge_key_( a, b )];
+			}
+		}
+
+		ret.kinds.assign( count, VertexKind_::manifold );
+		ret.borderNext.assign( count, kNone_ );
+		ret.borderPrev.assign( count, kNone_ );
+
+		std::vector<std::uint8_t> openOut( count, 0 ), openIn( count, 0 );
+		for( auto const& edge : ret.edges )
+		{
+			auto const a = std::uint32_t(edge.first >> 32);
+			auto const b = std::uint32_t(edge.first);
+
+			// Edges used more than once in the same direction are non-manifold.
+			if( edge.second > 1 )
+				ret.kinds[a] = ret.kinds[b] = VertexKind_::locked;
+
+			if( ret.edges.end() == ret.edges.find( edge_key_( b, a ) ) )
+			{
+				openOut[a] = std::uint8_t(std::min( 2, openOut[a]+1 ));
+				openIn[b] = std::uint8_t(std::min( 2, openIn[b]+1 ));
+				ret.borderNext[a] = b;
+				ret.borderPrev[b] = a;
+			}
+		}
+
+		for( std::size_t v = 0; v < count; ++v )
+		{
+			auto const c = ret.canonical[v];
+			if( c != v )
+				continue;
+
+			if( wedges[c] > 1 )
+				ret.kinds[c] = VertexKind_::locked;
+			else if( VertexKind_::locked != ret.kinds[c] && (openOut[c] || openIn[c]) )
+				ret.kinds[c] = (1 == openOut[c] && 1 == openIn[c]) ? VertexKind_::border : VertexKind_::locked;
+
+			if( VertexKind_::border == ret.kinds[c] )
+			{
+				auto const in = aPositions[c] - aPositions[ret.borderPrev[c]];
+				auto const out = aPositions[ret.borderNext[c]] - aPositions[c];
+				if( dot( in, out ) < kCornerCos_ * length( in ) * length( out ) )
+					ret.kinds[c] = VertexKind_::locked;
+			}
+		}
+
+		for( std::size_t v = 0; v < aLocked.size(); ++v )
+		{
+			if( aLocked[v] )
+				ret.kinds[ret.canonical[v]] = VertexKind_::locked;
+		}
+
+		for( std::size_t v = 0; v < count; ++v )
+			ret.kinds[v] = ret.kinds[ret.canonical[v]];
+
+		return ret;
+	}
+
+	bool is_open_( Topology_ const& aTopo, std::uint32_t aA, std::uint32_t aB )
+	{
+		auto const a = aTopo.canonical[aA], b = aTopo.canonical[aB];
+		return aTopo.edges.end() == aTopo.edges.find( edge_key_( b, a ) );
+	}
+
+	bool can_collapse_( Topology_ const& aTopo, std::uint32_t aFrom, std::uint32_t aTo )
+	{
+		switch( aTopo.kinds[aFrom] )
+		{
+			case VertexKind_::manifold:
+				return true;
+			case VertexKind_::border:
+			{
+				auto const to = aTopo.canonical[aTo];
+				return to == aTopo.borderNext[aFrom] || to == aTopo.borderPrev[aFrom];
+			}
+			case VertexKind_::locked:
+				return false;
+		}
+		return false;
+	}
+
+	// aFrom, a border vertex, has been collapsed onto one of its border
+	// neighbours; aTo takes its place on the border.
+	void collapse_border_( Topology_& aTopo, std::uint32_t aFrom, std::uint32_t aTo )
+	{
+		auto const to = aTopo.canonical[aTo];
+		auto const prev = aTopo.borderPrev[aFrom], next = aTopo.borderNext[aFrom];
+
+		if( to == next )
+		{
+			aTopo.borderNext[prev] = to;
+			aTopo.borderPrev[to] = prev;
+		}
+		else
+		{
+			aTopo.borderPrev[next] = to;
+			aTopo.borderNext[to] = next;
+		}
+	}
+
+	Quadric_ make_quadric_( double aNX, double aNY, double aNZ, double aD, double aWeight )
+	{
+		// w * (n.p + d)^2
+		return Quadric_{
+			float(aWeight*aNX*aNX), float(aWeight*aNX*aNY), float(aWeight*aNX*aNZ),
+			float(aWeight*aNY*aNY), float(aWeight*aNY*aNZ), float(aWeight*aNZ*aNZ),
+			float(aWeight*aNX*aD), float(aWeight*aNY*aD), float(aWeight*aNZ*aD),
+			float(aWeight*aD*aD),
+			float(aWeight)
+		};
+	}
+
+	void add_( Quadric_& aQ, Quadric_ const& aR ) noexcept
+	{
+		aQ.a00 += aR.a00; aQ.a01 += aR.a01; aQ.a02 += aR.a02;
+		aQ.a11 += aR.a11; aQ.a12 += aR.a12; aQ.a22 += aR.a22;
+		aQ.b0 += aR.b0; aQ.b1 += aR.b1; aQ.b2 += aR.b2;
+		aQ.c += aR.c;
+		aQ.w += aR.w;
+	}
+
+	void add_( AttribQuadric_& aQ, AttribQuadric_ const& aR ) noexcept
+	{
+		add_( aQ.q, aR.q );
+		for( std::size_t k = 0; k < kMaxAttribs_; ++k )
+		{
+			for( std::size_t i = 0; i < 4; ++i )
+				aQ.linear[k][i] += aR.linear[k][i];
+		}
+	}
+
+	// Unnormalized: p^T A p + 2 b.p + c
+	double evaluate_sum_( Quadric_ const& aQ, Vec3f aP ) noexcept
+	{
+		double const x = aP.x, y = aP.y, z = aP.z;
+		return x*x*aQ.a00 + y*y*aQ.a11 + z*z*aQ.a22
+			+ 2.0*(x*y*aQ.a01 + x*z*aQ.a02 + y*z*aQ.a12)
+			+ 2.0*(x*aQ.b0 + y*aQ.b1 + z*aQ.b2)
+			+ aQ.c
+		;
+	}
+
+	double evaluate_( Quadric_ const& aQ, Vec3f aP ) noexcept
+	{
+		if( aQ.w <= 0.f )
+			return 0.0;
+		return std::max( 0.0, evaluate_sum_( aQ, aP ) / aQ.w );
+	}
+
+	double evaluate_( AttribQuadric_ const& aQ, Vec3f aP, float const* aAttribs, std::size_t aCount ) noexcept
+	{
+		if( aQ.q.w <= 0.f )
+			return 0.0;
+
+		double sum = evaluate_sum_( aQ.q, aP );
+		for( std::size_t k = 0; k < aCount; ++k )
+		{
+			auto const& l = aQ.linear[k];
+			double const s = aAttribs[k];
+			sum += s * (s*aQ.q.w - 2.0*(l[0]*aP.x + l[1]*aP.y + l[2]*aP.z + l[3]));
+		}
+
+		return std::max( 0.0, sum / aQ.q.w );
+	}
+
+	Vec3f cross_( Vec3f aLeft, Vec3f aRight ) noexcept
+	{
+		return Vec3f{
+			aLeft.y*aRight.z - aLeft.z*aRight.y,
+			aLeft.z*aRight.x - aLeft.x*aRight.z,
+			aLeft.x*aRight.y - aLeft.y*aRight.x
+		};
+	}
+
+	struct Collapse_
+	{
+		std::uint32_t from, to;
+		float cost;   // geometric + attribute error
+		float error;  // geometric error only
+	};
+}
+
+std::vector<std::uint32_t> simplify_mesh( SimpleMeshData const& aMesh, std::size_t aTargetTriangles, float aTargetError, float* aResultError )
+{
+	return simplify_mesh( aMesh, aMesh.indices, {}, aTargetTriangles, aTargetError, aResultError );
+}
+
+std::vector<std::uint32_t> simplify_mesh( SimpleMeshData const& aMesh, std::vector<std::uint32_t> const& aIndices, std::vector<std::uint8_t> const& aLocked, std::size_t aTargetTriangles, float aTargetError, float* aResultError )
+{
+	assert( aIndices.size() % 3 == 0 );
+	assert( aLocked.empty() || aLocked.size() == aMesh.positions.size() );
+
+	auto const count = aMesh.positions.size();
+	std::vector<std::uint32_t> indices = aIndices;
+
+	if( aResultError )
+		*aResultError = 0.f;
+
+	if( indices.size()/3 <= aTargetTriangles )
+		return indices;
+
+	auto topo = classify_( aMesh.positions, indices, aLocked );
+
+	// Normalize positions, such that errors don't depend on the mesh's scale
+	Vec3f bmin{ std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+	Vec3f bmax = -bmin;
+	for( auto const& p : aMesh.positions )
+	{
+		bmin = Vec3f{ std::min( bmin.x, p.x ), std::min( bmin.y, p.y ), std::min( bmin.z, p.z ) };
+		bmax = Vec3f{ std::max( bmax.x, p.x ), std::max( bmax.y, p.y ), std::max( bmax.z, p.z ) };
+	}
+
+	float const extent = std::max( { bmax.x-bmin.x, bmax.y-bmin.y, bmax.z-bmin.z } );
+	float const scale = extent > 0.f ? 1.f / extent : 1.f;
+
+	std::vector<Vec3f> positions( count );
+	for( std::size_t v = 0; v < count; ++v )
+		positions[v] = (aMesh.positions[v] - bmin) * scale;
+
+	// Attributes, pre-multiplied by their weights
+	std::size_t attribCount = 0;
+	if( aMesh.texcoords.size() == count )
+		attribCount += 2;
+	if( aMesh.normals.size() == count )
+		attribCount += 3;
+
+	std::vector<float> attribs( count * attribCount );
+	for( std::size_t v = 0; v < count; ++v )
+	{
+		float* out = attribs.data() + v*attribCount;
+		if( aMesh.texcoords.size() == count )
+		{
+			*out++ = aMesh.texcoords[v].x * kTexcoordWeight_;
+			*out++ = aMesh.texcoords[v].y * kTexcoordWeight_;
+		}
+		if( aMesh.normals.size() == count )
+		{
+			*out++ = aMesh.normals[v].x * kNormalWeight_;
+			*out++ = aMesh.normals[v].y * kNormalWeight_;
+			*out++ = aMesh.normals[v].z * kNormalWeight_;
+		}
+	}
+
+	// Quadrics
+	std::vector<Quadric_> quadrics( count, Quadric_{} );
+	std::vector<AttribQuadric_> attribQuadrics( attribCount ? count : 0, AttribQuadric_{} );
+
+	for( std::size_t i = 0; i < indices.size(); i += 3 )
+	{
+		std::uint32_t const tri[3] = { indices[i+0], indices[i+1], indices[i+2] };
+		Vec3f const p0 = positions[tri[0]], p1 = positions[tri[1]], p2 = positions[tri[2]];
+
+		Vec3f const e1 = p1 - p0, e2 = p2 - p0;
+		Vec3f const n = cross_( e1, e2 );
+		float const len = length( n );
+		if( len <= 0.f )
+			continue;
+
+		double const area = 0.5 * len;
+		Vec3f const nn = n / len;
+
+		auto const plane = make_quadric_( nn.x, nn.y, nn.z, -dot( nn, p0 ), area );
+		for( auto const v : tri )
+			add_( quadrics[v], plane );
+
+		// Open edges: plane through the edge, perpendicular to the triangle
+		for( std::size_t j = 0; j < 3; ++j )
+		{
+			auto const a = tri[j], b = tri[(j+1)%3];
+			if( !is_open_( topo, a, b ) )
+				continue;
+
+			Vec3f const edge = positions[b] - positions[a];
+			Vec3f const m = cross_( edge, nn );
+			float const mlen = length( m );
+			if( mlen <= 0.f )
+				continue;
+
+			Vec3f const mn = m / mlen;
+			auto const border = make_quadric_( mn.x, mn.y, mn.z, -dot( mn, positions[a] ), kBorderWeight_ * dot( edge, edge ) );
+			add_( quadrics[a], border );
+			add_( quadrics[b], border );
+		}
+
+		// Attribute gradients: find g in the triangle's plane such that
+		// g.(p1-p0) = s1-s0 and g.(p2-p0) = s2-s0.
+		if( attribCount )
+		{
+			double const d11 = dot( e1, e1 ), d12 = dot( e1, e2 ), d22 = dot( e2, e2 );
+			double const det = d11*d22 - d12*d12;
+			if( det <= 0.0 )
+				continue;
+
+			AttribQuadric_ aq{};
+			for( std::size_t k = 0; k < attribCount; ++k )
+			{
+				double const s0 = attribs[tri[0]*attribCount+k];
+				double const ds1 = attribs[tri[1]*attribCount+k] - s0;
+				double const ds2 = attribs[tri[2]*attribCount+k] - s0;
+
+				double const alpha = (d22*ds1 - d12*ds2) / det;
+				double const beta = (d11*ds2 - d12*ds1) / det;
+
+				double const gx = alpha*e1.x + beta*e2.x;
+				double const gy = alpha*e1.y + beta*e2.y;
+				double const gz = alpha*e1.z + beta*e2.z;
+				double const d = s0 - (gx*p0.x + gy*p0.y + gz*p0.z);
+
+				auto q = make_quadric_( gx, gy, gz, d, area );
+				q.w = 0.f; // counted once per triangle, below
+				add_( aq.q, q );
+
+				aq.linear[k][0] = float(area*gx);
+				aq.linear[k][1] = float(area*gy);
+				aq.linear[k][2] = float(area*gz);
+				aq.linear[k][3] = float(area*d);
+			}
+			aq.q.w = float(area);
+
+			for( auto const v : tri )
+				add_( attribQuadrics[v], aq );
+		}
+	}
+
+	auto const collapse_cost = [&] (std::uint32_t aFrom, std::uint32_t aTo) {
+		auto const error = evaluate_( quadrics[aFrom], positions[aTo] );
+		auto cost = error;
+		if( attribCount )
+			cost += evaluate_( attribQuadrics[aFrom], positions[aTo], attribs.data() + aTo*attribCount, attribCount );
+		return Collapse_{ aFrom, aTo, float(cost), float(error) };
+	};
+
+	double const targetError = double(aTargetError) * scale;
+	double const maxError = targetError * targetError;
+
+	float resultError = 0.f;
+
+	// Collapse edges in passes. Each pass picks the cheapest collapses such
+	// that no vertex is involved in more than one of them; costs are
+	// re-evaluated between passes.
+	std::vector<Collapse_> collapses;
+	std::vector<std::uint32_t> order;
+	std::vector<std::uint32_t> remap( count );
+	std::vector<std::uint8_t> touched( count );
+	std::vector<std::uint32_t> adjOffsets, adjTriangles;
+
+	while( indices.size()/3 > aTargetTriangles )
+	{
+		auto const triangleCount = indices.size() / 3;
+
+		// Vertex -> triangle adjacency
+		adjOffsets.assign( count+1, 0 );
+		for( auto const idx : indices )
+			++adjOffsets[idx+1];
+		std::partial_sum( adjOffsets.begin(), adjOffsets.end(), adjOffsets.begin() );
+
+		adjTriangles.resize( indices.size() );
+		{
+			std::vector<std::uint32_t> fill( adjOffsets.begin(), adjOffsets.end()-1 );
+			for( std::size_t i = 0; i < indices.size(); ++i )
+				adjTriangles[fill[indices[i]]++] = std::uint32_t(i / 3);
+		}
+
+		// Candidates. Interior edges are seen from both triangles; only one
+		// of them is needed.
+		collapses.clear();
+		for( std::size_t i = 0; i < indices.size(); i += 3 )
+		{
+			for( std::size_t j = 0; j < 3; ++j )
+			{
+				auto const a = indices[i+j], b = indices[i+(j+1)%3];
+				if( a > b && (VertexKind_::manifold == topo.kinds[a] || VertexKind_::manifold == topo.kinds[b]) )
+					continue;
+
+				bool const ab = can_collapse_( topo, a, b );
+				bool const ba = can_collapse_( topo, b, a );
+				if( !ab && !ba )
+					continue;
+
+				auto const cab = ab ? collapse_cost( a, b ) : Collapse_{};
+				auto const cba = ba ? collapse_cost( b, a ) : Collapse_{};
+
+				if( ab && (!ba || cab.cost <= cba.cost) )
+					collapses.emplace_back( cab );
+				else
+					collapses.emplace_back( cba );
+			}
+		}
+
+		if( collapses.empty() )
+			break;
+
+		order.resize( collapses.size() );
+		std::iota( order.begin(), order.end(), std::uint32_t(0) );
+		std::sort( order.begin(), order.end(), [&] (std::uint32_t aA, std::uint32_t aB) {
+			return collapses[aA].cost < collapses[aB].cost;
+		} );
+
+		// A collapse of an interior edge removes two triangles. Don't stray
+		// too far beyond the collapses needed to reach the target, since
+		// costs are only accurate for the first collapse around a vertex.
+		// The cheapest valid collapse is always performed, though: when the
+		// cheap ones are blocked (or all costs are rounding noise, as on a
+		// flat mesh), the pass would otherwise make no progress.
+		auto const goal = triangleCount - aTargetTriangles;
+		auto const edgeGoal = goal / 2;
+		double const costGoal = edgeGoal < order.size() ? 1.5 * collapses[order[edgeGoal]].cost : std::numeric_limits<double>::infinity();
+
+		std::iota( remap.begin(), remap.end(), std::uint32_t(0) );
+		std::fill( touched.begin(), touched.end(), std::uint8_t(0) );
+
+		std::size_t removed = 0, performed = 0;
+		for( auto const ci : order )
+		{
+			auto const& c = collapses[ci];
+			if( removed >= goal || (performed && c.cost > costGoal) )
+				break;
+
+			if( c.error > maxError )
+				continue;
+
+			auto const u = c.from, v = c.to;
+			if( touched[u] || touched[v] )
+				continue;
+
+			// Reject collapses that flip (or nearly flip) remaining triangles.
+			std::size_t shared = 0;
+			bool flips = false;
+			for( auto k = adjOffsets[u]; k < adjOffsets[u+1] && !flips; ++k )
+			{
+				auto const t = adjTriangles[k];
+				std::uint32_t tri[3] = { remap[indices[t*3+0]], remap[indices[t*3+1]], remap[indices[t*3+2]] };
+				if( tri[0] == tri[1] || tri[1] == tri[2] || tri[2] == tri[0] )
+					continue;
+
+				if( tri[0] == v || tri[1] == v || tri[2] == v )
+				{
+					++shared;
+					continue;
+				}
+
+				Vec3f const n0 = cross_( positions[tri[1]] - positions[tri[0]], positions[tri[2]] - positions[tri[0]] );
+				for( auto& x : tri )
+				{
+					if( x == u )
+						x = v;
+				}
+				Vec3f const n1 = cross_( positions[tri[1]] - positions[tri[0]], positions[tri[2]] - positions[tri[0]] );
+
+				if( dot( n0, n1 ) <= 1e-2f * length( n0 ) * length( n1 ) )
+					flips = true;
+			}
+
+			if( flips || 0 == shared )
+				continue;
+
+			remap[u] = v;
+			touched[u] = touched[v] = 1;
+
+			if( VertexKind_::border == topo.kinds[u] )
+				collapse_border_( topo, u, v );
+
+			add_( quadrics[v], quadrics[u] );
+			if( attribCount )
+				add_( attribQuadrics[v], attribQuadrics[u] );
+
+			resultError = std::max( resultError, c.error );
+			removed += shared;
+			++performed;
+		}
+
+		if( 0 == performed )
+			break;
+
+		// Apply collapses and drop degenerate triangles
+		std::size_t out = 0;
+		for( std::size_t i = 0; i < indices.size(); i += 3 )
+		{
+			auto const a = remap[indices[i+0]], b = remap[indices[i+1]], c = remap[indices[i+2]];
+			if( a == b || b == c || c == a )
+				continue;
+
+			indices[out++] = a;
+			indices[out++] = b;
+			indices[out++] = c;
+		}
+		indices.resize( out );
+	}
+
+	if( aResultError )
+		*aResultError = std::sqrt( resultError ) / scale;
+
+	return indices;
+}
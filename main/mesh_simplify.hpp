@@ -0,0 +1,55 @@
+#ifndef MESH_SIMPLIFY_HPP_7D3F2A90_4C1B_4E85_9B6A_1E8C5F0D2B47
+#define MESH_SIMPLIFY_HPP_7D3F2A90_4C1B_4E85_9B6A_1E8C5F0D2B47
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "simple_mesh.hpp"
+
+/* Mesh simplification with quadric error metrics (Garland & Heckbert 1997).
+ *
+ * Edges are collapsed onto one of their endpoints (half-edge collapses), so
+ * the simplified mesh only references vertices of the input mesh. The
+ * result is an index list into the input's attribute arrays; the attribute
+ * arrays can be shared between all levels of detail.
+ *
+ * The cost of a collapse combines
+ *  - the squared distance to the planes of the original triangles around the
+ *    removed vertex (the classic quadric error), plus distance to planes
+ *    through open edges, which keeps mesh borders in place, and
+ *  - the squared difference between the attributes (texture coordinates and
+ *    normals) of the kept vertex and the attributes that the original
+ *    triangles interpolate at its position (Hoppe 1999, New Quadric Metric
+ *    for Simplifying Meshes with Appearance Attributes).
+ *
+ * Vertices on attribute seams (several vertices with the same position but
+ * different attributes), on non-manifold edges and at sharp corners of the
+ * mesh's border are never moved.
+ */
+
+// Simplifies the (indexed) mesh until at most aTargetTriangles triangles
+// remain, or until the next collapse would exceed aTargetError (a distance
+// in the mesh's units). If aResultError is non-null, it receives the
+// largest geometric error that was introduced (again in mesh units).
+std::vector<std::uint32_t> simplify_mesh(
+	SimpleMeshData const&,
+	std::size_t aTargetTriangles,
+	float aTargetError,
+	float* aResultError = nullptr
+);
+
+// Same, but simplifies the triangles aIndices instead of the mesh's own
+// indices (e.g. a level of detail generated earlier). Vertices v with
+// aLocked[v] != 0 are never moved; aLocked may be empty.
+std::vector<std::uint32_t> simplify_mesh(
+	SimpleMeshData const&,
+	std::vector<std::uint32_t> const& aIndices,
+	std::vector<std::uint8_t> const& aLocked,
+	std::size_t aTargetTriangles,
+	float aTargetError,
+	float* aResultError = nullptr
+);
+
+#endif // MESH_SIMPLIFY_HPP_7D3F2A90_4C1B_4E85_9B6A_1E8C5F0D2B47
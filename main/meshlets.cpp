@@ -0,0 +1,311 @@
+#include "meshlets.hpp"
+
+#include <limits>
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+#include "mesh_optimize.hpp"
+
+namespace
+{
+	// Weight of the normal deviation (1 - cos) relative to the number of new
+	// vertices when growing a meshlet
+	constexpr float kConeWeight_ = 2.f;
+
+	// Non-adjacent triangles considered when a meshlet can't grow any
+	// further, and how far (1 - cos) their normals may deviate
+	constexpr std::size_t kFallbackWindow_ = 32;
+	constexpr float kFallbackMaxDeviation_ = 0.1f;
+
+	Vec3f cross_( Vec3f aLeft, Vec3f aRight ) noexcept
+	{
+		return Vec3f{
+			aLeft.y*aRight.z - aLeft.z*aRight.y,
+			aLeft.z*aRight.x - aLeft.x*aRight.z,
+			aLeft.x*aRight.y - aLeft.y*aRight.x
+		};
+	}
+
+	// Fills in the bounds of a meshlet whose range is already set.
+	void compute_bounds_( Meshlet& aMeshlet, std::vector<std::uint32_t> const& aIndices, std::vector<Vec3f> const& aPositions )
+	{
+		auto const begin = aMeshlet.firstIndex, end = aMeshlet.firstIndex + aMeshlet.indexCount;
+
+		// Bounding sphere around the center of the bounding box. Not
+		// minimal, but close enough for clusters this small.
+		Vec3f bmin{ std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+		Vec3f bmax = -bmin;
+		for( auto i = begin; i < end; ++i )
+		{
+			auto const& p = aPositions[aIndices[i]];
+			bmin = Vec3f{ std::min( bmin.x, p.x ), std::min( bmin.y, p.y ), std::min( bmin.z, p.z ) };
+			bmax = Vec3f{ std::max( bmax.x, p.x ), std::max( bmax.y, p.y ), std::max( bmax.z, p.z ) };
+		}
+
+		aMeshlet.center = (bmin + bmax) * 0.5f;
+		aMeshlet.radius = 0.f;
+		for( auto i = begin; i < end; ++i )
+			aMeshlet.radius = std::max( aMeshlet.radius, length( aPositions[aIndices[i]] - aMeshlet.center ) );
+
+		// Normal cone: the axis is the area weighted average normal, the
+		// half-angle that of the normal furthest away from it. Degenerate
+		// triangles are never drawn and don't constrain the cone.
+		Vec3f axis{ 0.f, 0.f, 0.f };
+		for( auto i = begin; i < end; i += 3 )
+		{
+			auto const& p0 = aPositions[aIndices[i+0]];
+			auto const& p1 = aPositions[aIndices[i+1]];
+			auto const& p2 = aPositions[aIndices[i+2]];
+			axis += cross_( p1 - p0, p2 - p0 );
+		}
+
+		float const axisLength = length( axis );
+		if( axisLength <= 0.f )
+		{
+			aMeshlet.coneAxis = Vec3f{ 0.f, 0.f, 1.f };
+			aMeshlet.coneCutoff = kNoCone;
+			return;
+		}
+
+		axis = axis / axisLength;
+
+		float minDot = 1.f;
+		for( auto i = begin; i < end; i += 3 )
+		{
+			auto const& p0 = aPositions[aIndices[i+0]];
+			auto const& p1 = aPositions[aIndices[i+1]];
+			auto const& p2 = aPositions[aIndices[i+2]];
+
+			auto const n = cross_( p1 - p0, p2 - p0 );
+			float const len = length( n );
+			if( len > 0.f )
+				minDot = std::min( minDot, dot( n, axis ) / len );
+		}
+
+		aMeshlet.coneAxis = axis;
+		if( minDot <= 0.f )
+			aMeshlet.coneCutoff = kNoCone; // spread over a hemisphere or more
+		else
+			aMeshlet.coneCutoff = std::sqrt( std::max( 0.f, 1.f - minDot*minDot ) );
+	}
+}
+
+void append_meshlets( std::vector<std::uint32_t>& aIndices, std::size_t aFirstIndex, std::size_t aIndexCount, std::vector<Vec3f> const& aPositions, std::vector<Meshlet>& aOut )
+{
+	assert( aIndexCount % 3 == 0 );
+	assert( aFirstIndex + aIndexCount <= aIndices.size() );
+
+	auto const triangleCount = aIndexCount / 3;
+	if( 0 == triangleCount )
+		return;
+
+	auto const* tris = aIndices.data() + aFirstIndex;
+
+	// Number the vertices of the range locally. The range is usually a
+	// small part of the mesh, so avoid anything proportional to the number
+	// of vertices of the whole mesh.
+	std::vector<std::uint32_t> vertices( tris, tris + aIndexCount );
+	std::sort( vertices.begin(), vertices.end() );
+	vertices.erase( std::unique( vertices.begin(), vertices.end() ), vertices.end() );
+
+	auto const vertexCount = vertices.size();
+
+	std::vector<std::uint32_t> local( aIndexCount );
+	for( std::size_t i = 0; i < aIndexCount; ++i )
+		local[i] = std::uint32_t(std::lower_bound( vertices.begin(), vertices.end(), tris[i] ) - vertices.begin());
+
+	// Vertex -> triangle adjacency
+	std::vector<std::uint32_t> adjOffsets( vertexCount+1, 0 );
+	for( auto const v : local )
+		++adjOffsets[v+1];
+	for( std::size_t v = 0; v < vertexCount; ++v )
+		adjOffsets[v+1] += adjOffsets[v];
+
+	std::vector<std::uint32_t> adjTriangles( aIndexCount );
+	{
+		auto fill = adjOffsets;
+		for( std::size_t i = 0; i < aIndexCount; ++i )
+			adjTriangles[fill[local[i]]++] = std::uint32_t(i / 3);
+	}
+
+	// Unit triangle normals (zero for degenerate triangles)
+	std::vector<Vec3f> normals( triangleCount );
+	for( std::size_t t = 0; t < triangleCount; ++t )
+	{
+		auto const& p0 = aPositions[tris[t*3+0]];
+		auto const& p1 = aPositions[tris[t*3+1]];
+		auto const& p2 = aPositions[tris[t*3+2]];
+
+		auto const n = cross_( p1 - p0, p2 - p0 );
+		float const len = length( n );
+		normals[t] = len > 0.f ? n / len : Vec3f{ 0.f, 0.f, 0.f };
+	}
+
+	// Grow meshlets greedily, starting from the first remaining triangle in
+	// the input order. The next triangle is picked among those adjacent to
+	// the meshlet, preferring ones that add few new vertices and whose
+	// normals agree with the meshlet's (which keeps the normal cones
+	// narrow).
+	constexpr auto kNone = std::numeric_limits<std::uint32_t>::max();
+
+	std::vector<std::uint8_t> emitted( triangleCount, 0 );
+	std::vector<std::uint32_t> vertexMeshlet( vertexCount, kNone ); // last meshlet that used the vertex
+	std::vector<std::uint32_t> candidates;
+
+	std::vector<std::uint32_t> reordered;
+	reordered.reserve( aIndexCount );
+
+	auto const firstMeshlet = aOut.size();
+
+	std::size_t cursor = 0;
+	std::uint32_t meshletId = 0;
+	while( reordered.size() < aIndexCount )
+	{
+		while( emitted[cursor] )
+			++cursor;
+
+		Meshlet meshlet{};
+		meshlet.firstIndex = std::uint32_t(aFirstIndex + reordered.size());
+
+		std::size_t meshletVertices = 0;
+		Vec3f normalSum{ 0.f, 0.f, 0.f };
+		candidates.clear();
+
+		auto const new_vertices = [&] (std::uint32_t aTriangle) {
+			std::size_t ret = 0;
+			for( std::size_t j = 0; j < 3; ++j )
+			{
+				auto const v = local[aTriangle*3+j];
+				if( vertexMeshlet[v] != meshletId && (j < 1 || v != local[aTriangle*3]) && (j < 2 || v != local[aTriangle*3+1]) )
+					++ret;
+			}
+			return ret;
+		};
+
+		auto next = std::uint32_t(cursor);
+		while( kNone != next )
+		{
+			// Add the triangle
+			emitted[next] = 1;
+			for( std::size_t j = 0; j < 3; ++j )
+			{
+				auto const v = local[next*3+j];
+				if( vertexMeshlet[v] != meshletId )
+				{
+					vertexMeshlet[v] = meshletId;
+					++meshletVertices;
+
+					for( auto k = adjOffsets[v]; k < adjOffsets[v+1]; ++k )
+					{
+						if( !emitted[adjTriangles[k]] )
+							candidates.emplace_back( adjTriangles[k] );
+					}
+				}
+
+				reordered.emplace_back( tris[next*3+j] );
+			}
+
+			normalSum += normals[next];
+			meshlet.indexCount += 3;
+
+			if( meshlet.indexCount/3 == kMeshletMaxTriangles )
+				break;
+
+			// Pick the next one
+			float const sumLength = length( normalSum );
+			Vec3f const axis = sumLength > 0.f ? normalSum / sumLength : Vec3f{ 0.f, 0.f, 0.f };
+
+			next = kNone;
+			float bestScore = std::numeric_limits<float>::max();
+
+			std::size_t out = 0;
+			for( auto const t : candidates )
+			{
+				if( emitted[t] )
+					continue;
+
+				candidates[out++] = t; // drop emitted ones as we go
+
+				auto const added = new_vertices( t );
+				if( meshletVertices + added > kMeshletMaxVertices )
+					continue;
+
+				float const score = float(added) + kConeWeight_ * (1.f - dot( normals[t], axis ));
+				if( score < bestScore )
+				{
+					bestScore = score;
+					next = t;
+				}
+			}
+			candidates.resize( out );
+
+			// Nothing adjacent (e.g. at hard edges, where vertices are split):
+			// continue with one of the next triangles in the input order,
+			// which are usually nearby.
+			if( kNone == next )
+			{
+				std::size_t seen = 0;
+				for( auto t = cursor; t < triangleCount && seen < kFallbackWindow_; ++t )
+				{
+					if( emitted[t] )
+						continue;
+
+					++seen;
+
+					auto const added = new_vertices( std::uint32_t(t) );
+					if( meshletVertices + added > kMeshletMaxVertices )
+						continue;
+
+					float const deviation = 1.f - dot( normals[t], axis );
+					if( deviation > kFallbackMaxDeviation_ )
+						continue;
+
+					float const score = float(added) + kConeWeight_ * deviation;
+					if( score < bestScore )
+					{
+						bestScore = score;
+						next = std::uint32_t(t);
+					}
+				}
+			}
+		}
+
+		aOut.emplace_back( meshlet );
+		++meshletId;
+	}
+
+	// Growing meshlets scrambles the triangle order, so optimize each one for
+	// the vertex cache again. Meshlets have few vertices, so number them
+	// locally.
+	std::vector<std::uint32_t> meshletIndices;
+	std::vector<std::uint32_t> meshletVertices;
+	for( auto i = firstMeshlet; i < aOut.size(); ++i )
+	{
+		auto const& meshlet = aOut[i];
+		auto const begin = reordered.begin() + (meshlet.firstIndex - aFirstIndex);
+		auto const end = begin + meshlet.indexCount;
+
+		meshletVertices.clear();
+		meshletIndices.clear();
+		for( auto it = begin; it != end; ++it )
+		{
+			auto const found = std::find( meshletVertices.begin(), meshletVertices.end(), *it );
+			meshletIndices.emplace_back( std::uint32_t(found - meshletVertices.begin()) );
+			if( found == meshletVertices.end() )
+				meshletVertices.emplace_back( *it );
+		}
+
+		meshletIndices = optimize_vertex_cache( meshletIndices, meshletVertices.size() );
+
+		auto out = begin;
+		for( auto const idx : meshletIndices )
+			*out++ = meshletVertices[idx];
+	}
+
+	std::copy( reordered.begin(), reordered.end(), aIndices.begin() + aFirstIndex );
+
+	for( auto i = firstMeshlet; i < aOut.size(); ++i )
+		compute_bounds_( aOut[i], aIndices, aPositions );
+}
@@ -0,0 +1,59 @@
+#ifndef MESHLETS_HPP_7C2F0B94_5E1D_4A38_9B63_D48E2A71C05F
+#define MESHLETS_HPP_7C2F0B94_5E1D_4A38_9B63_D48E2A71C05F
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../vmlib/vec3.hpp"
+
+/* Meshlets: small clusters of triangles that can be culled individually.
+ *
+ * A meshlet is a contiguous range of a mesh's index buffer (so it can be
+ * drawn without any extra data) with at most kMeshletMaxVertices unique
+ * vertices and kMeshletMaxTriangles triangles. Each meshlet has a bounding
+ * sphere, for frustum culling, and a normal cone bounding the (geometric)
+ * normals of its triangles, for back-face culling of the whole cluster.
+ *
+ * The cone is stored as its axis and the sine of its half-angle. If all
+ * triangle normals are within an angle a of the axis, every triangle of the
+ * meshlet faces away from a viewer at eye if
+ *   dot(center - eye, coneAxis) >= coneCutoff * (|center - eye| + radius) + radius
+ * with coneCutoff = sin(a); see is_backfacing() in culling.hpp. Meshlets
+ * whose normals spread over more than a hemisphere get kNoCone.
+ */
+struct Meshlet
+{
+	Vec3f center;
+	float radius;
+
+	Vec3f coneAxis;
+	float coneCutoff;
+
+	std::uint32_t firstIndex;
+	std::uint32_t indexCount;
+};
+
+static_assert( sizeof(Meshlet) == 40 );
+
+constexpr std::size_t kMeshletMaxVertices = 64;
+constexpr std::size_t kMeshletMaxTriangles = 124;
+
+// A cutoff that no view direction passes
+constexpr float kNoCone = 2.f;
+
+// Splits the triangles aIndices[aFirstIndex, aFirstIndex+aIndexCount) into
+// meshlets and appends them to aOut. The triangles of the range are
+// reordered so that each meshlet is contiguous. Meshlets are grown from the
+// first remaining triangle of the range, so the range should already be
+// optimized for the vertex cache (which keeps neighbouring triangles close
+// to each other).
+void append_meshlets(
+	std::vector<std::uint32_t>& aIndices,
+	std::size_t aFirstIndex, std::size_t aIndexCount,
+	std::vector<Vec3f> const& aPositions,
+	std::vector<Meshlet>& aOut
+);
+
+#endif // MESHLETS_HPP_7C2F0B94_5E1D_4A38_9B63_D48E2A71C05F
@@ -0,0 +1,422 @@
+#include "occlusion.hpp"
+
+#include <limits>
+#include <future>
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+#include <emmintrin.h> // SSE2, always available on x64
+
+#include "jobs.hpp"
+
+namespace
+{
+	// Depth of pixels without occluders; nothing is ever behind this
+	constexpr float kFar_ = std::numeric_limits<float>::max();
+
+	// Inward shift of triangle edges (in pixels), see rasterize_()
+	constexpr float kEdgeBias_ = 1.f / 256.f;
+
+	// Minimum number of rows per band when rasterizing in parallel
+	constexpr std::size_t kMinBandRows_ = 8;
+
+	// The columns of a (row-major) Mat44f, for transforming points as
+	// c0*x + c1*y + c2*z + c3
+	struct Columns_
+	{
+		__m128 c[4];
+	};
+
+	Columns_ load_columns_( Mat44f const& aM ) noexcept
+	{
+		Columns_ ret;
+		for( int j = 0; j < 4; ++j )
+			ret.c[j] = _mm_setr_ps( aM(0,j), aM(1,j), aM(2,j), aM(3,j) );
+		return ret;
+	}
+
+	Vec4f transform_( Columns_ const& aM, Vec3f const& aP ) noexcept
+	{
+		__m128 r = _mm_add_ps( _mm_mul_ps( aM.c[0], _mm_set1_ps( aP.x ) ), aM.c[3] );
+		r = _mm_add_ps( r, _mm_mul_ps( aM.c[1], _mm_set1_ps( aP.y ) ) );
+		r = _mm_add_ps( r, _mm_mul_ps( aM.c[2], _mm_set1_ps( aP.z ) ) );
+
+		alignas(16) float v[4];
+		_mm_store_ps( v, r );
+		return Vec4f{ v[0], v[1], v[2], v[3] };
+	}
+
+	// Signed distance to the near plane (z >= -w in clip space)
+	float near_distance_( Vec4f const& aV ) noexcept
+	{
+		return aV.z + aV.w;
+	}
+
+	Vec4f lerp_( Vec4f const& aA, Vec4f const& aB, float aT ) noexcept
+	{
+		return aA + (aB - aA) * aT;
+	}
+}
+
+OcclusionBuffer::OcclusionBuffer( std::size_t aWidth, std::size_t aHeight )
+{
+	assert( aWidth > 0 && 0 == aWidth % 4 );
+	assert( aHeight > 0 );
+
+	// Pyramid down to a single texel
+	std::size_t w = aWidth, h = aHeight;
+	while( true )
+	{
+		mLevels.emplace_back( Level_{ w, h, std::vector<float>( w*h, kFar_ ) } );
+		if( 1 == w && 1 == h )
+			break;
+
+		w = (w+1) / 2;
+		h = (h+1) / 2;
+	}
+}
+
+void OcclusionBuffer::clear()
+{
+	mTriangles.clear();
+}
+
+void OcclusionBuffer::add_occluder( Mat44f const& aClipFromObject, Vec3f const* aPositions, std::size_t aPositionCount, std::uint32_t const* aIndices, std::size_t aIndexCount )
+{
+	assert( aIndexCount % 3 == 0 );
+
+	// Transform each vertex once
+	auto const m = load_columns_( aClipFromObject );
+
+	mClip.resize( aPositionCount );
+	for( std::size_t i = 0; i < aPositionCount; ++i )
+		mClip[i] = transform_( m, aPositions[i] );
+
+	for( std::size_t i = 0; i < aIndexCount; i += 3 )
+	{
+		assert( aIndices[i+0] < aPositionCount && aIndices[i+1] < aPositionCount && aIndices[i+2] < aPositionCount );
+		Vec4f const v[3] = { mClip[aIndices[i+0]], mClip[aIndices[i+1]], mClip[aIndices[i+2]] };
+
+		// Entirely outside of one of the side planes?
+		if( (v[0].x > v[0].w && v[1].x > v[1].w && v[2].x > v[2].w)
+			|| (v[0].x < -v[0].w && v[1].x < -v[1].w && v[2].x < -v[2].w)
+			|| (v[0].y > v[0].w && v[1].y > v[1].w && v[2].y > v[2].w)
+			|| (v[0].y < -v[0].w && v[1].y < -v[1].w && v[2].y < -v[2].w) )
+			continue;
+
+		float const d[3] = { near_distance_( v[0] ), near_distance_( v[1] ), near_distance_( v[2] ) };
+		if( d[0] >= 0.f && d[1] >= 0.f && d[2] >= 0.f )
+		{
+			add_triangle_( v[0], v[1], v[2] );
+			continue;
+		}
+		if( d[0] < 0.f && d[1] < 0.f && d[2] < 0.f )
+			continue;
+
+		// Clip to the near plane. The result has three or four vertices.
+		Vec4f poly[4];
+		std::size_t count = 0;
+		for( std::size_t j = 0; j < 3; ++j )
+		{
+			auto const k = (j+1) % 3;
+			if( d[j] >= 0.f )
+				poly[count++] = v[j];
+			if( (d[j] >= 0.f) != (d[k] >= 0.f) )
+				poly[count++] = lerp_( v[j], v[k], d[j] / (d[j] - d[k]) );
+		}
+
+		assert( 3 == count || 4 == count );
+		add_triangle_( poly[0], poly[1], poly[2] );
+		if( 4 == count )
+			add_triangle_( poly[0], poly[2], poly[3] );
+	}
+}
+
+void OcclusionBuffer::add_occluder( Mat44f const& aClipFromObject, OccluderMesh const& aMesh, OccluderChunk const& aChunk )
+{
+	add_occluder( aClipFromObject,
+		aMesh.positions.data() + aChunk.firstVertex, aChunk.vertexCount,
+		aMesh.indices.data() + aChunk.firstIndex, aChunk.indexCount
+	);
+}
+
+void OcclusionBuffer::render( ThreadPool* aPool )
+{
+	auto const height = mLevels[0].height;
+
+	std::size_t bands = 1;
+	if( aPool )
+		bands = std::min<std::size_t>( aPool->thread_count() + 1, height / kMinBandRows_ );
+	bands = std::max<std::size_t>( bands, 1 );
+
+	auto const rowsPerBand = (height + bands - 1) / bands;
+
+	std::vector<std::future<void>> jobs;
+	for( std::size_t b = 1; b < bands; ++b )
+	{
+		auto const begin = std::min( b * rowsPerBand, height );
+		auto const end = std::min( begin + rowsPerBand, height );
+		jobs.emplace_back( aPool->submit( [this, begin, end] { rasterize_( begin, end ); } ) );
+	}
+
+	// The calling thread takes the first band
+	rasterize_( 0, std::min( rowsPerBand, height ) );
+
+	for( auto& job : jobs )
+		job.get();
+
+	build_pyramid_();
+}
+
+bool OcclusionBuffer::test_box( Mat44f const& aClipFromObject, Vec3f aMin, Vec3f aMax ) const noexcept
+{
+	auto const& base = mLevels[0];
+	auto const m = load_columns_( aClipFromObject );
+
+	float minX = std::numeric_limits<float>::max(), maxX = -minX;
+	float minY = minX, maxY = -minX;
+	float minZ = minX;
+	for( int i = 0; i < 8; ++i )
+	{
+		Vec3f const corner{
+			(i & 1) ? aMax.x : aMin.x,
+			(i & 2) ? aMax.y : aMin.y,
+			(i & 4) ? aMax.z : aMin.z
+		};
+
+		auto const c = transform_( m, corner );
+
+		// Crosses the near plane: the box covers the eye, or at least a
+		// large part of the screen. Don't bother.
+		if( near_distance_( c ) < 0.f || c.w <= 0.f )
+			return true;
+
+		float const x = (c.x / c.w * 0.5f + 0.5f) * float(base.width);
+		float const y = (c.y / c.w * 0.5f + 0.5f) * float(base.height);
+		minX = std::min( minX, x );
+		maxX = std::max( maxX, x );
+		minY = std::min( minY, y );
+		maxY = std::max( maxY, y );
+		minZ = std::min( minZ, c.z / c.w );
+	}
+
+	if( maxX < 0.f || maxY < 0.f || minX >= float(base.width) || minY >= float(base.height) )
+		return false;
+
+	auto const x0 = std::size_t(std::max( minX, 0.f ));
+	auto const y0 = std::size_t(std::max( minY, 0.f ));
+	auto const x1 = std::min( std::size_t(maxX), base.width-1 );
+	auto const y1 = std::min( std::size_t(maxY), base.height-1 );
+
+	// Level where the box covers at most 4x4 texels
+	std::size_t level = 0;
+	while( level+1 < mLevels.size() && ((x1 >> level) - (x0 >> level) >= 4 || (y1 >> level) - (y0 >> level) >= 4) )
+		++level;
+
+	auto const& lvl = mLevels[level];
+	for( auto y = y0 >> level; y <= (y1 >> level); ++y )
+	{
+		for( auto x = x0 >> level; x <= (x1 >> level); ++x )
+		{
+			if( minZ <= lvl.depth[y*lvl.width + x] )
+				return true;
+		}
+	}
+
+	return false;
+}
+
+std::size_t OcclusionBuffer::width() const noexcept
+{
+	return mLevels[0].width;
+}
+std::size_t OcclusionBuffer::height() const noexcept
+{
+	return mLevels[0].height;
+}
+
+std::size_t OcclusionBuffer::triangle_count() const noexcept
+{
+	return mTriangles.size();
+}
+
+float OcclusionBuffer::depth( std::size_t aX, std::size_t aY ) const noexcept
+{
+	return depth( 0, aX, aY );
+}
+
+std::size_t OcclusionBuffer::level_count() const noexcept
+{
+	return mLevels.size();
+}
+std::size_t OcclusionBuffer::level_width( std::size_t aLevel ) const noexcept
+{
+	assert( aLevel < mLevels.size() );
+	return mLevels[aLevel].width;
+}
+std::size_t OcclusionBuffer::level_height( std::size_t aLevel ) const noexcept
+{
+	assert( aLevel < mLevels.size() );
+	return mLevels[aLevel].height;
+}
+
+float OcclusionBuffer::depth( std::size_t aLevel, std::size_t aX, std::size_t aY ) const noexcept
+{
+	assert( aLevel < mLevels.size() );
+	auto const& lvl = mLevels[aLevel];
+	assert( aX < lvl.width && aY < lvl.height );
+	return lvl.depth[aY*lvl.width + aX];
+}
+
+void OcclusionBuffer::add_triangle_( Vec4f const& aV0, Vec4f const& aV1, Vec4f const& aV2 )
+{
+	auto const& base = mLevels[0];
+	float const w = float(base.width), h = float(base.height);
+
+	Triangle_ tri;
+	float z[3];
+
+	Vec4f const* v[3] = { &aV0, &aV1, &aV2 };
+	for( std::size_t i = 0; i < 3; ++i )
+	{
+		if( v[i]->w <= 0.f )
+			return;
+
+		float const invW = 1.f / v[i]->w;
+		tri.x[i] = (v[i]->x * invW * 0.5f + 0.5f) * w;
+		tri.y[i] = (v[i]->y * invW * 0.5f + 0.5f) * h;
+		z[i] = v[i]->z * invW;
+	}
+
+	// Twice the signed area; back-facing (clockwise) and degenerate
+	// triangles are dropped.
+	float const x10 = tri.x[1] - tri.x[0], y10 = tri.y[1] - tri.y[0];
+	float const x20 = tri.x[2] - tri.x[0], y20 = tri.y[2] - tri.y[0];
+	float const area = x10*y20 - x20*y10;
+	if( !(area > 0.f) )
+		return;
+
+	// Pixels whose centers (i+0.5) are inside the bounding box
+	float const bminX = std::min( { tri.x[0], tri.x[1], tri.x[2] } );
+	float const bmaxX = std::max( { tri.x[0], tri.x[1], tri.x[2] } );
+	float const bminY = std::min( { tri.y[0], tri.y[1], tri.y[2] } );
+	float const bmaxY = std::max( { tri.y[0], tri.y[1], tri.y[2] } );
+
+	tri.minX = std::int32_t(std::max( std::ceil( bminX - 0.5f ), 0.f ));
+	tri.maxX = std::int32_t(std::min( std::floor( bmaxX - 0.5f ), w - 1.f ));
+	tri.minY = std::int32_t(std::max( std::ceil( bminY - 0.5f ), 0.f ));
+	tri.maxY = std::int32_t(std::min( std::floor( bmaxY - 0.5f ), h - 1.f ));
+	if( tri.minX > tri.maxX || tri.minY > tri.maxY )
+		return;
+
+	// Depth plane. Pixels store the farthest depth of the triangle within
+	// the pixel (rather than at its center), so that the buffer never
+	// claims more occlusion than there is.
+	float const z10 = z[1] - z[0], z20 = z[2] - z[0];
+	tri.dzdx = (z10*y20 - z20*y10) / area;
+	tri.dzdy = (x10*z20 - x20*z10) / area;
+	tri.z0 = z[0] + 0.5f * (std::abs( tri.dzdx ) + std::abs( tri.dzdy ));
+
+	mTriangles.emplace_back( tri );
+}
+
+void OcclusionBuffer::rasterize_( std::size_t aRowBegin, std::size_t aRowEnd )
+{
+	auto& base = mLevels[0];
+	std::fill( base.depth.begin() + aRowBegin*base.width, base.depth.begin() + aRowEnd*base.width, kFar_ );
+
+	__m128 const laneOffsets = _mm_setr_ps( 0.5f, 1.5f, 2.5f, 3.5f );
+	__m128 const zero = _mm_setzero_ps();
+
+	auto const rowBegin = std::int32_t(aRowBegin), rowEnd = std::int32_t(aRowEnd);
+	for( auto const& tri : mTriangles )
+	{
+		auto const y0 = std::max( tri.minY, rowBegin );
+		auto const y1 = std::min( tri.maxY, rowEnd-1 );
+		if( y0 > y1 )
+			continue;
+
+		// Edge functions E(p) = A*p.x + B*p.y + C, positive inside
+		float A[3], B[3], C[3];
+		for( std::size_t i = 0; i < 3; ++i )
+		{
+			auto const j = (i+1) % 3;
+			A[i] = tri.y[i] - tri.y[j];
+			B[i] = tri.x[j] - tri.x[i];
+			C[i] = -A[i]*tri.x[i] - B[i]*tri.y[i];
+
+			// Move the edges in a tiny bit, so that rounding never lets a
+			// triangle cover a pixel center that is outside of it. (A pixel
+			// center on an edge shared by two triangles may then be covered
+			// by neither. That only loses occlusion, it never hides
+			// anything that is visible.)
+			C[i] -= kEdgeBias_ * (std::abs( A[i] ) + std::abs( B[i] ));
+		}
+
+		auto const x0 = tri.minX & ~std::int32_t(3);
+		__m128 const px0 = _mm_add_ps( _mm_set1_ps( float(x0) ), laneOffsets );
+
+		__m128 const stepE0 = _mm_set1_ps( 4.f * A[0] );
+		__m128 const stepE1 = _mm_set1_ps( 4.f * A[1] );
+		__m128 const stepE2 = _mm_set1_ps( 4.f * A[2] );
+		__m128 const stepZ = _mm_set1_ps( 4.f * tri.dzdx );
+
+		for( auto y = y0; y <= y1; ++y )
+		{
+			float const py = float(y) + 0.5f;
+
+			__m128 e0 = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( A[0] ), px0 ), _mm_set1_ps( B[0]*py + C[0] ) );
+			__m128 e1 = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( A[1] ), px0 ), _mm_set1_ps( B[1]*py + C[1] ) );
+			__m128 e2 = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( A[2] ), px0 ), _mm_set1_ps( B[2]*py + C[2] ) );
+			__m128 z = _mm_add_ps(
+				_mm_mul_ps( _mm_set1_ps( tri.dzdx ), _mm_sub_ps( px0, _mm_set1_ps( tri.x[0] ) ) ),
+				_mm_set1_ps( tri.z0 + tri.dzdy * (py - tri.y[0]) )
+			);
+
+			float* row = base.depth.data() + std::size_t(y) * base.width;
+			for( auto x = x0; x <= tri.maxX; x += 4 )
+			{
+				__m128 const inside = _mm_and_ps(
+					_mm_and_ps( _mm_cmpge_ps( e0, zero ), _mm_cmpge_ps( e1, zero ) ),
+					_mm_cmpge_ps( e2, zero )
+				);
+
+				if( _mm_movemask_ps( inside ) )
+				{
+					__m128 const old = _mm_loadu_ps( row + x );
+					__m128 const nearer = _mm_min_ps( old, z );
+					_mm_storeu_ps( row + x, _mm_or_ps( _mm_and_ps( inside, nearer ), _mm_andnot_ps( inside, old ) ) );
+				}
+
+				e0 = _mm_add_ps( e0, stepE0 );
+				e1 = _mm_add_ps( e1, stepE1 );
+				e2 = _mm_add_ps( e2, stepE2 );
+				z = _mm_add_ps( z, stepZ );
+			}
+		}
+	}
+}
+
+void OcclusionBuffer::build_pyramid_()
+{
+	for( std::size_t l = 1; l < mLevels.size(); ++l )
+	{
+		auto const& src = mLevels[l-1];
+		auto& dst = mLevels[l];
+
+		for( std::size_t y = 0; y < dst.height; ++y )
+		{
+			auto const sy0 = 2*y, sy1 = std::min( 2*y+1, src.height-1 );
+			for( std::size_t x = 0; x < dst.width; ++x )
+			{
+				auto const sx0 = 2*x, sx1 = std::min( 2*x+1, src.width-1 );
+				dst.depth[y*dst.width + x] = std::max(
+					std::max( src.depth[sy0*src.width + sx0], src.depth[sy0*src.width + sx1] ),
+					std::max( src.depth[sy1*src.width + sx0], src.depth[sy1*src.width + sx1] )
+				);
+			}
+		}
+	}
+}
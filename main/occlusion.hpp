@@ -0,0 +1,132 @@
+#ifndef OCCLUSION_HPP_5A0E3C7B_92D4_4F61_8B1E_6C3F07D2A985
+#define OCCLUSION_HPP_5A0E3C7B_92D4_4F61_8B1E_6C3F07D2A985
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "culling.hpp"
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/vec4.hpp"
+#include "../vmlib/mat44.hpp"
+
+class ThreadPool;
+
+/* Simplified geometry of a mesh, for occlusion culling.
+ *
+ * Holds a coarse level of detail of each chunk of a mesh (see
+ * make_occluder() in loadcustom.hpp), so that occluders can be limited to
+ * the chunks that are in view. Each chunk has its own vertices; its indices
+ * are relative to its first vertex.
+ */
+struct OccluderChunk
+{
+	std::uint32_t firstVertex, vertexCount;
+	std::uint32_t firstIndex, indexCount;
+};
+
+struct OccluderMesh
+{
+	std::vector<Vec3f> positions;
+	std::vector<std::uint32_t> indices;
+	std::vector<OccluderChunk> chunks;
+};
+
+/* OcclusionBuffer: software depth buffer for occlusion culling.
+ *
+ * Each frame, occluders (low-poly versions of large meshes, e.g., the
+ * terrain) are rasterized into a small depth buffer on the CPU. The buffer
+ * is reduced to a hierarchical depth (Hi-Z) pyramid, where each texel holds
+ * the farthest depth of the four below it. Bounding boxes are then tested
+ * against the level of the pyramid where they cover only a few texels: a
+ * box is hidden if its nearest point is behind the farthest occluder in
+ * all texels that it covers.
+ *
+ * Depths are normalized device z (-1 near to 1 far), as with OpenGL's
+ * default depth range. Occluder triangles are clipped to the near plane and
+ * back-face culled, and are rasterized four pixels at a time with SSE.
+ * With a ThreadPool, horizontal bands of the buffer are rasterized in
+ * parallel. render() waits for the bands, so the pool should be one of its
+ * own: on a shared pool, the bands queue up behind other jobs (e.g., the
+ * loader's texture streaming) and stall the frame.
+ *
+ * The buffer doesn't use OpenGL, so it can be tested and benchmarked
+ * without a window (see main-test and --bench-occlusion).
+ */
+class OcclusionBuffer final
+{
+	public:
+		static constexpr std::size_t kDefaultWidth = 256;
+		static constexpr std::size_t kDefaultHeight = 144;
+
+	public:
+		// aWidth must be a multiple of four.
+		explicit OcclusionBuffer( std::size_t aWidth = kDefaultWidth, std::size_t aHeight = kDefaultHeight );
+
+	public:
+		// Starts a new frame: removes all occluders
+		void clear();
+
+		// Queues the triangles aIndices[0 ... aIndexCount-1], which refer to
+		// aPositions[0 ... aPositionCount-1]. aClipFromObject transforms the
+		// positions to clip space.
+		void add_occluder(
+			Mat44f const& aClipFromObject,
+			Vec3f const* aPositions, std::size_t aPositionCount,
+			std::uint32_t const* aIndices, std::size_t aIndexCount
+		);
+
+		void add_occluder( Mat44f const& aClipFromObject, OccluderMesh const&, OccluderChunk const& );
+
+		// Rasterizes the queued occluders and builds the depth pyramid.
+		void render( ThreadPool* = nullptr );
+
+		// False if the box is certainly hidden by the occluders (or entirely
+		// off-screen). Must be called after render().
+		bool test_box( Mat44f const& aClipFromObject, Vec3f aMin, Vec3f aMax ) const noexcept;
+
+	public:
+		std::size_t width() const noexcept;
+		std::size_t height() const noexcept;
+
+		std::size_t triangle_count() const noexcept; // queued, after clipping and culling
+
+		// Depth of level 0 (the full resolution buffer); row 0 is the bottom
+		float depth( std::size_t aX, std::size_t aY ) const noexcept;
+
+		// Levels of the depth pyramid. Level 0 is the full resolution
+		// buffer, each further level has half the size (rounded up).
+		std::size_t level_count() const noexcept;
+		std::size_t level_width( std::size_t aLevel ) const noexcept;
+		std::size_t level_height( std::size_t aLevel ) const noexcept;
+
+		float depth( std::size_t aLevel, std::size_t aX, std::size_t aY ) const noexcept;
+
+	private:
+		// Triangle in pixel coordinates (x right, y up), counter-clockwise
+		struct Triangle_
+		{
+			float x[3], y[3];
+			float z0, dzdx, dzdy; // depth plane, relative to vertex 0
+			std::int32_t minX, maxX, minY, maxY; // covered pixels (inclusive)
+		};
+
+		struct Level_
+		{
+			std::size_t width, height;
+			std::vector<float> depth;
+		};
+
+		void add_triangle_( Vec4f const&, Vec4f const&, Vec4f const& );
+		void rasterize_( std::size_t aRowBegin, std::size_t aRowEnd );
+		void build_pyramid_();
+
+	private:
+		std::vector<Vec4f> mClip; // scratch, transformed positions
+		std::vector<Triangle_> mTriangles;
+		std::vector<Level_> mLevels; // mLevels[0] is the depth buffer
+};
+
+#endif // OCCLUSION_HPP_5A0E3C7B_92D4_4F61_8B1E_6C3F07D2A985
@@ -0,0 +1,215 @@
+#include "packed_mesh.hpp"
+
+#include <limits>
+#include <algorithm>
+
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	constexpr std::uint32_t kPositionOffset_ = 0;
+	constexpr std::uint32_t kColorOffset_ = 8;
+	constexpr std::uint32_t kNormalOffset_ = 12;
+	constexpr std::uint32_t kTexcoordOffset_ = 16;
+
+	std::uint16_t to_unorm16_( float aValue ) noexcept
+	{
+		float const c = std::clamp( aValue, 0.f, 1.f );
+		return std::uint16_t(std::lround( c * 65535.f ));
+	}
+	std::uint8_t to_unorm8_( float aValue ) noexcept
+	{
+		float const c = std::clamp( aValue, 0.f, 1.f );
+		return std::uint8_t(std::lround( c * 255.f ));
+	}
+
+	std::uint32_t to_snorm10_( float aValue ) noexcept
+	{
+		float const c = std::clamp( aValue, -1.f, 1.f );
+		return std::uint32_t(std::lround( c * 511.f )) & 0x3ffu;
+	}
+
+	std::uint32_t pack_normal_( Vec3f aNormal ) noexcept
+	{
+		// The generators don't always produce unit-length normals (the shader
+		// normalizes anyway). Normalize here so that the direction survives
+		// the clamp to [-1,1].
+		float const len = length( aNormal );
+		Vec3f const n = len > 0.f ? aNormal / len : Vec3f{ 0.f, 0.f, 0.f };
+
+		return to_snorm10_( n.x ) | (to_snorm10_( n.y ) << 10) | (to_snorm10_( n.z ) << 20);
+	}
+
+	std::uint16_t to_half_( float aValue ) noexcept
+	{
+		// float -> IEEE 754 binary16, rounding to nearest even. Values that
+		// are too large become infinity; denormals are handled.
+		std::uint32_t bits;
+		std::memcpy( &bits, &aValue, sizeof(bits) );
+
+		std::uint32_t const sign = (bits >> 16) & 0x8000u;
+		std::uint32_t const absBits = bits & 0x7fffffffu;
+
+		if( absBits >= 0x7f800000u ) // Inf/NaN
+			return std::uint16_t(sign | 0x7c00u | (absBits > 0x7f800000u ? 0x200u : 0u));
+		if( absBits >= 0x477ff000u ) // overflows after rounding
+			return std::uint16_t(sign | 0x7c00u);
+
+		if( absBits < 0x38800000u ) // denormal or zero in half precision
+		{
+			if( absBits < 0x33000000u )
+				return std::uint16_t(sign);
+
+			std::uint32_t const exp = absBits >> 23;
+			std::uint32_t const mant = (absBits & 0x7fffffu) | 0x800000u;
+			std::uint32_t const shift = 126u - exp;
+			std::uint32_t half = mant >> shift;
+			std::uint32_t const rem = mant & ((1u << shift) - 1u);
+			std::uint32_t const halfway = 1u << (shift - 1u);
+			if( rem > halfway || (rem == halfway && (half & 1u)) )
+				++half;
+			return std::uint16_t(sign | half);
+		}
+
+		std::uint32_t half = ((absBits - 0x38000000u) >> 13);
+		std::uint32_t const rem = absBits & 0x1fffu;
+		if( rem > 0x1000u || (rem == 0x1000u && (half & 1u)) )
+			++half;
+		return std::uint16_t(sign | half);
+	}
+}
+
+void apply_dequant( MeshDequant const& aDequant )
+{
+	glUniform3fv( kPositionScaleLocation, 1, &aDequant.positionScale.x );
+	glUniform3fv( kPositionBiasLocation, 1, &aDequant.positionBias.x );
+	glUniform1f( kColorScaleLocation, aDequant.colorScale );
+}
+
+PackedMesh pack_mesh( SimpleMeshData const& aMesh )
+{
+	bool const hasTexcoords = !aMesh.texcoords.empty();
+	std::size_t const count = aMesh.positions.size();
+
+	// Texture coordinates in [0,1] (e.g. the terrain orthophoto) are stored
+	// as unorm16, which is ~16x more precise than half floats near 1.0.
+	// Anything else (e.g. repeating textures) falls back to half floats.
+	bool const unitTexcoords = std::all_of( aMesh.texcoords.begin(), aMesh.texcoords.end(), [] (Vec2f const& aT) {
+		return aT.x >= 0.f && aT.x <= 1.f && aT.y >= 0.f && aT.y <= 1.f;
+	} );
+
+	PackedMesh ret{};
+	ret.vertexCount = count;
+	ret.indices = aMesh.indices;
+
+	// Layout
+	ret.layout.stride = hasTexcoords ? 20 : 16;
+	ret.layout.attribs[ret.layout.attribCount++] = { 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, kPositionOffset_ };
+	ret.layout.attribs[ret.layout.attribCount++] = { 1, 3, GL_UNSIGNED_BYTE, GL_TRUE, kColorOffset_ };
+	ret.layout.attribs[ret.layout.attribCount++] = { 2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, kNormalOffset_ };
+	if( hasTexcoords )
+	{
+		if( unitTexcoords )
+			ret.layout.attribs[ret.layout.attribCount++] = { 3, 2, GL_UNSIGNED_SHORT, GL_TRUE, kTexcoordOffset_ };
+		else
+			ret.layout.attribs[ret.layout.attribCount++] = { 3, 2, GL_HALF_FLOAT, GL_FALSE, kTexcoordOffset_ };
+	}
+
+	// Quantization ranges
+	Vec3f bmin{ std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+	Vec3f bmax = -bmin;
+	for( auto const& p : aMesh.positions )
+	{
+		bmin = Vec3f{ std::min( bmin.x, p.x ), std::min( bmin.y, p.y ), std::min( bmin.z, p.z ) };
+		bmax = Vec3f{ std::max( bmax.x, p.x ), std::max( bmax.y, p.y ), std::max( bmax.z, p.z ) };
+	}
+
+	float maxColor = 0.f;
+	for( auto const& c : aMesh.colors )
+		maxColor = std::max( { maxColor, c.x, c.y, c.z } );
+
+	if( 0 == count )
+		bmin = bmax = Vec3f{ 0.f, 0.f, 0.f };
+
+	Vec3f const extent = bmax - bmin;
+	ret.dequant.positionBias = bmin;
+	ret.dequant.positionScale = extent;
+	ret.dequant.colorScale = maxColor > 0.f ? maxColor : 1.f;
+
+	auto const inv = [] (float aExtent) { return aExtent > 0.f ? 1.f / aExtent : 0.f; };
+	Vec3f const invExtent{ inv( extent.x ), inv( extent.y ), inv( extent.z ) };
+	float const invColor = 1.f / ret.dequant.colorScale;
+
+	// Pack
+	ret.vertices.resize( count * ret.layout.stride );
+	for( std::size_t i = 0; i < count; ++i )
+	{
+		std::byte* out = ret.vertices.data() + i * ret.layout.stride;
+
+		Vec3f const p = aMesh.positions[i] - bmin;
+		std::uint16_t const pos[4] = {
+			to_unorm16_( p.x * invExtent.x ),
+			to_unorm16_( p.y * invExtent.y ),
+			to_unorm16_( p.z * invExtent.z ),
+			0
+		};
+		std::memcpy( out + kPositionOffset_, pos, sizeof(pos) );
+
+		Vec3f const c = aMesh.colors.empty() ? Vec3f{ 1.f, 1.f, 1.f } * invColor : aMesh.colors[i] * invColor;
+		std::uint8_t const col[4] = { to_unorm8_( c.x ), to_unorm8_( c.y ), to_unorm8_( c.z ), 255 };
+		std::memcpy( out + kColorOffset_, col, sizeof(col) );
+
+		std::uint32_t const nor = aMesh.normals.empty() ? 0u : pack_normal_( aMesh.normals[i] );
+		std::memcpy( out + kNormalOffset_, &nor, sizeof(nor) );
+
+		if( hasTexcoords )
+		{
+			Vec2f const t = aMesh.texcoords[i];
+			std::uint16_t const tex[2] = {
+				unitTexcoords ? to_unorm16_( t.x ) : to_half_( t.x ),
+				unitTexcoords ? to_unorm16_( t.y ) : to_half_( t.y )
+			};
+			std::memcpy( out + kTexcoordOffset_, tex, sizeof(tex) );
+		}
+	}
+
+	return ret;
+}
+
+PackedMeshView make_view( PackedMesh const& aMesh )
+{
+	return PackedMeshView{
+		aMesh.layout,
+		aMesh.vertexCount, aMesh.vertices.data(),
+		aMesh.indices.size(), aMesh.indices.data(),
+		aMesh.dequant,
+		aMesh.lods.size(), aMesh.lods.data(),
+		aMesh.chunks.size(), aMesh.chunks.data(),
+		aMesh.meshlets.size(), aMesh.meshlets.data()
+	};
+}
+
+Vec3f unpack_position( PackedMeshView const& aView, std::size_t aVertex ) noexcept
+{
+	std::uint16_t pos[3];
+	auto const* vertex = static_cast<std::byte const*>(aView.vertices) + aVertex * aView.layout.stride;
+	std::memcpy( pos, vertex + kPositionOffset_, sizeof(pos) );
+
+	auto const& dq = aView.dequant;
+	return Vec3f{
+		dq.positionBias.x + dq.positionScale.x * (pos[0] / 65535.f),
+		dq.positionBias.y + dq.positionScale.y * (pos[1] / 65535.f),
+		dq.positionBias.z + dq.positionScale.z * (pos[2] / 65535.f)
+	};
+}
+
+GLuint create_vao( PackedMesh const& aMesh )
+{
+	return create_vao( make_view( aMesh ) );
+}
+GLuint create_vao( PackedMeshView const& aView )
+{
+	return create_vao( aView.layout, aView.vertices, aView.vertexCount,
+		aView.indices, aView.indexCount );
+}
@@ -0,0 +1,109 @@
+#ifndef PACKED_MESH_HPP_9E2B61F4_3A7C_4D85_B0E1_6F58C2A94D17
+#define PACKED_MESH_HPP_9E2B61F4_3A7C_4D85_B0E1_6F58C2A94D17
+
+#include <glad.h>
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "mesh_lod.hpp"
+#include "mesh_chunks.hpp"
+#include "simple_mesh.hpp"
+
+#include "../vmlib/vec3.hpp"
+
+/* Dequantization parameters for a packed mesh.
+ *
+ * The vertex shader (default.vert) reconstructs attributes as
+ *   position = uPositionBias + uPositionScale * iPosition
+ *   color    = uColorScale * iColor
+ * where iPosition and iColor are normalized integers in [0,1].
+ *
+ * Unpacked (float) meshes are drawn with kNoDequant.
+ */
+struct MeshDequant
+{
+	Vec3f positionScale;
+	Vec3f positionBias;
+	float colorScale;
+};
+
+constexpr MeshDequant kNoDequant = { { 1.f, 1.f, 1.f }, { 0.f, 0.f, 0.f }, 1.f };
+
+// Uniform locations used by default.vert for dequantization
+constexpr GLint kPositionScaleLocation = 5;
+constexpr GLint kPositionBiasLocation = 6;
+constexpr GLint kColorScaleLocation = 7;
+
+// Set the dequantization uniforms of the currently bound program.
+void apply_dequant( MeshDequant const& );
+
+/* PackedMesh: compact, interleaved vertex format.
+ *
+ * Per vertex:
+ *   position  4 x unorm16, relative to the mesh's bounding box  (8 bytes)
+ *   color     4 x unorm8, scaled by the largest color component (4 bytes)
+ *   normal    GL_INT_2_10_10_10_REV, normalized                  (4 bytes)
+ *   texcoord  2 x unorm16 if all texcoords are in [0,1], else
+ *             2 x half float (only if the mesh has texcoords)    (4 bytes)
+ *
+ * That is 20 bytes per vertex (16 without texture coordinates), compared to
+ * 44 bytes for the float layout used by create_vao( SimpleMeshData ).
+ */
+struct PackedMesh
+{
+	VertexLayout layout;
+	std::size_t vertexCount;
+	std::vector<std::byte> vertices;
+	std::vector<std::uint32_t> indices;
+
+	MeshDequant dequant;
+
+	// Levels of detail (see mesh_lod.hpp). Empty if the mesh has a single
+	// level, in which case all indices belong to level 0.
+	std::vector<MeshLod> lods;
+
+	// Spatial chunks (see mesh_chunks.hpp). Empty if the mesh isn't split,
+	// in which case the whole mesh is a single chunk using all levels.
+	std::vector<MeshChunk> chunks;
+
+	// Meshlets of the levels of detail (see meshlets.hpp). May be empty.
+	std::vector<Meshlet> meshlets;
+};
+
+// Non-owning view of packed vertex and index data. Used to upload data that
+// doesn't live in a PackedMesh, e.g., a memory mapped mesh cache file.
+struct PackedMeshView
+{
+	VertexLayout layout;
+	std::size_t vertexCount;
+	void const* vertices;
+	std::size_t indexCount;
+	std::uint32_t const* indices;
+
+	MeshDequant dequant;
+
+	std::size_t lodCount;
+	MeshLod const* lods;
+
+	std::size_t chunkCount;
+	MeshChunk const* chunks;
+
+	std::size_t meshletCount;
+	Meshlet const* meshlets;
+};
+
+PackedMesh pack_mesh( SimpleMeshData const& );
+
+PackedMeshView make_view( PackedMesh const& );
+
+// Dequantized position of a vertex, for CPU-side use of packed meshes (e.g.,
+// occlusion culling)
+Vec3f unpack_position( PackedMeshView const&, std::size_t aVertex ) noexcept;
+
+GLuint create_vao( PackedMesh const& );
+GLuint create_vao( PackedMeshView const& );
+
+#endif // PACKED_MESH_HPP_9E2B61F4_3A7C_4D85_B0E1_6F58C2A94D17
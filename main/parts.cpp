@@ -0,0 +1,135 @@
+#include "parts.hpp"
+
+#include <cassert>
+
+#include "cone.hpp"
+#include "cube.hpp"
+#include "cylinder.hpp"
+#include "mesh_optimize.hpp"
+
+namespace
+{
+	PackedMesh pack_primitive_( SimpleMeshData aMesh )
+	{
+		aMesh.indices = optimize_vertex_cache( aMesh.indices, aMesh.positions.size() );
+		return pack_mesh( aMesh );
+	}
+}
+
+std::uint32_t PartHierarchy::add( std::uint32_t aParent, PartShape aShape, Mat44f const& aLocal, Vec3f aColor )
+{
+	assert( kNoParent == aParent || aParent < mParts.size() );
+
+	auto const ret = std::uint32_t(mParts.size());
+	mParts.emplace_back( Part{ aParent, aShape, aColor, aLocal } );
+	return ret;
+}
+
+std::size_t PartHierarchy::size() const noexcept
+{
+	return mParts.size();
+}
+
+Part const& PartHierarchy::operator[] ( std::size_t aIndex ) const noexcept
+{
+	assert( aIndex < mParts.size() );
+	return mParts[aIndex];
+}
+Part& PartHierarchy::operator[] ( std::size_t aIndex ) noexcept
+{
+	assert( aIndex < mParts.size() );
+	return mParts[aIndex];
+}
+
+void PartHierarchy::world_transforms( Mat44f const& aRoot, std::vector<Mat44f>& aOut ) const
+{
+	aOut.resize( mParts.size() );
+	for( std::size_t i = 0; i < mParts.size(); ++i )
+	{
+		auto const& part = mParts[i];
+		auto const& parent = kNoParent == part.parent ? aRoot : aOut[part.parent];
+		aOut[i] = parent * part.local;
+	}
+}
+
+
+PrimitiveMeshes make_primitive_meshes( std::size_t aSubdivs )
+{
+	Vec3f const white{ 1.f, 1.f, 1.f };
+
+	PrimitiveMeshes ret;
+	ret.meshes[std::size_t(PartShape::cylinder)] = pack_primitive_( make_cylinder( true, aSubdivs, white ) );
+	ret.meshes[std::size_t(PartShape::cone)] = pack_primitive_( make_cone( true, aSubdivs, white ) );
+
+	// The cube's faces are flat, so subdividing them only adds vertices.
+	ret.meshes[std::size_t(PartShape::cube)] = pack_primitive_( make_cube( true, 1, white ) );
+	return ret;
+}
+
+
+PartRenderer::PartRenderer( PrimitiveMeshes const& aMeshes )
+{
+	for( std::size_t i = 0; i < kPartShapeCount; ++i )
+	{
+		auto const& mesh = aMeshes.meshes[i];
+		if( mesh.indices.empty() )
+			continue;
+
+		auto& prim = mPrimitives[i];
+		prim.vao = create_vao( mesh );
+		prim.indexCount = GLsizei(mesh.indices.size());
+		prim.dequant = mesh.dequant;
+		prim.instances.attach( prim.vao );
+	}
+}
+
+PartRenderer::~PartRenderer()
+{
+	for( auto const& prim : mPrimitives )
+	{
+		if( prim.vao )
+			glDeleteVertexArrays( 1, &prim.vao );
+	}
+}
+
+void PartRenderer::draw( PartHierarchy const& aParts, Mat44f const& aRoot )
+{
+	aParts.world_transforms( aRoot, mWorld );
+
+	// Sort the parts into one batch per primitive
+	for( auto& prim : mPrimitives )
+	{
+		prim.transforms.clear();
+		prim.colors.clear();
+	}
+
+	for( std::size_t i = 0; i < aParts.size(); ++i )
+	{
+		auto const& part = aParts[i];
+		auto& prim = mPrimitives[std::size_t(part.shape)];
+		if( !prim.vao )
+			continue;
+
+		prim.transforms.emplace_back( mWorld[i] );
+		prim.colors.emplace_back( part.color );
+	}
+
+	mDrawCalls = 0;
+	for( auto& prim : mPrimitives )
+	{
+		if( prim.transforms.empty() )
+			continue;
+
+		prim.instances.update( prim.transforms.data(), prim.colors.data(), prim.transforms.size() );
+
+		glBindVertexArray( prim.vao );
+		apply_dequant( prim.dequant );
+		glDrawElementsInstanced( GL_TRIANGLES, prim.indexCount, GL_UNSIGNED_INT, nullptr, GLsizei(prim.transforms.size()) );
+		++mDrawCalls;
+	}
+}
+
+std::size_t PartRenderer::draw_calls() const noexcept
+{
+	return mDrawCalls;
+}
@@ -0,0 +1,117 @@
+#ifndef PARTS_HPP_8B3E1F60_47D2_4A9C_B5E8_0C6D2F91A734
+#define PARTS_HPP_8B3E1F60_47D2_4A9C_B5E8_0C6D2F91A734
+
+#include <glad.h>
+
+#include <array>
+#include <limits>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "instancing.hpp"
+#include "packed_mesh.hpp"
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/mat44.hpp"
+
+/* Models built from transformed instances of a few shared primitives.
+ *
+ * A PartHierarchy is a tree of parts. Each part has a transform relative to
+ * its parent and, optionally, a primitive shape (unit cylinder, cone or
+ * cube, see make_primitive_meshes()) and a color. Parts without a shape
+ * only group other parts.
+ *
+ * The primitives exist once, no matter how many parts use them; a part only
+ * costs its transform and color. A PartRenderer draws a whole hierarchy
+ * with one instanced draw call per primitive, so changing or rebuilding a
+ * hierarchy (e.g., make_ship() with a different ShipConfig) doesn't create
+ * any meshes.
+ */
+enum class PartShape : std::uint8_t
+{
+	none,
+	cylinder,
+	cone,
+	cube
+};
+
+constexpr std::size_t kPartShapeCount = 4; // including none
+
+constexpr std::uint32_t kNoParent = std::numeric_limits<std::uint32_t>::max();
+
+struct Part
+{
+	std::uint32_t parent;
+	PartShape shape;
+	Vec3f color;
+	Mat44f local; // part to parent
+};
+
+class PartHierarchy final
+{
+	public:
+		// Adds a part and returns its index. The parent must already exist
+		// (so parents always precede their children).
+		std::uint32_t add( std::uint32_t aParent, PartShape, Mat44f const& aLocal, Vec3f aColor = { 1.f, 1.f, 1.f } );
+
+		std::size_t size() const noexcept;
+		Part const& operator[] ( std::size_t ) const noexcept;
+		Part& operator[] ( std::size_t ) noexcept;
+
+		// Part to world transforms of all parts, given the transform of the
+		// root(s). A single pass, as parents precede their children.
+		void world_transforms( Mat44f const& aRoot, std::vector<Mat44f>& aOut ) const;
+
+	private:
+		std::vector<Part> mParts;
+};
+
+// Unit primitives, packed but not yet uploaded (doesn't use OpenGL):
+//  - cylinder: radius 1 around the x axis, from x = 0 to 1
+//  - cone: around the x axis, from the tip at x = 0 to a base of radius 1
+//    at x = 1
+//  - cube: from -0.5 to 0.5 along each axis
+// Vertex colors are white; parts supply their own color.
+struct PrimitiveMeshes
+{
+	std::array<PackedMesh, kPartShapeCount> meshes; // indexed by PartShape
+};
+
+PrimitiveMeshes make_primitive_meshes( std::size_t aSubdivs = 128 );
+
+class PartRenderer final
+{
+	public:
+		explicit PartRenderer( PrimitiveMeshes const& );
+		~PartRenderer();
+
+		PartRenderer( PartRenderer const& ) = delete;
+		PartRenderer& operator= (PartRenderer const&) = delete;
+
+	public:
+		// Draws the hierarchy with the current program (assets/default.vert;
+		// uProjCameraWorld must be set). One draw call per primitive.
+		void draw( PartHierarchy const&, Mat44f const& aRoot );
+
+		std::size_t draw_calls() const noexcept; // of the last draw()
+
+	private:
+		struct Primitive_
+		{
+			GLuint vao = 0;
+			GLsizei indexCount = 0;
+			MeshDequant dequant{};
+			InstanceBuffer instances;
+
+			std::vector<Mat44f> transforms; // scratch
+			std::vector<Vec3f> colors;
+		};
+
+		std::array<Primitive_, kPartShapeCount> mPrimitives; // indexed by PartShape (none is unused)
+		std::vector<Mat44f> mWorld;
+		std::size_t mDrawCalls = 0;
+};
+
+#endif // PARTS_HPP_8B3E1F60_47D2_4A9C_B5E8_0C6D2F91A734
@@ -0,0 +1,147 @@
+#include "perf.hpp"
+
+#include "packed_mesh.hpp"
+
+#include <cstdio>
+
+#include "../support/checkpoint.hpp"
+
+namespace
+{
+	constexpr unsigned kWarmupDraws_ = 4;
+	constexpr unsigned kTimedDraws_ = 64;
+
+	// The vertex layout used before create_vao() switched to a single
+	// interleaved buffer: one VBO per attribute stream. Kept here only as the
+	// baseline for benchmark_vertex_layouts().
+	GLuint create_vao_separate_streams_( SimpleMeshData const& );
+}
+
+double measure_draw_ms( GLuint aVao, std::size_t aVertexCount, std::size_t aIndexCount, unsigned aRepeats )
+{
+	GLuint query = 0;
+	glGenQueries( 1, &query );
+
+	glBindVertexArray( aVao );
+
+	auto const draw = [&] {
+		if( aIndexCount )
+			glDrawElements( GL_TRIANGLES, GLsizei(aIndexCount), GL_UNSIGNED_INT, nullptr );
+		else
+			glDrawArrays( GL_TRIANGLES, 0, GLsizei(aVertexCount) );
+	};
+
+	for( unsigned i = 0; i < kWarmupDraws_; ++i )
+		draw();
+
+	glBeginQuery( GL_TIME_ELAPSED, query );
+	for( unsigned i = 0; i < aRepeats; ++i )
+		draw();
+	glEndQuery( GL_TIME_ELAPSED );
+
+	GLuint64 ns = 0;
+	glGetQueryObjectui64v( query, GL_QUERY_RESULT, &ns ); // waits
+	glDeleteQueries( 1, &query );
+
+	glBindVertexArray( 0 );
+	OGL_CHECKPOINT_ALWAYS();
+
+	return double(ns) * 1e-6;
+}
+
+void benchmark_vertex_layouts( char const* aName, SimpleMeshData const& aMesh )
+{
+	std::size_t const vertexCount = aMesh.positions.size();
+	std::size_t const indexCount = aMesh.indices.size();
+	std::size_t const drawnVertices = indexCount ? indexCount : vertexCount;
+
+	auto const packed = pack_mesh( aMesh );
+	auto const floatLayout = make_vertex_layout( aMesh );
+
+	GLuint const separate = create_vao_separate_streams_( aMesh );
+	GLuint const interleaved = create_vao( aMesh );
+	GLuint const packedVao = create_vao( packed );
+
+	glEnable( GL_RASTERIZER_DISCARD );
+
+	apply_dequant( kNoDequant );
+	double const separateMs = measure_draw_ms( separate, vertexCount, indexCount, kTimedDraws_ );
+	double const interleavedMs = measure_draw_ms( interleaved, vertexCount, indexCount, kTimedDraws_ );
+	apply_dequant( packed.dequant );
+	double const packedMs = measure_draw_ms( packedVao, vertexCount, indexCount, kTimedDraws_ );
+
+	glDisable( GL_RASTERIZER_DISCARD );
+
+	glDeleteVertexArrays( 1, &separate );
+	glDeleteVertexArrays( 1, &interleaved );
+	glDeleteVertexArrays( 1, &packedVao );
+
+	auto const mverts = [&] (double aMs) {
+		return double(drawnVertices) * kTimedDraws_ / (aMs * 1e-3) * 1e-6;
+	};
+	// Vertex data fetched per second, assuming every index fetches a full
+	// vertex (i.e., ignoring the post-transform cache).
+	auto const gbps = [&] (double aMs, std::size_t aStride) {
+		return double(drawnVertices) * aStride * kTimedDraws_ / (aMs * 1e-3) * 1e-9;
+	};
+	auto const mib = [&] (std::size_t aStride) {
+		return double(vertexCount * aStride) / (1024.0 * 1024.0);
+	};
+
+	// The separate streams always had four attributes, texcoords or not.
+	std::size_t const separateStride = 3*sizeof(Vec3f) + sizeof(Vec2f);
+
+	std::printf( "Vertex layout benchmark '%s' (%zu vertices, %zu indices, %u draws)\n", aName, vertexCount, indexCount, kTimedDraws_ );
+	std::printf( "  separate streams: %2zu B/vert %8.2f MiB  %8.3f ms  %10.1f Mvert/s  %6.1f GB/s\n", separateStride, mib(separateStride), separateMs, mverts(separateMs), gbps(separateMs, separateStride) );
+	std::printf( "  interleaved     : %2u B/vert %8.2f MiB  %8.3f ms  %10.1f Mvert/s  %6.1f GB/s  (%.2fx)\n", floatLayout.stride, mib(floatLayout.stride), interleavedMs, mverts(interleavedMs), gbps(interleavedMs, floatLayout.stride), separateMs / interleavedMs );
+	std::printf( "  packed          : %2u B/vert %8.2f MiB  %8.3f ms  %10.1f Mvert/s  %6.1f GB/s  (%.2fx)\n", packed.layout.stride, mib(packed.layout.stride), packedMs, mverts(packedMs), gbps(packedMs, packed.layout.stride), separateMs / packedMs );
+}
+
+
+namespace
+{
+	GLuint create_vao_separate_streams_( SimpleMeshData const& aMeshData )
+	{
+		GLuint vbos[4] = {};
+		glGenBuffers( 4, vbos );
+
+		glBindBuffer( GL_ARRAY_BUFFER, vbos[0] );
+		glBufferData( GL_ARRAY_BUFFER, aMeshData.positions.size() * sizeof(Vec3f), aMeshData.positions.data(), GL_STATIC_DRAW );
+		glBindBuffer( GL_ARRAY_BUFFER, vbos[1] );
+		glBufferData( GL_ARRAY_BUFFER, aMeshData.colors.size() * sizeof(Vec3f), aMeshData.colors.data(), GL_STATIC_DRAW );
+		glBindBuffer( GL_ARRAY_BUFFER, vbos[2] );
+		glBufferData( GL_ARRAY_BUFFER, aMeshData.normals.size() * sizeof(Vec3f), aMeshData.normals.data(), GL_STATIC_DRAW );
+		glBindBuffer( GL_ARRAY_BUFFER, vbos[3] );
+		glBufferData( GL_ARRAY_BUFFER, aMeshData.texcoords.size() * sizeof(Vec2f), aMeshData.texcoords.data(), GL_STATIC_DRAW );
+
+		GLuint vao = 0;
+		glGenVertexArrays( 1, &vao );
+		glBindVertexArray( vao );
+
+		GLint const components[4] = { 3, 3, 3, 2 };
+		for( GLuint i = 0; i < 4; ++i )
+		{
+			glBindBuffer( GL_ARRAY_BUFFER, vbos[i] );
+			glVertexAttribPointer( i, components[i], GL_FLOAT, GL_FALSE, 0, nullptr );
+			glEnableVertexAttribArray( i );
+		}
+
+		GLuint ibo = 0;
+		if( !aMeshData.indices.empty() )
+		{
+			glGenBuffers( 1, &ibo );
+			glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ibo );
+			glBufferData( GL_ELEMENT_ARRAY_BUFFER, aMeshData.indices.size() * sizeof(std::uint32_t), aMeshData.indices.data(), GL_STATIC_DRAW );
+		}
+
+		glBindVertexArray( 0 );
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+		glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+
+		glDeleteBuffers( 4, vbos );
+		if( ibo )
+			glDeleteBuffers( 1, &ibo );
+
+		return vao;
+	}
+}
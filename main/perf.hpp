@@ -0,0 +1,25 @@
+#ifndef PERF_HPP_4C0F6D3A_8E1B_4B7A_9A55_2D0C9E3F17B2
+#define PERF_HPP_4C0F6D3A_8E1B_4B7A_9A55_2D0C9E3F17B2
+
+#include <glad.h>
+
+#include <cstddef>
+
+#include "simple_mesh.hpp"
+
+// Measure the GPU time (in milliseconds) that it takes to draw the given VAO
+// aRepeats times. Uses a GL_TIME_ELAPSED query and waits for the result.
+//
+// If aIndexCount is nonzero, the VAO is drawn with glDrawElements(),
+// otherwise with glDrawArrays( ..., aVertexCount ). The currently bound
+// program and uniforms are used as-is.
+double measure_draw_ms( GLuint aVao, std::size_t aVertexCount, std::size_t aIndexCount, unsigned aRepeats );
+
+// Compare memory use and vertex throughput of the old layout (one
+// GL_STATIC_DRAW VBO per attribute, including empty ones), the interleaved
+// float layout from create_vao( SimpleMeshData ) and the packed layout from
+// pack_mesh(). Rasterization is disabled during the measurement, so that
+// only vertex fetch and vertex shading are timed. Prints results to stdout.
+void benchmark_vertex_layouts( char const* aName, SimpleMeshData const& );
+
+#endif // PERF_HPP_4C0F6D3A_8E1B_4B7A_9A55_2D0C9E3F17B2
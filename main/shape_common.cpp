@@ -0,0 +1,61 @@
+#include "shape_common.hpp"
+
+#include <mutex>
+#include <unordered_map>
+
+#include <cmath>
+
+#include "../vmlib/affine34.hpp"
+#include "../vmlib/transform.hpp"
+
+namespace
+{
+	bool is_identity_( Mat44f const& aM ) noexcept
+	{
+		for( std::size_t i = 0; i < 4; ++i )
+		{
+			for( std::size_t j = 0; j < 4; ++j )
+			{
+				if( aM(i,j) != (i == j ? 1.f : 0.f) )
+					return false;
+			}
+		}
+		return true;
+	}
+}
+
+std::vector<Vec2f> const& unit_circle( std::size_t aSubdivs )
+{
+	// Elements of an unordered_map don't move when it grows, so references
+	// to earlier tables stay valid.
+	static std::mutex mutex;
+	static std::unordered_map<std::size_t, std::vector<Vec2f>> tables;
+
+	std::lock_guard<std::mutex> lock( mutex );
+
+	auto [it, inserted] = tables.try_emplace( aSubdivs );
+	if( inserted )
+	{
+		auto& points = it->second;
+		points.resize( aSubdivs );
+		for( std::size_t i = 0; i < aSubdivs; ++i )
+		{
+			double const angle = 2.0 * 3.14159265358979323846 * double(i) / double(aSubdivs);
+			points[i] = Vec2f{ float(std::cos( angle )), float(std::sin( angle )) };
+		}
+	}
+
+	return it->second;
+}
+
+void apply_pre_transform( SimpleMeshData& aMesh, Mat44f const& aPreTransform )
+{
+	if( is_identity_( aPreTransform ) )
+		return;
+
+	transform_points( aPreTransform, aMesh.positions.data(), aMesh.positions.data(), aMesh.positions.size() );
+
+	// pre-compute N once by extracting the 3x3 submatrix of inverse-transpose of M
+	Mat33f const N = normal_matrix( aPreTransform );
+	transform_normals( N, aMesh.normals.data(), aMesh.normals.data(), aMesh.normals.size() );
+}
@@ -0,0 +1,25 @@
+#ifndef SHAPE_COMMON_HPP_3A8C51E7_0B94_4F2D_86C1_E75D2A9F40B8
+#define SHAPE_COMMON_HPP_3A8C51E7_0B94_4F2D_86C1_E75D2A9F40B8
+
+#include <vector>
+
+#include <cstddef>
+
+#include "simple_mesh.hpp"
+
+#include "../vmlib/vec2.hpp"
+#include "../vmlib/mat44.hpp"
+
+// Helpers shared by the shape generators (make_cylinder(), make_cone() and
+// make_cube()).
+
+// Points on the unit circle, { cos(a), sin(a) } for a = 2*pi*i/aSubdivs and
+// i = 0..aSubdivs-1. Tables are computed once per subdivision count and kept
+// for the lifetime of the program; this is safe to call from several threads.
+std::vector<Vec2f> const& unit_circle( std::size_t aSubdivs );
+
+// Transforms positions by aPreTransform and normals by its inverse
+// transpose. Does nothing for the identity.
+void apply_pre_transform( SimpleMeshData&, Mat44f const& aPreTransform );
+
+#endif // SHAPE_COMMON_HPP_3A8C51E7_0B94_4F2D_86C1_E75D2A9F40B8
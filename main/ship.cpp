@@ -0,0 +1,74 @@
+#include "ship.hpp"
+
+#include "../vmlib/mat44.hpp"
+
+namespace
+{
+	constexpr float kPi_ = 3.1415926f;
+}
+
+PartHierarchy make_ship( ShipConfig const& aConfig )
+{
+	// The primitives lie along the x axis; the ship stands along the y axis.
+	Mat44f const upright = make_rotation_z( kPi_ / 2.f );
+	Mat44f const downright = make_rotation_z( -kPi_ / 2.f );
+
+	float const length = aConfig.bodyLength;
+	float const bodyBase = 0.1f * length;
+	float const bodyTop = bodyBase + length;
+
+	PartHierarchy ret;
+	auto const root = ret.add( kNoParent, PartShape::none, kIdentity44f );
+
+	// Body and nose cone
+	auto const hull = ret.add( root, PartShape::none, kIdentity44f );
+	ret.add( hull, PartShape::cylinder,
+		upright
+		* make_scaling( length, 0.5f, 0.5f )
+		* make_translation( { 0.1f, 0.f, 0.f } ),
+		aConfig.bodyColor
+	);
+	ret.add( hull, PartShape::cone,
+		downright
+		* make_translation( { -bodyTop - 1.f, 0.f, 0.f } )
+		* make_scaling( 1.f, 0.5f, 0.5f ),
+		aConfig.noseColor
+	);
+
+	// Boosters, on either side of the body for the default two
+	auto const boosters = ret.add( root, PartShape::none, kIdentity44f );
+	for( std::size_t i = 0; i < aConfig.boosterCount; ++i )
+	{
+		float const angle = 2.f * kPi_ * float(i) / float(aConfig.boosterCount);
+		ret.add( boosters, PartShape::cylinder,
+			make_rotation_y( angle )
+			* upright
+			* make_scaling( 0.9f, 0.3f, 0.4f )
+			* make_translation( { 1.3f, 2.5f, 0.f } ),
+			aConfig.boosterColor
+		);
+	}
+
+	// Blocks at the base
+	auto const base = ret.add( root, PartShape::none, kIdentity44f );
+	ret.add( base, PartShape::cube,
+		downright
+		* make_scaling( 0.75f, 0.5f, 0.5f )
+		* make_translation( { 0.1f, 0.f, 0.f } ),
+		aConfig.baseColor
+	);
+	ret.add( base, PartShape::cube,
+		downright
+		* make_scaling( 0.5f, 0.6f, 0.6f )
+		* make_translation( { -0.6f, 0.9f, 0.f } ),
+		aConfig.baseColor
+	);
+	ret.add( base, PartShape::cube,
+		downright
+		* make_scaling( 0.5f, 0.6f, 0.6f )
+		* make_translation( { -0.6f, -0.9f, 0.f } ),
+		aConfig.baseColor
+	);
+
+	return ret;
+}
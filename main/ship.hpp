@@ -0,0 +1,28 @@
+#ifndef SHIP_HPP_F2A7C095_1E6B_4D38_8C41_9B5D3E07A6F2
+#define SHIP_HPP_F2A7C095_1E6B_4D38_8C41_9B5D3E07A6F2
+
+#include <cstddef>
+
+#include "parts.hpp"
+
+#include "../vmlib/vec3.hpp"
+
+// Parameters of the space ship. The defaults give the original ship: a red
+// body with a yellow nose cone, two blue boosters, and three gray blocks at
+// its base.
+struct ShipConfig
+{
+	float bodyLength = 3.f;
+	std::size_t boosterCount = 2; // evenly spaced around the body
+
+	Vec3f bodyColor{ 3.4f, 0.4f, 0.4f };
+	Vec3f noseColor{ 1.f, 1.f, 0.f };
+	Vec3f boosterColor{ 0.f, 0.6f, 0.7f };
+	Vec3f baseColor{ 0.4f, 0.4f, 0.4f };
+};
+
+// Builds the ship from the unit primitives (see parts.hpp). The ship points
+// up the y axis, with its base at the origin. Part 0 is the ship's root.
+PartHierarchy make_ship( ShipConfig const& = {} );
+
+#endif // SHIP_HPP_F2A7C095_1E6B_4D38_8C41_9B5D3E07A6F2
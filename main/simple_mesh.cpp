@@ -1,98 +1,233 @@
 #include "simple_mesh.hpp"
 
+#include <cassert>
+#include <cstring>
+#include <cstddef>
+#include <unordered_map>
+
+#include "mesh_builder.hpp"
+
+namespace
+{
+	// Key used to weld vertices. All attributes are compared bitwise; this is
+	// exactly what we want for OBJ data, where shared vertices reference the
+	// very same attribute values.
+	struct VertexKey_
+	{
+		Vec3f position;
+		Vec3f color;
+		Vec3f normal;
+		Vec2f texcoord;
+	};
+
+	bool operator==( VertexKey_ const& aLeft, VertexKey_ const& aRight ) noexcept
+	{
+		return 0 == std::memcmp( &aLeft, &aRight, sizeof(VertexKey_) );
+	}
+
+	struct VertexKeyHash_
+	{
+		std::size_t operator()( VertexKey_ const& aKey ) const noexcept
+		{
+			// FNV-1a over the 32-bit words of the key.
+			static_assert( sizeof(VertexKey_) % sizeof(std::uint32_t) == 0 );
+			std::uint32_t words[sizeof(VertexKey_)/sizeof(std::uint32_t)];
+			std::memcpy( words, &aKey, sizeof(VertexKey_) );
+
+			std::uint64_t hash = 14695981039346656037ull;
+			for( auto const w : words )
+			{
+				hash ^= w;
+				hash *= 1099511628211ull;
+			}
+			return std::size_t(hash ^ (hash >> 32));
+		}
+	};
+}
+
 SimpleMeshData concatenate( SimpleMeshData aM, SimpleMeshData const& aN )
 {
-	aM.positions.insert( aM.positions.end(), aN.positions.begin(), aN.positions.end() );
-	aM.colors.insert( aM.colors.end(), aN.colors.begin(), aN.colors.end() );
-	aM.normals.insert(aM.normals.end(), aN.normals.begin(), aN.normals.end());
-	aM.texcoords.insert(aM.texcoords.end(), aN.texcoords.begin(), aN.texcoords.end());
+	MeshBuilder builder( aM );
+	builder.plan( aN );
+	builder.append( aN );
 	return aM;
 }
 
+SimpleMeshData make_indexed( SimpleMeshData const& aMesh )
+{
+	bool const hasTexcoords = !aMesh.texcoords.empty();
+
+	std::size_t const count = aMesh.indices.empty() ? aMesh.positions.size() : aMesh.indices.size();
 
-GLuint create_vao( SimpleMeshData const& aMeshData )
+	SimpleMeshData ret;
+	ret.indices.reserve( count );
+
+	// Most meshes share each vertex between several triangles; start with a
+	// guess so that we don't rehash too often.
+	std::unordered_map<VertexKey_, std::uint32_t, VertexKeyHash_> unique;
+	unique.reserve( count / 2 + 1 );
+
+	for( std::size_t i = 0; i < count; ++i )
+	{
+		std::size_t const src = aMesh.indices.empty() ? i : aMesh.indices[i];
+
+		VertexKey_ key{};
+		key.position = aMesh.positions[src];
+		key.color = aMesh.colors[src];
+		key.normal = aMesh.normals[src];
+		if( hasTexcoords )
+			key.texcoord = aMesh.texcoords[src];
+
+		auto const [it, inserted] = unique.emplace( key, std::uint32_t(ret.positions.size()) );
+		if( inserted )
+		{
+			ret.positions.emplace_back( key.position );
+			ret.colors.emplace_back( key.color );
+			ret.normals.emplace_back( key.normal );
+			if( hasTexcoords )
+				ret.texcoords.emplace_back( key.texcoord );
+		}
+
+		ret.indices.emplace_back( it->second );
+	}
+
+	ret.positions.shrink_to_fit();
+	ret.colors.shrink_to_fit();
+	ret.normals.shrink_to_fit();
+	ret.texcoords.shrink_to_fit();
+
+	return ret;
+}
+
+
+VertexLayout make_vertex_layout( SimpleMeshData const& aMeshData )
+{
+	// Only attributes that the mesh actually contains become part of the
+	// layout. The attribute locations match the ones in default.vert.
+	VertexLayout layout{};
+
+	auto const add = [&layout] ( GLuint aLocation, GLint aComponents ) {
+		assert( layout.attribCount < kMaxVertexAttribs );
+		layout.attribs[layout.attribCount++] = VertexAttrib{
+			aLocation, aComponents, GL_FLOAT, GL_FALSE, layout.stride
+		};
+		layout.stride += std::uint32_t(aComponents * sizeof(float));
+	};
+
+	add( 0, 3 ); // positions are always present
+	if( !aMeshData.colors.empty() )
+		add( 1, 3 );
+	if( !aMeshData.normals.empty() )
+		add( 2, 3 );
+	if( !aMeshData.texcoords.empty() )
+		add( 3, 2 );
+
+	return layout;
+}
+
+std::vector<std::byte> interleave_vertices( SimpleMeshData const& aMeshData, VertexLayout const& aLayout )
+{
+	std::size_t const count = aMeshData.positions.size();
+	std::vector<std::byte> ret( count * aLayout.stride );
+
+	for( std::uint32_t a = 0; a < aLayout.attribCount; ++a )
+	{
+		auto const& attrib = aLayout.attribs[a];
+
+		// Layouts produced by make_vertex_layout() only contain float
+		// attributes that map 1:1 onto the SimpleMeshData arrays.
+		assert( GL_FLOAT == attrib.type );
+		void const* src = nullptr;
+		switch( attrib.location )
+		{
+			case 0: src = aMeshData.positions.data(); break;
+			case 1: src = aMeshData.colors.data(); break;
+			case 2: src = aMeshData.normals.data(); break;
+			case 3: src = aMeshData.texcoords.data(); break;
+		}
+		assert( src );
+
+		std::size_t const bytes = attrib.components * sizeof(float);
+		auto const* in = static_cast<std::byte const*>(src);
+		auto* out = ret.data() + attrib.offset;
+		for( std::size_t i = 0; i < count; ++i )
+		{
+			std::memcpy( out, in, bytes );
+			in += bytes;
+			out += aLayout.stride;
+		}
+	}
+
+	return ret;
+}
+
+GLuint create_static_buffer( GLenum aTarget, std::size_t aBytes, void const* aData )
 {
-	//TODO: implement me
-	 
-	//================== vbo =====================	
-	// Position vertex Buffer object  
-	GLuint positionVBO = 0;			// initialise VBO container 
-	glGenBuffers(1, &positionVBO);	// generate a VBO and store it in 'positionVBO'
-	glBindBuffer(GL_ARRAY_BUFFER, positionVBO); // bining with array buffer
-	glBufferData(GL_ARRAY_BUFFER, aMeshData.positions.size() * sizeof(Vec3f),
-		aMeshData.positions.data(), GL_STATIC_DRAW); //send the vertex position data to the GPU
-	
-	//Colour Vertex Buffer Object
-	GLuint colorVBO = 0;
-	glGenBuffers(1, &colorVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, colorVBO);
-	glBufferData(GL_ARRAY_BUFFER, aMeshData.colors.size() * sizeof(Vec3f),
-		aMeshData.colors.data(), GL_STATIC_DRAW);
-	//Normal Vertex Buffer Object
-	GLuint normalVBO = 0;
-	glGenBuffers(1, &normalVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, normalVBO);
-	glBufferData(GL_ARRAY_BUFFER, aMeshData.normals.size() * sizeof(Vec3f),
-		aMeshData.normals.data(), GL_STATIC_DRAW);
-
-	// Texture Coordinates vertex buffer objecct 
-	GLuint texCoordVBO = 0;
-	glGenBuffers(1, &texCoordVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, texCoordVBO);
-	glBufferData(GL_ARRAY_BUFFER, aMeshData.texcoords.size() * sizeof(Vec2f),
-		aMeshData.texcoords.data(), GL_STATIC_DRAW);
+	GLuint buffer = 0;
+	glGenBuffers( 1, &buffer );
+	glBindBuffer( aTarget, buffer );
+
+	// Immutable storage (GL 4.4) lets the driver place the data once and
+	// never worry about it being respecified. We request a 4.3 context, so
+	// fall back to glBufferData() if the driver doesn't give us more.
+	if( GLAD_GL_VERSION_4_4 )
+		glBufferStorage( aTarget, GLsizeiptr(aBytes), aData, 0 );
+	else
+		glBufferData( aTarget, GLsizeiptr(aBytes), aData, GL_STATIC_DRAW );
+
+	return buffer;
+}
+
+GLuint create_vao( VertexLayout const& aLayout, void const* aVertices, std::size_t aVertexCount, std::uint32_t const* aIndices, std::size_t aIndexCount )
+{
+	//================== vbo =====================
+	// A single interleaved vertex buffer holds all attributes of a vertex
+	// next to each other, so fetching one vertex touches one cache line
+	// instead of one per attribute stream.
+	GLuint const vertexBO = create_static_buffer( GL_ARRAY_BUFFER, aVertexCount * aLayout.stride, aVertices );
+
 	// ================== vao ====================
 	GLuint vao = 0;
 	glGenVertexArrays(1, &vao);
 	glBindVertexArray(vao);
-	// positionVBO binding 
-	glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
-	glVertexAttribPointer(
-		0, // location = 0 in vertex shader 
-		3, GL_FLOAT, GL_FALSE, // 2 -> how many attributes composed, GL_FlOAT -> attribute type, GL_FALSE -> not normalised 
-		0,	//  indicates that there is no padding between inputs 
-		0	// data starts at oset 0 in the VBO.
-	);
-	glEnableVertexAttribArray(0);
-
-	glBindBuffer(GL_ARRAY_BUFFER, colorVBO);
-	glVertexAttribPointer(
-		1,
-		3, GL_FLOAT, GL_FALSE,
-		0,
-		0
-	);
-	glEnableVertexAttribArray(1);
-
-	glBindBuffer(GL_ARRAY_BUFFER, normalVBO);
-	glVertexAttribPointer(
-		2,
-		3, GL_FLOAT, GL_FALSE,
-		0,
-		0
-	);
-	glEnableVertexAttribArray(2);
-
-	glBindBuffer(GL_ARRAY_BUFFER, texCoordVBO);
-	glVertexAttribPointer(
-		3, // location = 1 in vertex shader 
-		2, GL_FLOAT, GL_FALSE, // 2D, floats, not normalized to 0..1 (GL FALSE) 
-		0, // see above
-		nullptr //see above
-	);
-	glEnableVertexAttribArray(3);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBO);
+	for( std::uint32_t a = 0; a < aLayout.attribCount; ++a )
+	{
+		auto const& attrib = aLayout.attribs[a];
+		glVertexAttribPointer(
+			attrib.location,
+			attrib.components, attrib.type, attrib.normalized,
+			GLsizei(aLayout.stride),
+			reinterpret_cast<void const*>(std::uintptr_t(attrib.offset))
+		);
+		glEnableVertexAttribArray(attrib.location);
+	}
+
+	// Index buffer. The GL_ELEMENT_ARRAY_BUFFER binding is part of the VAO
+	// state, so it must be bound while the VAO is bound.
+	GLuint indexBO = 0;
+	if( aIndexCount )
+		indexBO = create_static_buffer( GL_ELEMENT_ARRAY_BUFFER, aIndexCount * sizeof(std::uint32_t), aIndices );
 
 	// Reset state 
 	glBindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-	// clean up buffers 
-	glDeleteBuffers(1, &positionVBO);
-	glDeleteBuffers(1, &colorVBO);
-	glDeleteBuffers(1, &normalVBO);
-	glDeleteBuffers(1, &texCoordVBO);
+	// clean up buffers (the VAO keeps them alive)
+	glDeleteBuffers(1, &vertexBO);
+	if( indexBO )
+		glDeleteBuffers(1, &indexBO);
 
 	return vao;
 }
 
-  
\ No newline at end of file
+GLuint create_vao( SimpleMeshData const& aMeshData )
+{
+	auto const layout = make_vertex_layout( aMeshData );
+	auto const vertices = interleave_vertices( aMeshData, layout );
+
+	return create_vao( layout, vertices.data(), aMeshData.positions.size(),
+		aMeshData.indices.data(), aMeshData.indices.size() );
+}
@@ -4,6 +4,10 @@
 #include <glad.h>
 
 #include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
 #include "../vmlib/vec2.hpp"
 #include "../vmlib/vec3.hpp"
 
@@ -13,10 +17,62 @@ struct SimpleMeshData
 	std::vector<Vec3f> colors;
 	std::vector<Vec3f> normals;
 	std::vector<Vec2f> texcoords;
+
+	// Optional triangle list indices. When empty, the mesh is a plain
+	// triangle soup (draw with glDrawArrays()). Otherwise, the attribute
+	// arrays hold unique vertices only, and the mesh is drawn with
+	// glDrawElements( GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, ... ).
+	std::vector<std::uint32_t> indices;
 };
 
+// Appends the second mesh to the first. Each call copies the first mesh;
+// use a MeshBuilder (mesh_builder.hpp) to assemble more than a few parts.
 SimpleMeshData concatenate( SimpleMeshData, SimpleMeshData const& );
 
+// Weld identical vertices (same position, color, normal and texture
+// coordinate) of a mesh and return the indexed equivalent. Meshes that are
+// already indexed are welded as well; the result is always indexed.
+SimpleMeshData make_indexed( SimpleMeshData const& );
+
+// Interleaved vertex layout. Describes where each attribute lives inside a
+// single vertex buffer (see create_vao()).
+struct VertexAttrib
+{
+	GLuint location;         // attribute location in the vertex shader
+	GLint components;        // 1..4
+	GLenum type;             // e.g. GL_FLOAT
+	GLboolean normalized;
+	std::uint32_t offset;    // byte offset within a vertex
+};
+
+constexpr std::uint32_t kMaxVertexAttribs = 8;
+
+struct VertexLayout
+{
+	std::uint32_t stride;    // bytes per vertex
+	std::uint32_t attribCount;
+	VertexAttrib attribs[kMaxVertexAttribs];
+};
+
+// Derive an interleaved layout containing the attributes that the mesh
+// actually has (e.g., no texture coordinates -> no texcoord attribute).
+VertexLayout make_vertex_layout( SimpleMeshData const& );
+
+// Pack the attribute arrays of a mesh into a single interleaved buffer
+// according to a layout returned by make_vertex_layout().
+std::vector<std::byte> interleave_vertices( SimpleMeshData const&, VertexLayout const& );
+
+// Create a buffer object with immutable storage (glBufferStorage() where
+// available) initialized with the given data. The buffer is left bound to
+// the target.
+GLuint create_static_buffer( GLenum aTarget, std::size_t aBytes, void const* aData );
+
+// Create a VAO from pre-interleaved vertex data and (optional) indices.
+GLuint create_vao( 
+	VertexLayout const&,
+	void const* aVertices, std::size_t aVertexCount,
+	std::uint32_t const* aIndices = nullptr, std::size_t aIndexCount = 0
+);
 
 GLuint create_vao( SimpleMeshData const& );
 
@@ -1,34 +1,68 @@
 #include "texture.hpp"
 
+#include <string>
+#include <algorithm>
+
+#include <cstdio>
 #include <cassert>
+#include <cstring>
 
 #include <stb_image.h>
 
 #include "../support/error.hpp"
 
-GLuint load_texture_2d( char const* aPath )
+#include "ctex_format.hpp"
+
+ImageRGBA8 load_image_rgba8( char const* aPath )
 {
 	assert(aPath); 
 		
 	// Load image first 
 	// This may fail (e.g., image does not exist), so there's no point in 
 	// allocating OpenGL resources ahead of time. 
-	stbi_set_flip_vertically_on_load(true); 
+	// The flip flag is per-thread, since images may be decoded on worker
+	// threads.
+	stbi_set_flip_vertically_on_load_thread(true); 
 		
 	int w, h, channels; 
 	stbi_uc * ptr = stbi_load(aPath, &w, &h, &channels, 4); 
 	if(!ptr) 
-		throw Error("Unable to load image %s\n", aPath); 
+		throw Error("Unable to load image '%s'\n", aPath); 
+
+	return ImageRGBA8{ w, h, { ptr, &stbi_image_free } };
+}
+
+GLuint create_texture_2d( ImageRGBA8 const& aImage )
+{
+	assert(aImage.pixels);
+
+	// Initialize texture with image
+	GLuint tex = create_texture_storage_2d( aImage.width, aImage.height );
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, aImage.width, aImage.height, GL_RGBA, GL_UNSIGNED_BYTE, aImage.pixels.get());
 	
-	// Generate texture object and initialize texture with image
+	// Generate mipmap hierarchy 
+	glGenerateMipmap(GL_TEXTURE_2D); 	
+		
+	return tex;
+}
+
+GLuint create_texture_storage_2d( GLsizei aWidth, GLsizei aHeight, GLenum aFormat, GLsizei aLevels )
+{
+	assert( aWidth > 0 && aHeight > 0 );
+
+	// Number of levels in a full mipmap chain
+	if( 0 == aLevels )
+	{
+		aLevels = 1;
+		for( auto size = std::max( aWidth, aHeight ); size > 1; size /= 2 )
+			++aLevels;
+	}
+
 	GLuint tex = 0; 
 	glGenTextures(1, &tex); 
 	glBindTexture(GL_TEXTURE_2D, tex); 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, ptr);
-	
-	stbi_image_free(ptr); 
-	// Generate mipmap hierarchy 
-	glGenerateMipmap(GL_TEXTURE_2D); 	
+	glTexStorage2D(GL_TEXTURE_2D, aLevels, aFormat, aWidth, aHeight);
+
 	// Configure texture 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); 
@@ -37,7 +71,106 @@ GLuint load_texture_2d( char const* aPath )
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); 
 		
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY, 6.f); 
-		
+
+	return tex;
+}
+
+GLuint create_placeholder_texture_2d( std::uint8_t aR, std::uint8_t aG, std::uint8_t aB, std::uint8_t aA )
+{
+	std::uint8_t const texel[4] = { aR, aG, aB, aA };
+
+	GLuint tex = create_texture_storage_2d( 1, 1 );
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, texel);
 	return tex;
 }
 
+CompressedImage load_compressed_image( char const* aPath )
+{
+	assert( aPath );
+
+	std::FILE* fin = std::fopen( aPath, "rb" );
+	if( !fin )
+		throw Error( "Unable to open '%s' for reading", aPath );
+
+	std::vector<std::byte> file;
+	{
+		std::byte buffer[64*1024];
+		while( auto const count = std::fread( buffer, 1, sizeof(buffer), fin ) )
+			file.insert( file.end(), buffer, buffer+count );
+
+		auto const err = std::ferror( fin );
+		std::fclose( fin );
+		if( err )
+			throw Error( "Error while reading '%s'", aPath );
+	}
+
+	CtexHeader header;
+	if( file.size() < sizeof(header) )
+		throw Error( "'%s': truncated ctex file", aPath );
+
+	std::memcpy( &header, file.data(), sizeof(header) );
+	if( 0 != std::memcmp( header.magic, kCtexMagic, sizeof(kCtexMagic) ) )
+		throw Error( "'%s': not a ctex file", aPath );
+	if( kCtexVersion != header.version )
+		throw Error( "'%s': unsupported ctex version %u", aPath, unsigned(header.version) );
+	if( 0 == header.levelCount || header.levelCount > 32 || 0 == header.blockBytes )
+		throw Error( "'%s': corrupt ctex header", aPath );
+
+	auto const tableEnd = sizeof(header) + header.levelCount * sizeof(CtexLevel);
+	if( file.size() < tableEnd )
+		throw Error( "'%s': truncated ctex file", aPath );
+
+	CompressedImage ret;
+	ret.format = GLenum(header.glInternalFormat);
+	ret.width = int(header.width);
+	ret.height = int(header.height);
+	ret.blockBytes = header.blockBytes;
+
+	ret.levels.reserve( header.levelCount );
+	for( std::uint32_t i = 0; i < header.levelCount; ++i )
+	{
+		CtexLevel level;
+		std::memcpy( &level, file.data() + sizeof(header) + i*sizeof(CtexLevel), sizeof(level) );
+
+		auto const expected = std::uint64_t((level.width+3)/4) * ((level.height+3)/4) * header.blockBytes;
+		if( level.bytes != expected || level.offset > file.size() || level.bytes > file.size() - level.offset )
+			throw Error( "'%s': corrupt ctex level %u", aPath, unsigned(i) );
+
+		ret.levels.emplace_back( CompressedImage::Level{ 
+			int(level.width), int(level.height), 
+			std::size_t(level.offset), std::size_t(level.bytes)
+		} );
+	}
+
+	ret.data = std::move(file);
+	return ret;
+}
+
+GLuint create_texture_2d( CompressedImage const& aImage )
+{
+	assert( !aImage.levels.empty() );
+
+	GLuint tex = create_texture_storage_2d( aImage.width, aImage.height, aImage.format, GLsizei(aImage.levels.size()) );
+
+	for( std::size_t i = 0; i < aImage.levels.size(); ++i )
+	{
+		auto const& level = aImage.levels[i];
+		glCompressedTexSubImage2D( GL_TEXTURE_2D, GLint(i), 0, 0, level.width, level.height, aImage.format, GLsizei(level.bytes), aImage.data.data() + level.offset );
+	}
+
+	// A file may (legally) contain fewer levels than the full chain.
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(aImage.levels.size()-1));
+
+	return tex;
+}
+
+GLuint load_texture_2d( char const* aPath )
+{
+	assert( aPath );
+
+	std::string const path( aPath );
+	if( path.size() >= 5 && 0 == path.compare( path.size()-5, 5, ".ctex" ) )
+		return create_texture_2d( load_compressed_image( aPath ) );
+
+	return create_texture_2d( load_image_rgba8( aPath ) );
+}
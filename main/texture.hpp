@@ -3,6 +3,63 @@
 
 #include <glad.h>
 
+#include <vector>
+#include <memory>
+
+#include <cstddef>
+#include <cstdint>
+
+// Decoded 8-bit RGBA image, as returned by load_image_rgba8(). Rows are
+// stored bottom-up (i.e., flipped for OpenGL).
+struct ImageRGBA8
+{
+	int width, height;
+	std::unique_ptr<unsigned char, void (*)(void*)> pixels;
+};
+
+// Decode an image file. Does not touch OpenGL and may therefore be called
+// from any thread.
+ImageRGBA8 load_image_rgba8( char const* aPath );
+
+// Create an sRGB texture with a full mipmap chain from a decoded image.
+GLuint create_texture_2d( ImageRGBA8 const& );
+
+// Block-compressed image with a precomputed mipmap chain, as stored in a
+// .ctex file (see ctex_format.hpp). Produced offline by texconv.
+struct CompressedImage
+{
+	struct Level
+	{
+		int width, height;
+		std::size_t offset, bytes; // into data
+	};
+
+	GLenum format; // e.g. GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+	int width, height;
+	std::size_t blockBytes;
+
+	std::vector<Level> levels;
+	std::vector<std::byte> data;
+};
+
+// Read a .ctex file. Does not touch OpenGL, and may be called from any
+// thread.
+CompressedImage load_compressed_image( char const* aPath );
+
+// Create a texture from a compressed image. The stored mipmap chain is
+// uploaded as-is (no decoding, no glGenerateMipmap).
+GLuint create_texture_2d( CompressedImage const& );
+
+// Allocate immutable storage for a texture (glTexStorage2D), and set the default sampling parameters. The contents
+// are left undefined. aLevels == 0 selects a full mipmap chain. The texture remains bound to GL_TEXTURE_2D.
+GLuint create_texture_storage_2d( GLsizei aWidth, GLsizei aHeight, GLenum aFormat = GL_SRGB8_ALPHA8, GLsizei aLevels = 0 );
+
+// Create a 1x1 texture with the given (sRGB) color. Useful as a stand-in
+// while the real texture is still loading.
+GLuint create_placeholder_texture_2d( std::uint8_t aR, std::uint8_t aG, std::uint8_t aB, std::uint8_t aA = 255 );
+
+// Shorthand for create_texture_2d( load_image_rgba8( aPath ) ), or
+// create_texture_2d( load_compressed_image( aPath ) ) for .ctex files.
 GLuint load_texture_2d( char const* aPath );
 
 #endif // TEXTURE_HPP_D0746DED_C9C6_40CD_B6E0_C6FEF665DD31
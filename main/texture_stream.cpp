@@ -0,0 +1,326 @@
+#include "texture_stream.hpp"
+
+#include <chrono>
+#include <exception>
+#include <algorithm>
+
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+
+#include "../support/error.hpp"
+
+TextureStreamer::TextureStreamer( std::size_t aSegmentBytes, std::size_t aSegmentCount, std::size_t aBytesPerFrame )
+	: mBuffer( 0 )
+	, mMapped( nullptr )
+	, mSegmentBytes( aSegmentBytes )
+	, mBytesPerFrame( aBytesPerFrame )
+	, mNextSegment( 0 )
+	, mSegments( aSegmentCount, Segment_{ nullptr } )
+{
+	assert( aSegmentBytes > 0 && aSegmentCount > 0 );
+
+	auto const bytes = GLsizeiptr(aSegmentBytes * aSegmentCount);
+
+	glGenBuffers( 1, &mBuffer );
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, mBuffer );
+
+	// With GL 4.4 (or ARB_buffer_storage), keep the staging buffer mapped
+	// for its entire lifetime. Otherwise, each band is mapped individually
+	// (unsynchronized; the fences take care of synchronization).
+	if( GLAD_GL_VERSION_4_4 )
+	{
+		GLbitfield const flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage( GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, flags );
+		mMapped = static_cast<std::byte*>(glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, bytes, flags ));
+		if( !mMapped )
+			throw Error( "Unable to persistently map texture staging buffer (%zu bytes)", std::size_t(bytes) );
+	}
+	else
+	{
+		glBufferData( GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW );
+	}
+
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	for( auto& pending : mPending )
+	{
+		if( pending.texture )
+			glDeleteTextures( 1, &pending.texture );
+	}
+
+	// Placeholders may be shared; delete each texture once.
+	std::vector<GLuint> textures;
+	for( auto const& entry : mEntries )
+	{
+		textures.emplace_back( entry.placeholder );
+		if( entry.ready )
+			textures.emplace_back( entry.current );
+	}
+
+	std::sort( textures.begin(), textures.end() );
+	textures.erase( std::unique( textures.begin(), textures.end() ), textures.end() );
+	textures.erase( std::remove( textures.begin(), textures.end(), GLuint(0) ), textures.end() );
+
+	if( !textures.empty() )
+		glDeleteTextures( GLsizei(textures.size()), textures.data() );
+
+	for( auto& segment : mSegments )
+	{
+		if( segment.fence )
+			glDeleteSync( segment.fence );
+	}
+
+	if( mMapped )
+	{
+		glBindBuffer( GL_PIXEL_UNPACK_BUFFER, mBuffer );
+		glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER );
+		glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+	}
+
+	glDeleteBuffers( 1, &mBuffer );
+}
+
+TextureStreamer::Handle TextureStreamer::request( std::future<ImageRGBA8> aImage, GLuint aPlaceholder )
+{
+	Handle const handle = mEntries.size();
+	mEntries.emplace_back( Entry_{ aPlaceholder, aPlaceholder, false } );
+
+	Pending_ pending;
+	pending.handle = handle;
+	pending.future = std::move(aImage);
+	mPending.emplace_back( std::move(pending) );
+
+	return handle;
+}
+TextureStreamer::Handle TextureStreamer::request( std::future<CompressedImage> aImage, GLuint aPlaceholder )
+{
+	Handle const handle = mEntries.size();
+	mEntries.emplace_back( Entry_{ aPlaceholder, aPlaceholder, false } );
+
+	Pending_ pending;
+	pending.handle = handle;
+	pending.compressedFuture = std::move(aImage);
+	pending.isCompressed = true;
+	mPending.emplace_back( std::move(pending) );
+
+	return handle;
+}
+
+void TextureStreamer::update()
+{
+	std::size_t uploaded = 0;
+
+	for( auto it = mPending.begin(); it != mPending.end() && uploaded < mBytesPerFrame; )
+	{
+		auto& pending = *it;
+
+		// Not yet started? Check if the image has been decoded.
+		if( !pending.texture )
+		{
+			auto const status = pending.isCompressed
+				? pending.compressedFuture.wait_for( std::chrono::seconds(0) )
+				: pending.future.wait_for( std::chrono::seconds(0) )
+			;
+
+			if( std::future_status::ready != status )
+			{
+				++it;
+				continue;
+			}
+
+			if( !start_( pending ) )
+			{
+				it = mPending.erase( it );
+				continue;
+			}
+		}
+
+		// Upload bands until the image is complete, the budget for this frame
+		// is exhausted, or no staging segment is free.
+		while( pending.level < pending.levelCount && uploaded < mBytesPerFrame )
+		{
+			auto const bytes = upload_band_( pending );
+			if( 0 == bytes )
+				return; // no free segment; try again next frame
+
+			uploaded += bytes;
+
+			if( pending.nextRow == rows_( pending ).rowCount )
+			{
+				++pending.level;
+				pending.nextRow = 0;
+			}
+		}
+
+		if( pending.level < pending.levelCount )
+			break;
+
+		// All data submitted. Since GL commands execute in order, the texture
+		// can be used right away.
+		if( !pending.isCompressed )
+		{
+			// Mipmaps are generated on the GPU.
+			glBindTexture( GL_TEXTURE_2D, pending.texture );
+			glGenerateMipmap( GL_TEXTURE_2D );
+		}
+
+		auto& entry = mEntries[pending.handle];
+		entry.current = pending.texture;
+		entry.ready = true;
+
+		it = mPending.erase( it );
+	}
+}
+
+GLuint TextureStreamer::texture( Handle aHandle ) const noexcept
+{
+	assert( aHandle < mEntries.size() );
+	return mEntries[aHandle].current;
+}
+bool TextureStreamer::ready( Handle aHandle ) const noexcept
+{
+	assert( aHandle < mEntries.size() );
+	return mEntries[aHandle].ready;
+}
+
+bool TextureStreamer::idle() const noexcept
+{
+	return mPending.empty();
+}
+
+bool TextureStreamer::start_( Pending_& aPending )
+{
+	try
+	{
+		if( aPending.isCompressed )
+		{
+			aPending.compressed = aPending.compressedFuture.get();
+			aPending.levelCount = aPending.compressed.levels.size();
+		}
+		else
+		{
+			aPending.image = aPending.future.get();
+			aPending.levelCount = 1;
+		}
+
+		for( aPending.level = 0; aPending.level < aPending.levelCount; ++aPending.level )
+		{
+			auto const rowBytes = rows_( aPending ).rowBytes;
+			if( rowBytes > mSegmentBytes )
+				throw Error( "Image row (%zu bytes) exceeds staging segment size (%zu bytes)", rowBytes, mSegmentBytes );
+		}
+		aPending.level = 0;
+	}
+	catch( std::exception const& eErr )
+	{
+		// Not fatal. Keep using the placeholder.
+		std::fprintf( stderr, "Texture streaming failed: %s\n", eErr.what() );
+		return false;
+	}
+
+	if( aPending.isCompressed )
+	{
+		auto const& image = aPending.compressed;
+		aPending.texture = create_texture_storage_2d( image.width, image.height, image.format, GLsizei(image.levels.size()) );
+		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(image.levels.size()-1) );
+	}
+	else
+	{
+		aPending.texture = create_texture_storage_2d( aPending.image.width, aPending.image.height );
+	}
+
+	return true;
+}
+
+TextureStreamer::Rows_ TextureStreamer::rows_( Pending_ const& aPending )
+{
+	if( aPending.isCompressed )
+	{
+		// Compressed data is uploaded in rows of 4x4 blocks.
+		auto const& image = aPending.compressed;
+		auto const& level = image.levels[aPending.level];
+
+		return Rows_{
+			image.data.data() + level.offset,
+			std::size_t((level.width+3)/4) * image.blockBytes,
+			std::size_t((level.height+3)/4)
+		};
+	}
+
+	auto const& image = aPending.image;
+	return Rows_{
+		reinterpret_cast<std::byte const*>(image.pixels.get()),
+		std::size_t(image.width) * 4,
+		std::size_t(image.height)
+	};
+}
+
+std::size_t TextureStreamer::upload_band_( Pending_& aPending )
+{
+	auto& segment = mSegments[mNextSegment];
+
+	// Is the GPU still reading from this segment? Never wait for it.
+	if( segment.fence )
+	{
+		auto const res = glClientWaitSync( segment.fence, 0, 0 );
+		if( GL_TIMEOUT_EXPIRED == res )
+			return 0;
+
+		glDeleteSync( segment.fence );
+		segment.fence = nullptr;
+	}
+
+	auto const source = rows_( aPending );
+	auto const rows = std::min( source.rowCount - aPending.nextRow, mSegmentBytes / source.rowBytes );
+	auto const bytes = rows * source.rowBytes;
+	auto const offset = mNextSegment * mSegmentBytes;
+
+	auto const* src = source.data + aPending.nextRow * source.rowBytes;
+
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, mBuffer );
+
+	if( mMapped )
+	{
+		std::memcpy( mMapped + offset, src, bytes );
+	}
+	else
+	{
+		GLbitfield const flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+		auto* dst = glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, GLintptr(offset), GLsizeiptr(bytes), flags );
+		if( !dst )
+			throw Error( "Unable to map texture staging buffer" );
+
+		std::memcpy( dst, src, bytes );
+		glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER );
+	}
+
+	glBindTexture( GL_TEXTURE_2D, aPending.texture );
+
+	auto const* pboOffset = reinterpret_cast<void const*>(offset);
+	if( aPending.isCompressed )
+	{
+		auto const& image = aPending.compressed;
+		auto const& level = image.levels[aPending.level];
+
+		// The last band may end in a partial row of blocks.
+		auto const y = GLint(aPending.nextRow * 4);
+		auto const h = std::min( GLint(rows * 4), level.height - y );
+		glCompressedTexSubImage2D( GL_TEXTURE_2D, GLint(aPending.level), 0, y, level.width, h, image.format, GLsizei(bytes), pboOffset );
+	}
+	else
+	{
+		glTexSubImage2D( GL_TEXTURE_2D, 0, 0, GLint(aPending.nextRow), aPending.image.width, GLsizei(rows), GL_RGBA, GL_UNSIGNED_BYTE, pboOffset );
+	}
+
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+
+	segment.fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	mNextSegment = (mNextSegment+1) % mSegments.size();
+
+	aPending.nextRow += rows;
+	return bytes;
+}
@@ -0,0 +1,120 @@
+#ifndef TEXTURE_STREAM_HPP_3E9C1B74_2A6D_4F0E_9B58_71D4C0A6E2F3
+#define TEXTURE_STREAM_HPP_3E9C1B74_2A6D_4F0E_9B58_71D4C0A6E2F3
+
+#include <glad.h>
+
+#include <deque>
+#include <future>
+#include <vector>
+
+#include <cstddef>
+
+#include "texture.hpp"
+
+/* TextureStreamer: uploads textures in the background, without stalling the
+ * render loop.
+ *
+ * Images are decoded elsewhere (typically as a ThreadPool job) and handed
+ * over as a std::future. Once an image has been decoded, update() copies it
+ * band-by-band into a staging pixel buffer object (PBO) and issues
+ * glTexSubImage2D() from the PBO. Compressed images are streamed in the
+ * same way, level by level, using glCompressedTexSubImage2D(). At most aBytesPerFrame bytes are copied
+ * per call to update(). The staging buffer is split into segments, each
+ * protected by a fence; a segment is only reused once the GPU has finished
+ * reading from it, and update() never waits for this.
+ *
+ * Until all of its data has been uploaded (and its mipmaps generated),
+ * texture() returns the placeholder texture given to request(). The
+ * streamer owns both the placeholders and the streamed textures, and deletes
+ * them when it is destroyed. A placeholder may be shared between requests.
+ *
+ * Must only be used on the thread that owns the OpenGL context.
+ */
+class TextureStreamer final
+{
+	public:
+		using Handle = std::size_t;
+
+	public:
+		explicit TextureStreamer(
+			std::size_t aSegmentBytes = 4*1024*1024,
+			std::size_t aSegmentCount = 3,
+			std::size_t aBytesPerFrame = 8*1024*1024
+		);
+		~TextureStreamer();
+
+		TextureStreamer( TextureStreamer const& ) = delete;
+		TextureStreamer& operator= (TextureStreamer const&) = delete;
+
+	public:
+		Handle request( std::future<ImageRGBA8> aImage, GLuint aPlaceholder );
+		Handle request( std::future<CompressedImage> aImage, GLuint aPlaceholder );
+
+		// Advance pending uploads. Call once per frame.
+		void update();
+
+		GLuint texture( Handle ) const noexcept;
+		bool ready( Handle ) const noexcept;
+
+		// True when no uploads are pending.
+		bool idle() const noexcept;
+
+	private:
+		struct Entry_
+		{
+			GLuint current;
+			GLuint placeholder;
+			bool ready;
+		};
+
+		struct Pending_
+		{
+			Handle handle;
+
+			// Exactly one of the futures is valid().
+			std::future<ImageRGBA8> future;
+			std::future<CompressedImage> compressedFuture;
+
+			ImageRGBA8 image{ 0, 0, { nullptr, nullptr } };
+			CompressedImage compressed{};
+			bool isCompressed = false;
+
+			GLuint texture = 0;
+			std::size_t levelCount = 0;
+			std::size_t level = 0;
+			std::size_t nextRow = 0; // texel rows, or rows of blocks
+		};
+
+		// One level of a pending image, as a sequence of rows
+		struct Rows_
+		{
+			std::byte const* data;
+			std::size_t rowBytes;
+			std::size_t rowCount;
+		};
+
+		struct Segment_
+		{
+			GLsync fence;
+		};
+
+		bool start_( Pending_& );
+		static Rows_ rows_( Pending_ const& );
+
+		// Returns the number of bytes staged, or zero if no segment is free.
+		std::size_t upload_band_( Pending_& );
+
+	private:
+		GLuint mBuffer;
+		std::byte* mMapped; // Non-null if persistently mapped
+
+		std::size_t mSegmentBytes;
+		std::size_t mBytesPerFrame;
+		std::size_t mNextSegment;
+		std::vector<Segment_> mSegments;
+
+		std::vector<Entry_> mEntries;
+		std::deque<Pending_> mPending;
+};
+
+#endif // TEXTURE_STREAM_HPP_3E9C1B74_2A6D_4F0E_9B58_71D4C0A6E2F3
@@ -0,0 +1,535 @@
+#include "virtual_texture.hpp"
+
+#include <chrono>
+#include <limits>
+#include <utility>
+#include <exception>
+#include <algorithm>
+#include <unordered_set>
+
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+
+#include "../support/error.hpp"
+
+namespace
+{
+	// The feedback pass renders at 1/kFeedbackScale_ of the framebuffer
+	// resolution (in each direction).
+	constexpr int kFeedbackScale_ = 8;
+	constexpr float kFeedbackBias_ = -3.f; // -log2(kFeedbackScale_)
+
+	constexpr std::size_t kMaxLoadsInFlight_ = 32;
+	constexpr std::size_t kMaxUploadsPerFrame_ = 16;
+
+	constexpr std::uint64_t kNoTile_ = std::numeric_limits<std::uint64_t>::max();
+	constexpr std::uint64_t kPinned_ = std::numeric_limits<std::uint64_t>::max();
+
+	std::uint64_t make_key_( std::uint32_t aLevel, std::uint32_t aX, std::uint32_t aY )
+	{
+		return (std::uint64_t(aLevel) << 48) | (std::uint64_t(aY) << 24) | aX;
+	}
+
+	std::uint32_t key_level_( std::uint64_t aKey ) { return std::uint32_t(aKey >> 48); }
+	std::uint32_t key_y_( std::uint64_t aKey ) { return std::uint32_t(aKey >> 24) & 0xffffffu; }
+	std::uint32_t key_x_( std::uint64_t aKey ) { return std::uint32_t(aKey) & 0xffffffu; }
+
+	std::uint64_t parent_key_( std::uint64_t aKey )
+	{
+		return make_key_( key_level_( aKey )+1, key_x_( aKey )/2, key_y_( aKey )/2 );
+	}
+
+	int next_power_of_two_( std::uint32_t aValue )
+	{
+		int ret = 1;
+		while( std::uint32_t(ret) < aValue )
+			ret *= 2;
+		return ret;
+	}
+
+	void fseek_( std::FILE* aFile, std::uint64_t aOffset )
+	{
+#		if defined(_WIN32)
+		auto const ret = _fseeki64( aFile, __int64(aOffset), SEEK_SET );
+#		else
+		auto const ret = fseeko( aFile, off_t(aOffset), SEEK_SET );
+#		endif
+		if( 0 != ret )
+			throw Error( "fseek() to %llu failed", static_cast<unsigned long long>(aOffset) );
+	}
+
+	void fread_( void* aPtr, std::size_t aBytes, std::FILE* aFile, char const* aPath )
+	{
+		if( aBytes && 1 != std::fread( aPtr, aBytes, 1, aFile ) )
+			throw Error( "'%s': unexpected end of file or read error", aPath );
+	}
+}
+
+VirtualTexture::VirtualTexture( char const* aPath, ThreadPool& aPool, unsigned aAtlasTiles )
+	: mPath( aPath )
+	, mPool( &aPool )
+	, mAtlasTiles( aAtlasTiles )
+	, mAtlas( 0 )
+	, mIndirection( 0 )
+	, mIndirectionDirty( true )
+	, mFrame( 0 )
+	, mFeedbackWidth( 0 )
+	, mFeedbackHeight( 0 )
+	, mFeedbackFbo( 0 )
+	, mFeedbackColor( 0 )
+	, mFeedbackDepth( 0 )
+	, mReadback{}
+	, mReadbackNext( 0 )
+	, mStats{}
+{
+	assert( aAtlasTiles > 0 && aAtlasTiles <= 256 );
+
+	// Read header and level table
+	{
+		std::FILE* fin = std::fopen( aPath, "rb" );
+		if( !fin )
+			throw Error( "Unable to open '%s' for reading", aPath );
+
+		try
+		{
+			fread_( &mHeader, sizeof(mHeader), fin, aPath );
+			if( 0 != std::memcmp( mHeader.magic, kVtexMagic, sizeof(kVtexMagic) ) )
+				throw Error( "'%s': not a vtex file", aPath );
+			if( kVtexVersion != mHeader.version )
+				throw Error( "'%s': unsupported vtex version %u", aPath, unsigned(mHeader.version) );
+			if( 0 == mHeader.levelCount || mHeader.levelCount > 24 || 0 == mHeader.tileSize || 0 != (mHeader.tileSize + 2*mHeader.tileBorder) % 4 )
+				throw Error( "'%s': corrupt vtex header", aPath );
+
+			mLevels.resize( mHeader.levelCount );
+			fread_( mLevels.data(), mLevels.size() * sizeof(VtexLevel), fin, aPath );
+		}
+		catch( ... )
+		{
+			std::fclose( fin );
+			throw;
+		}
+
+		std::fclose( fin );
+	}
+
+	mPaddedTile = int(mHeader.tileSize + 2*mHeader.tileBorder);
+
+	auto const expectedTileBytes = std::uint64_t(mPaddedTile/4) * (mPaddedTile/4) * mHeader.blockBytes;
+	if( mHeader.tileBytes != expectedTileBytes || 1 != mLevels.back().tilesX || 1 != mLevels.back().tilesY )
+		throw Error( "'%s': corrupt vtex header", aPath );
+
+	// Indirection texture: one texel per tile of level 0, rounded up to a
+	// power of two, such that each level of tiles fits into the matching
+	// mipmap level.
+	mIndirectionWidth = next_power_of_two_( mLevels.front().tilesX );
+	mIndirectionHeight = next_power_of_two_( mLevels.front().tilesY );
+
+	for( std::size_t i = 0; i < mLevels.size(); ++i )
+	{
+		auto const iw = std::max( 1, mIndirectionWidth >> i );
+		auto const ih = std::max( 1, mIndirectionHeight >> i );
+		if( int(mLevels[i].tilesX) > iw || int(mLevels[i].tilesY) > ih )
+			throw Error( "'%s': level %zu has too many tiles (%ux%u)", aPath, i, mLevels[i].tilesX, mLevels[i].tilesY );
+		if( std::max( mIndirectionWidth, mIndirectionHeight ) >> i == 0 )
+			throw Error( "'%s': too many levels", aPath );
+	}
+
+	glGenTextures( 1, &mIndirection );
+	glBindTexture( GL_TEXTURE_2D, mIndirection );
+	glTexStorage2D( GL_TEXTURE_2D, GLsizei(mLevels.size()), GL_RGBA8UI, mIndirectionWidth, mIndirectionHeight );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+
+	// Physical atlas. Tiles carry their own borders, so plain bilinear
+	// filtering works across tile edges; there are no mipmaps.
+	auto const atlasSize = GLsizei(mAtlasTiles * mPaddedTile);
+
+	glGenTextures( 1, &mAtlas );
+	glBindTexture( GL_TEXTURE_2D, mAtlas );
+	glTexStorage2D( GL_TEXTURE_2D, 1, GLenum(mHeader.glInternalFormat), atlasSize, atlasSize );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+	mSlots.assign( std::size_t(mAtlasTiles) * mAtlasTiles, Slot_{ kNoTile_, 0 } );
+
+	// The coarsest level is loaded right away, and never evicted.
+	auto const rootKey = make_key_( mHeader.levelCount-1, 0, 0 );
+	if( !upload_( rootKey, read_tile_( rootKey ) ) )
+		throw Error( "'%s': unable to upload the root tile", aPath );
+	mSlots[mResident.at( rootKey )].lastUsed = kPinned_;
+
+	// Feedback readback buffers
+	for( auto& readback : mReadback )
+		glGenBuffers( 1, &readback.buffer );
+
+	glGenFramebuffers( 1, &mFeedbackFbo );
+	glGenRenderbuffers( 1, &mFeedbackColor );
+	glGenRenderbuffers( 1, &mFeedbackDepth );
+
+	update_indirection_();
+}
+
+VirtualTexture::~VirtualTexture()
+{
+	// Loading jobs reference this object.
+	for( auto& loading : mLoading )
+		loading.second.wait();
+
+	for( auto& readback : mReadback )
+	{
+		if( readback.fence )
+			glDeleteSync( readback.fence );
+		glDeleteBuffers( 1, &readback.buffer );
+	}
+
+	glDeleteFramebuffers( 1, &mFeedbackFbo );
+	glDeleteRenderbuffers( 1, &mFeedbackColor );
+	glDeleteRenderbuffers( 1, &mFeedbackDepth );
+
+	glDeleteTextures( 1, &mAtlas );
+	glDeleteTextures( 1, &mIndirection );
+}
+
+void VirtualTexture::begin_feedback( int aFramebufferWidth, int aFramebufferHeight )
+{
+	auto const width = std::max( 1, aFramebufferWidth / kFeedbackScale_ );
+	auto const height = std::max( 1, aFramebufferHeight / kFeedbackScale_ );
+
+	if( width != mFeedbackWidth || height != mFeedbackHeight )
+	{
+		glBindRenderbuffer( GL_RENDERBUFFER, mFeedbackColor );
+		glRenderbufferStorage( GL_RENDERBUFFER, GL_RGBA16UI, width, height );
+		glBindRenderbuffer( GL_RENDERBUFFER, mFeedbackDepth );
+		glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height );
+		glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+
+		glBindFramebuffer( GL_FRAMEBUFFER, mFeedbackFbo );
+		glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mFeedbackColor );
+		glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mFeedbackDepth );
+
+		if( auto const status = glCheckFramebufferStatus( GL_FRAMEBUFFER ); GL_FRAMEBUFFER_COMPLETE != status )
+			throw Error( "Virtual texture feedback framebuffer incomplete (%x)", unsigned(status) );
+
+		mFeedbackWidth = width;
+		mFeedbackHeight = height;
+	}
+
+	glBindFramebuffer( GL_FRAMEBUFFER, mFeedbackFbo );
+	glViewport( 0, 0, width, height );
+
+	// Alpha = 0 marks pixels that don't sample the virtual texture.
+	GLuint const clear[4] = { 0, 0, 0, 0 };
+	glClearBufferuiv( GL_COLOR, 0, clear );
+	glClear( GL_DEPTH_BUFFER_BIT );
+}
+
+void VirtualTexture::end_feedback()
+{
+	// Queue an asynchronous readback, unless the results of the previous
+	// readback into this buffer haven't been processed yet. In that case,
+	// this frame's feedback is simply dropped.
+	auto& readback = mReadback[mReadbackNext];
+	if( !readback.fence )
+	{
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, readback.buffer );
+		if( readback.width != mFeedbackWidth || readback.height != mFeedbackHeight )
+		{
+			auto const bytes = GLsizeiptr(mFeedbackWidth) * mFeedbackHeight * 4 * sizeof(std::uint16_t);
+			glBufferData( GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ );
+		}
+
+		glReadPixels( 0, 0, mFeedbackWidth, mFeedbackHeight, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, nullptr );
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+		readback.fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+		readback.width = mFeedbackWidth;
+		readback.height = mFeedbackHeight;
+
+		mReadbackNext = (mReadbackNext+1) % 2;
+	}
+
+	glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+}
+
+void VirtualTexture::update()
+{
+	// Process readbacks that have completed (oldest first). Never wait.
+	for( unsigned i = 0; i < 2; ++i )
+	{
+		auto& readback = mReadback[(mReadbackNext+i) % 2];
+		if( !readback.fence )
+			continue;
+
+		if( GL_TIMEOUT_EXPIRED == glClientWaitSync( readback.fence, 0, 0 ) )
+			continue;
+
+		glDeleteSync( readback.fence );
+		readback.fence = nullptr;
+
+		auto const count = std::size_t(readback.width) * readback.height;
+
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, readback.buffer );
+		auto const* texels = static_cast<std::uint16_t const*>(glMapBufferRange( GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(count * 4 * sizeof(std::uint16_t)), GL_MAP_READ_BIT ));
+		if( texels )
+		{
+			process_feedback_( texels, count );
+			glUnmapBuffer( GL_PIXEL_PACK_BUFFER );
+		}
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+	}
+
+	// Upload tiles that have finished loading
+	std::size_t uploads = 0;
+	for( auto it = mLoading.begin(); it != mLoading.end() && uploads < kMaxUploadsPerFrame_; )
+	{
+		if( std::future_status::ready != it->second.wait_for( std::chrono::seconds(0) ) )
+		{
+			++it;
+			continue;
+		}
+
+		bool full = false;
+		try
+		{
+			full = !upload_( it->first, it->second.get() );
+		}
+		catch( std::exception const& eErr )
+		{
+			// Not fatal. A coarser tile is used instead, and the tile will be
+			// requested again if it is still visible.
+			std::fprintf( stderr, "Virtual texture: %s\n", eErr.what() );
+		}
+
+		it = mLoading.erase( it );
+
+		// The atlas is full of tiles that the latest feedback needs. The tile
+		// stays non-resident, and is requested again if it is still visible.
+		// Other tiles wouldn't fit either.
+		if( full )
+			break;
+
+		++uploads;
+	}
+
+	if( mIndirectionDirty )
+		update_indirection_();
+
+	mStats.resident = mResident.size();
+	mStats.loading = mLoading.size();
+}
+
+void VirtualTexture::bind() const
+{
+	glActiveTexture( GL_TEXTURE0 + kVtIndirectionUnit );
+	glBindTexture( GL_TEXTURE_2D, mIndirection );
+	glActiveTexture( GL_TEXTURE0 + kVtAtlasUnit );
+	glBindTexture( GL_TEXTURE_2D, mAtlas );
+	glActiveTexture( GL_TEXTURE0 );
+
+	auto const atlasSize = float(mAtlasTiles * mPaddedTile);
+
+	glUniform1i( kVtEnabledLocation, 1 );
+	glUniform4f( kVtSizeLocation, float(mHeader.width), float(mHeader.height), float(mHeader.tileSize), float(mHeader.tileBorder) );
+	glUniform2f( kVtAtlasSizeLocation, atlasSize, atlasSize );
+	glUniform1f( kVtMaxLevelLocation, float(mHeader.levelCount-1) );
+}
+
+void VirtualTexture::bind_feedback() const
+{
+	glUniform4f( kVtSizeLocation, float(mHeader.width), float(mHeader.height), float(mHeader.tileSize), float(mHeader.tileBorder) );
+	glUniform1f( kVtMaxLevelLocation, float(mHeader.levelCount-1) );
+	glUniform1f( kVtFeedbackBiasLocation, kFeedbackBias_ );
+}
+
+VirtualTexture::Stats const& VirtualTexture::stats() const noexcept
+{
+	return mStats;
+}
+
+void VirtualTexture::process_feedback_( std::uint16_t const* aTexels, std::size_t aCount )
+{
+	++mFrame;
+
+	// Unique tiles referenced by the feedback
+	std::vector<std::uint64_t> keys;
+	for( std::size_t i = 0; i < aCount; ++i )
+	{
+		auto const* texel = aTexels + i*4;
+		if( 0 == texel[3] )
+			continue;
+
+		auto const level = std::uint32_t(texel[2]);
+		if( level >= mLevels.size() || texel[0] >= mLevels[level].tilesX || texel[1] >= mLevels[level].tilesY )
+			continue;
+
+		keys.emplace_back( make_key_( level, texel[0], texel[1] ) );
+	}
+
+	std::sort( keys.begin(), keys.end() );
+	keys.erase( std::unique( keys.begin(), keys.end() ), keys.end() );
+
+	// Mark visible tiles, and their ancestors (which are used as fallbacks
+	// while a tile is loading), as used. Collect missing tiles.
+	std::unordered_set<std::uint64_t> visited;
+	std::vector<std::uint64_t> missing;
+	for( auto key : keys )
+	{
+		for( ; key_level_( key ) < mLevels.size(); key = parent_key_( key ) )
+		{
+			if( !visited.insert( key ).second )
+				break; // ancestors have been handled already
+
+			if( auto const it = mResident.find( key ); mResident.end() != it )
+			{
+				auto& slot = mSlots[it->second];
+				if( kPinned_ != slot.lastUsed )
+					slot.lastUsed = mFrame;
+			}
+			else if( !mLoading.count( key ) )
+			{
+				missing.emplace_back( key );
+			}
+		}
+	}
+
+	// Request missing tiles, coarse levels first
+	std::sort( missing.begin(), missing.end(), [] (std::uint64_t aA, std::uint64_t aB) {
+		return key_level_( aA ) > key_level_( aB );
+	} );
+
+	for( auto const key : missing )
+	{
+		if( mLoading.size() >= kMaxLoadsInFlight_ )
+			break;
+
+		mLoading.emplace( key, mPool->submit( [this, key] { return read_tile_( key ); } ) );
+	}
+}
+
+bool VirtualTexture::upload_( std::uint64_t aKey, std::vector<std::byte> const& aData )
+{
+	assert( aData.size() == mHeader.tileBytes );
+
+	// Find a free slot, or the least recently used one that wasn't needed by
+	// the latest feedback.
+	std::size_t best = mSlots.size();
+	for( std::size_t i = 0; i < mSlots.size(); ++i )
+	{
+		auto const& slot = mSlots[i];
+		if( kNoTile_ == slot.key )
+		{
+			best = i;
+			break;
+		}
+
+		if( slot.lastUsed < mFrame && (mSlots.size() == best || slot.lastUsed < mSlots[best].lastUsed) )
+			best = i;
+	}
+
+	if( mSlots.size() == best )
+		return false; // Atlas is full of visible tiles.
+
+	auto& slot = mSlots[best];
+	if( kNoTile_ != slot.key )
+	{
+		mResident.erase( slot.key );
+		++mStats.evicted;
+	}
+
+	slot.key = aKey;
+	slot.lastUsed = mFrame;
+	mResident[aKey] = std::uint32_t(best);
+
+	auto const x = GLint(best % mAtlasTiles) * mPaddedTile;
+	auto const y = GLint(best / mAtlasTiles) * mPaddedTile;
+
+	glBindTexture( GL_TEXTURE_2D, mAtlas );
+	glCompressedTexSubImage2D( GL_TEXTURE_2D, 0, x, y, mPaddedTile, mPaddedTile, GLenum(mHeader.glInternalFormat), GLsizei(aData.size()), aData.data() );
+
+	++mStats.uploaded;
+	mIndirectionDirty = true;
+	return true;
+}
+
+void VirtualTexture::update_indirection_()
+{
+	// Each entry holds the atlas position (x, y) and level of the finest
+	// resident tile that covers the entry's tile. Build from the coarsest
+	// level down, so that non-resident tiles can inherit their parent's entry.
+	std::vector<std::uint8_t> parent, current;
+	int parentWidth = 0, parentHeight = 0;
+
+	glBindTexture( GL_TEXTURE_2D, mIndirection );
+
+	for( auto level = int(mLevels.size())-1; level >= 0; --level )
+	{
+		auto const width = std::max( 1, mIndirectionWidth >> level );
+		auto const height = std::max( 1, mIndirectionHeight >> level );
+		auto const& info = mLevels[level];
+
+		current.assign( std::size_t(width) * height * 4, 0 );
+		for( int y = 0; y < height; ++y )
+		{
+			for( int x = 0; x < width; ++x )
+			{
+				auto* entry = current.data() + (std::size_t(y)*width + x) * 4;
+
+				auto it = mResident.end();
+				if( std::uint32_t(x) < info.tilesX && std::uint32_t(y) < info.tilesY )
+					it = mResident.find( make_key_( std::uint32_t(level), std::uint32_t(x), std::uint32_t(y) ) );
+
+				if( mResident.end() != it )
+				{
+					entry[0] = std::uint8_t(it->second % mAtlasTiles);
+					entry[1] = std::uint8_t(it->second / mAtlasTiles);
+					entry[2] = std::uint8_t(level);
+					entry[3] = 255;
+				}
+				else
+				{
+					// The root tile is always resident, so there is a parent.
+					assert( !parent.empty() );
+					auto const px = std::min( x/2, parentWidth-1 );
+					auto const py = std::min( y/2, parentHeight-1 );
+					std::memcpy( entry, parent.data() + (std::size_t(py)*parentWidth + px) * 4, 4 );
+				}
+			}
+		}
+
+		glTexSubImage2D( GL_TEXTURE_2D, level, 0, 0, width, height, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, current.data() );
+
+		std::swap( parent, current );
+		parentWidth = width;
+		parentHeight = height;
+	}
+
+	mIndirectionDirty = false;
+}
+
+std::vector<std::byte> VirtualTexture::read_tile_( std::uint64_t aKey ) const
+{
+	auto const& level = mLevels[key_level_( aKey )];
+	auto const index = std::uint64_t(key_y_( aKey )) * level.tilesX + key_x_( aKey );
+
+	std::FILE* fin = std::fopen( mPath.c_str(), "rb" );
+	if( !fin )
+		throw Error( "Unable to open '%s' for reading", mPath.c_str() );
+
+	std::vector<std::byte> ret( mHeader.tileBytes );
+	try
+	{
+		fseek_( fin, level.offset + index * mHeader.tileBytes );
+		fread_( ret.data(), ret.size(), fin, mPath.c_str() );
+	}
+	catch( ... )
+	{
+		std::fclose( fin );
+		throw;
+	}
+
+	std::fclose( fin );
+	return ret;
+}
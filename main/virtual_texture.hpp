@@ -0,0 +1,132 @@
+#ifndef VIRTUAL_TEXTURE_HPP_C83A6F1E_0D47_4B92_A5E8_6B29F4D1C370
+#define VIRTUAL_TEXTURE_HPP_C83A6F1E_0D47_4B92_A5E8_6B29F4D1C370
+
+#include <glad.h>
+
+#include <future>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "jobs.hpp"
+#include "vtex_format.hpp"
+
+// Uniform locations and texture units used by the virtual texturing code in
+// assets/default.frag and assets/vt_feedback.frag.
+constexpr GLint kVtEnabledLocation = 8;
+constexpr GLint kVtSizeLocation = 9;
+constexpr GLint kVtAtlasSizeLocation = 10;
+constexpr GLint kVtMaxLevelLocation = 11;
+constexpr GLint kVtFeedbackBiasLocation = 12;
+
+constexpr GLuint kVtIndirectionUnit = 1;
+constexpr GLuint kVtAtlasUnit = 2;
+
+/* VirtualTexture: a tiled texture (.vtex, see vtex_format.hpp) of which only
+ * the tiles that are actually visible are kept in GPU memory.
+ *
+ * Each frame:
+ *  - a feedback pass renders the geometry at a low resolution, and records
+ *    which tile (level and position) each pixel would sample;
+ *  - the feedback is read back asynchronously (a frame or two later);
+ *  - missing tiles are read from disk on the thread pool, and uploaded into
+ *    a fixed-size physical atlas. When the atlas is full, the least recently
+ *    seen tile is replaced;
+ *  - an indirection texture (one texel per tile, with a mipmap level per
+ *    tile level) maps each tile to the finest resident tile covering it.
+ *
+ * The coarsest level (a single tile) is always resident, so there is always
+ * something to sample.
+ */
+class VirtualTexture final
+{
+	public:
+		struct Stats
+		{
+			std::size_t resident;
+			std::size_t loading;
+			std::size_t uploaded;  // total
+			std::size_t evicted;   // total
+		};
+
+	public:
+		// aAtlasTiles: the physical atlas holds aAtlasTiles^2 tiles (at most
+		// 256^2).
+		VirtualTexture( char const* aPath, ThreadPool&, unsigned aAtlasTiles = 32 );
+		~VirtualTexture();
+
+		VirtualTexture( VirtualTexture const& ) = delete;
+		VirtualTexture& operator= (VirtualTexture const&) = delete;
+
+	public:
+		// Feedback pass. In between, draw the geometry that uses the virtual
+		// texture with the feedback program (default.vert + vt_feedback.frag)
+		// after calling bind_feedback(). begin_feedback() changes the
+		// viewport; end_feedback() rebinds the default framebuffer, but does
+		// not restore the viewport.
+		void begin_feedback( int aFramebufferWidth, int aFramebufferHeight );
+		void end_feedback();
+
+		// Process feedback, request missing tiles and upload tiles that have
+		// finished loading. Call once per frame.
+		void update();
+
+		// Bind textures and set uniforms (the program must be in use).
+		void bind() const;
+		void bind_feedback() const;
+
+		Stats const& stats() const noexcept;
+
+	private:
+		struct Slot_
+		{
+			std::uint64_t key;
+			std::uint64_t lastUsed;
+		};
+
+		struct Readback_
+		{
+			GLuint buffer;
+			GLsync fence;
+			int width, height;
+		};
+
+		void process_feedback_( std::uint16_t const*, std::size_t aCount );
+		bool upload_( std::uint64_t aKey, std::vector<std::byte> const& );
+		void update_indirection_();
+
+		std::vector<std::byte> read_tile_( std::uint64_t aKey ) const;
+
+	private:
+		std::string mPath;
+		ThreadPool* mPool;
+
+		VtexHeader mHeader;
+		std::vector<VtexLevel> mLevels;
+
+		unsigned mAtlasTiles;
+		int mPaddedTile;
+		GLuint mAtlas;
+
+		int mIndirectionWidth, mIndirectionHeight;
+		GLuint mIndirection;
+		bool mIndirectionDirty;
+
+		std::vector<Slot_> mSlots;
+		std::unordered_map<std::uint64_t, std::uint32_t> mResident;
+		std::unordered_map<std::uint64_t, std::future<std::vector<std::byte>>> mLoading;
+		std::uint64_t mFrame;
+
+		int mFeedbackWidth, mFeedbackHeight;
+		GLuint mFeedbackFbo;
+		GLuint mFeedbackColor, mFeedbackDepth;
+		Readback_ mReadback[2];
+		unsigned mReadbackNext;
+
+		Stats mStats;
+};
+
+#endif // VIRTUAL_TEXTURE_HPP_C83A6F1E_0D47_4B92_A5E8_6B29F4D1C370
@@ -0,0 +1,51 @@
+#ifndef VTEX_FORMAT_HPP_A4D17E3B_58C2_4B9F_8E60_3F1C2D7B9A05
+#define VTEX_FORMAT_HPP_A4D17E3B_58C2_4B9F_8E60_3F1C2D7B9A05
+
+#include <cstddef>
+#include <cstdint>
+
+/* Tiled ("virtual") texture file (.vtex), written by texconv --virtual and
+ * read by VirtualTexture (virtual_texture.hpp).
+ *
+ * Layout (all values little endian):
+ *   VtexHeader
+ *   VtexLevel[header.levelCount]
+ *   tile data
+ *
+ * Each mipmap level is cut into tiles of tileSize x tileSize texels. Every
+ * tile is stored with a border of tileBorder texels on each side (copied
+ * from the neighbouring tiles, or clamped at the image edge), so that
+ * filtering near the tile edges is seamless. A stored tile is therefore
+ * (tileSize + 2*tileBorder)^2 texels, block-compressed, and occupies exactly
+ * header.tileBytes bytes.
+ *
+ * Tiles of a level are stored in rows, bottom row first, starting at
+ * VtexLevel::offset. The last level fits into a single tile.
+ */
+
+constexpr char kVtexMagic[8] = { '\0', 'C', 'O', 'M', 'P', 'v', 't', 'x' };
+constexpr std::uint32_t kVtexVersion = 1;
+
+struct VtexHeader
+{
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t glInternalFormat; // e.g. GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+	std::uint32_t width, height;    // of level 0
+	std::uint32_t tileSize, tileBorder;
+	std::uint32_t blockBytes;       // bytes per 4x4 block
+	std::uint32_t levelCount;
+	std::uint64_t tileBytes;
+};
+
+struct VtexLevel
+{
+	std::uint32_t width, height;
+	std::uint32_t tilesX, tilesY;
+	std::uint64_t offset; // of the first tile, from start of file
+};
+
+static_assert( sizeof(VtexHeader) == 48 );
+static_assert( sizeof(VtexLevel) == 24 );
+
+#endif // VTEX_FORMAT_HPP_A4D17E3B_58C2_4B9F_8E60_3F1C2D7B9A05
@@ -93,6 +93,23 @@ project "main"
 
 	files( sources )
 
+project "texconv"
+	local sources = { 
+		"texconv/**.cpp",
+		"texconv/**.hpp",
+		"texconv/**.hxx",
+		"texconv/**.inl"
+	}
+
+	kind "ConsoleApp"
+	location "texconv"
+
+	files( sources )
+
+	links "support"
+
+	links "x-stb"
+
 project "main-shaders"
 	local shaders = { 
 		"assets/*.vert",
@@ -134,6 +151,14 @@ project "vmlib"
 
 	files( sources )
 
+	-- GCC fuses a*b + c into FMAs on its own (for C++, even in standard
+	-- mode). The scalar code would then round differently at run time than
+	-- in constant expressions, and differently than the SIMD kernels (see
+	-- mat44.hpp).
+	filter "toolset:gcc or toolset:clang"
+		buildoptions { "-ffp-contract=off" }
+	filter "*"
+
 project "vmlib-test"
 	local sources = { 
 		"vmlib-test/**.cpp",
@@ -147,9 +172,54 @@ project "vmlib-test"
 
 	files( sources )
 
+	-- As for vmlib; the tests compare exact results.
+	filter "toolset:gcc or toolset:clang"
+		buildoptions { "-ffp-contract=off" }
+	filter "*"
+
 	links "vmlib"
 	links "x-catch2"
 
 	files( sources )
 
+project "main-test"
+	local sources = { 
+		"main-test/**.cpp",
+		"main-test/**.hpp",
+		"main-test/**.hxx",
+		"main-test/**.inl"
+	}
+
+	-- The parts of main that don't need a window or an OpenGL context
+	local headless = {
+		"main/cone.cpp",
+		"main/cube.cpp",
+		"main/cylinder.cpp",
+		"main/jobs.cpp",
+		"main/mesh_builder.cpp",
+		"main/mesh_chunks.cpp",
+		"main/mesh_lod.cpp",
+		"main/mesh_optimize.cpp",
+		"main/mesh_simplify.cpp",
+		"main/meshlets.cpp",
+		"main/occlusion.cpp",
+		"main/shape_common.cpp",
+		"main/simple_mesh.cpp"
+	}
+
+	kind "ConsoleApp"
+	location "main-test"
+
+	files( sources )
+	files( headless )
+
+	links "vmlib"
+	links "x-catch2"
+
+	-- simple_mesh.cpp also holds the VAO helpers. They are linked, but
+	-- never called.
+	links "x-glad"
+
+	files( sources )
+
 --EOF
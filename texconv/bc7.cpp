@@ -0,0 +1,376 @@
+#include "bc7.hpp"
+
+#include <atomic>
+#include <thread>
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+#include <cstring>
+
+/* BC7 mode 6 block layout (128 bits, least significant bit first):
+ *
+ *   7 bits   mode (0b1000000, i.e., bit 6 set)
+ *  56 bits   endpoints R0 R1 G0 G1 B0 B1 A0 A1, 7 bits each
+ *   2 bits   p-bits P0 P1 (LSB of the endpoints 0 and 1, respectively)
+ *  63 bits   indices, 4 bits each, except 3 bits for texel 0 ("anchor";
+ *            its MSB is implicitly zero)
+ *
+ * See the "BPTC Compressed Texture Image Formats" section of the OpenGL
+ * specification for details.
+ */
+
+namespace
+{
+	constexpr int kWeights_[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// Refinement passes (least squares endpoint fit) per block
+	constexpr int kRefinePasses_ = 2;
+
+	struct Endpoints_
+	{
+		int q[2][4]; // 7 bit
+		int p[2];    // p-bit
+	};
+
+	int endpoint_( Endpoints_ const& aEp, int aWhich, int aChannel )
+	{
+		return (aEp.q[aWhich][aChannel] << 1) | aEp.p[aWhich];
+	}
+
+	// Quantize a (floating point) endpoint to 7 bits per channel plus a
+	// shared p-bit, picking the p-bit that minimizes the error.
+	void quantize_endpoint_( float const aValue[4], int aQ[4], int& aP )
+	{
+		float bestErr = -1.f;
+		for( int p = 0; p < 2; ++p )
+		{
+			int q[4];
+			float err = 0.f;
+			for( int c = 0; c < 4; ++c )
+			{
+				q[c] = std::clamp( int(std::lround( (aValue[c] - p) * 0.5f )), 0, 127 );
+				float const d = float((q[c] << 1) | p) - aValue[c];
+				err += d*d;
+			}
+
+			if( bestErr < 0.f || err < bestErr )
+			{
+				bestErr = err;
+				aP = p;
+				std::memcpy( aQ, q, sizeof(q) );
+			}
+		}
+	}
+
+	// Pick the best palette entry for each texel. Returns the total squared
+	// error of the block.
+	int select_indices_( std::uint8_t const aTexels[64], Endpoints_ const& aEp, int aIndices[16] )
+	{
+		int palette[4][16]; // channel-major, so that the loops below vectorize
+		for( int c = 0; c < 4; ++c )
+		{
+			int const e0 = endpoint_( aEp, 0, c );
+			int const e1 = endpoint_( aEp, 1, c );
+			for( int k = 0; k < 16; ++k )
+				palette[c][k] = ((64 - kWeights_[k]) * e0 + kWeights_[k] * e1 + 32) >> 6;
+		}
+
+		int total = 0;
+		for( int i = 0; i < 16; ++i )
+		{
+			int err[16];
+			for( int k = 0; k < 16; ++k )
+			{
+				int const dr = palette[0][k] - aTexels[i*4+0];
+				int const dg = palette[1][k] - aTexels[i*4+1];
+				int const db = palette[2][k] - aTexels[i*4+2];
+				int const da = palette[3][k] - aTexels[i*4+3];
+				err[k] = dr*dr + dg*dg + db*db + da*da;
+			}
+
+			int best = 0;
+			for( int k = 1; k < 16; ++k )
+			{
+				if( err[k] < err[best] )
+					best = k;
+			}
+
+			aIndices[i] = best;
+			total += err[best];
+		}
+
+		return total;
+	}
+
+	// Initial endpoints: extent of the texels along their principal axis.
+	void fit_principal_axis_( std::uint8_t const aTexels[64], float aE0[4], float aE1[4] )
+	{
+		float mean[4] = {};
+		for( int i = 0; i < 16; ++i )
+		{
+			for( int c = 0; c < 4; ++c )
+				mean[c] += aTexels[i*4+c];
+		}
+		for( int c = 0; c < 4; ++c )
+			mean[c] *= 1.f / 16.f;
+
+		float cov[4][4] = {};
+		for( int i = 0; i < 16; ++i )
+		{
+			float d[4];
+			for( int c = 0; c < 4; ++c )
+				d[c] = aTexels[i*4+c] - mean[c];
+
+			for( int r = 0; r < 4; ++r )
+			{
+				for( int c = 0; c < 4; ++c )
+					cov[r][c] += d[r] * d[c];
+			}
+		}
+
+		// Power iteration
+		float axis[4] = { 1.f, 1.f, 1.f, 1.f };
+		for( int iter = 0; iter < 8; ++iter )
+		{
+			float next[4] = {};
+			for( int r = 0; r < 4; ++r )
+			{
+				for( int c = 0; c < 4; ++c )
+					next[r] += cov[r][c] * axis[c];
+			}
+
+			float const len = std::sqrt( next[0]*next[0] + next[1]*next[1] + next[2]*next[2] + next[3]*next[3] );
+			if( len < 1e-6f )
+				break; // (nearly) constant block; axis doesn't matter
+
+			for( int c = 0; c < 4; ++c )
+				axis[c] = next[c] / len;
+		}
+
+		float tmin = 0.f, tmax = 0.f;
+		for( int i = 0; i < 16; ++i )
+		{
+			float t = 0.f;
+			for( int c = 0; c < 4; ++c )
+				t += (aTexels[i*4+c] - mean[c]) * axis[c];
+
+			tmin = std::min( tmin, t );
+			tmax = std::max( tmax, t );
+		}
+
+		for( int c = 0; c < 4; ++c )
+		{
+			aE0[c] = std::clamp( mean[c] + tmin * axis[c], 0.f, 255.f );
+			aE1[c] = std::clamp( mean[c] + tmax * axis[c], 0.f, 255.f );
+		}
+	}
+
+	// Least squares fit of the endpoints, given the current indices. Returns
+	// false if the system is degenerate (all texels use the same weight).
+	bool fit_least_squares_( std::uint8_t const aTexels[64], int const aIndices[16], float aE0[4], float aE1[4] )
+	{
+		float a = 0.f, b = 0.f, c = 0.f;
+		float x0[4] = {}, x1[4] = {};
+		for( int i = 0; i < 16; ++i )
+		{
+			float const w = kWeights_[aIndices[i]] / 64.f;
+			float const v = 1.f - w;
+
+			a += v*v;
+			b += v*w;
+			c += w*w;
+
+			for( int ch = 0; ch < 4; ++ch )
+			{
+				x0[ch] += v * aTexels[i*4+ch];
+				x1[ch] += w * aTexels[i*4+ch];
+			}
+		}
+
+		float const det = a*c - b*b;
+		if( std::abs( det ) < 1e-6f )
+			return false;
+
+		float const inv = 1.f / det;
+		for( int ch = 0; ch < 4; ++ch )
+		{
+			aE0[ch] = std::clamp( (c*x0[ch] - b*x1[ch]) * inv, 0.f, 255.f );
+			aE1[ch] = std::clamp( (a*x1[ch] - b*x0[ch]) * inv, 0.f, 255.f );
+		}
+
+		return true;
+	}
+
+	struct BitWriter_
+	{
+		std::uint64_t bits[2] = {};
+		int pos = 0;
+
+		void put( std::uint32_t aValue, int aCount )
+		{
+			for( int i = 0; i < aCount; ++i, ++pos )
+			{
+				if( (aValue >> i) & 1u )
+					bits[pos/64] |= std::uint64_t(1) << (pos%64);
+			}
+		}
+	};
+
+	struct BitReader_
+	{
+		std::uint64_t bits[2];
+		int pos = 0;
+
+		std::uint32_t get( int aCount )
+		{
+			std::uint32_t ret = 0;
+			for( int i = 0; i < aCount; ++i, ++pos )
+				ret |= std::uint32_t((bits[pos/64] >> (pos%64)) & 1u) << i;
+			return ret;
+		}
+	};
+}
+
+void encode_bc7_block( std::uint8_t const aTexels[64], std::uint8_t aBlock[kBC7BlockBytes] )
+{
+	float e0[4], e1[4];
+	fit_principal_axis_( aTexels, e0, e1 );
+
+	Endpoints_ best;
+	int bestIndices[16];
+	int bestErr;
+
+	quantize_endpoint_( e0, best.q[0], best.p[0] );
+	quantize_endpoint_( e1, best.q[1], best.p[1] );
+	bestErr = select_indices_( aTexels, best, bestIndices );
+
+	for( int pass = 0; pass < kRefinePasses_ && bestErr > 0; ++pass )
+	{
+		if( !fit_least_squares_( aTexels, bestIndices, e0, e1 ) )
+			break;
+
+		Endpoints_ ep;
+		int indices[16];
+		quantize_endpoint_( e0, ep.q[0], ep.p[0] );
+		quantize_endpoint_( e1, ep.q[1], ep.p[1] );
+
+		int const err = select_indices_( aTexels, ep, indices );
+		if( err >= bestErr )
+			break;
+
+		best = ep;
+		bestErr = err;
+		std::memcpy( bestIndices, indices, sizeof(indices) );
+	}
+
+	// The anchor index (texel 0) must have its MSB clear. Swapping the
+	// endpoints mirrors the weights (kWeights_[15-k] == 64-kWeights_[k]).
+	if( bestIndices[0] & 8 )
+	{
+		std::swap( best.q[0], best.q[1] );
+		std::swap( best.p[0], best.p[1] );
+		for( auto& index : bestIndices )
+			index = 15 - index;
+	}
+
+	BitWriter_ out;
+	out.put( 1u << 6, 7 );
+	for( int c = 0; c < 4; ++c )
+	{
+		out.put( std::uint32_t(best.q[0][c]), 7 );
+		out.put( std::uint32_t(best.q[1][c]), 7 );
+	}
+	out.put( std::uint32_t(best.p[0]), 1 );
+	out.put( std::uint32_t(best.p[1]), 1 );
+
+	out.put( std::uint32_t(bestIndices[0]), 3 );
+	for( int i = 1; i < 16; ++i )
+		out.put( std::uint32_t(bestIndices[i]), 4 );
+
+	assert( 128 == out.pos );
+	for( std::size_t i = 0; i < kBC7BlockBytes; ++i )
+		aBlock[i] = std::uint8_t(out.bits[i/8] >> (8*(i%8)));
+}
+
+void decode_bc7_block( std::uint8_t const aBlock[kBC7BlockBytes], std::uint8_t aTexels[64] )
+{
+	BitReader_ in{};
+	for( std::size_t i = 0; i < kBC7BlockBytes; ++i )
+		in.bits[i/8] |= std::uint64_t(aBlock[i]) << (8*(i%8));
+
+	if( (1u << 6) != in.get( 7 ) )
+	{
+		std::memset( aTexels, 0, 64 );
+		return;
+	}
+
+	int q[2][4];
+	for( int c = 0; c < 4; ++c )
+	{
+		q[0][c] = int(in.get( 7 ));
+		q[1][c] = int(in.get( 7 ));
+	}
+	int const p0 = int(in.get( 1 ));
+	int const p1 = int(in.get( 1 ));
+
+	for( int i = 0; i < 16; ++i )
+	{
+		int const w = kWeights_[in.get( 0 == i ? 3 : 4 )];
+		for( int c = 0; c < 4; ++c )
+		{
+			int const e0 = (q[0][c] << 1) | p0;
+			int const e1 = (q[1][c] << 1) | p1;
+			aTexels[i*4+c] = std::uint8_t(((64 - w) * e0 + w * e1 + 32) >> 6);
+		}
+	}
+}
+
+std::vector<std::byte> encode_bc7( ImageRgba8 const& aImage, unsigned aThreads )
+{
+	assert( aImage.width > 0 && aImage.height > 0 );
+
+	auto const blocksX = (aImage.width + 3) / 4;
+	auto const blocksY = (aImage.height + 3) / 4;
+
+	std::vector<std::byte> ret( std::size_t(blocksX) * blocksY * kBC7BlockBytes );
+
+	std::atomic<int> nextRow{ 0 };
+	auto const work = [&] {
+		std::uint8_t texels[64];
+		for( int by = nextRow++; by < blocksY; by = nextRow++ )
+		{
+			for( int bx = 0; bx < blocksX; ++bx )
+			{
+				// Gather the block, repeating the last row/column at the edges.
+				for( int y = 0; y < 4; ++y )
+				{
+					auto const sy = std::min( by*4 + y, aImage.height-1 );
+					for( int x = 0; x < 4; ++x )
+					{
+						auto const sx = std::min( bx*4 + x, aImage.width-1 );
+						std::memcpy( texels + (y*4+x)*4, aImage.pixels.data() + (std::size_t(sy)*aImage.width + sx)*4, 4 );
+					}
+				}
+
+				auto* out = ret.data() + (std::size_t(by)*blocksX + bx) * kBC7BlockBytes;
+				encode_bc7_block( texels, reinterpret_cast<std::uint8_t*>(out) );
+			}
+		}
+	};
+
+	if( 0 == aThreads )
+		aThreads = std::max( 1u, std::thread::hardware_concurrency() );
+	aThreads = std::min( aThreads, unsigned(blocksY) );
+
+	std::vector<std::thread> workers;
+	for( unsigned i = 1; i < aThreads; ++i )
+		workers.emplace_back( work );
+
+	work(); // this thread helps as well
+
+	for( auto& worker : workers )
+		worker.join();
+
+	return ret;
+}
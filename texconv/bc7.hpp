@@ -0,0 +1,30 @@
+#ifndef BC7_HPP_8C2F5E19_7B3A_4D61_9E04_A5D83C1F6B27
+#define BC7_HPP_8C2F5E19_7B3A_4D61_9E04_A5D83C1F6B27
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "image.hpp"
+
+// Size of a single compressed 4x4 BC7 block.
+constexpr std::size_t kBC7BlockBytes = 16;
+
+// Encode a single 4x4 block of RGBA8 texels (row-major, 64 bytes) to BC7.
+//
+// Only mode 6 (one subset, 7.7.7.7 endpoints with a unique p-bit each,
+// 4-bit indices) is used. It is a good fit for smooth, photographic content
+// such as the orthophoto, and keeps the encoder simple and fast.
+void encode_bc7_block( std::uint8_t const aTexels[64], std::uint8_t aBlock[kBC7BlockBytes] );
+
+// Decode a single BC7 mode 6 block. Other modes are not supported (and
+// decode to transparent black, like the reserved mode).
+void decode_bc7_block( std::uint8_t const aBlock[kBC7BlockBytes], std::uint8_t aTexels[64] );
+
+// Encode a full image. Blocks along the right and top edge are padded by
+// repeating the last column/row. Rows of blocks are distributed over
+// aThreads threads (0 = one per hardware thread).
+std::vector<std::byte> encode_bc7( ImageRgba8 const&, unsigned aThreads = 0 );
+
+#endif // BC7_HPP_8C2F5E19_7B3A_4D61_9E04_A5D83C1F6B27
@@ -0,0 +1,104 @@
+#include "image.hpp"
+
+#include <utility>
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+#include <stb_image.h>
+
+#include "../support/error.hpp"
+
+namespace
+{
+	float srgb_to_linear_( float aValue )
+	{
+		if( aValue <= 0.04045f )
+			return aValue / 12.92f;
+		return std::pow( (aValue + 0.055f) / 1.055f, 2.4f );
+	}
+	float linear_to_srgb_( float aValue )
+	{
+		if( aValue <= 0.0031308f )
+			return aValue * 12.92f;
+		return 1.055f * std::pow( aValue, 1.f/2.4f ) - 0.055f;
+	}
+
+	std::uint8_t to_unorm8_( float aValue )
+	{
+		return std::uint8_t(std::clamp( aValue, 0.f, 1.f ) * 255.f + 0.5f);
+	}
+}
+
+ImageRgba8 load_image( char const* aPath )
+{
+	assert( aPath );
+
+	stbi_set_flip_vertically_on_load( true );
+
+	int w, h, channels;
+	stbi_uc* ptr = stbi_load( aPath, &w, &h, &channels, 4 );
+	if( !ptr )
+		throw Error( "Unable to load image '%s': %s", aPath, stbi_failure_reason() );
+
+	ImageRgba8 ret{ w, h, std::vector<std::uint8_t>( ptr, ptr + std::size_t(w)*h*4 ) };
+	stbi_image_free( ptr );
+	return ret;
+}
+
+ImageRgba8 downsample( ImageRgba8 const& aImage, bool aSrgb )
+{
+	float toLinear[256];
+	for( int i = 0; i < 256; ++i )
+		toLinear[i] = aSrgb ? srgb_to_linear_( i / 255.f ) : i / 255.f;
+
+	ImageRgba8 ret;
+	ret.width = std::max( 1, aImage.width / 2 );
+	ret.height = std::max( 1, aImage.height / 2 );
+	ret.pixels.resize( std::size_t(ret.width) * ret.height * 4 );
+
+	// Each texel averages a 2x2 block. With odd sizes, the last row/column of
+	// the source is folded into the last row/column of the result (3 texels
+	// wide); with a size of one, the single texel is used.
+	auto const span = [] (int aDst, int aDstSize, int aSrcSize) {
+		auto const first = std::min( 2*aDst, aSrcSize-1 );
+		auto const last = aDst == aDstSize-1 ? aSrcSize-1 : 2*aDst+1;
+		return std::pair<int, int>{ first, last };
+	};
+
+	for( int y = 0; y < ret.height; ++y )
+	{
+		auto const [y0, y1] = span( y, ret.height, aImage.height );
+		for( int x = 0; x < ret.width; ++x )
+		{
+			auto const [x0, x1] = span( x, ret.width, aImage.width );
+
+			float sum[3] = {};
+			unsigned alpha = 0;
+			for( int sy = y0; sy <= y1; ++sy )
+			{
+				auto const* src = aImage.pixels.data() + (std::size_t(sy)*aImage.width + x0) * 4;
+				for( int sx = x0; sx <= x1; ++sx, src += 4 )
+				{
+					for( int c = 0; c < 3; ++c )
+						sum[c] += toLinear[src[c]];
+					alpha += src[3];
+				}
+			}
+
+			auto const count = unsigned((y1-y0+1) * (x1-x0+1));
+
+			auto* dst = ret.pixels.data() + (std::size_t(y)*ret.width + x) * 4;
+			for( int c = 0; c < 3; ++c )
+			{
+				float const avg = sum[c] / float(count);
+				dst[c] = to_unorm8_( aSrgb ? linear_to_srgb_( avg ) : avg );
+			}
+
+			dst[3] = std::uint8_t((alpha + count/2) / count);
+		}
+	}
+
+	return ret;
+}
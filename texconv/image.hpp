@@ -0,0 +1,25 @@
+#ifndef IMAGE_HPP_4B7E0D52_C1A9_4F38_8D6B_2E95F0A3C714
+#define IMAGE_HPP_4B7E0D52_C1A9_4F38_8D6B_2E95F0A3C714
+
+#include <vector>
+
+#include <cstdint>
+
+// Uncompressed 8-bit RGBA image. Rows are stored bottom-up, i.e., in the
+// order that OpenGL expects.
+struct ImageRgba8
+{
+	int width, height;
+	std::vector<std::uint8_t> pixels; // width*height*4
+};
+
+ImageRgba8 load_image( char const* aPath );
+
+// Compute the next smaller mipmap level (half size, rounded down, but at
+// least 1x1) with a box filter. With odd sizes, the last row and column are
+// folded into the edge texels, so no texel of the source is dropped. When
+// aSrgb is set, the color channels are averaged in linear space; alpha is
+// always linear.
+ImageRgba8 downsample( ImageRgba8 const&, bool aSrgb );
+
+#endif // IMAGE_HPP_4B7E0D52_C1A9_4F38_8D6B_2E95F0A3C714
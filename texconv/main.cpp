@@ -0,0 +1,390 @@
+#include <glad.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <typeinfo>
+#include <algorithm>
+#include <stdexcept>
+#include <filesystem>
+
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+#include "../support/error.hpp"
+
+#include "../main/ctex_format.hpp"
+#include "../main/vtex_format.hpp"
+
+#include "bc7.hpp"
+#include "image.hpp"
+
+/* texconv: offline texture compression.
+ *
+ *   texconv [--linear] [--threads N] <input image> <output.ctex>
+ *   texconv --virtual [--tile-size N] [--linear] [--threads N] <input image> <output.vtex>
+ *
+ * Encodes an image (anything stb_image can load) to BC7, including a full,
+ * precomputed mipmap chain.
+ *
+ * The default output is a .ctex container (see ctex_format.hpp) that
+ * load_compressed_image() (main/texture.cpp) uploads without any decoding.
+ * With --virtual, each level is instead cut into tiles with borders and
+ * stored in a .vtex file (see vtex_format.hpp) for VirtualTexture.
+ *
+ * By default the image is treated as sRGB: mipmaps are filtered in linear
+ * space and the GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM format is used. Pass
+ * --linear for non-color data (e.g. normal maps).
+ */
+
+namespace
+{
+	using Clock_ = std::chrono::steady_clock;
+
+	constexpr unsigned kTileBorder_ = 4;
+
+	struct Options_
+	{
+		bool linear = false;
+		bool virtualTexture = false;
+		unsigned tileSize = 128;
+		unsigned threads = 0;
+		char const* input = nullptr;
+		char const* output = nullptr;
+	};
+
+	Options_ parse_options_( int, char* [] );
+
+	std::uint64_t write_ctex_( Options_ const&, ImageRgba8 );
+	std::uint64_t write_vtex_( Options_ const&, ImageRgba8 );
+
+	// Extract a tile of aSize x aSize texels, plus aBorder texels on each
+	// side, clamping at the image edges.
+	ImageRgba8 extract_tile_( ImageRgba8 const&, int aX, int aY, unsigned aSize, unsigned aBorder );
+
+	double psnr_( ImageRgba8 const&, std::vector<std::byte> const& aBlocks );
+
+	// Write to a temporary file and rename it once complete, so that a
+	// partially written file never replaces a good one.
+	template< typename tWriter >
+	void write_file_( char const* aPath, tWriter&& );
+
+	void fwrite_( void const*, std::size_t, std::FILE* );
+}
+
+int main( int aArgc, char* aArgv[] ) try
+{
+	auto const options = parse_options_( aArgc, aArgv );
+	auto const start = Clock_::now();
+
+	auto image = load_image( options.input );
+	std::printf( "%s: %dx%d\n", options.input, image.width, image.height );
+
+	auto const rgbaBytes = std::uint64_t(image.width) * image.height * 4 * 4 / 3; // incl. mipmaps
+	auto const bytes = options.virtualTexture
+		? write_vtex_( options, std::move(image) )
+		: write_ctex_( options, std::move(image) )
+	;
+
+	auto const ms = std::chrono::duration<double, std::milli>( Clock_::now() - start ).count();
+	std::printf( "%s: %.2f MiB (RGBA8: %.2f MiB), %.2f ms\n", options.output, bytes / (1024.*1024.), rgbaBytes / (1024.*1024.), ms );
+
+	return 0;
+}
+catch( std::exception const& eErr )
+{
+	std::fprintf( stderr, "Top-level Exception (%s):\n", typeid(eErr).name() );
+	std::fprintf( stderr, "%s\n", eErr.what() );
+	std::fprintf( stderr, "Bye.\n" );
+	return 1;
+}
+
+namespace
+{
+	Options_ parse_options_( int aArgc, char* aArgv[] )
+	{
+		Options_ ret;
+		for( int i = 1; i < aArgc; ++i )
+		{
+			if( 0 == std::strcmp( aArgv[i], "--linear" ) )
+				ret.linear = true;
+			else if( 0 == std::strcmp( aArgv[i], "--virtual" ) )
+				ret.virtualTexture = true;
+			else if( 0 == std::strcmp( aArgv[i], "--tile-size" ) && i+1 < aArgc )
+				ret.tileSize = unsigned(std::strtoul( aArgv[++i], nullptr, 10 ));
+			else if( 0 == std::strcmp( aArgv[i], "--threads" ) && i+1 < aArgc )
+				ret.threads = unsigned(std::strtoul( aArgv[++i], nullptr, 10 ));
+			else if( '-' == aArgv[i][0] )
+				throw Error( "Unknown command line option '%s'", aArgv[i] );
+			else if( !ret.input )
+				ret.input = aArgv[i];
+			else if( !ret.output )
+				ret.output = aArgv[i];
+			else
+				throw Error( "Unexpected argument '%s'", aArgv[i] );
+		}
+
+		if( !ret.input || !ret.output )
+			throw Error( "Usage: %s [--virtual [--tile-size N]] [--linear] [--threads N] <input image> <output>", aArgv[0] );
+
+		// Tiles (with their borders) must consist of whole BC7 blocks.
+		if( ret.tileSize < 16 || 0 != ret.tileSize % 4 )
+			throw Error( "Tile size must be a multiple of 4, and at least 16 (got %u)", ret.tileSize );
+
+		return ret;
+	}
+
+	std::uint64_t write_ctex_( Options_ const& aOptions, ImageRgba8 aImage )
+	{
+		// Encode all levels
+		std::vector<CtexLevel> levels;
+		std::vector<std::vector<std::byte>> data;
+
+		for( int i = 0; ; ++i )
+		{
+			auto const levelStart = Clock_::now();
+			auto blocks = encode_bc7( aImage, aOptions.threads );
+			auto const ms = std::chrono::duration<double, std::milli>( Clock_::now() - levelStart ).count();
+
+			if( 0 == i )
+				std::printf( "  level 0: %.2f ms, PSNR %.2f dB\n", ms, psnr_( aImage, blocks ) );
+
+			levels.emplace_back( CtexLevel{ std::uint32_t(aImage.width), std::uint32_t(aImage.height), 0, blocks.size() } );
+			data.emplace_back( std::move(blocks) );
+
+			if( 1 == aImage.width && 1 == aImage.height )
+				break;
+
+			aImage = downsample( aImage, !aOptions.linear );
+		}
+
+		// Assign offsets
+		std::uint64_t offset = sizeof(CtexHeader) + levels.size() * sizeof(CtexLevel);
+		for( auto& level : levels )
+		{
+			offset = (offset + kCtexAlign-1) / kCtexAlign * kCtexAlign;
+			level.offset = offset;
+			offset += level.bytes;
+		}
+
+		// Write
+		CtexHeader header{};
+		std::memcpy( header.magic, kCtexMagic, sizeof(kCtexMagic) );
+		header.version = kCtexVersion;
+		header.glInternalFormat = aOptions.linear ? GL_COMPRESSED_RGBA_BPTC_UNORM : GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+		header.width = levels.front().width;
+		header.height = levels.front().height;
+		header.blockBytes = std::uint32_t(kBC7BlockBytes);
+		header.levelCount = std::uint32_t(levels.size());
+
+		write_file_( aOptions.output, [&] (std::FILE* aFile) {
+			fwrite_( &header, sizeof(header), aFile );
+			fwrite_( levels.data(), levels.size() * sizeof(CtexLevel), aFile );
+
+			for( std::size_t i = 0; i < levels.size(); ++i )
+			{
+				static constexpr std::byte kZero[kCtexAlign] = {};
+				auto const pos = std::uint64_t(std::ftell( aFile ));
+				fwrite_( kZero, std::size_t(levels[i].offset - pos), aFile );
+				fwrite_( data[i].data(), data[i].size(), aFile );
+			}
+		} );
+
+		std::printf( "  %u levels\n", unsigned(levels.size()) );
+		return offset;
+	}
+
+	std::uint64_t write_vtex_( Options_ const& aOptions, ImageRgba8 aImage )
+	{
+		auto const tile = aOptions.tileSize;
+		auto const padded = tile + 2*kTileBorder_;
+		auto const tileBytes = std::uint64_t(padded/4) * (padded/4) * kBC7BlockBytes;
+
+		// Encode all levels, down to the first one that fits into a single
+		// tile. Tiles are small, so parallelize over tiles rather than over
+		// the blocks of a tile.
+		std::vector<VtexLevel> levels;
+		std::vector<std::vector<std::byte>> data;
+
+		for( ;; )
+		{
+			VtexLevel level{};
+			level.width = std::uint32_t(aImage.width);
+			level.height = std::uint32_t(aImage.height);
+			level.tilesX = (level.width + tile-1) / tile;
+			level.tilesY = (level.height + tile-1) / tile;
+
+			auto const tileCount = level.tilesX * level.tilesY;
+			std::vector<std::byte> tiles( tileCount * tileBytes );
+
+			std::atomic<std::uint32_t> nextTile{ 0 };
+			auto const work = [&] {
+				for( auto i = nextTile++; i < tileCount; i = nextTile++ )
+				{
+					auto const x = int(i % level.tilesX);
+					auto const y = int(i / level.tilesX);
+					auto const blocks = encode_bc7( extract_tile_( aImage, x, y, tile, kTileBorder_ ), 1 );
+
+					assert( blocks.size() == tileBytes );
+					std::memcpy( tiles.data() + i*tileBytes, blocks.data(), blocks.size() );
+				}
+			};
+
+			auto threads = aOptions.threads ? aOptions.threads : std::max( 1u, std::thread::hardware_concurrency() );
+			threads = std::min( threads, tileCount );
+
+			std::vector<std::thread> workers;
+			for( unsigned i = 1; i < threads; ++i )
+				workers.emplace_back( work );
+
+			work(); // this thread helps as well
+
+			for( auto& worker : workers )
+				worker.join();
+
+			std::printf( "  level %zu: %ux%u, %ux%u tiles\n", levels.size(), level.width, level.height, level.tilesX, level.tilesY );
+
+			levels.emplace_back( level );
+			data.emplace_back( std::move(tiles) );
+
+			if( 1 == level.tilesX && 1 == level.tilesY )
+				break;
+
+			aImage = downsample( aImage, !aOptions.linear );
+		}
+
+		// Assign offsets. Tiles are multiples of 16 bytes, so alignment only
+		// needs to be established once.
+		std::uint64_t offset = sizeof(VtexHeader) + levels.size() * sizeof(VtexLevel);
+		offset = (offset + kCtexAlign-1) / kCtexAlign * kCtexAlign;
+
+		auto const dataStart = offset;
+		for( auto& level : levels )
+		{
+			level.offset = offset;
+			offset += std::uint64_t(level.tilesX) * level.tilesY * tileBytes;
+		}
+
+		// Write
+		VtexHeader header{};
+		std::memcpy( header.magic, kVtexMagic, sizeof(kVtexMagic) );
+		header.version = kVtexVersion;
+		header.glInternalFormat = aOptions.linear ? GL_COMPRESSED_RGBA_BPTC_UNORM : GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+		header.width = levels.front().width;
+		header.height = levels.front().height;
+		header.tileSize = tile;
+		header.tileBorder = kTileBorder_;
+		header.blockBytes = std::uint32_t(kBC7BlockBytes);
+		header.levelCount = std::uint32_t(levels.size());
+		header.tileBytes = tileBytes;
+
+		write_file_( aOptions.output, [&] (std::FILE* aFile) {
+			fwrite_( &header, sizeof(header), aFile );
+			fwrite_( levels.data(), levels.size() * sizeof(VtexLevel), aFile );
+
+			static constexpr std::byte kZero[kCtexAlign] = {};
+			auto const pos = std::uint64_t(std::ftell( aFile ));
+			fwrite_( kZero, std::size_t(dataStart - pos), aFile );
+
+			for( auto const& tiles : data )
+				fwrite_( tiles.data(), tiles.size(), aFile );
+		} );
+
+		return offset;
+	}
+
+	ImageRgba8 extract_tile_( ImageRgba8 const& aImage, int aX, int aY, unsigned aSize, unsigned aBorder )
+	{
+		auto const padded = int(aSize + 2*aBorder);
+
+		ImageRgba8 ret;
+		ret.width = ret.height = padded;
+		ret.pixels.resize( std::size_t(padded) * padded * 4 );
+
+		for( int y = 0; y < padded; ++y )
+		{
+			auto const sy = std::clamp( aY*int(aSize) + y - int(aBorder), 0, aImage.height-1 );
+			for( int x = 0; x < padded; ++x )
+			{
+				auto const sx = std::clamp( aX*int(aSize) + x - int(aBorder), 0, aImage.width-1 );
+				std::memcpy( ret.pixels.data() + (std::size_t(y)*padded + x)*4, aImage.pixels.data() + (std::size_t(sy)*aImage.width + sx)*4, 4 );
+			}
+		}
+
+		return ret;
+	}
+
+	double psnr_( ImageRgba8 const& aImage, std::vector<std::byte> const& aBlocks )
+	{
+		auto const blocksX = (aImage.width + 3) / 4;
+
+		double sum = 0.0;
+		std::uint8_t texels[64];
+		for( int y = 0; y < aImage.height; ++y )
+		{
+			for( int x = 0; x < aImage.width; ++x )
+			{
+				// Decoding the whole block for each texel is wasteful, but
+				// this is just for reporting.
+				if( 0 == x % 4 )
+				{
+					auto const* block = aBlocks.data() + (std::size_t(y/4)*blocksX + x/4) * kBC7BlockBytes;
+					decode_bc7_block( reinterpret_cast<std::uint8_t const*>(block), texels );
+				}
+
+				auto const* ref = aImage.pixels.data() + (std::size_t(y)*aImage.width + x) * 4;
+				auto const* dec = texels + ((y%4)*4 + x%4) * 4;
+				for( int c = 0; c < 4; ++c )
+				{
+					double const d = double(ref[c]) - dec[c];
+					sum += d*d;
+				}
+			}
+		}
+
+		double const mse = sum / (double(aImage.width) * aImage.height * 4);
+		if( mse <= 0.0 )
+			return INFINITY;
+
+		return 10.0 * std::log10( 255.0*255.0 / mse );
+	}
+
+	template< typename tWriter >
+	void write_file_( char const* aPath, tWriter&& aWriter )
+	{
+		auto const tmpPath = std::string(aPath) + ".tmp";
+		std::FILE* fout = std::fopen( tmpPath.c_str(), "wb" );
+		if( !fout )
+			throw Error( "Unable to open '%s' for writing", tmpPath.c_str() );
+
+		try
+		{
+			aWriter( fout );
+
+			auto const err = std::fclose( fout );
+			fout = nullptr;
+			if( 0 != err )
+				throw Error( "Error while writing '%s'", tmpPath.c_str() );
+		}
+		catch( ... )
+		{
+			if( fout )
+				std::fclose( fout );
+			std::remove( tmpPath.c_str() );
+			throw;
+		}
+
+		std::filesystem::rename( tmpPath, aPath );
+	}
+
+	void fwrite_( void const* aPtr, std::size_t aBytes, std::FILE* aFile )
+	{
+		if( aBytes && 1 != std::fwrite( aPtr, aBytes, 1, aFile ) )
+			throw Error( "fwrite() failed" );
+	}
+}
@@ -0,0 +1,155 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <vector>
+
+#include "common.hpp"
+
+#include "../vmlib/affine34.hpp"
+
+namespace
+{
+	constexpr Affine34f kShift_ = make_affine( { {
+		1.f, 0.f, 0.f, 1.f,
+		0.f, 1.f, 0.f, 2.f,
+		0.f, 0.f, 1.f, 3.f,
+		0.f, 0.f, 0.f, 1.f
+	} } );
+	static_assert( 3.f == transform_point( kShift_, { 0.f, 1.f, 0.f } ).y );
+	static_assert( 1.f == to_mat44( kShift_ )(3,3) );
+	static_assert( 6.f == (kShift_ * kShift_)(2,3) );
+}
+
+TEST_CASE( "Affine transforms match the general path", "[affine34]" )
+{
+	auto const transforms = random_affine_transforms( 100, 1 );
+
+	SECTION( "Round trip" )
+	{
+		for( auto const& m : transforms )
+		{
+			REQUIRE( is_affine( m ) );
+
+			auto const back = to_mat44( make_affine( m ) );
+			for( std::size_t i = 0; i < 16; ++i )
+				REQUIRE( back.v[i] == m.v[i] );
+		}
+
+		REQUIRE( !is_affine( make_perspective_projection( 1.f, 1.5f, 0.1f, 100.f ) ) );
+	}
+
+	SECTION( "Composition" )
+	{
+		for( std::size_t i = 0; i + 1 < transforms.size(); ++i )
+		{
+			auto const expected = transforms[i] * transforms[i+1];
+			auto const affine = to_mat44( make_affine( transforms[i] ) * make_affine( transforms[i+1] ) );
+			auto const scalar = to_mat44( multiply_scalar( make_affine( transforms[i] ), make_affine( transforms[i+1] ) ) );
+			auto const mixed = transforms[i] * make_affine( transforms[i+1] );
+
+			require_close( affine, expected, 1e-4f );
+			require_close( scalar, expected, 1e-4f );
+			require_close( mixed, expected, 1e-4f );
+		}
+	}
+
+	SECTION( "Inverse" )
+	{
+		for( auto const& m : transforms )
+		{
+			auto const expected = invert( m );
+			auto const inverse = to_mat44( invert( make_affine( m ) ) );
+			require_close( inverse, expected, 1e-4f );
+		}
+	}
+
+	SECTION( "Normal matrix" )
+	{
+		for( auto const& m : transforms )
+		{
+			auto const expected = mat44_to_mat33( transpose( invert( m ) ) );
+			auto const affine = normal_matrix( make_affine( m ) );
+			auto const general = normal_matrix( m );
+
+			for( std::size_t j = 0; j < 9; ++j )
+			{
+				REQUIRE_THAT( affine.v[j], close_to( expected.v[j], 1e-4f ) );
+				REQUIRE_THAT( general.v[j], close_to( expected.v[j], 1e-4f ) );
+			}
+		}
+	}
+
+	SECTION( "Points and directions" )
+	{
+		for( auto const& m : transforms )
+		{
+			auto const a = make_affine( m );
+			Vec3f const p{ 1.f, -2.f, 3.f };
+
+			auto const point = m * Vec4f{ p.x, p.y, p.z, 1.f };
+			auto const dir = m * Vec4f{ p.x, p.y, p.z, 0.f };
+
+			auto const ap = transform_point( a, p );
+			auto const ad = transform_direction( a, p );
+			auto const av = a * Vec4f{ p.x, p.y, p.z, 1.f };
+
+			require_close( ap, Vec3f{ point.x, point.y, point.z }, 1e-4f );
+			require_close( ad, Vec3f{ dir.x, dir.y, dir.z }, 1e-4f );
+			require_close( av, point, 1e-4f );
+			REQUIRE( 1.f == av.w );
+		}
+	}
+}
+
+VMLIB_BENCHMARK_CASE( "Affine transform benchmark", "[affine34]" )
+{
+	constexpr std::size_t kCount = 10000;
+
+	auto const transforms = random_affine_transforms( kCount, 2 );
+
+	std::vector<Affine34f> affine( kCount );
+	for( std::size_t i = 0; i < kCount; ++i )
+		affine[i] = make_affine( transforms[i] );
+
+	std::vector<Mat44f> out44( kCount );
+	std::vector<Affine34f> out34( kCount );
+	std::vector<Mat33f> out33( kCount );
+
+	BENCHMARK( "inverse, Mat44f" )
+	{
+		for( std::size_t i = 0; i < kCount; ++i )
+			out44[i] = invert( transforms[i] );
+		return out44[kCount-1].v[0];
+	};
+	BENCHMARK( "inverse, Affine34f" )
+	{
+		for( std::size_t i = 0; i < kCount; ++i )
+			out34[i] = invert( affine[i] );
+		return out34[kCount-1].v[0];
+	};
+
+	BENCHMARK( "normal matrix, Mat44f" )
+	{
+		for( std::size_t i = 0; i < kCount; ++i )
+			out33[i] = mat44_to_mat33( transpose( invert( transforms[i] ) ) );
+		return out33[kCount-1].v[0];
+	};
+	BENCHMARK( "normal matrix, Affine34f" )
+	{
+		for( std::size_t i = 0; i < kCount; ++i )
+			out33[i] = normal_matrix( affine[i] );
+		return out33[kCount-1].v[0];
+	};
+
+	BENCHMARK( "composition, Mat44f" )
+	{
+		for( std::size_t i = 0; i + 1 < kCount; ++i )
+			out44[i] = transforms[i] * transforms[i+1];
+		return out44[kCount-2].v[0];
+	};
+	BENCHMARK( "composition, Affine34f" )
+	{
+		for( std::size_t i = 0; i + 1 < kCount; ++i )
+			out34[i] = affine[i] * affine[i+1];
+		return out34[kCount-2].v[0];
+	};
+}
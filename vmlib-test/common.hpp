@@ -0,0 +1,144 @@
+#ifndef COMMON_HPP_9C41E7B2_6A0D_4F58_B3E1_27D84F06A5C9
+#define COMMON_HPP_9C41E7B2_6A0D_4F58_B3E1_27D84F06A5C9
+
+#include <catch2/catch_amalgamated.hpp>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+
+#include "../vmlib/vec3.hpp"
+#include "../vmlib/vec4.hpp"
+#include "../vmlib/mat44.hpp"
+
+// Shared by the vmlib tests.
+
+// Benchmarks are hidden by default; run with: vmlib-test "[benchmark]" (or,
+// e.g., "[benchmark][mat44]" for a single one).
+#define VMLIB_BENCHMARK_CASE(name,tags) TEST_CASE( name, "[.][benchmark]" tags )
+
+// Seeded random inputs. aMake draws one value from the generator.
+template< typename tType, typename tMake >
+std::vector<tType> random_values( std::size_t aCount, unsigned aSeed, tMake&& aMake )
+{
+	std::mt19937 rng( aSeed );
+
+	std::vector<tType> ret( aCount );
+	for( auto& v : ret )
+		v = aMake( rng );
+	return ret;
+}
+
+// Components in [-10, 10)
+inline
+std::vector<Vec3f> random_vec3s( std::size_t aCount, unsigned aSeed )
+{
+	std::uniform_real_distribution<float> dist( -10.f, 10.f );
+	return random_values<Vec3f>( aCount, aSeed, [&] (std::mt19937& aRng) {
+		return Vec3f{ dist( aRng ), dist( aRng ), dist( aRng ) };
+	} );
+}
+inline
+std::vector<Vec4f> random_vec4s( std::size_t aCount, unsigned aSeed )
+{
+	std::uniform_real_distribution<float> dist( -10.f, 10.f );
+	return random_values<Vec4f>( aCount, aSeed, [&] (std::mt19937& aRng) {
+		return Vec4f{ dist( aRng ), dist( aRng ), dist( aRng ), dist( aRng ) };
+	} );
+}
+
+// Arbitrary matrices, all elements in [-10, 10)
+inline
+std::vector<Mat44f> random_mat44s( std::size_t aCount, unsigned aSeed )
+{
+	std::uniform_real_distribution<float> dist( -10.f, 10.f );
+	return random_values<Mat44f>( aCount, aSeed, [&] (std::mt19937& aRng) {
+		Mat44f ret;
+		for( auto& v : ret.v )
+			v = dist( aRng );
+		return ret;
+	} );
+}
+
+// Random translations, rotations and scalings, composed as Mat44f
+inline
+std::vector<Mat44f> random_affine_transforms( std::size_t aCount, unsigned aSeed )
+{
+	std::uniform_real_distribution<float> angle( -3.f, 3.f );
+	std::uniform_real_distribution<float> scale( 0.5f, 2.f );
+	std::uniform_real_distribution<float> offset( -10.f, 10.f );
+	return random_values<Mat44f>( aCount, aSeed, [&] (std::mt19937& aRng) {
+		return make_translation( { offset( aRng ), offset( aRng ), offset( aRng ) } )
+			* make_rotation_y( angle( aRng ) )
+			* make_rotation_x( angle( aRng ) )
+			* make_scaling( scale( aRng ), scale( aRng ), scale( aRng ) );
+	} );
+}
+
+// Within a relative tolerance, or an absolute one (near zero). Use as
+// REQUIRE_THAT( value, close_to( expected ) ).
+//
+// Unlike WithinRel( ... ) || WithinAbs( ... ), this can be returned from a
+// function: Catch's combined matchers only refer to their parts.
+class CloseToMatcher final : public Catch::Matchers::MatcherBase<float>
+{
+	public:
+		CloseToMatcher( float aTarget, float aRelative, float aAbsolute )
+			: mRelative( Catch::Matchers::WithinRel( aTarget, aRelative ) )
+			, mAbsolute( Catch::Matchers::WithinAbs( aTarget, aAbsolute ) )
+		{}
+
+	public:
+		bool match( float const& aValue ) const override
+		{
+			return mRelative.match( aValue ) || mAbsolute.match( aValue );
+		}
+
+		std::string describe() const override
+		{
+			return mRelative.describe() + " or " + mAbsolute.describe();
+		}
+
+	private:
+		Catch::Matchers::WithinRelMatcher mRelative;
+		Catch::Matchers::WithinAbsMatcher mAbsolute;
+};
+
+inline
+CloseToMatcher close_to( float aTarget, float aRelative = 1e-5f, float aAbsolute = 1e-5f )
+{
+	return CloseToMatcher( aTarget, aRelative, aAbsolute );
+}
+
+// REQUIRE_THAT( aValue, close_to( aExpected ) ), componentwise for vectors
+// and matrices
+inline
+void require_close( float aValue, float aExpected, float aRelative = 1e-5f )
+{
+	REQUIRE_THAT( aValue, close_to( aExpected, aRelative ) );
+}
+inline
+void require_close( Vec3f aValue, Vec3f aExpected, float aRelative = 1e-5f )
+{
+	REQUIRE_THAT( aValue.x, close_to( aExpected.x, aRelative ) );
+	REQUIRE_THAT( aValue.y, close_to( aExpected.y, aRelative ) );
+	REQUIRE_THAT( aValue.z, close_to( aExpected.z, aRelative ) );
+}
+inline
+void require_close( Vec4f aValue, Vec4f aExpected, float aRelative = 1e-5f )
+{
+	REQUIRE_THAT( aValue.x, close_to( aExpected.x, aRelative ) );
+	REQUIRE_THAT( aValue.y, close_to( aExpected.y, aRelative ) );
+	REQUIRE_THAT( aValue.z, close_to( aExpected.z, aRelative ) );
+	REQUIRE_THAT( aValue.w, close_to( aExpected.w, aRelative ) );
+}
+inline
+void require_close( Mat44f const& aValue, Mat44f const& aExpected, float aRelative = 1e-5f )
+{
+	for( std::size_t i = 0; i < 16; ++i )
+		REQUIRE_THAT( aValue.v[i], close_to( aExpected.v[i], aRelative ) );
+}
+
+#endif // COMMON_HPP_9C41E7B2_6A0D_4F58_B3E1_27D84F06A5C9
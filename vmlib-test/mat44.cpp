@@ -0,0 +1,176 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <vector>
+
+#include <cstring>
+
+#include "common.hpp"
+
+#include "../vmlib/mat44.hpp"
+
+namespace
+{
+	// The SIMD kernels must give exactly the scalar results, including in
+	// constant expressions (where the scalar code runs).
+	constexpr Mat44f kLeft_ = { {
+		1.f, 2.f, 3.f, 4.f,
+		5.f, 6.f, 7.f, 8.f,
+		9.f, 10.f, 11.f, 12.f,
+		13.f, 14.f, 15.f, 16.f
+	} };
+	constexpr Mat44f kRight_ = { {
+		17.f, 18.f, 19.f, 20.f,
+		21.f, 22.f, 23.f, 24.f,
+		25.f, 26.f, 27.f, 28.f,
+		29.f, 30.f, 31.f, 32.f
+	} };
+
+	constexpr Mat44f kProduct_ = kLeft_ * kRight_;
+	static_assert( 250.f == kProduct_(0,0) && 1528.f == kProduct_(3,3) );
+
+	constexpr Vec4f kTransformed_ = kLeft_ * Vec4f{ 1.f, 2.f, 3.f, 4.f };
+	static_assert( 30.f == kTransformed_.x && 150.f == kTransformed_.w );
+
+	// The products above are exact either way. With non-integer elements,
+	// rounding differs if the compiler fuses multiplies and adds (see
+	// mat44.hpp), so these are compared at run time below.
+	constexpr Mat44f kFracLeft_ = { {
+		0.1f, -1.7f, 2.3f, 0.35f,
+		1.9f, 0.7f, -0.45f, 3.1f,
+		-2.6f, 0.15f, 1.3f, -0.9f,
+		0.55f, 2.2f, -1.1f, 1.05f
+	} };
+	constexpr Mat44f kFracRight_ = { {
+		1.3f, 0.27f, -0.8f, 2.9f,
+		-0.33f, 1.7f, 0.6f, -1.4f,
+		2.05f, -0.95f, 1.15f, 0.4f,
+		0.7f, 0.19f, -2.3f, 1.6f
+	} };
+
+	constexpr Mat44f kFracProduct_ = kFracLeft_ * kFracRight_;
+	constexpr Vec4f kFracTransformed_ = kFracLeft_ * Vec4f{ 0.3f, -1.9f, 2.7f, 1.f };
+
+	// A copy that the compiler can't see through, so that products with it
+	// are computed at run time.
+	Mat44f opaque_( Mat44f const& aM )
+	{
+		Mat44f ret;
+		volatile float const* src = aM.v;
+		for( std::size_t i = 0; i < 16; ++i )
+			ret.v[i] = src[i];
+		return ret;
+	}
+
+	bool same_bits_( Mat44f const& aA, Mat44f const& aB )
+	{
+		return 0 == std::memcmp( aA.v, aB.v, sizeof(aA.v) );
+	}
+}
+
+TEST_CASE( "Run-time products match constant-evaluated ones", "[mat44][simd]" )
+{
+	auto const left = opaque_( kFracLeft_ );
+	auto const right = opaque_( kFracRight_ );
+
+	REQUIRE( same_bits_( left * right, kFracProduct_ ) );
+	REQUIRE( same_bits_( multiply_scalar( left, right ), kFracProduct_ ) );
+
+	auto const v = left * Vec4f{ 0.3f, -1.9f, 2.7f, 1.f };
+	REQUIRE( 0 == std::memcmp( &v, &kFracTransformed_, sizeof(v) ) );
+}
+
+TEST_CASE( "SIMD matrix products match the scalar code", "[mat44][simd]" )
+{
+	auto const matrices = random_mat44s( 1000, 1 );
+
+	SECTION( "Matrix-matrix" )
+	{
+		for( std::size_t i = 0; i + 1 < matrices.size(); ++i )
+		{
+			auto const& a = matrices[i];
+			auto const& b = matrices[i+1];
+			REQUIRE( same_bits_( a * b, multiply_scalar( a, b ) ) );
+		}
+	}
+
+	SECTION( "Matrix-vector" )
+	{
+		for( std::size_t i = 0; i + 1 < matrices.size(); ++i )
+		{
+			auto const& m = matrices[i];
+			auto const& n = matrices[i+1];
+			Vec4f const v{ n.v[0], n.v[1], n.v[2], n.v[3] };
+
+			auto const simd = m * v;
+			auto const scalar = multiply_scalar( m, v );
+			REQUIRE( 0 == std::memcmp( &simd, &scalar, sizeof(Vec4f) ) );
+		}
+	}
+}
+
+TEST_CASE( "Batched matrix products", "[mat44][simd]" )
+{
+	auto const count = GENERATE( std::size_t(0), 1, 2, 7, 1000 );
+
+	auto const left = random_mat44s( 1, 2 ).front();
+	auto const right = random_mat44s( count, 3 );
+
+	SECTION( "Separate output" )
+	{
+		std::vector<Mat44f> out( count );
+		multiply_many( left, right.data(), out.data(), count );
+
+		for( std::size_t i = 0; i < count; ++i )
+			REQUIRE( same_bits_( out[i], multiply_scalar( left, right[i] ) ) );
+	}
+	SECTION( "In place" )
+	{
+		auto out = right;
+		multiply_many( left, out.data(), out.data(), count );
+
+		for( std::size_t i = 0; i < count; ++i )
+			REQUIRE( same_bits_( out[i], multiply_scalar( left, right[i] ) ) );
+	}
+}
+
+VMLIB_BENCHMARK_CASE( "Matrix product benchmark", "[mat44]" )
+{
+	constexpr std::size_t kCount = 10000;
+
+	auto const projCameraWorld = random_mat44s( 1, 4 ).front();
+	auto const models = random_mat44s( kCount, 5 );
+	std::vector<Mat44f> out( kCount );
+
+	BENCHMARK( "MVP, scalar" )
+	{
+		for( std::size_t i = 0; i < kCount; ++i )
+			out[i] = multiply_scalar( projCameraWorld, models[i] );
+		return out[kCount-1].v[0];
+	};
+	BENCHMARK( "MVP, operator*" )
+	{
+		for( std::size_t i = 0; i < kCount; ++i )
+			out[i] = projCameraWorld * models[i];
+		return out[kCount-1].v[0];
+	};
+	BENCHMARK( "MVP, multiply_many" )
+	{
+		multiply_many( projCameraWorld, models.data(), out.data(), kCount );
+		return out[kCount-1].v[0];
+	};
+
+	BENCHMARK( "matrix-vector, scalar" )
+	{
+		Vec4f sum{ 0.f, 0.f, 0.f, 0.f };
+		for( std::size_t i = 0; i < kCount; ++i )
+			sum += multiply_scalar( models[i], Vec4f{ 1.f, 2.f, 3.f, 1.f } );
+		return sum;
+	};
+	BENCHMARK( "matrix-vector, operator*" )
+	{
+		Vec4f sum{ 0.f, 0.f, 0.f, 0.f };
+		for( std::size_t i = 0; i < kCount; ++i )
+			sum += models[i] * Vec4f{ 1.f, 2.f, 3.f, 1.f };
+		return sum;
+	};
+}
@@ -0,0 +1,131 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <vector>
+
+#include "common.hpp"
+
+#include "../vmlib/packet.hpp"
+
+TEST_CASE( "Packet gather and scatter", "[packet]" )
+{
+	auto const count = GENERATE( std::size_t(1), 3, 7, 8, 9, 16, 21 );
+
+	SECTION( "Vec3f" )
+	{
+		auto const in = random_vec3s( count, 1 );
+		std::vector<Vec3f> out( count, Vec3f{ -1.f, -1.f, -1.f } );
+
+		for( std::size_t i = 0; i < count; i += 8 )
+		{
+			auto const p = gather( in, i );
+			for( std::size_t j = 0; j < 8; ++j )
+			{
+				auto const v = extract( p, j );
+				if( i + j < count )
+				{
+					REQUIRE( v.x == in[i+j].x );
+					REQUIRE( v.y == in[i+j].y );
+					REQUIRE( v.z == in[i+j].z );
+				}
+				else
+				{
+					REQUIRE( (0.f == v.x && 0.f == v.y && 0.f == v.z) );
+				}
+			}
+
+			scatter( out, i, p );
+		}
+
+		for( std::size_t i = 0; i < count; ++i )
+			REQUIRE( (out[i].x == in[i].x && out[i].y == in[i].y && out[i].z == in[i].z) );
+	}
+
+	SECTION( "Vec4f" )
+	{
+		auto const in = random_vec4s( count, 2 );
+		std::vector<Vec4f> out( count, Vec4f{ -1.f, -1.f, -1.f, -1.f } );
+
+		for( std::size_t i = 0; i < count; i += 8 )
+		{
+			auto const p = gather( in, i );
+			for( std::size_t j = 0; j < 8; ++j )
+			{
+				auto const v = extract( p, j );
+				if( i + j < count )
+					REQUIRE( (v.x == in[i+j].x && v.y == in[i+j].y && v.z == in[i+j].z && v.w == in[i+j].w) );
+				else
+					REQUIRE( (0.f == v.x && 0.f == v.y && 0.f == v.z && 0.f == v.w) );
+			}
+
+			scatter( out, i, p );
+		}
+
+		for( std::size_t i = 0; i < count; ++i )
+			REQUIRE( (out[i].x == in[i].x && out[i].y == in[i].y && out[i].z == in[i].z && out[i].w == in[i].w) );
+	}
+}
+
+TEST_CASE( "Packet operations match Vec3f and Vec4f", "[packet]" )
+{
+	auto const a = random_vec3s( 8, 3 );
+	auto const b = random_vec3s( 8, 4 );
+	auto const pa = gather( a.data() );
+	auto const pb = gather( b.data() );
+
+	std::vector<float> s( 8 );
+	for( std::size_t i = 0; i < 8; ++i )
+		s[i] = 1.f + float(i);
+	auto const ps = load_floatx8( s.data() );
+
+	SECTION( "Arithmetic" )
+	{
+		for( std::size_t i = 0; i < 8; ++i )
+		{
+			require_close( extract( pa + pb, i ), a[i] + b[i] );
+			require_close( extract( pa - pb, i ), a[i] - b[i] );
+			require_close( extract( -pa, i ), -a[i] );
+			require_close( extract( 2.f * pa, i ), 2.f * a[i] );
+			require_close( extract( pa * ps, i ), a[i] * s[i] );
+			require_close( extract( pa / 4.f, i ), a[i] / 4.f );
+			require_close( extract( pa / ps, i ), a[i] / s[i] );
+		}
+
+		auto c = pa;
+		c += pb;
+		c *= ps;
+		c -= pa;
+		c /= 2.f;
+		for( std::size_t i = 0; i < 8; ++i )
+			require_close( extract( c, i ), ((a[i] + b[i]) * s[i] - a[i]) / 2.f );
+	}
+
+	SECTION( "Functions" )
+	{
+		for( std::size_t i = 0; i < 8; ++i )
+		{
+			require_close( extract( dot( pa, pb ), i ), dot( a[i], b[i] ) );
+			require_close( extract( length( pa ), i ), length( a[i] ) );
+			require_close( extract( normalize( pa ), i ), normalize( a[i] ) );
+			require_close( extract( min( pa.x, pb.x ), i ), std::min( a[i].x, b[i].x ) );
+			require_close( extract( max( pa.x, pb.x ), i ), std::max( a[i].x, b[i].x ) );
+		}
+	}
+
+	SECTION( "Matrices" )
+	{
+		Mat44f const m = make_perspective_projection( 1.f, 1.5f, 0.1f, 100.f ) * make_rotation_y( 0.3f );
+		Mat33f const n = mat44_to_mat33( make_rotation_x( 0.6f ) * make_scaling( 1.f, 2.f, 3.f ) );
+		Affine34f const t = make_affine( make_translation( { 1.f, 2.f, 3.f } ) * make_rotation_z( 1.1f ) );
+
+		auto const v = random_vec4s( 8, 5 );
+		auto const pv = gather( v.data() );
+
+		for( std::size_t i = 0; i < 8; ++i )
+		{
+			require_close( extract( m * pv, i ), m * v[i] );
+			require_close( extract( n * pa, i ), n * a[i] );
+			require_close( extract( transform_point( t, pa ), i ), transform_point( t, a[i] ) );
+			require_close( extract( transform_direction( t, pa ), i ), transform_direction( t, a[i] ) );
+		}
+	}
+}
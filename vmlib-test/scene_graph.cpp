@@ -0,0 +1,219 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "common.hpp"
+
+#include "../vmlib/scene_graph.hpp"
+
+namespace
+{
+	std::vector<Affine34f> random_locals_( std::size_t aCount, unsigned aSeed )
+	{
+		auto const transforms = random_affine_transforms( aCount, aSeed );
+
+		std::vector<Affine34f> ret( aCount );
+		for( std::size_t i = 0; i < aCount; ++i )
+			ret[i] = make_affine( transforms[i] );
+		return ret;
+	}
+
+	// World transforms of all nodes, computed from scratch
+	std::vector<Affine34f> recompute_( SceneGraph const& aGraph )
+	{
+		std::vector<Affine34f> ret( aGraph.size() );
+		for( SceneNode i = 0; i < aGraph.size(); ++i )
+		{
+			auto const parent = aGraph.parent( i );
+			ret[i] = kNoSceneNode == parent
+				? aGraph.local( i )
+				: ret[parent] * aGraph.local( i )
+			;
+		}
+		return ret;
+	}
+
+	// Same operations in the same order, so the results are exact
+	void require_recomputed_( SceneGraph const& aGraph )
+	{
+		auto const expected = recompute_( aGraph );
+		for( SceneNode i = 0; i < aGraph.size(); ++i )
+		{
+			for( std::size_t j = 0; j < 12; ++j )
+				REQUIRE( aGraph.world( i ).v[j] == expected[i].v[j] );
+		}
+	}
+}
+
+TEST_CASE( "Scene graph updates match a full recompute", "[scene_graph]" )
+{
+	auto const locals = random_locals_( 1000, 1 );
+
+	std::mt19937 rng( 2 );
+	auto const random_local = [&] {
+		return locals[rng() % locals.size()];
+	};
+
+	for( int round = 0; round < 50; ++round )
+	{
+		SceneGraph graph;
+
+		auto const count = 1 + rng() % 300;
+		for( SceneNode i = 0; i < count; ++i )
+		{
+			auto const parent = (0 == i || 0 == rng() % 5) ? kNoSceneNode : SceneNode(rng() % i);
+			graph.add( parent, random_local() );
+		}
+
+		REQUIRE( count == graph.update() );
+		require_recomputed_( graph );
+
+		for( int frame = 0; frame < 20; ++frame )
+		{
+			auto const edits = rng() % 5;
+			for( std::size_t i = 0; i < edits; ++i )
+				graph.set_local( SceneNode(rng() % graph.size()), random_local() );
+
+			if( 0 == rng() % 4 )
+				graph.add( SceneNode(rng() % graph.size()), random_local() );
+
+			auto const changed = graph.update();
+			REQUIRE( changed == graph.changed().size() );
+			REQUIRE( changed <= graph.visited() );
+
+			auto nodes = graph.changed();
+			std::sort( nodes.begin(), nodes.end() );
+			REQUIRE( std::adjacent_find( nodes.begin(), nodes.end() ) == nodes.end() );
+
+			require_recomputed_( graph );
+		}
+	}
+}
+
+TEST_CASE( "Scene graph updates only dirty subtrees", "[scene_graph]" )
+{
+	auto const locals = random_locals_( 4, 3 );
+
+	SceneGraph graph;
+	auto const a = graph.add( kNoSceneNode, locals[0] );
+	auto const b = graph.add( a, locals[1] );
+	auto const c = graph.add( kNoSceneNode, locals[2] );
+	auto const d = graph.add( b, locals[3] );
+
+	REQUIRE( 4 == graph.update() );
+
+	SECTION( "Static" )
+	{
+		REQUIRE( 0 == graph.update() );
+		REQUIRE( graph.changed().empty() );
+	}
+
+	SECTION( "Leaf" )
+	{
+		graph.set_local( c, locals[0] );
+		REQUIRE( 1 == graph.update() );
+		REQUIRE( std::vector<SceneNode>{ c } == graph.changed() );
+	}
+
+	SECTION( "Subtree" )
+	{
+		graph.set_local( b, locals[0] );
+		REQUIRE( 2 == graph.update() );
+		REQUIRE( std::vector<SceneNode>{ b, d } == graph.changed() );
+	}
+
+	SECTION( "Nested" )
+	{
+		// d is below a; it must not be updated twice
+		graph.set_local( d, locals[0] );
+		graph.set_local( a, locals[1] );
+		REQUIRE( 3 == graph.update() );
+		REQUIRE( std::vector<SceneNode>{ a, b, d } == graph.changed() );
+	}
+
+	require_recomputed_( graph );
+}
+
+TEST_CASE( "Scene graph subtrees stay contiguous", "[scene_graph]" )
+{
+	constexpr std::size_t kStatic = 1000;
+
+	auto const locals = random_locals_( 4, 5 );
+
+	// The child is added after many unrelated nodes
+	SceneGraph graph;
+	auto const parent = graph.add( kNoSceneNode, locals[0] );
+	for( std::size_t i = 0; i < kStatic; ++i )
+		graph.add( kNoSceneNode, locals[1] );
+	auto const child = graph.add( parent, locals[2] );
+	auto const grandchild = graph.add( child, locals[3] );
+
+	REQUIRE( kStatic + 3 == graph.update() );
+	REQUIRE( parent == graph.parent( child ) );
+	REQUIRE( child == graph.parent( grandchild ) );
+	require_recomputed_( graph );
+
+	graph.set_local( parent, locals[3] );
+	REQUIRE( 3 == graph.update() );
+	REQUIRE( std::vector<SceneNode>{ parent, child, grandchild } == graph.changed() );
+	REQUIRE( 3 == graph.visited() );
+	require_recomputed_( graph );
+
+	graph.set_local( child, locals[0] );
+	REQUIRE( 2 == graph.update() );
+	REQUIRE( 2 == graph.visited() );
+	require_recomputed_( graph );
+
+	// Nodes added in the middle keep their handles
+	auto const sibling = graph.add( parent, locals[1] );
+	graph.set_local( SceneNode(kStatic), locals[2] );
+	REQUIRE( 2 == graph.update() );
+	REQUIRE( std::vector<SceneNode>{ sibling, SceneNode(kStatic) } == graph.changed() );
+	REQUIRE( 2 == graph.visited() );
+	require_recomputed_( graph );
+}
+
+VMLIB_BENCHMARK_CASE( "Scene graph benchmark", "[scene_graph]" )
+{
+	constexpr std::size_t kStatic = 50000;
+
+	auto const locals = random_locals_( 100, 4 );
+
+	// A small moving subtree among many static nodes. Half of its children
+	// are added last, after the static ones.
+	SceneGraph graph;
+	auto const root = graph.add( kNoSceneNode, locals[0] );
+	for( std::size_t i = 0; i < 5; ++i )
+		graph.add( root, locals[i] );
+
+	SceneNode group = kNoSceneNode;
+	for( std::size_t i = 0; i < kStatic; ++i )
+	{
+		if( 0 == i % 100 )
+			group = graph.add( kNoSceneNode, locals[i % locals.size()] );
+		else
+			graph.add( group, locals[i % locals.size()] );
+	}
+
+	for( std::size_t i = 5; i < 10; ++i )
+		graph.add( root, locals[i] );
+
+	graph.update();
+
+	std::size_t frame = 0;
+	BENCHMARK( "update, one moving subtree" )
+	{
+		graph.set_local( root, locals[++frame % locals.size()] );
+		return graph.update();
+	};
+	BENCHMARK( "update, static" )
+	{
+		return graph.update();
+	};
+	BENCHMARK( "full recompute" )
+	{
+		return recompute_( graph ).size();
+	};
+}
@@ -0,0 +1,123 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <vector>
+
+#include "common.hpp"
+
+#include "../vmlib/transform.hpp"
+
+namespace
+{
+	// A typical pre-transform (affine) and a projection (not affine)
+	Mat44f const kAffine_ = make_rotation_z( 0.7f ) * make_scaling( 2.f, 0.5f, 1.5f ) * make_translation( { 1.f, -2.f, 3.f } );
+	Mat44f const kProjective_ = make_perspective_projection( 1.f, 1.5f, 0.1f, 100.f ) * make_translation( { 0.f, 0.f, -30.f } );
+}
+
+TEST_CASE( "Batch point transform", "[transform]" )
+{
+	auto const matrix = GENERATE( kAffine_, kProjective_ );
+	auto const count = GENERATE( std::size_t(0), 1, 3, 4, 7, 8, 9, 17, 1000 );
+
+	auto const in = random_vec3s( count, 1 );
+	std::vector<Vec3f> expected( count ), out( count );
+
+	transform_points_scalar( matrix, in.data(), expected.data(), count );
+
+	SECTION( "Separate output" )
+	{
+		transform_points( matrix, in.data(), out.data(), count );
+	}
+	SECTION( "In place" )
+	{
+		out = in;
+		transform_points( matrix, out.data(), out.data(), count );
+	}
+
+	for( std::size_t i = 0; i < count; ++i )
+		require_close( out[i], expected[i] );
+}
+
+TEST_CASE( "Batch normal transform", "[transform]" )
+{
+	auto const normalMatrix = mat44_to_mat33( transpose( invert( kAffine_ ) ) );
+	auto const count = GENERATE( std::size_t(0), 1, 5, 8, 13, 1000 );
+
+	auto const in = random_vec3s( count, 2 );
+	std::vector<Vec3f> expected( count ), out( count );
+
+	transform_normals_scalar( normalMatrix, in.data(), expected.data(), count );
+	transform_normals( normalMatrix, in.data(), out.data(), count );
+
+	for( std::size_t i = 0; i < count; ++i )
+		require_close( out[i], expected[i] );
+}
+
+TEST_CASE( "Batch normalization", "[transform]" )
+{
+	auto const count = GENERATE( std::size_t(0), 1, 6, 8, 15, 1000 );
+
+	auto const in = random_vec3s( count, 4 );
+	std::vector<Vec3f> expected( count ), out( count );
+
+	normalize_vectors_scalar( in.data(), expected.data(), count );
+	normalize_vectors( in.data(), out.data(), count );
+
+	for( std::size_t i = 0; i < count; ++i )
+		require_close( out[i], expected[i] );
+}
+
+VMLIB_BENCHMARK_CASE( "Batch transform benchmark", "[transform]" )
+{
+	constexpr std::size_t kCount = 100000;
+
+	auto const in = random_vec3s( kCount, 3 );
+	std::vector<Vec3f> out( kCount );
+
+	auto const normalMatrix = mat44_to_mat33( transpose( invert( kAffine_ ) ) );
+
+	WARN( "SIMD path: " << transform_simd_path() );
+
+	BENCHMARK( "points, scalar" )
+	{
+		transform_points_scalar( kAffine_, in.data(), out.data(), kCount );
+		return out[kCount-1].x;
+	};
+	BENCHMARK( "points, batch" )
+	{
+		transform_points( kAffine_, in.data(), out.data(), kCount );
+		return out[kCount-1].x;
+	};
+
+	BENCHMARK( "projected points, scalar" )
+	{
+		transform_points_scalar( kProjective_, in.data(), out.data(), kCount );
+		return out[kCount-1].x;
+	};
+	BENCHMARK( "projected points, batch" )
+	{
+		transform_points( kProjective_, in.data(), out.data(), kCount );
+		return out[kCount-1].x;
+	};
+
+	BENCHMARK( "normals, scalar" )
+	{
+		transform_normals_scalar( normalMatrix, in.data(), out.data(), kCount );
+		return out[kCount-1].x;
+	};
+	BENCHMARK( "normals, batch" )
+	{
+		transform_normals( normalMatrix, in.data(), out.data(), kCount );
+		return out[kCount-1].x;
+	};
+
+	BENCHMARK( "normalize, scalar" )
+	{
+		normalize_vectors_scalar( in.data(), out.data(), kCount );
+		return out[kCount-1].x;
+	};
+	BENCHMARK( "normalize, batch" )
+	{
+		normalize_vectors( in.data(), out.data(), kCount );
+		return out[kCount-1].x;
+	};
+}
@@ -0,0 +1,201 @@
+#include <catch2/catch_amalgamated.hpp>
+
+#include <tuple>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "common.hpp"
+
+#include "../vmlib/typed_transform.hpp"
+
+namespace
+{
+	// Result kinds are decided at compile time.
+	static_assert( std::is_same_v<decltype(translation( {} ) * translation( {} )), Translation> );
+	static_assert( std::is_same_v<decltype(scaling( 1.f, 2.f, 3.f ) * scaling( 1.f, 2.f, 3.f )), Scale> );
+	static_assert( std::is_same_v<decltype(rotation_y( 0.f ) * rotation_y( 0.f )), RotationY> );
+	static_assert( std::is_same_v<decltype(translation( {} ) * rotation_y( 0.f ) * rotation_x( 0.f )), Affine34f> );
+	static_assert( std::is_same_v<decltype(kIdentity44f * scaling( 1.f, 1.f, 1.f )), Mat44f> );
+
+	// ... and so are products that don't need sin() and cos().
+	constexpr Affine34f kPlaced_ = translation( { 1.f, 2.f, 3.f } ) * scaling( 2.f, 2.f, 2.f ) * translation( { 1.f, 0.f, 0.f } );
+	static_assert( 3.f == kPlaced_(0,3) && 2.f == kPlaced_(1,1) );
+
+	// A typed transform and the dense matrix that it stands for, built from
+	// the same parameters.
+	template< typename tType >
+	struct Sample_
+	{
+		tType typed;
+		Mat44f dense;
+	};
+
+	template< typename tType >
+	Sample_<tType> sample_( std::mt19937& aRng )
+	{
+		std::uniform_real_distribution<float> angle( -3.f, 3.f );
+		std::uniform_real_distribution<float> scale( 0.25f, 4.f );
+		std::uniform_real_distribution<float> offset( -10.f, 10.f );
+
+		if constexpr( std::is_same_v<tType, Translation> )
+		{
+			Vec3f const t{ offset( aRng ), offset( aRng ), offset( aRng ) };
+			return { translation( t ), make_translation( t ) };
+		}
+		else if constexpr( std::is_same_v<tType, RotationX> )
+		{
+			float const a = angle( aRng );
+			return { rotation_x( a ), make_rotation_x( a ) };
+		}
+		else if constexpr( std::is_same_v<tType, RotationY> )
+		{
+			float const a = angle( aRng );
+			return { rotation_y( a ), make_rotation_y( a ) };
+		}
+		else if constexpr( std::is_same_v<tType, RotationZ> )
+		{
+			float const a = angle( aRng );
+			return { rotation_z( a ), make_rotation_z( a ) };
+		}
+		else
+		{
+			float const x = scale( aRng ), y = scale( aRng ), z = scale( aRng );
+			return { scaling( x, y, z ), make_scaling( x, y, z ) };
+		}
+	}
+
+	auto samples_( std::mt19937& aRng )
+	{
+		return std::make_tuple(
+			sample_<Translation>( aRng ),
+			sample_<RotationX>( aRng ),
+			sample_<RotationY>( aRng ),
+			sample_<RotationZ>( aRng ),
+			sample_<Scale>( aRng )
+		);
+	}
+
+	using Samples_ = decltype(samples_( std::declval<std::mt19937&>() ));
+
+	// vmlib-test is built without contracting into fused multiply-adds (see
+	// typed_transform.hpp), so the results must match exactly.
+	void require_equal_( Mat44f const& aA, Mat44f const& aB )
+	{
+		for( std::size_t i = 0; i < 16; ++i )
+			REQUIRE( aA.v[i] == aB.v[i] );
+	}
+}
+
+TEST_CASE( "Typed transforms match the dense products", "[typed_transform]" )
+{
+	// A general affine transform to compose with
+	Mat44f const dense = make_translation( { 1.f, -2.f, 3.f } )
+		* make_rotation_x( 0.4f ) * make_rotation_y( -1.2f ) * make_rotation_z( 2.1f )
+		* make_scaling( 0.5f, 2.f, 1.5f );
+	Affine34f const affine = make_affine( dense );
+
+	auto const rounds = random_values<Samples_>( 50, 1, samples_ );
+
+	SECTION( "Conversions" )
+	{
+		for( auto const& samples : rounds )
+		{
+			std::apply( [&] (auto const&... aSample) {
+				( require_equal_( to_mat44( aSample.typed ), aSample.dense ), ... );
+			}, samples );
+		}
+	}
+
+	SECTION( "Pairs" )
+	{
+		for( auto const& samples : rounds )
+		{
+			std::apply( [&] (auto const&... aLeft) {
+				auto const with_rights = [&] (auto const& aL) {
+					std::apply( [&] (auto const&... aRight) {
+						( require_equal_( to_mat44( aL.typed * aRight.typed ), aL.dense * aRight.dense ), ... );
+					}, samples );
+				};
+				( with_rights( aLeft ), ... );
+			}, samples );
+		}
+	}
+
+	SECTION( "With Affine34f and Mat44f" )
+	{
+		for( auto const& samples : rounds )
+		{
+			std::apply( [&] (auto const&... aSample) {
+				( require_equal_( to_mat44( affine * aSample.typed ), dense * aSample.dense ), ... );
+				( require_equal_( to_mat44( aSample.typed * affine ), aSample.dense * dense ), ... );
+				( require_equal_( dense * aSample.typed, dense * aSample.dense ), ... );
+				( require_equal_( aSample.typed * dense, aSample.dense * dense ), ... );
+			}, samples );
+		}
+	}
+
+	SECTION( "Chains" )
+	{
+		for( auto const& samples : rounds )
+		{
+			auto const& [t, rx, ry, rz, s] = samples;
+
+			// Camera (see main.cpp)
+			require_equal_( to_mat44( t.typed * ry.typed * rx.typed ), t.dense * ry.dense * rx.dense );
+
+			// Object placement
+			require_equal_( to_mat44( t.typed * rz.typed * ry.typed * s.typed ), t.dense * rz.dense * ry.dense * s.dense );
+			require_equal_( to_mat44( rz.typed * s.typed * t.typed ), rz.dense * s.dense * t.dense );
+		}
+	}
+}
+
+VMLIB_BENCHMARK_CASE( "Typed transform benchmark", "[typed_transform]" )
+{
+	constexpr std::size_t kCount = 10000;
+
+	// Precomputed, so that sin() and cos() aren't part of the timings
+	auto const samples = random_values<Samples_>( kCount, 2, samples_ );
+
+	Mat44f const projection = make_perspective_projection( 1.f, 1.5f, 0.1f, 100.f );
+	std::vector<Mat44f> out( kCount );
+
+	BENCHMARK( "camera chain, dense" )
+	{
+		for( std::size_t i = 0; i < kCount; ++i )
+		{
+			auto const& [t, rx, ry, rz, s] = samples[i];
+			out[i] = projection * (t.dense * ry.dense * rx.dense);
+		}
+		return out[kCount-1].v[0];
+	};
+	BENCHMARK( "camera chain, typed" )
+	{
+		for( std::size_t i = 0; i < kCount; ++i )
+		{
+			auto const& [t, rx, ry, rz, s] = samples[i];
+			out[i] = projection * (t.typed * ry.typed * rx.typed);
+		}
+		return out[kCount-1].v[0];
+	};
+
+	BENCHMARK( "vehicle chain, dense" )
+	{
+		for( std::size_t i = 0; i < kCount; ++i )
+		{
+			auto const& [t, rx, ry, rz, s] = samples[i];
+			out[i] = t.dense * rz.dense * ry.dense;
+		}
+		return out[kCount-1].v[0];
+	};
+	BENCHMARK( "vehicle chain, typed" )
+	{
+		for( std::size_t i = 0; i < kCount; ++i )
+		{
+			auto const& [t, rx, ry, rz, s] = samples[i];
+			out[i] = to_mat44( t.typed * rz.typed * ry.typed );
+		}
+		return out[kCount-1].v[0];
+	};
+}
@@ -0,0 +1,155 @@
+#include "affine34.hpp"
+
+#include <cassert>
+
+namespace
+{
+#	if defined(VMLIB_AFFINE34_SIMD)
+	// Lanes 0-2 of the result are cross( aA, aB ); lane 3 is zero (aA.w*aB.w
+	// minus itself).
+	__m128 cross_( __m128 aA, __m128 aB ) noexcept
+	{
+		__m128 const a1 = _mm_shuffle_ps( aA, aA, _MM_SHUFFLE(3,0,2,1) );
+		__m128 const b1 = _mm_shuffle_ps( aB, aB, _MM_SHUFFLE(3,1,0,2) );
+		__m128 const a2 = _mm_shuffle_ps( aA, aA, _MM_SHUFFLE(3,1,0,2) );
+		__m128 const b2 = _mm_shuffle_ps( aB, aB, _MM_SHUFFLE(3,0,2,1) );
+		return _mm_sub_ps( _mm_mul_ps( a1, b1 ), _mm_mul_ps( a2, b2 ) );
+	}
+
+	// Rows of the cofactor matrix of the linear part, already divided by
+	// the determinant. The rows of the cofactor matrix are the cross
+	// products of pairs of rows of L; row k of the result is column k of
+	// the inverse of L.
+	struct ScaledCofactorsSimd_
+	{
+		__m128 c0, c1, c2;
+	};
+
+	ScaledCofactorsSimd_ scaled_cofactors_simd_( Affine34f const& aA ) noexcept
+	{
+		__m128 const r0 = _mm_loadu_ps( aA.v+0 );
+		__m128 const r1 = _mm_loadu_ps( aA.v+4 );
+		__m128 const r2 = _mm_loadu_ps( aA.v+8 );
+
+		__m128 const c0 = cross_( r1, r2 );
+		__m128 const c1 = cross_( r2, r0 );
+		__m128 const c2 = cross_( r0, r1 );
+
+		// det = dot( row 0, cofactor row 0 ) in all lanes (lane 3 of c0 is
+		// zero, so the translation in lane 3 of r0 drops out).
+		__m128 det = _mm_mul_ps( r0, c0 );
+		det = _mm_add_ps( det, _mm_shuffle_ps( det, det, _MM_SHUFFLE(2,3,0,1) ) );
+		det = _mm_add_ps( det, _mm_shuffle_ps( det, det, _MM_SHUFFLE(1,0,3,2) ) );
+		assert( 0.f != _mm_cvtss_f32( det ) );
+
+		__m128 const rcp = _mm_div_ps( _mm_set1_ps( 1.f ), det );
+
+		return { _mm_mul_ps( c0, rcp ), _mm_mul_ps( c1, rcp ), _mm_mul_ps( c2, rcp ) };
+	}
+#	else // !SIMD
+	// Cofactor matrix and determinant of the linear part. The inverse of
+	// the linear part is transpose(cofactors) / det.
+	struct Cofactors_
+	{
+		Mat33f c;
+		float det;
+	};
+
+	Cofactors_ cofactors_( Affine34f const& aA ) noexcept
+	{
+		Cofactors_ ret;
+		auto& c = ret.c;
+		c(0,0) = aA(1,1)*aA(2,2) - aA(1,2)*aA(2,1);
+		c(0,1) = aA(1,2)*aA(2,0) - aA(1,0)*aA(2,2);
+		c(0,2) = aA(1,0)*aA(2,1) - aA(1,1)*aA(2,0);
+		c(1,0) = aA(0,2)*aA(2,1) - aA(0,1)*aA(2,2);
+		c(1,1) = aA(0,0)*aA(2,2) - aA(0,2)*aA(2,0);
+		c(1,2) = aA(0,1)*aA(2,0) - aA(0,0)*aA(2,1);
+		c(2,0) = aA(0,1)*aA(1,2) - aA(0,2)*aA(1,1);
+		c(2,1) = aA(0,2)*aA(1,0) - aA(0,0)*aA(1,2);
+		c(2,2) = aA(0,0)*aA(1,1) - aA(0,1)*aA(1,0);
+
+		ret.det = aA(0,0)*c(0,0) + aA(0,1)*c(0,1) + aA(0,2)*c(0,2);
+		return ret;
+	}
+#	endif // ~ SIMD
+}
+
+Affine34f invert( Affine34f const& aA ) noexcept
+{
+#	if defined(VMLIB_AFFINE34_SIMD)
+	auto [c0, c1, c2] = scaled_cofactors_simd_( aA );
+
+	// The translation -L' t is a combination of the columns of L', i.e., of
+	// the scaled cofactor rows. With it as the fourth row, a 4x4 transpose
+	// gives the rows of the result.
+	__m128 const r0 = _mm_loadu_ps( aA.v+0 );
+	__m128 const r1 = _mm_loadu_ps( aA.v+4 );
+	__m128 const r2 = _mm_loadu_ps( aA.v+8 );
+
+	__m128 t = _mm_mul_ps( _mm_shuffle_ps( r0, r0, _MM_SHUFFLE(3,3,3,3) ), c0 );
+	t = _mm_add_ps( t, _mm_mul_ps( _mm_shuffle_ps( r1, r1, _MM_SHUFFLE(3,3,3,3) ), c1 ) );
+	t = _mm_add_ps( t, _mm_mul_ps( _mm_shuffle_ps( r2, r2, _MM_SHUFFLE(3,3,3,3) ), c2 ) );
+	t = _mm_sub_ps( _mm_setzero_ps(), t );
+
+	_MM_TRANSPOSE4_PS( c0, c1, c2, t );
+
+	Affine34f ret;
+	_mm_storeu_ps( ret.v+0, c0 );
+	_mm_storeu_ps( ret.v+4, c1 );
+	_mm_storeu_ps( ret.v+8, c2 );
+	return ret;
+#	else // !SIMD
+	auto const [c, det] = cofactors_( aA );
+	assert( 0.f != det );
+	float const rcp = 1.f / det;
+
+	Affine34f ret{};
+	for( std::size_t i = 0; i < 3; ++i )
+	{
+		for( std::size_t j = 0; j < 3; ++j )
+			ret(i,j) = c(j,i) * rcp;
+	}
+
+	for( std::size_t i = 0; i < 3; ++i )
+		ret(i,3) = -(ret(i,0) * aA(0,3) + ret(i,1) * aA(1,3) + ret(i,2) * aA(2,3));
+
+	return ret;
+#	endif // ~ SIMD
+}
+
+Mat33f normal_matrix( Affine34f const& aA ) noexcept
+{
+#	if defined(VMLIB_AFFINE34_SIMD)
+	auto const [c0, c1, c2] = scaled_cofactors_simd_( aA );
+
+	// Mat33f rows are three floats apart; the last row goes through a
+	// temporary so the store stays in bounds.
+	Mat33f ret;
+	float last[4];
+	_mm_storeu_ps( ret.v+0, c0 );
+	_mm_storeu_ps( ret.v+3, c1 );
+	_mm_storeu_ps( last, c2 );
+	ret.v[6] = last[0];
+	ret.v[7] = last[1];
+	ret.v[8] = last[2];
+	return ret;
+#	else // !SIMD
+	auto const [c, det] = cofactors_( aA );
+	assert( 0.f != det );
+	float const rcp = 1.f / det;
+
+	Mat33f ret;
+	for( std::size_t i = 0; i < 9; ++i )
+		ret.v[i] = c.v[i] * rcp;
+	return ret;
+#	endif // ~ SIMD
+}
+
+Mat33f normal_matrix( Mat44f const& aM ) noexcept
+{
+	if( is_affine( aM ) )
+		return normal_matrix( make_affine( aM ) );
+
+	return mat44_to_mat33( transpose( invert( aM ) ) );
+}
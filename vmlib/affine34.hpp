@@ -0,0 +1,217 @@
+#ifndef AFFINE34_HPP_0D6B2F84_93E1_4C57_A8F0_5E2C71B9D43A
+#define AFFINE34_HPP_0D6B2F84_93E1_4C57_A8F0_5E2C71B9D43A
+
+#include <cassert>
+#include <cstdlib>
+
+#include "simd.hpp"
+#include "vec3.hpp"
+#include "vec4.hpp"
+#include "mat33.hpp"
+#include "mat44.hpp"
+
+/** Affine34f: affine transform (3x4 matrix with floats)
+ *
+ * An Affine34f stores the upper three rows of a 4x4 matrix whose last row is
+ * ( 0 0 0 1 ), i.e., a linear part L (the left 3x3 block) and a translation
+ * t (the last column):
+ *
+ *   ⎛ 0,0  0,1  0,2  0,3 ⎞
+ *   ⎜ 1,0  1,1  1,2  1,3 ⎟
+ *   ⎝ 2,0  2,1  2,2  2,3 ⎠
+ *
+ * Translations, rotations and scalings (make_translation() etc.), and their
+ * products, are all affine. Knowing that makes them cheaper to handle than a
+ * general Mat44f: they take 12 floats, compose with 36 multiplies instead of
+ * 64, and the inverse and the normal matrix only need the inverse of the
+ * 3x3 block (see invert() and normal_matrix()).
+ *
+ * Like Mat44f, the storage is row-major and element (i,j) is accessed with
+ * operator(). Convert with make_affine() and to_mat44().
+ */
+struct Affine34f
+{
+	float v[12];
+
+	constexpr
+	float& operator() (std::size_t aI, std::size_t aJ) noexcept
+	{
+		assert( aI < 3 && aJ < 4 );
+		return v[aI*4 + aJ];
+	}
+	constexpr
+	float const& operator() (std::size_t aI, std::size_t aJ) const noexcept
+	{
+		assert( aI < 3 && aJ < 4 );
+		return v[aI*4 + aJ];
+	}
+};
+
+// Identity transform
+constexpr Affine34f kIdentity34f = { {
+	1.f, 0.f, 0.f, 0.f,
+	0.f, 1.f, 0.f, 0.f,
+	0.f, 0.f, 1.f, 0.f
+} };
+
+// Conversions:
+
+// True if the last row of aM is exactly ( 0 0 0 1 ).
+constexpr
+bool is_affine( Mat44f const& aM ) noexcept
+{
+	return 0.f == aM(3,0) && 0.f == aM(3,1) && 0.f == aM(3,2) && 1.f == aM(3,3);
+}
+
+// Drops the last row, which must be ( 0 0 0 1 ) (see is_affine()).
+constexpr
+Affine34f make_affine( Mat44f const& aM ) noexcept
+{
+	assert( is_affine( aM ) );
+
+	return { {
+		aM.v[0], aM.v[1], aM.v[2], aM.v[3],
+		aM.v[4], aM.v[5], aM.v[6], aM.v[7],
+		aM.v[8], aM.v[9], aM.v[10], aM.v[11]
+	} };
+}
+
+// Like make_affine(), this builds the result in one go. Writing it element
+// by element would keep compilers from using wide loads and stores.
+constexpr
+Mat44f to_mat44( Affine34f const& aA ) noexcept
+{
+	return { {
+		aA.v[0], aA.v[1], aA.v[2], aA.v[3],
+		aA.v[4], aA.v[5], aA.v[6], aA.v[7],
+		aA.v[8], aA.v[9], aA.v[10], aA.v[11],
+		0.f, 0.f, 0.f, 1.f
+	} };
+}
+
+// Operators:
+
+// Composition, equal to make_affine( to_mat44( aLeft ) * to_mat44( aRight ) ).
+// As with Mat44f, operator* uses vmlib_simd::multiply() at run time where
+// available (SSE/AVX2), and multiply_scalar() in constant expressions.
+constexpr
+Affine34f multiply_scalar( Affine34f const& aLeft, Affine34f const& aRight ) noexcept
+{
+	Affine34f ret{};
+	for( std::size_t i = 0; i < 3; ++i )
+	{
+		for( std::size_t j = 0; j < 4; ++j )
+		{
+			ret(i,j) = aLeft(i,0) * aRight(0,j)
+				+ aLeft(i,1) * aRight(1,j)
+				+ aLeft(i,2) * aRight(2,j);
+		}
+		ret(i,3) += aLeft(i,3);
+	}
+	return ret;
+}
+
+#if defined(VMLIB_SIMD_AVX2) || defined(VMLIB_SIMD_SSE)
+#	define VMLIB_AFFINE34_SIMD 1
+
+namespace vmlib_simd
+{
+	// Row i of the product is sum_k aLeft(i,k) * (row k of aRight), plus
+	// aLeft(i,3) in the last column.
+	inline
+	Affine34f multiply( Affine34f const& aLeft, Affine34f const& aRight ) noexcept
+	{
+		__m128 const r0 = _mm_loadu_ps( aRight.v+0 );
+		__m128 const r1 = _mm_loadu_ps( aRight.v+4 );
+		__m128 const r2 = _mm_loadu_ps( aRight.v+8 );
+		__m128 const w = _mm_castsi128_ps( _mm_setr_epi32( 0, 0, 0, -1 ) );
+
+		Affine34f ret;
+		for( std::size_t i = 0; i < 12; i += 4 )
+		{
+			__m128 const l = _mm_loadu_ps( aLeft.v+i );
+			__m128 acc = _mm_mul_ps( _mm_shuffle_ps( l, l, _MM_SHUFFLE(0,0,0,0) ), r0 );
+			acc = _mm_add_ps( acc, _mm_mul_ps( _mm_shuffle_ps( l, l, _MM_SHUFFLE(1,1,1,1) ), r1 ) );
+			acc = _mm_add_ps( acc, _mm_mul_ps( _mm_shuffle_ps( l, l, _MM_SHUFFLE(2,2,2,2) ), r2 ) );
+			acc = _mm_add_ps( acc, _mm_and_ps( l, w ) );
+			_mm_storeu_ps( ret.v+i, acc );
+		}
+		return ret;
+	}
+}
+#endif // ~ SIMD
+
+constexpr
+Affine34f operator*( Affine34f const& aLeft, Affine34f const& aRight ) noexcept
+{
+#	if defined(VMLIB_AFFINE34_SIMD)
+	if( !VMLIB_IS_CONSTANT_EVALUATED() )
+		return vmlib_simd::multiply( aLeft, aRight );
+#	endif
+	return multiply_scalar( aLeft, aRight );
+}
+
+// Skips the implicit bottom row of aRight. This stays scalar: aRight is often
+// computed just before (e.g., from typed transforms), and reloading it with
+// wide loads costs more than the SIMD product saves.
+constexpr
+Mat44f operator*( Mat44f const& aLeft, Affine34f const& aRight ) noexcept
+{
+	auto const e = [&] (std::size_t aI, std::size_t aJ) {
+		return aLeft(aI,0) * aRight(0,aJ) + aLeft(aI,1) * aRight(1,aJ) + aLeft(aI,2) * aRight(2,aJ);
+	};
+	return { {
+		e(0,0), e(0,1), e(0,2), e(0,3) + aLeft(0,3),
+		e(1,0), e(1,1), e(1,2), e(1,3) + aLeft(1,3),
+		e(2,0), e(2,1), e(2,2), e(2,3) + aLeft(2,3),
+		e(3,0), e(3,1), e(3,2), e(3,3) + aLeft(3,3)
+	} };
+}
+
+// Transforms a homogeneous vector; w is unchanged.
+constexpr
+Vec4f operator*( Affine34f const& aLeft, Vec4f const& aRight ) noexcept
+{
+	return {
+		aLeft(0,0) * aRight.x + aLeft(0,1) * aRight.y + aLeft(0,2) * aRight.z + aLeft(0,3) * aRight.w,
+		aLeft(1,0) * aRight.x + aLeft(1,1) * aRight.y + aLeft(1,2) * aRight.z + aLeft(1,3) * aRight.w,
+		aLeft(2,0) * aRight.x + aLeft(2,1) * aRight.y + aLeft(2,2) * aRight.z + aLeft(2,3) * aRight.w,
+		aRight.w
+	};
+}
+
+// Points are translated, directions are not.
+constexpr
+Vec3f transform_point( Affine34f const& aA, Vec3f aP ) noexcept
+{
+	return {
+		aA(0,0) * aP.x + aA(0,1) * aP.y + aA(0,2) * aP.z + aA(0,3),
+		aA(1,0) * aP.x + aA(1,1) * aP.y + aA(1,2) * aP.z + aA(1,3),
+		aA(2,0) * aP.x + aA(2,1) * aP.y + aA(2,2) * aP.z + aA(2,3)
+	};
+}
+constexpr
+Vec3f transform_direction( Affine34f const& aA, Vec3f aD ) noexcept
+{
+	return {
+		aA(0,0) * aD.x + aA(0,1) * aD.y + aA(0,2) * aD.z,
+		aA(1,0) * aD.x + aA(1,1) * aD.y + aA(1,2) * aD.z,
+		aA(2,0) * aD.x + aA(2,1) * aD.y + aA(2,2) * aD.z
+	};
+}
+
+// Functions:
+
+// Inverse transform: the inverse L' of the linear part (via its cofactors),
+// and the translation -L' t. The linear part must be invertible.
+Affine34f invert( Affine34f const& aA ) noexcept;
+
+// Transpose of the inverse of the linear part, for transforming normals.
+// Same as mat44_to_mat33( transpose( invert( to_mat44( aA ) ) ) ).
+Mat33f normal_matrix( Affine34f const& aA ) noexcept;
+
+// As above for a Mat44f; takes the affine path if is_affine( aM ), and
+// inverts the full matrix otherwise.
+Mat33f normal_matrix( Mat44f const& aM ) noexcept;
+
+#endif // AFFINE34_HPP_0D6B2F84_93E1_4C57_A8F0_5E2C71B9D43A
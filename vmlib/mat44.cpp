@@ -67,3 +67,48 @@ Mat44f invert( Mat44f const& aM ) noexcept
 	return ret;
 }
 
+
+void multiply_many( Mat44f const& aLeft, Mat44f const* aRight, Mat44f* aOut, std::size_t aCount ) noexcept
+{
+	std::size_t i = 0;
+
+#	if defined(VMLIB_SIMD_AVX2)
+	// As vmlib_simd::multiply(), with the elements of aLeft splatted once
+	// for all matrices: l01[k] holds aLeft(0,k) and aLeft(1,k), l23[k] holds
+	// aLeft(2,k) and aLeft(3,k), one per lane.
+	__m256 const left01 = _mm256_loadu_ps( aLeft.v+0 );
+	__m256 const left23 = _mm256_loadu_ps( aLeft.v+8 );
+	__m256 const l01[4] = {
+		_mm256_permute_ps( left01, _MM_SHUFFLE(0,0,0,0) ), _mm256_permute_ps( left01, _MM_SHUFFLE(1,1,1,1) ),
+		_mm256_permute_ps( left01, _MM_SHUFFLE(2,2,2,2) ), _mm256_permute_ps( left01, _MM_SHUFFLE(3,3,3,3) )
+	};
+	__m256 const l23[4] = {
+		_mm256_permute_ps( left23, _MM_SHUFFLE(0,0,0,0) ), _mm256_permute_ps( left23, _MM_SHUFFLE(1,1,1,1) ),
+		_mm256_permute_ps( left23, _MM_SHUFFLE(2,2,2,2) ), _mm256_permute_ps( left23, _MM_SHUFFLE(3,3,3,3) )
+	};
+
+	for( ; i < aCount; ++i )
+	{
+		float const* right = aRight[i].v;
+		__m256 const r0 = _mm256_broadcast_ps( reinterpret_cast<__m128 const*>(right+0) );
+		__m256 const r1 = _mm256_broadcast_ps( reinterpret_cast<__m128 const*>(right+4) );
+		__m256 const r2 = _mm256_broadcast_ps( reinterpret_cast<__m128 const*>(right+8) );
+		__m256 const r3 = _mm256_broadcast_ps( reinterpret_cast<__m128 const*>(right+12) );
+
+		__m256 a = _mm256_mul_ps( l01[0], r0 );
+		__m256 b = _mm256_mul_ps( l23[0], r0 );
+		a = _mm256_add_ps( a, _mm256_mul_ps( l01[1], r1 ) );
+		b = _mm256_add_ps( b, _mm256_mul_ps( l23[1], r1 ) );
+		a = _mm256_add_ps( a, _mm256_mul_ps( l01[2], r2 ) );
+		b = _mm256_add_ps( b, _mm256_mul_ps( l23[2], r2 ) );
+		a = _mm256_add_ps( a, _mm256_mul_ps( l01[3], r3 ) );
+		b = _mm256_add_ps( b, _mm256_mul_ps( l23[3], r3 ) );
+
+		_mm256_storeu_ps( aOut[i].v+0, a );
+		_mm256_storeu_ps( aOut[i].v+8, b );
+	}
+#	endif // ~ AVX2
+
+	for( ; i < aCount; ++i )
+		aOut[i] = aLeft * aRight[i];
+}
@@ -5,6 +5,7 @@
 #include <cassert>
 #include <cstdlib>
 
+#include "simd.hpp"
 #include "vec3.hpp"
 #include "vec4.hpp"
 
@@ -54,10 +55,18 @@ constexpr Mat44f kIdentity44f = { {
 } };
 
 // Common operators for Mat44f.
-// Note that you will need to implement these yourself.
+//
+// The products use SIMD kernels (see simd.hpp) at run time, and the plain
+// scalar code in constant expressions. Both perform the same operations in
+// the same order. Their results are identical only if the compiler doesn't
+// fuse multiplies and adds in the scalar code on its own, which GCC does by
+// default (e.g., with -march=native). vmlib and vmlib-test are therefore
+// built with -ffp-contract=off (see premake5.lua). Code built without it
+// may see run-time products differ from constant-evaluated ones in the last
+// bit.
 
 constexpr
-Mat44f operator*( Mat44f const& aLeft, Mat44f const& aRight ) noexcept
+Mat44f multiply_scalar( Mat44f const& aLeft, Mat44f const& aRight ) noexcept
 {
 	Mat44f result = kIdentity44f;
 	for (int y = 0; y < 4; y++)
@@ -75,7 +84,7 @@ Mat44f operator*( Mat44f const& aLeft, Mat44f const& aRight ) noexcept
 }
 
 constexpr
-Vec4f operator*( Mat44f const& aLeft, Vec4f const& aRight ) noexcept
+Vec4f multiply_scalar( Mat44f const& aLeft, Vec4f const& aRight ) noexcept
 {
 	float x = (aLeft.v[0] * aRight.x) + (aLeft.v[1] * aRight.y) + (aLeft.v[2] * aRight.z) + (aLeft.v[3] * aRight.w);
 	float y = (aLeft.v[4] * aRight.x) + (aLeft.v[5] * aRight.y) + (aLeft.v[6] * aRight.z) + (aLeft.v[7] * aRight.w);
@@ -84,6 +93,119 @@ Vec4f operator*( Mat44f const& aLeft, Vec4f const& aRight ) noexcept
 	return { x, y, z, w };
 }
 
+#if defined(VMLIB_SIMD_AVX2) || defined(VMLIB_SIMD_SSE) || defined(VMLIB_SIMD_NEON)
+#	define VMLIB_MAT44_SIMD 1
+
+namespace vmlib_simd
+{
+	// Row i of the product is sum_k aLeft(i,k) * (row k of aRight).
+	inline
+	Mat44f multiply( Mat44f const& aLeft, Mat44f const& aRight ) noexcept
+	{
+		Mat44f ret;
+#		if defined(VMLIB_SIMD_AVX2)
+		// Two rows of the result at a time, one per 128-bit lane
+		__m256 const r0 = _mm256_broadcast_ps( reinterpret_cast<__m128 const*>(aRight.v+0) );
+		__m256 const r1 = _mm256_broadcast_ps( reinterpret_cast<__m128 const*>(aRight.v+4) );
+		__m256 const r2 = _mm256_broadcast_ps( reinterpret_cast<__m128 const*>(aRight.v+8) );
+		__m256 const r3 = _mm256_broadcast_ps( reinterpret_cast<__m128 const*>(aRight.v+12) );
+		for( int i = 0; i < 16; i += 8 )
+		{
+			__m256 const l = _mm256_loadu_ps( aLeft.v+i );
+			__m256 acc = _mm256_mul_ps( _mm256_permute_ps( l, _MM_SHUFFLE(0,0,0,0) ), r0 );
+			acc = _mm256_add_ps( acc, _mm256_mul_ps( _mm256_permute_ps( l, _MM_SHUFFLE(1,1,1,1) ), r1 ) );
+			acc = _mm256_add_ps( acc, _mm256_mul_ps( _mm256_permute_ps( l, _MM_SHUFFLE(2,2,2,2) ), r2 ) );
+			acc = _mm256_add_ps( acc, _mm256_mul_ps( _mm256_permute_ps( l, _MM_SHUFFLE(3,3,3,3) ), r3 ) );
+			_mm256_storeu_ps( ret.v+i, acc );
+		}
+#		elif defined(VMLIB_SIMD_SSE)
+		__m128 const r0 = _mm_loadu_ps( aRight.v+0 );
+		__m128 const r1 = _mm_loadu_ps( aRight.v+4 );
+		__m128 const r2 = _mm_loadu_ps( aRight.v+8 );
+		__m128 const r3 = _mm_loadu_ps( aRight.v+12 );
+		for( int i = 0; i < 16; i += 4 )
+		{
+			__m128 acc = _mm_mul_ps( _mm_set1_ps( aLeft.v[i+0] ), r0 );
+			acc = _mm_add_ps( acc, _mm_mul_ps( _mm_set1_ps( aLeft.v[i+1] ), r1 ) );
+			acc = _mm_add_ps( acc, _mm_mul_ps( _mm_set1_ps( aLeft.v[i+2] ), r2 ) );
+			acc = _mm_add_ps( acc, _mm_mul_ps( _mm_set1_ps( aLeft.v[i+3] ), r3 ) );
+			_mm_storeu_ps( ret.v+i, acc );
+		}
+#		elif defined(VMLIB_SIMD_NEON)
+		float32x4_t const r0 = vld1q_f32( aRight.v+0 );
+		float32x4_t const r1 = vld1q_f32( aRight.v+4 );
+		float32x4_t const r2 = vld1q_f32( aRight.v+8 );
+		float32x4_t const r3 = vld1q_f32( aRight.v+12 );
+		for( int i = 0; i < 16; i += 4 )
+		{
+			float32x4_t acc = vmulq_n_f32( r0, aLeft.v[i+0] );
+			acc = vaddq_f32( acc, vmulq_n_f32( r1, aLeft.v[i+1] ) );
+			acc = vaddq_f32( acc, vmulq_n_f32( r2, aLeft.v[i+2] ) );
+			acc = vaddq_f32( acc, vmulq_n_f32( r3, aLeft.v[i+3] ) );
+			vst1q_f32( ret.v+i, acc );
+		}
+#		endif
+		return ret;
+	}
+
+	// The columns of aLeft, scaled by the elements of aRight and summed.
+	inline
+	Vec4f multiply( Mat44f const& aLeft, Vec4f const& aRight ) noexcept
+	{
+		Vec4f ret;
+#		if defined(VMLIB_SIMD_AVX2) || defined(VMLIB_SIMD_SSE)
+		__m128 c0 = _mm_loadu_ps( aLeft.v+0 );
+		__m128 c1 = _mm_loadu_ps( aLeft.v+4 );
+		__m128 c2 = _mm_loadu_ps( aLeft.v+8 );
+		__m128 c3 = _mm_loadu_ps( aLeft.v+12 );
+		_MM_TRANSPOSE4_PS( c0, c1, c2, c3 );
+
+		__m128 acc = _mm_mul_ps( c0, _mm_set1_ps( aRight.x ) );
+		acc = _mm_add_ps( acc, _mm_mul_ps( c1, _mm_set1_ps( aRight.y ) ) );
+		acc = _mm_add_ps( acc, _mm_mul_ps( c2, _mm_set1_ps( aRight.z ) ) );
+		acc = _mm_add_ps( acc, _mm_mul_ps( c3, _mm_set1_ps( aRight.w ) ) );
+		_mm_storeu_ps( &ret.x, acc );
+#		elif defined(VMLIB_SIMD_NEON)
+		float32x4x4_t const c = vld4q_f32( aLeft.v ); // deinterleaves rows into columns
+
+		float32x4_t acc = vmulq_n_f32( c.val[0], aRight.x );
+		acc = vaddq_f32( acc, vmulq_n_f32( c.val[1], aRight.y ) );
+		acc = vaddq_f32( acc, vmulq_n_f32( c.val[2], aRight.z ) );
+		acc = vaddq_f32( acc, vmulq_n_f32( c.val[3], aRight.w ) );
+		vst1q_f32( &ret.x, acc );
+#		endif
+		return ret;
+	}
+}
+#endif // ~ SIMD
+
+constexpr
+Mat44f operator*( Mat44f const& aLeft, Mat44f const& aRight ) noexcept
+{
+#	if defined(VMLIB_MAT44_SIMD)
+	if( !VMLIB_IS_CONSTANT_EVALUATED() )
+		return vmlib_simd::multiply( aLeft, aRight );
+#	endif
+	return multiply_scalar( aLeft, aRight );
+}
+
+constexpr
+Vec4f operator*( Mat44f const& aLeft, Vec4f const& aRight ) noexcept
+{
+#	if defined(VMLIB_MAT44_SIMD)
+	if( !VMLIB_IS_CONSTANT_EVALUATED() )
+		return vmlib_simd::multiply( aLeft, aRight );
+#	endif
+	return multiply_scalar( aLeft, aRight );
+}
+
+// aOut[i] = aLeft * aRight[i] for i = 0..aCount-1, e.g., the model-view-
+// projection matrices of many instances. aOut may be the same array as
+// aRight. Results are identical to operator* only if the caller is also
+// built with -ffp-contract=off (like vmlib and vmlib-test). Elsewhere, the
+// inline operator* may be fused into FMAs and differ in the last bit.
+void multiply_many( Mat44f const& aLeft, Mat44f const* aRight, Mat44f* aOut, std::size_t aCount ) noexcept;
+
 // Functions:
 
 Mat44f invert( Mat44f const& aM ) noexcept;
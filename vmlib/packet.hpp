@@ -0,0 +1,792 @@
+#ifndef PACKET_HPP_3C8E5A17_B2D4_4F09_8E61_7A9D0C24F5B3
+#define PACKET_HPP_3C8E5A17_B2D4_4F09_8E61_7A9D0C24F5B3
+
+#include <vector>
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+#include <cstdlib>
+
+#include "simd.hpp"
+#include "vec3.hpp"
+#include "vec4.hpp"
+#include "mat33.hpp"
+#include "mat44.hpp"
+#include "affine34.hpp"
+
+/** Packets: eight values processed together (structure of arrays)
+ *
+ * Floatx8 holds eight floats; Vec3fx8 and Vec4fx8 hold eight vectors as one
+ * Floatx8 per component (x0..x7, y0..y7, ...). Each operation then applies
+ * to all eight lanes at once, so code written once in terms of packets runs
+ * as one AVX2 instruction or two SSE instructions per operation (see
+ * simd.hpp). Without either, the lanes are plain loops over a float array.
+ *
+ * The operators and functions mirror vec3.hpp and vec4.hpp, with scalars
+ * being either a float (the same in all lanes) or a Floatx8 (one per lane).
+ * Matrices are broadcast, i.e., the same Mat44f, Mat33f or Affine34f is
+ * applied to all eight vectors.
+ *
+ * gather() and scatter() convert between packets and arrays (or
+ * std::vector<>s) of Vec3f or Vec4f. Partial packets (fewer than eight
+ * elements at the end of an array) are padded with zeros.
+ *
+ * Example:
+ *    for( std::size_t i = 0; i < normals.size(); i += 8 )
+ *       scatter( normals, i, normalize( gather( normals, i ) ) );
+ */
+struct Floatx8
+{
+#	if defined(VMLIB_SIMD_AVX2)
+	__m256 v;
+#	elif defined(VMLIB_SIMD_SSE)
+	__m128 lo, hi;
+#	else
+	float v[8];
+#	endif
+};
+
+struct Vec3fx8
+{
+	Floatx8 x, y, z;
+};
+
+struct Vec4fx8
+{
+	Floatx8 x, y, z, w;
+};
+
+
+// Floatx8 basics:
+
+inline
+Floatx8 make_floatx8( float aValue ) noexcept
+{
+#	if defined(VMLIB_SIMD_AVX2)
+	return { _mm256_set1_ps( aValue ) };
+#	elif defined(VMLIB_SIMD_SSE)
+	return { _mm_set1_ps( aValue ), _mm_set1_ps( aValue ) };
+#	else
+	Floatx8 ret;
+	for( auto& v : ret.v )
+		v = aValue;
+	return ret;
+#	endif
+}
+
+inline
+Floatx8 load_floatx8( float const* aIn ) noexcept
+{
+#	if defined(VMLIB_SIMD_AVX2)
+	return { _mm256_loadu_ps( aIn ) };
+#	elif defined(VMLIB_SIMD_SSE)
+	return { _mm_loadu_ps( aIn ), _mm_loadu_ps( aIn+4 ) };
+#	else
+	Floatx8 ret;
+	for( std::size_t i = 0; i < 8; ++i )
+		ret.v[i] = aIn[i];
+	return ret;
+#	endif
+}
+
+inline
+void store( float* aOut, Floatx8 aValue ) noexcept
+{
+#	if defined(VMLIB_SIMD_AVX2)
+	_mm256_storeu_ps( aOut, aValue.v );
+#	elif defined(VMLIB_SIMD_SSE)
+	_mm_storeu_ps( aOut, aValue.lo );
+	_mm_storeu_ps( aOut+4, aValue.hi );
+#	else
+	for( std::size_t i = 0; i < 8; ++i )
+		aOut[i] = aValue.v[i];
+#	endif
+}
+
+// Value of a single lane. Slow; meant for tests and debugging.
+inline
+float extract( Floatx8 aValue, std::size_t aLane ) noexcept
+{
+	assert( aLane < 8 );
+	float lanes[8];
+	store( lanes, aValue );
+	return lanes[aLane];
+}
+
+
+// Floatx8 arithmetic:
+
+#if defined(VMLIB_SIMD_AVX2)
+#	define VMLIB_PACKET_OP_(name,avx,sse,op) \
+	inline Floatx8 name( Floatx8 aLeft, Floatx8 aRight ) noexcept { \
+		return { avx( aLeft.v, aRight.v ) }; \
+	}
+#elif defined(VMLIB_SIMD_SSE)
+#	define VMLIB_PACKET_OP_(name,avx,sse,op) \
+	inline Floatx8 name( Floatx8 aLeft, Floatx8 aRight ) noexcept { \
+		return { sse( aLeft.lo, aRight.lo ), sse( aLeft.hi, aRight.hi ) }; \
+	}
+#else
+#	define VMLIB_PACKET_OP_(name,avx,sse,op) \
+	inline Floatx8 name( Floatx8 aLeft, Floatx8 aRight ) noexcept { \
+		Floatx8 ret; \
+		for( std::size_t i = 0; i < 8; ++i ) \
+			ret.v[i] = op( aLeft.v[i], aRight.v[i] ); \
+		return ret; \
+	}
+#endif
+
+#define VMLIB_PACKET_ADD_(a,b) ((a) + (b))
+#define VMLIB_PACKET_SUB_(a,b) ((a) - (b))
+#define VMLIB_PACKET_MUL_(a,b) ((a) * (b))
+#define VMLIB_PACKET_DIV_(a,b) ((a) / (b))
+
+VMLIB_PACKET_OP_( operator+, _mm256_add_ps, _mm_add_ps, VMLIB_PACKET_ADD_ )
+VMLIB_PACKET_OP_( operator-, _mm256_sub_ps, _mm_sub_ps, VMLIB_PACKET_SUB_ )
+VMLIB_PACKET_OP_( operator*, _mm256_mul_ps, _mm_mul_ps, VMLIB_PACKET_MUL_ )
+VMLIB_PACKET_OP_( operator/, _mm256_div_ps, _mm_div_ps, VMLIB_PACKET_DIV_ )
+VMLIB_PACKET_OP_( min, _mm256_min_ps, _mm_min_ps, std::min )
+VMLIB_PACKET_OP_( max, _mm256_max_ps, _mm_max_ps, std::max )
+
+#undef VMLIB_PACKET_DIV_
+#undef VMLIB_PACKET_MUL_
+#undef VMLIB_PACKET_SUB_
+#undef VMLIB_PACKET_ADD_
+#undef VMLIB_PACKET_OP_
+
+inline
+Floatx8 operator+( Floatx8 aValue ) noexcept
+{
+	return aValue;
+}
+inline
+Floatx8 operator-( Floatx8 aValue ) noexcept
+{
+	return make_floatx8( 0.f ) - aValue;
+}
+
+// aA * aB + aC. A fused multiply-add with AVX2 (so it may round differently
+// from the separate operations).
+inline
+Floatx8 mul_add( Floatx8 aA, Floatx8 aB, Floatx8 aC ) noexcept
+{
+#	if defined(VMLIB_SIMD_AVX2)
+	return { _mm256_fmadd_ps( aA.v, aB.v, aC.v ) };
+#	else
+	return aA * aB + aC;
+#	endif
+}
+
+inline
+Floatx8 sqrt( Floatx8 aValue ) noexcept
+{
+#	if defined(VMLIB_SIMD_AVX2)
+	return { _mm256_sqrt_ps( aValue.v ) };
+#	elif defined(VMLIB_SIMD_SSE)
+	return { _mm_sqrt_ps( aValue.lo ), _mm_sqrt_ps( aValue.hi ) };
+#	else
+	Floatx8 ret;
+	for( std::size_t i = 0; i < 8; ++i )
+		ret.v[i] = std::sqrt( aValue.v[i] );
+	return ret;
+#	endif
+}
+
+inline
+Floatx8& operator+=( Floatx8& aLeft, Floatx8 aRight ) noexcept
+{
+	return aLeft = aLeft + aRight;
+}
+inline
+Floatx8& operator-=( Floatx8& aLeft, Floatx8 aRight ) noexcept
+{
+	return aLeft = aLeft - aRight;
+}
+inline
+Floatx8& operator*=( Floatx8& aLeft, Floatx8 aRight ) noexcept
+{
+	return aLeft = aLeft * aRight;
+}
+inline
+Floatx8& operator/=( Floatx8& aLeft, Floatx8 aRight ) noexcept
+{
+	return aLeft = aLeft / aRight;
+}
+
+
+// Vec3fx8 (see vec3.hpp):
+
+inline
+Vec3fx8 make_vec3fx8( Vec3f aVec ) noexcept
+{
+	return { make_floatx8( aVec.x ), make_floatx8( aVec.y ), make_floatx8( aVec.z ) };
+}
+
+inline
+Vec3f extract( Vec3fx8 const& aVec, std::size_t aLane ) noexcept
+{
+	return { extract( aVec.x, aLane ), extract( aVec.y, aLane ), extract( aVec.z, aLane ) };
+}
+
+inline
+Vec3fx8 operator+( Vec3fx8 const& aVec ) noexcept
+{
+	return aVec;
+}
+inline
+Vec3fx8 operator-( Vec3fx8 const& aVec ) noexcept
+{
+	return { -aVec.x, -aVec.y, -aVec.z };
+}
+
+inline
+Vec3fx8 operator+( Vec3fx8 const& aLeft, Vec3fx8 const& aRight ) noexcept
+{
+	return { aLeft.x + aRight.x, aLeft.y + aRight.y, aLeft.z + aRight.z };
+}
+inline
+Vec3fx8 operator-( Vec3fx8 const& aLeft, Vec3fx8 const& aRight ) noexcept
+{
+	return { aLeft.x - aRight.x, aLeft.y - aRight.y, aLeft.z - aRight.z };
+}
+
+inline
+Vec3fx8 operator*( Floatx8 aScalar, Vec3fx8 const& aVec ) noexcept
+{
+	return { aScalar * aVec.x, aScalar * aVec.y, aScalar * aVec.z };
+}
+inline
+Vec3fx8 operator*( Vec3fx8 const& aVec, Floatx8 aScalar ) noexcept
+{
+	return aScalar * aVec;
+}
+inline
+Vec3fx8 operator*( float aScalar, Vec3fx8 const& aVec ) noexcept
+{
+	return make_floatx8( aScalar ) * aVec;
+}
+inline
+Vec3fx8 operator*( Vec3fx8 const& aVec, float aScalar ) noexcept
+{
+	return make_floatx8( aScalar ) * aVec;
+}
+
+inline
+Vec3fx8 operator/( Vec3fx8 const& aVec, Floatx8 aScalar ) noexcept
+{
+	return { aVec.x / aScalar, aVec.y / aScalar, aVec.z / aScalar };
+}
+inline
+Vec3fx8 operator/( Vec3fx8 const& aVec, float aScalar ) noexcept
+{
+	return aVec / make_floatx8( aScalar );
+}
+
+inline
+Vec3fx8& operator+=( Vec3fx8& aLeft, Vec3fx8 const& aRight ) noexcept
+{
+	return aLeft = aLeft + aRight;
+}
+inline
+Vec3fx8& operator-=( Vec3fx8& aLeft, Vec3fx8 const& aRight ) noexcept
+{
+	return aLeft = aLeft - aRight;
+}
+
+inline
+Vec3fx8& operator*=( Vec3fx8& aLeft, Floatx8 aRight ) noexcept
+{
+	return aLeft = aLeft * aRight;
+}
+inline
+Vec3fx8& operator*=( Vec3fx8& aLeft, float aRight ) noexcept
+{
+	return aLeft = aLeft * aRight;
+}
+inline
+Vec3fx8& operator/=( Vec3fx8& aLeft, Floatx8 aRight ) noexcept
+{
+	return aLeft = aLeft / aRight;
+}
+inline
+Vec3fx8& operator/=( Vec3fx8& aLeft, float aRight ) noexcept
+{
+	return aLeft = aLeft / aRight;
+}
+
+inline
+Floatx8 dot( Vec3fx8 const& aLeft, Vec3fx8 const& aRight ) noexcept
+{
+	return mul_add( aLeft.z, aRight.z, mul_add( aLeft.y, aRight.y, aLeft.x * aRight.x ) );
+}
+
+inline
+Floatx8 length( Vec3fx8 const& aVec ) noexcept
+{
+	return sqrt( dot( aVec, aVec ) );
+}
+
+inline
+Vec3fx8 normalize( Vec3fx8 const& aVec ) noexcept
+{
+	return aVec / length( aVec );
+}
+
+
+// Vec4fx8 (see vec4.hpp):
+
+inline
+Vec4fx8 make_vec4fx8( Vec4f aVec ) noexcept
+{
+	return { make_floatx8( aVec.x ), make_floatx8( aVec.y ), make_floatx8( aVec.z ), make_floatx8( aVec.w ) };
+}
+
+inline
+Vec4f extract( Vec4fx8 const& aVec, std::size_t aLane ) noexcept
+{
+	return { extract( aVec.x, aLane ), extract( aVec.y, aLane ), extract( aVec.z, aLane ), extract( aVec.w, aLane ) };
+}
+
+inline
+Vec4fx8 operator+( Vec4fx8 const& aVec ) noexcept
+{
+	return aVec;
+}
+inline
+Vec4fx8 operator-( Vec4fx8 const& aVec ) noexcept
+{
+	return { -aVec.x, -aVec.y, -aVec.z, -aVec.w };
+}
+
+inline
+Vec4fx8 operator+( Vec4fx8 const& aLeft, Vec4fx8 const& aRight ) noexcept
+{
+	return { aLeft.x + aRight.x, aLeft.y + aRight.y, aLeft.z + aRight.z, aLeft.w + aRight.w };
+}
+inline
+Vec4fx8 operator-( Vec4fx8 const& aLeft, Vec4fx8 const& aRight ) noexcept
+{
+	return { aLeft.x - aRight.x, aLeft.y - aRight.y, aLeft.z - aRight.z, aLeft.w - aRight.w };
+}
+
+inline
+Vec4fx8 operator*( Floatx8 aScalar, Vec4fx8 const& aVec ) noexcept
+{
+	return { aScalar * aVec.x, aScalar * aVec.y, aScalar * aVec.z, aScalar * aVec.w };
+}
+inline
+Vec4fx8 operator*( Vec4fx8 const& aVec, Floatx8 aScalar ) noexcept
+{
+	return aScalar * aVec;
+}
+inline
+Vec4fx8 operator*( float aScalar, Vec4fx8 const& aVec ) noexcept
+{
+	return make_floatx8( aScalar ) * aVec;
+}
+inline
+Vec4fx8 operator*( Vec4fx8 const& aVec, float aScalar ) noexcept
+{
+	return make_floatx8( aScalar ) * aVec;
+}
+
+inline
+Vec4fx8 operator/( Vec4fx8 const& aVec, Floatx8 aScalar ) noexcept
+{
+	return { aVec.x / aScalar, aVec.y / aScalar, aVec.z / aScalar, aVec.w / aScalar };
+}
+inline
+Vec4fx8 operator/( Vec4fx8 const& aVec, float aScalar ) noexcept
+{
+	return aVec / make_floatx8( aScalar );
+}
+
+inline
+Vec4fx8& operator+=( Vec4fx8& aLeft, Vec4fx8 const& aRight ) noexcept
+{
+	return aLeft = aLeft + aRight;
+}
+inline
+Vec4fx8& operator-=( Vec4fx8& aLeft, Vec4fx8 const& aRight ) noexcept
+{
+	return aLeft = aLeft - aRight;
+}
+
+inline
+Vec4fx8& operator*=( Vec4fx8& aLeft, Floatx8 aRight ) noexcept
+{
+	return aLeft = aLeft * aRight;
+}
+inline
+Vec4fx8& operator*=( Vec4fx8& aLeft, float aRight ) noexcept
+{
+	return aLeft = aLeft * aRight;
+}
+inline
+Vec4fx8& operator/=( Vec4fx8& aLeft, Floatx8 aRight ) noexcept
+{
+	return aLeft = aLeft / aRight;
+}
+inline
+Vec4fx8& operator/=( Vec4fx8& aLeft, float aRight ) noexcept
+{
+	return aLeft = aLeft / aRight;
+}
+
+inline
+Floatx8 dot( Vec4fx8 const& aLeft, Vec4fx8 const& aRight ) noexcept
+{
+	return mul_add( aLeft.w, aRight.w, mul_add( aLeft.z, aRight.z, mul_add( aLeft.y, aRight.y, aLeft.x * aRight.x ) ) );
+}
+
+inline
+Floatx8 length( Vec4fx8 const& aVec ) noexcept
+{
+	return sqrt( dot( aVec, aVec ) );
+}
+
+
+// Broadcast matrices:
+
+inline
+Vec4fx8 operator*( Mat44f const& aLeft, Vec4fx8 const& aRight ) noexcept
+{
+	auto const row = [&] (std::size_t aI) {
+		Floatx8 r = make_floatx8( aLeft(aI,0) ) * aRight.x;
+		r = mul_add( make_floatx8( aLeft(aI,1) ), aRight.y, r );
+		r = mul_add( make_floatx8( aLeft(aI,2) ), aRight.z, r );
+		return mul_add( make_floatx8( aLeft(aI,3) ), aRight.w, r );
+	};
+	return { row( 0 ), row( 1 ), row( 2 ), row( 3 ) };
+}
+
+inline
+Vec3fx8 operator*( Mat33f const& aLeft, Vec3fx8 const& aRight ) noexcept
+{
+	auto const row = [&] (std::size_t aI) {
+		Floatx8 r = make_floatx8( aLeft(aI,0) ) * aRight.x;
+		r = mul_add( make_floatx8( aLeft(aI,1) ), aRight.y, r );
+		return mul_add( make_floatx8( aLeft(aI,2) ), aRight.z, r );
+	};
+	return { row( 0 ), row( 1 ), row( 2 ) };
+}
+
+// See affine34.hpp. Points are translated, directions are not.
+inline
+Vec3fx8 transform_direction( Affine34f const& aA, Vec3fx8 const& aD ) noexcept
+{
+	auto const row = [&] (std::size_t aI) {
+		Floatx8 r = make_floatx8( aA(aI,0) ) * aD.x;
+		r = mul_add( make_floatx8( aA(aI,1) ), aD.y, r );
+		return mul_add( make_floatx8( aA(aI,2) ), aD.z, r );
+	};
+	return { row( 0 ), row( 1 ), row( 2 ) };
+}
+inline
+Vec3fx8 transform_point( Affine34f const& aA, Vec3fx8 const& aP ) noexcept
+{
+	auto const d = transform_direction( aA, aP );
+	return {
+		d.x + make_floatx8( aA(0,3) ),
+		d.y + make_floatx8( aA(1,3) ),
+		d.z + make_floatx8( aA(2,3) )
+	};
+}
+
+
+// Gather and scatter:
+
+namespace vmlib_simd
+{
+#	if defined(VMLIB_SIMD_AVX2) || defined(VMLIB_SIMD_SSE)
+	// Four Vec3f are loaded as three registers
+	//   a = x0 y0 z0 x1,  b = y1 z1 x2 y2,  c = z2 x3 y3 z3
+	// and shuffled into x0..x3, y0..y3 and z0..z3 (and back). The AVX2 path
+	// uses the same shuffles on eight Vec3f at once, four per 128-bit lane.
+	// Vec4f are transposed four at a time in the same way.
+#	define VMLIB_SHUF_(a,b,c,d) _MM_SHUFFLE(d,c,b,a)
+#	endif
+
+#	if defined(VMLIB_SIMD_AVX2)
+	inline __m256 load_lanes( float const* aLo, float const* aHi ) noexcept
+	{
+		return _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( aLo ) ), _mm_loadu_ps( aHi ), 1 );
+	}
+	inline void store_lanes( float* aLo, float* aHi, __m256 aV ) noexcept
+	{
+		_mm_storeu_ps( aLo, _mm256_castps256_ps128( aV ) );
+		_mm_storeu_ps( aHi, _mm256_extractf128_ps( aV, 1 ) );
+	}
+
+	inline
+	Vec3fx8 load_vec3x8( float const* aIn ) noexcept
+	{
+		__m256 const a = load_lanes( aIn+0, aIn+12 );
+		__m256 const b = load_lanes( aIn+4, aIn+16 );
+		__m256 const c = load_lanes( aIn+8, aIn+20 );
+
+		Vec3fx8 ret;
+		ret.x.v = _mm256_shuffle_ps( a, _mm256_shuffle_ps( b, c, VMLIB_SHUF_(2,2,1,1) ), VMLIB_SHUF_(0,3,0,2) );
+		ret.y.v = _mm256_shuffle_ps( _mm256_shuffle_ps( a, b, VMLIB_SHUF_(1,1,0,0) ), _mm256_shuffle_ps( b, c, VMLIB_SHUF_(3,3,2,2) ), VMLIB_SHUF_(0,2,0,2) );
+		ret.z.v = _mm256_shuffle_ps( _mm256_shuffle_ps( a, b, VMLIB_SHUF_(2,2,1,1) ), _mm256_shuffle_ps( c, c, VMLIB_SHUF_(0,0,3,3) ), VMLIB_SHUF_(0,2,0,2) );
+		return ret;
+	}
+
+	inline
+	void store_vec3x8( float* aOut, Vec3fx8 const& aVec ) noexcept
+	{
+		__m256 const x = aVec.x.v, y = aVec.y.v, z = aVec.z.v;
+		__m256 const a = _mm256_shuffle_ps( _mm256_shuffle_ps( x, y, VMLIB_SHUF_(0,0,0,0) ), _mm256_shuffle_ps( z, x, VMLIB_SHUF_(0,0,1,1) ), VMLIB_SHUF_(0,2,0,2) );
+		__m256 const b = _mm256_shuffle_ps( _mm256_shuffle_ps( y, z, VMLIB_SHUF_(1,1,1,1) ), _mm256_shuffle_ps( x, y, VMLIB_SHUF_(2,2,2,2) ), VMLIB_SHUF_(0,2,0,2) );
+		__m256 const c = _mm256_shuffle_ps( _mm256_shuffle_ps( z, x, VMLIB_SHUF_(2,2,3,3) ), _mm256_shuffle_ps( y, z, VMLIB_SHUF_(3,3,3,3) ), VMLIB_SHUF_(0,2,0,2) );
+
+		store_lanes( aOut+0, aOut+12, a );
+		store_lanes( aOut+4, aOut+16, b );
+		store_lanes( aOut+8, aOut+20, c );
+	}
+
+	// 4x4 transpose in each 128-bit lane
+	inline
+	void transpose4( __m256& aR0, __m256& aR1, __m256& aR2, __m256& aR3 ) noexcept
+	{
+		__m256 const t0 = _mm256_unpacklo_ps( aR0, aR1 );
+		__m256 const t1 = _mm256_unpackhi_ps( aR0, aR1 );
+		__m256 const t2 = _mm256_unpacklo_ps( aR2, aR3 );
+		__m256 const t3 = _mm256_unpackhi_ps( aR2, aR3 );
+		aR0 = _mm256_shuffle_ps( t0, t2, _MM_SHUFFLE(1,0,1,0) );
+		aR1 = _mm256_shuffle_ps( t0, t2, _MM_SHUFFLE(3,2,3,2) );
+		aR2 = _mm256_shuffle_ps( t1, t3, _MM_SHUFFLE(1,0,1,0) );
+		aR3 = _mm256_shuffle_ps( t1, t3, _MM_SHUFFLE(3,2,3,2) );
+	}
+
+	inline
+	Vec4fx8 load_vec4x8( float const* aIn ) noexcept
+	{
+		Vec4fx8 ret;
+		ret.x.v = load_lanes( aIn+0, aIn+16 );
+		ret.y.v = load_lanes( aIn+4, aIn+20 );
+		ret.z.v = load_lanes( aIn+8, aIn+24 );
+		ret.w.v = load_lanes( aIn+12, aIn+28 );
+		transpose4( ret.x.v, ret.y.v, ret.z.v, ret.w.v );
+		return ret;
+	}
+
+	inline
+	void store_vec4x8( float* aOut, Vec4fx8 aVec ) noexcept
+	{
+		transpose4( aVec.x.v, aVec.y.v, aVec.z.v, aVec.w.v );
+		store_lanes( aOut+0, aOut+16, aVec.x.v );
+		store_lanes( aOut+4, aOut+20, aVec.y.v );
+		store_lanes( aOut+8, aOut+24, aVec.z.v );
+		store_lanes( aOut+12, aOut+28, aVec.w.v );
+	}
+#	elif defined(VMLIB_SIMD_SSE)
+	inline
+	void load_vec3x4( float const* aIn, __m128& aX, __m128& aY, __m128& aZ ) noexcept
+	{
+		__m128 const a = _mm_loadu_ps( aIn+0 );
+		__m128 const b = _mm_loadu_ps( aIn+4 );
+		__m128 const c = _mm_loadu_ps( aIn+8 );
+
+		aX = _mm_shuffle_ps( a, _mm_shuffle_ps( b, c, VMLIB_SHUF_(2,2,1,1) ), VMLIB_SHUF_(0,3,0,2) );
+		aY = _mm_shuffle_ps( _mm_shuffle_ps( a, b, VMLIB_SHUF_(1,1,0,0) ), _mm_shuffle_ps( b, c, VMLIB_SHUF_(3,3,2,2) ), VMLIB_SHUF_(0,2,0,2) );
+		aZ = _mm_shuffle_ps( _mm_shuffle_ps( a, b, VMLIB_SHUF_(2,2,1,1) ), _mm_shuffle_ps( c, c, VMLIB_SHUF_(0,0,3,3) ), VMLIB_SHUF_(0,2,0,2) );
+	}
+
+	inline
+	void store_vec3x4( float* aOut, __m128 aX, __m128 aY, __m128 aZ ) noexcept
+	{
+		__m128 const a = _mm_shuffle_ps( _mm_shuffle_ps( aX, aY, VMLIB_SHUF_(0,0,0,0) ), _mm_shuffle_ps( aZ, aX, VMLIB_SHUF_(0,0,1,1) ), VMLIB_SHUF_(0,2,0,2) );
+		__m128 const b = _mm_shuffle_ps( _mm_shuffle_ps( aY, aZ, VMLIB_SHUF_(1,1,1,1) ), _mm_shuffle_ps( aX, aY, VMLIB_SHUF_(2,2,2,2) ), VMLIB_SHUF_(0,2,0,2) );
+		__m128 const c = _mm_shuffle_ps( _mm_shuffle_ps( aZ, aX, VMLIB_SHUF_(2,2,3,3) ), _mm_shuffle_ps( aY, aZ, VMLIB_SHUF_(3,3,3,3) ), VMLIB_SHUF_(0,2,0,2) );
+
+		_mm_storeu_ps( aOut+0, a );
+		_mm_storeu_ps( aOut+4, b );
+		_mm_storeu_ps( aOut+8, c );
+	}
+
+	inline
+	Vec3fx8 load_vec3x8( float const* aIn ) noexcept
+	{
+		Vec3fx8 ret;
+		load_vec3x4( aIn, ret.x.lo, ret.y.lo, ret.z.lo );
+		load_vec3x4( aIn+12, ret.x.hi, ret.y.hi, ret.z.hi );
+		return ret;
+	}
+
+	inline
+	void store_vec3x8( float* aOut, Vec3fx8 const& aVec ) noexcept
+	{
+		store_vec3x4( aOut, aVec.x.lo, aVec.y.lo, aVec.z.lo );
+		store_vec3x4( aOut+12, aVec.x.hi, aVec.y.hi, aVec.z.hi );
+	}
+
+	inline
+	Vec4fx8 load_vec4x8( float const* aIn ) noexcept
+	{
+		Vec4fx8 ret;
+		ret.x.lo = _mm_loadu_ps( aIn+0 );
+		ret.y.lo = _mm_loadu_ps( aIn+4 );
+		ret.z.lo = _mm_loadu_ps( aIn+8 );
+		ret.w.lo = _mm_loadu_ps( aIn+12 );
+		_MM_TRANSPOSE4_PS( ret.x.lo, ret.y.lo, ret.z.lo, ret.w.lo );
+		ret.x.hi = _mm_loadu_ps( aIn+16 );
+		ret.y.hi = _mm_loadu_ps( aIn+20 );
+		ret.z.hi = _mm_loadu_ps( aIn+24 );
+		ret.w.hi = _mm_loadu_ps( aIn+28 );
+		_MM_TRANSPOSE4_PS( ret.x.hi, ret.y.hi, ret.z.hi, ret.w.hi );
+		return ret;
+	}
+
+	inline
+	void store_vec4x8( float* aOut, Vec4fx8 aVec ) noexcept
+	{
+		_MM_TRANSPOSE4_PS( aVec.x.lo, aVec.y.lo, aVec.z.lo, aVec.w.lo );
+		_mm_storeu_ps( aOut+0, aVec.x.lo );
+		_mm_storeu_ps( aOut+4, aVec.y.lo );
+		_mm_storeu_ps( aOut+8, aVec.z.lo );
+		_mm_storeu_ps( aOut+12, aVec.w.lo );
+		_MM_TRANSPOSE4_PS( aVec.x.hi, aVec.y.hi, aVec.z.hi, aVec.w.hi );
+		_mm_storeu_ps( aOut+16, aVec.x.hi );
+		_mm_storeu_ps( aOut+20, aVec.y.hi );
+		_mm_storeu_ps( aOut+24, aVec.z.hi );
+		_mm_storeu_ps( aOut+28, aVec.w.hi );
+	}
+#	else // !SIMD
+	inline
+	Vec3fx8 load_vec3x8( float const* aIn ) noexcept
+	{
+		Vec3fx8 ret;
+		for( std::size_t i = 0; i < 8; ++i )
+		{
+			ret.x.v[i] = aIn[i*3+0];
+			ret.y.v[i] = aIn[i*3+1];
+			ret.z.v[i] = aIn[i*3+2];
+		}
+		return ret;
+	}
+
+	inline
+	void store_vec3x8( float* aOut, Vec3fx8 const& aVec ) noexcept
+	{
+		for( std::size_t i = 0; i < 8; ++i )
+		{
+			aOut[i*3+0] = aVec.x.v[i];
+			aOut[i*3+1] = aVec.y.v[i];
+			aOut[i*3+2] = aVec.z.v[i];
+		}
+	}
+
+	inline
+	Vec4fx8 load_vec4x8( float const* aIn ) noexcept
+	{
+		Vec4fx8 ret;
+		for( std::size_t i = 0; i < 8; ++i )
+		{
+			ret.x.v[i] = aIn[i*4+0];
+			ret.y.v[i] = aIn[i*4+1];
+			ret.z.v[i] = aIn[i*4+2];
+			ret.w.v[i] = aIn[i*4+3];
+		}
+		return ret;
+	}
+
+	inline
+	void store_vec4x8( float* aOut, Vec4fx8 const& aVec ) noexcept
+	{
+		for( std::size_t i = 0; i < 8; ++i )
+		{
+			aOut[i*4+0] = aVec.x.v[i];
+			aOut[i*4+1] = aVec.y.v[i];
+			aOut[i*4+2] = aVec.z.v[i];
+			aOut[i*4+3] = aVec.w.v[i];
+		}
+	}
+#	endif // ~ SIMD
+
+#	if defined(VMLIB_SHUF_)
+#	undef VMLIB_SHUF_
+#	endif
+}
+
+static_assert( sizeof(Vec3f) == 3*sizeof(float), "Vec3f arrays must be tightly packed floats" );
+static_assert( sizeof(Vec4f) == 4*sizeof(float), "Vec4f arrays must be tightly packed floats" );
+
+// Loads aIn[0..aCount-1] into lanes 0..aCount-1; the remaining lanes are
+// zero. aCount must be at most 8.
+inline
+Vec3fx8 gather( Vec3f const* aIn, std::size_t aCount = 8 ) noexcept
+{
+	assert( aCount <= 8 );
+	if( 8 == aCount )
+		return vmlib_simd::load_vec3x8( &aIn[0].x );
+
+	Vec3f lanes[8]{};
+	std::copy( aIn, aIn + aCount, lanes );
+	return vmlib_simd::load_vec3x8( &lanes[0].x );
+}
+inline
+Vec4fx8 gather( Vec4f const* aIn, std::size_t aCount = 8 ) noexcept
+{
+	assert( aCount <= 8 );
+	if( 8 == aCount )
+		return vmlib_simd::load_vec4x8( &aIn[0].x );
+
+	Vec4f lanes[8]{};
+	std::copy( aIn, aIn + aCount, lanes );
+	return vmlib_simd::load_vec4x8( &lanes[0].x );
+}
+
+// Stores lanes 0..aCount-1 to aOut[0..aCount-1]. aCount must be at most 8.
+inline
+void scatter( Vec3f* aOut, Vec3fx8 const& aVec, std::size_t aCount = 8 ) noexcept
+{
+	assert( aCount <= 8 );
+	if( 8 == aCount )
+		return vmlib_simd::store_vec3x8( &aOut[0].x, aVec );
+
+	Vec3f lanes[8];
+	vmlib_simd::store_vec3x8( &lanes[0].x, aVec );
+	std::copy( lanes, lanes + aCount, aOut );
+}
+inline
+void scatter( Vec4f* aOut, Vec4fx8 const& aVec, std::size_t aCount = 8 ) noexcept
+{
+	assert( aCount <= 8 );
+	if( 8 == aCount )
+		return vmlib_simd::store_vec4x8( &aOut[0].x, aVec );
+
+	Vec4f lanes[8];
+	vmlib_simd::store_vec4x8( &lanes[0].x, aVec );
+	std::copy( lanes, lanes + aCount, aOut );
+}
+
+// Elements aFirst .. aFirst+7 of a std::vector<>, or as many as there are.
+inline
+Vec3fx8 gather( std::vector<Vec3f> const& aIn, std::size_t aFirst ) noexcept
+{
+	assert( aFirst < aIn.size() );
+	return gather( aIn.data() + aFirst, std::min<std::size_t>( 8, aIn.size() - aFirst ) );
+}
+inline
+Vec4fx8 gather( std::vector<Vec4f> const& aIn, std::size_t aFirst ) noexcept
+{
+	assert( aFirst < aIn.size() );
+	return gather( aIn.data() + aFirst, std::min<std::size_t>( 8, aIn.size() - aFirst ) );
+}
+
+inline
+void scatter( std::vector<Vec3f>& aOut, std::size_t aFirst, Vec3fx8 const& aVec ) noexcept
+{
+	assert( aFirst < aOut.size() );
+	scatter( aOut.data() + aFirst, aVec, std::min<std::size_t>( 8, aOut.size() - aFirst ) );
+}
+inline
+void scatter( std::vector<Vec4f>& aOut, std::size_t aFirst, Vec4fx8 const& aVec ) noexcept
+{
+	assert( aFirst < aOut.size() );
+	scatter( aOut.data() + aFirst, aVec, std::min<std::size_t>( 8, aOut.size() - aFirst ) );
+}
+
+#endif // PACKET_HPP_3C8E5A17_B2D4_4F09_8E61_7A9D0C24F5B3
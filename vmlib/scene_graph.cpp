@@ -0,0 +1,138 @@
+#include "scene_graph.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+
+SceneNode SceneGraph::add( SceneNode aParent, Affine34f const& aLocal )
+{
+	assert( kNoSceneNode == aParent || aParent < mSlots.size() );
+
+	auto const ret = SceneNode(mSlots.size());
+
+	// A root goes to the end. A child goes to the end of its parent's
+	// subtree, so that the subtree stays contiguous.
+	auto const parent = kNoSceneNode == aParent ? kNoSceneNode : mSlots[aParent];
+	auto const slot = kNoSceneNode == parent ? std::uint32_t(mNodes.size()) : mSubtreeEnds[parent];
+
+	// Make room: positions at or after the slot move up by one. So do the
+	// subtree ends that reach the slot, i.e., those of the ancestors.
+	if( slot < mNodes.size() )
+	{
+		for( auto& s : mSlots )
+		{
+			if( s >= slot )
+				++s;
+		}
+		for( auto& p : mParents )
+		{
+			if( kNoSceneNode != p && p >= slot )
+				++p;
+		}
+		for( std::size_t i = slot; i < mSubtreeEnds.size(); ++i )
+			++mSubtreeEnds[i];
+	}
+
+	for( auto p = parent; kNoSceneNode != p; p = mParents[p] )
+		++mSubtreeEnds[p];
+
+	mSlots.emplace_back( slot );
+	mNodes.insert( mNodes.begin() + slot, ret );
+	mParents.insert( mParents.begin() + slot, parent );
+	mSubtreeEnds.insert( mSubtreeEnds.begin() + slot, slot + 1 );
+	mLocal.insert( mLocal.begin() + slot, aLocal );
+	mWorld.insert( mWorld.begin() + slot, aLocal );
+	mDirty.insert( mDirty.begin() + slot, std::uint8_t(1) );
+	mDirtyNodes.emplace_back( ret );
+
+	return ret;
+}
+
+std::size_t SceneGraph::size() const noexcept
+{
+	return mNodes.size();
+}
+
+SceneNode SceneGraph::parent( SceneNode aNode ) const noexcept
+{
+	assert( aNode < mSlots.size() );
+	auto const p = mParents[mSlots[aNode]];
+	return kNoSceneNode == p ? kNoSceneNode : mNodes[p];
+}
+Affine34f const& SceneGraph::local( SceneNode aNode ) const noexcept
+{
+	assert( aNode < mSlots.size() );
+	return mLocal[mSlots[aNode]];
+}
+Affine34f const& SceneGraph::world( SceneNode aNode ) const noexcept
+{
+	assert( aNode < mSlots.size() );
+	return mWorld[mSlots[aNode]];
+}
+
+void SceneGraph::set_local( SceneNode aNode, Affine34f const& aLocal )
+{
+	assert( aNode < mSlots.size() );
+	auto const slot = mSlots[aNode];
+	mLocal[slot] = aLocal;
+
+	if( !mDirty[slot] )
+	{
+		mDirty[slot] = 1;
+		mDirtyNodes.emplace_back( aNode );
+	}
+}
+
+std::size_t SceneGraph::update()
+{
+	mChanged.clear();
+	mVisited = 0;
+	if( mDirtyNodes.empty() )
+		return 0;
+
+	// Visit the dirty subtrees in depth-first order. A dirty node inside an
+	// earlier dirty subtree was visited with it.
+	for( auto& node : mDirtyNodes )
+		node = mSlots[node];
+	std::sort( mDirtyNodes.begin(), mDirtyNodes.end() );
+
+	std::uint32_t end = 0;
+	for( auto const first : mDirtyNodes )
+	{
+		if( first < end )
+			continue; // already visited
+
+		end = mSubtreeEnds[first];
+		mVisited += end - first;
+
+		for( auto i = first; i < end; ++i )
+		{
+			auto const p = mParents[i];
+			bool const parentChanged = kNoSceneNode != p && mDirty[p];
+			if( !mDirty[i] && !parentChanged )
+				continue;
+
+			mDirty[i] = 1;
+			mWorld[i] = kNoSceneNode == p ? mLocal[i] : mWorld[p] * mLocal[i];
+			mChanged.emplace_back( i );
+		}
+	}
+
+	for( auto& node : mChanged )
+	{
+		mDirty[node] = 0;
+		node = mNodes[node];
+	}
+	mDirtyNodes.clear();
+
+	return mChanged.size();
+}
+
+std::vector<SceneNode> const& SceneGraph::changed() const noexcept
+{
+	return mChanged;
+}
+std::size_t SceneGraph::visited() const noexcept
+{
+	return mVisited;
+}
@@ -0,0 +1,87 @@
+#ifndef SCENE_GRAPH_HPP_5E0C7A29_D4B8_4F16_A3E7_91C2B06F58D4
+#define SCENE_GRAPH_HPP_5E0C7A29_D4B8_4F16_A3E7_91C2B06F58D4
+
+#include <limits>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "affine34.hpp"
+
+/* SceneGraph: world transforms of a hierarchy of nodes, updated
+ * incrementally.
+ *
+ * Each node has a transform relative to its parent. As in PartHierarchy
+ * (see main/parts.hpp), nodes live in flat arrays in which parents precede
+ * their children, so one forward pass computes the world transforms. The
+ * arrays are kept in depth-first order: each subtree is one contiguous
+ * range that holds the node and its descendants, and nothing else.
+ *
+ * set_local() only marks a node as dirty. update() then recomputes the
+ * world transforms of the dirty nodes and their descendants, and only
+ * visits the ranges that hold those subtrees. Static nodes cost nothing,
+ * however many there are. The nodes whose world transform changed are
+ * listed by changed() until the next update(). Use this list to upload
+ * only what changed, e.g., instance transforms.
+ *
+ * A SceneNode is a handle. Handles are handed out in the order the nodes
+ * were added and don't change. Adding a child to a node whose subtree is
+ * not at the end of the arrays inserts it in the middle, which moves the
+ * nodes after it (linear in their number). Building the hierarchy
+ * depth-first avoids this.
+ *
+ * world() returns the transform as of the last update(). A node added
+ * since then has no valid world transform yet.
+ */
+using SceneNode = std::uint32_t;
+
+constexpr SceneNode kNoSceneNode = std::numeric_limits<SceneNode>::max();
+
+class SceneGraph final
+{
+	public:
+		// Adds a node and returns its handle. The parent must already exist
+		// (kNoSceneNode for a root). New nodes are dirty.
+		SceneNode add( SceneNode aParent, Affine34f const& aLocal = kIdentity34f );
+
+		std::size_t size() const noexcept;
+
+		SceneNode parent( SceneNode ) const noexcept;
+		Affine34f const& local( SceneNode ) const noexcept; // node to parent
+		Affine34f const& world( SceneNode ) const noexcept; // node to world
+
+		void set_local( SceneNode, Affine34f const& );
+
+		// Recomputes the world transforms of dirty subtrees. Returns the
+		// number of nodes whose world transform changed.
+		std::size_t update();
+
+		// Nodes updated by the last update(), in depth-first order
+		std::vector<SceneNode> const& changed() const noexcept;
+
+		// Nodes the last update() looked at, including those it left
+		// unchanged (for statistics)
+		std::size_t visited() const noexcept;
+
+	private:
+		// Indexed by handle
+		std::vector<std::uint32_t> mSlots; // position in the arrays below
+
+		// Indexed by position, in depth-first order
+		std::vector<SceneNode> mNodes; // handle
+		std::vector<std::uint32_t> mParents; // position of the parent
+		std::vector<std::uint32_t> mSubtreeEnds; // one past the last descendant
+		std::vector<Affine34f> mLocal;
+		std::vector<Affine34f> mWorld;
+
+		// Set by set_local() and add(). During update(), also set for the
+		// nodes updated so far, so that their children follow.
+		std::vector<std::uint8_t> mDirty;
+		std::vector<SceneNode> mDirtyNodes; // handles, in any order, no duplicates
+
+		std::vector<SceneNode> mChanged;
+		std::size_t mVisited = 0;
+};
+
+#endif // SCENE_GRAPH_HPP_5E0C7A29_D4B8_4F16_A3E7_91C2B06F58D4
@@ -0,0 +1,37 @@
+#ifndef SIMD_HPP_47B2E0D9_8C6A_4E1F_9D35_A1F7C04B62E8
+#define SIMD_HPP_47B2E0D9_8C6A_4E1F_9D35_A1F7C04B62E8
+
+/* Compile-time selection of the SIMD instruction set used by vmlib.
+ *
+ * At most one of the following is defined, depending on what the compiler
+ * targets (e.g., -march=native, /arch:AVX2):
+ *   VMLIB_SIMD_AVX2   AVX2 and FMA (x86-64)
+ *   VMLIB_SIMD_SSE    SSE2 (any x86-64)
+ *   VMLIB_SIMD_NEON   NEON (ARM)
+ * Without any, vmlib only uses its scalar code. Define VMLIB_NO_SIMD to
+ * force that.
+ *
+ * VMLIB_IS_CONSTANT_EVALUATED() lets constexpr functions use SIMD kernels at
+ * run time and the scalar code at compile time. Without compiler support
+ * for it, SIMD is disabled altogether.
+ */
+#if defined(__GNUC__) || defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1925)
+#	define VMLIB_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#else
+#	define VMLIB_NO_SIMD 1
+#endif
+
+#if !defined(VMLIB_NO_SIMD)
+#	if defined(__AVX2__) && defined(__FMA__)
+#		define VMLIB_SIMD_AVX2 1
+#		include <immintrin.h>
+#	elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#		define VMLIB_SIMD_SSE 1
+#		include <emmintrin.h>
+#	elif defined(__ARM_NEON) || defined(_M_ARM64)
+#		define VMLIB_SIMD_NEON 1
+#		include <arm_neon.h>
+#	endif
+#endif
+
+#endif // SIMD_HPP_47B2E0D9_8C6A_4E1F_9D35_A1F7C04B62E8
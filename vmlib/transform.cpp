@@ -0,0 +1,117 @@
+#include "transform.hpp"
+
+#include <algorithm>
+
+#include "simd.hpp"
+#include "packet.hpp"
+#include "affine34.hpp"
+
+namespace
+{
+	// Whole packets of eight; a partial packet at the end is padded (see
+	// gather()), so these handle all aCount elements.
+#	if defined(VMLIB_SIMD_AVX2) || defined(VMLIB_SIMD_SSE)
+	void transform_points_simd_( Mat44f const& aM, Vec3f const* aIn, Vec3f* aOut, std::size_t aCount ) noexcept
+	{
+		if( is_affine( aM ) )
+		{
+			auto const a = make_affine( aM );
+			for( std::size_t i = 0; i < aCount; i += 8 )
+			{
+				auto const n = std::min<std::size_t>( 8, aCount - i );
+				scatter( aOut + i, transform_point( a, gather( aIn + i, n ) ), n );
+			}
+		}
+		else
+		{
+			auto const one = make_floatx8( 1.f );
+			for( std::size_t i = 0; i < aCount; i += 8 )
+			{
+				auto const n = std::min<std::size_t>( 8, aCount - i );
+				auto const p = gather( aIn + i, n );
+				auto const t = aM * Vec4fx8{ p.x, p.y, p.z, one };
+				scatter( aOut + i, Vec3fx8{ t.x, t.y, t.z } / t.w, n );
+			}
+		}
+	}
+
+	void transform_normals_simd_( Mat33f const& aN, Vec3f const* aIn, Vec3f* aOut, std::size_t aCount ) noexcept
+	{
+		for( std::size_t i = 0; i < aCount; i += 8 )
+		{
+			auto const n = std::min<std::size_t>( 8, aCount - i );
+			scatter( aOut + i, aN * gather( aIn + i, n ), n );
+		}
+	}
+
+	void normalize_vectors_simd_( Vec3f const* aIn, Vec3f* aOut, std::size_t aCount ) noexcept
+	{
+		for( std::size_t i = 0; i < aCount; i += 8 )
+		{
+			auto const n = std::min<std::size_t>( 8, aCount - i );
+			scatter( aOut + i, normalize( gather( aIn + i, n ) ), n );
+		}
+	}
+#	endif // ~ SIMD
+}
+
+void transform_points( Mat44f const& aM, Vec3f const* aIn, Vec3f* aOut, std::size_t aCount ) noexcept
+{
+#	if defined(VMLIB_SIMD_AVX2) || defined(VMLIB_SIMD_SSE)
+	transform_points_simd_( aM, aIn, aOut, aCount );
+#	else
+	transform_points_scalar( aM, aIn, aOut, aCount );
+#	endif
+}
+
+void transform_normals( Mat33f const& aN, Vec3f const* aIn, Vec3f* aOut, std::size_t aCount ) noexcept
+{
+#	if defined(VMLIB_SIMD_AVX2) || defined(VMLIB_SIMD_SSE)
+	transform_normals_simd_( aN, aIn, aOut, aCount );
+#	else
+	transform_normals_scalar( aN, aIn, aOut, aCount );
+#	endif
+}
+
+void normalize_vectors( Vec3f const* aIn, Vec3f* aOut, std::size_t aCount ) noexcept
+{
+#	if defined(VMLIB_SIMD_AVX2) || defined(VMLIB_SIMD_SSE)
+	normalize_vectors_simd_( aIn, aOut, aCount );
+#	else
+	normalize_vectors_scalar( aIn, aOut, aCount );
+#	endif
+}
+
+void transform_points_scalar( Mat44f const& aM, Vec3f const* aIn, Vec3f* aOut, std::size_t aCount ) noexcept
+{
+	for( std::size_t i = 0; i < aCount; ++i )
+	{
+		auto const p = aIn[i];
+		auto t = aM * Vec4f{ p.x, p.y, p.z, 1.f };
+		t /= t.w;
+		aOut[i] = Vec3f{ t.x, t.y, t.z };
+	}
+}
+
+void transform_normals_scalar( Mat33f const& aN, Vec3f const* aIn, Vec3f* aOut, std::size_t aCount ) noexcept
+{
+	for( std::size_t i = 0; i < aCount; ++i )
+		aOut[i] = aN * aIn[i];
+}
+
+void normalize_vectors_scalar( Vec3f const* aIn, Vec3f* aOut, std::size_t aCount ) noexcept
+{
+	for( std::size_t i = 0; i < aCount; ++i )
+		aOut[i] = normalize( aIn[i] );
+}
+
+char const* transform_simd_path() noexcept
+{
+#	if defined(VMLIB_SIMD_AVX2)
+	return "AVX2";
+#	elif defined(VMLIB_SIMD_SSE)
+	return "SSE";
+#	else
+	return "scalar";
+#	endif
+}
@@ -0,0 +1,42 @@
+#ifndef TRANSFORM_HPP_9E41C7B2_5A0D_4F63_B817_C2D04E6A93F5
+#define TRANSFORM_HPP_9E41C7B2_5A0D_4F63_B817_C2D04E6A93F5
+
+#include <cstddef>
+
+#include "vec3.hpp"
+#include "mat33.hpp"
+#include "mat44.hpp"
+
+/** Batch transforms of Vec3f arrays
+ *
+ * transform_points() computes, for each point p,
+ *    t = aM * Vec4f{ p.x, p.y, p.z, 1.f };
+ *    out = Vec3f{ t.x, t.y, t.z } / t.w;
+ * and transform_normals() computes aN * n for each normal n (pass the
+ * inverse transpose of the point transform, see mat44_to_mat33()).
+ *
+ * normalize_vectors() computes normalize( v ) for each vector v.
+ *
+ * When the compiler targets AVX2 or SSE (see simd.hpp), the arrays are
+ * processed as packets of eight (see packet.hpp), with the last one padded
+ * as needed. Otherwise they go through the scalar versions. Results agree
+ * with the scalar versions up to rounding (the packets may use fused
+ * multiply-adds).
+ *
+ * aOut may be the same array as aIn, but the arrays must not otherwise
+ * overlap.
+ */
+void transform_points( Mat44f const& aM, Vec3f const* aIn, Vec3f* aOut, std::size_t aCount ) noexcept;
+void transform_normals( Mat33f const& aN, Vec3f const* aIn, Vec3f* aOut, std::size_t aCount ) noexcept;
+void normalize_vectors( Vec3f const* aIn, Vec3f* aOut, std::size_t aCount ) noexcept;
+
+// Plain one-element-at-a-time loops.
+void transform_points_scalar( Mat44f const& aM, Vec3f const* aIn, Vec3f* aOut, std::size_t aCount ) noexcept;
+void transform_normals_scalar( Mat33f const& aN, Vec3f const* aIn, Vec3f* aOut, std::size_t aCount ) noexcept;
+void normalize_vectors_scalar( Vec3f const* aIn, Vec3f* aOut, std::size_t aCount ) noexcept;
+
+// Name of the SIMD path that the functions above use: "AVX2", "SSE" or
+// "scalar".
+char const* transform_simd_path() noexcept;
+
+#endif // TRANSFORM_HPP_9E41C7B2_5A0D_4F63_B817_C2D04E6A93F5
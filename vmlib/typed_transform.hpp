@@ -0,0 +1,342 @@
+#ifndef TYPED_TRANSFORM_HPP_B4E7196D_2C5A_4F38_9D06_E13A8F7C52B1
+#define TYPED_TRANSFORM_HPP_B4E7196D_2C5A_4F38_9D06_E13A8F7C52B1
+
+#include <type_traits>
+
+#include <cmath>
+#include <cstdlib>
+
+#include "vec3.hpp"
+#include "mat44.hpp"
+#include "affine34.hpp"
+
+/** Typed transforms: translations, rotations and scalings that know their
+ * structure
+ *
+ * make_translation() and friends return dense Mat44fs, so their products
+ * cost 64 multiplies each even though most entries are 0 or 1. The types
+ * below store only the free parameters:
+ *
+ *   Translation   t          = make_translation( t )
+ *   RotationX/Y/Z c, s       = make_rotation_x/y/z( angle ), c = cos, s = sin
+ *   Scale         x, y, z    = make_scaling( x, y, z )
+ *
+ * Their products are resolved at compile time (overloads and if constexpr)
+ * to the cheapest form:
+ *   - Two of the same kind stay in that kind (e.g., Translation *
+ *     Translation is a Translation).
+ *   - Anything else becomes an Affine34f, computed from the non-trivial
+ *     entries only. For example, Translation * RotationY takes no
+ *     arithmetic at all, and Affine34f * RotationX 12 multiplies.
+ * Only collapse into a dense matrix with to_mat44() (or by multiplying with
+ * a Mat44f) where one is needed, e.g., to combine with a projection.
+ *
+ * Skipping the zero terms does not change the arithmetic otherwise: the
+ * remaining terms are summed in the order of the dense product. Results are
+ * therefore identical to the dense ones when built with -ffp-contract=off
+ * (as vmlib-test is; see mat44.hpp). Otherwise the compiler may fuse some
+ * of the terms, and the two only agree up to rounding.
+ *
+ * Example:
+ *    Affine34f const world2camera = translation( -pos ) * rotation_y( phi ) * rotation_x( theta );
+ *    Mat44f const projCameraWorld = projection * world2camera;
+ */
+struct Translation
+{
+	Vec3f t;
+};
+
+struct RotationX
+{
+	float c, s;
+};
+struct RotationY
+{
+	float c, s;
+};
+struct RotationZ
+{
+	float c, s;
+};
+
+struct Scale
+{
+	float x, y, z;
+};
+
+template< typename tType >
+struct IsTypedTransform : std::false_type {};
+
+template<> struct IsTypedTransform<Translation> : std::true_type {};
+template<> struct IsTypedTransform<RotationX> : std::true_type {};
+template<> struct IsTypedTransform<RotationY> : std::true_type {};
+template<> struct IsTypedTransform<RotationZ> : std::true_type {};
+template<> struct IsTypedTransform<Scale> : std::true_type {};
+
+template< typename tType >
+constexpr bool kIsTypedTransform = IsTypedTransform<tType>::value;
+
+
+// Construction. The rotations evaluate cos() and sin() exactly like
+// make_rotation_x() etc., so they describe the same matrices.
+
+constexpr
+Translation translation( Vec3f aTranslation ) noexcept
+{
+	return { aTranslation };
+}
+
+inline
+RotationX rotation_x( float aAngle ) noexcept
+{
+	return { static_cast<float>(cos(aAngle)), static_cast<float>(sin(aAngle)) };
+}
+inline
+RotationY rotation_y( float aAngle ) noexcept
+{
+	return { static_cast<float>(cos(aAngle)), static_cast<float>(sin(aAngle)) };
+}
+inline
+RotationZ rotation_z( float aAngle ) noexcept
+{
+	return { static_cast<float>(cos(aAngle)), static_cast<float>(sin(aAngle)) };
+}
+
+constexpr
+Scale scaling( float aSX, float aSY, float aSZ ) noexcept
+{
+	return { aSX, aSY, aSZ };
+}
+
+
+// Conversions:
+
+constexpr
+Affine34f to_affine( Translation const& aT ) noexcept
+{
+	return { {
+		1.f, 0.f, 0.f, aT.t.x,
+		0.f, 1.f, 0.f, aT.t.y,
+		0.f, 0.f, 1.f, aT.t.z
+	} };
+}
+constexpr
+Affine34f to_affine( RotationX const& aR ) noexcept
+{
+	return { {
+		1.f, 0.f, 0.f, 0.f,
+		0.f, aR.c, -aR.s, 0.f,
+		0.f, aR.s, aR.c, 0.f
+	} };
+}
+constexpr
+Affine34f to_affine( RotationY const& aR ) noexcept
+{
+	return { {
+		aR.c, 0.f, aR.s, 0.f,
+		0.f, 1.f, 0.f, 0.f,
+		-aR.s, 0.f, aR.c, 0.f
+	} };
+}
+constexpr
+Affine34f to_affine( RotationZ const& aR ) noexcept
+{
+	return { {
+		aR.c, -aR.s, 0.f, 0.f,
+		aR.s, aR.c, 0.f, 0.f,
+		0.f, 0.f, 1.f, 0.f
+	} };
+}
+constexpr
+Affine34f to_affine( Scale const& aS ) noexcept
+{
+	return { {
+		aS.x, 0.f, 0.f, 0.f,
+		0.f, aS.y, 0.f, 0.f,
+		0.f, 0.f, aS.z, 0.f
+	} };
+}
+
+template< typename tType, std::enable_if_t< kIsTypedTransform<tType>, int > = 0 >
+constexpr
+Mat44f to_mat44( tType const& aX ) noexcept
+{
+	return to_mat44( to_affine( aX ) );
+}
+
+
+// Affine34f times a typed transform. Each result column (row, for the
+// left-hand versions further down) only involves the non-trivial entries;
+// the terms keep the order of the dense product. The results are written
+// as a whole (see to_mat44()).
+
+constexpr
+Affine34f operator*( Affine34f const& aA, Translation const& aT ) noexcept
+{
+	auto const col3 = [&] (std::size_t aI) {
+		return aA(aI,0) * aT.t.x + aA(aI,1) * aT.t.y + aA(aI,2) * aT.t.z + aA(aI,3);
+	};
+	return { {
+		aA(0,0), aA(0,1), aA(0,2), col3( 0 ),
+		aA(1,0), aA(1,1), aA(1,2), col3( 1 ),
+		aA(2,0), aA(2,1), aA(2,2), col3( 2 )
+	} };
+}
+constexpr
+Affine34f operator*( Affine34f const& aA, RotationX const& aR ) noexcept
+{
+	return { {
+		aA(0,0), aA(0,1) * aR.c + aA(0,2) * aR.s, aA(0,1) * -aR.s + aA(0,2) * aR.c, aA(0,3),
+		aA(1,0), aA(1,1) * aR.c + aA(1,2) * aR.s, aA(1,1) * -aR.s + aA(1,2) * aR.c, aA(1,3),
+		aA(2,0), aA(2,1) * aR.c + aA(2,2) * aR.s, aA(2,1) * -aR.s + aA(2,2) * aR.c, aA(2,3)
+	} };
+}
+constexpr
+Affine34f operator*( Affine34f const& aA, RotationY const& aR ) noexcept
+{
+	return { {
+		aA(0,0) * aR.c + aA(0,2) * -aR.s, aA(0,1), aA(0,0) * aR.s + aA(0,2) * aR.c, aA(0,3),
+		aA(1,0) * aR.c + aA(1,2) * -aR.s, aA(1,1), aA(1,0) * aR.s + aA(1,2) * aR.c, aA(1,3),
+		aA(2,0) * aR.c + aA(2,2) * -aR.s, aA(2,1), aA(2,0) * aR.s + aA(2,2) * aR.c, aA(2,3)
+	} };
+}
+constexpr
+Affine34f operator*( Affine34f const& aA, RotationZ const& aR ) noexcept
+{
+	return { {
+		aA(0,0) * aR.c + aA(0,1) * aR.s, aA(0,0) * -aR.s + aA(0,1) * aR.c, aA(0,2), aA(0,3),
+		aA(1,0) * aR.c + aA(1,1) * aR.s, aA(1,0) * -aR.s + aA(1,1) * aR.c, aA(1,2), aA(1,3),
+		aA(2,0) * aR.c + aA(2,1) * aR.s, aA(2,0) * -aR.s + aA(2,1) * aR.c, aA(2,2), aA(2,3)
+	} };
+}
+constexpr
+Affine34f operator*( Affine34f const& aA, Scale const& aS ) noexcept
+{
+	return { {
+		aA(0,0) * aS.x, aA(0,1) * aS.y, aA(0,2) * aS.z, aA(0,3),
+		aA(1,0) * aS.x, aA(1,1) * aS.y, aA(1,2) * aS.z, aA(1,3),
+		aA(2,0) * aS.x, aA(2,1) * aS.y, aA(2,2) * aS.z, aA(2,3)
+	} };
+}
+
+// Typed transform times Affine34f.
+
+constexpr
+Affine34f operator*( Translation const& aT, Affine34f const& aA ) noexcept
+{
+	return { {
+		aA(0,0), aA(0,1), aA(0,2), aA(0,3) + aT.t.x,
+		aA(1,0), aA(1,1), aA(1,2), aA(1,3) + aT.t.y,
+		aA(2,0), aA(2,1), aA(2,2), aA(2,3) + aT.t.z
+	} };
+}
+constexpr
+Affine34f operator*( RotationX const& aR, Affine34f const& aA ) noexcept
+{
+	auto const row1 = [&] (std::size_t aJ) { return aR.c * aA(1,aJ) + -aR.s * aA(2,aJ); };
+	auto const row2 = [&] (std::size_t aJ) { return aR.s * aA(1,aJ) + aR.c * aA(2,aJ); };
+	return { {
+		aA(0,0), aA(0,1), aA(0,2), aA(0,3),
+		row1( 0 ), row1( 1 ), row1( 2 ), row1( 3 ),
+		row2( 0 ), row2( 1 ), row2( 2 ), row2( 3 )
+	} };
+}
+constexpr
+Affine34f operator*( RotationY const& aR, Affine34f const& aA ) noexcept
+{
+	auto const row0 = [&] (std::size_t aJ) { return aR.c * aA(0,aJ) + aR.s * aA(2,aJ); };
+	auto const row2 = [&] (std::size_t aJ) { return -aR.s * aA(0,aJ) + aR.c * aA(2,aJ); };
+	return { {
+		row0( 0 ), row0( 1 ), row0( 2 ), row0( 3 ),
+		aA(1,0), aA(1,1), aA(1,2), aA(1,3),
+		row2( 0 ), row2( 1 ), row2( 2 ), row2( 3 )
+	} };
+}
+constexpr
+Affine34f operator*( RotationZ const& aR, Affine34f const& aA ) noexcept
+{
+	auto const row0 = [&] (std::size_t aJ) { return aR.c * aA(0,aJ) + -aR.s * aA(1,aJ); };
+	auto const row1 = [&] (std::size_t aJ) { return aR.s * aA(0,aJ) + aR.c * aA(1,aJ); };
+	return { {
+		row0( 0 ), row0( 1 ), row0( 2 ), row0( 3 ),
+		row1( 0 ), row1( 1 ), row1( 2 ), row1( 3 ),
+		aA(2,0), aA(2,1), aA(2,2), aA(2,3)
+	} };
+}
+constexpr
+Affine34f operator*( Scale const& aS, Affine34f const& aA ) noexcept
+{
+	return { {
+		aS.x * aA(0,0), aS.x * aA(0,1), aS.x * aA(0,2), aS.x * aA(0,3),
+		aS.y * aA(1,0), aS.y * aA(1,1), aS.y * aA(1,2), aS.y * aA(1,3),
+		aS.z * aA(2,0), aS.z * aA(2,1), aS.z * aA(2,2), aS.z * aA(2,3)
+	} };
+}
+
+
+// Two typed transforms of the same kind:
+
+constexpr
+Translation operator*( Translation const& aLeft, Translation const& aRight ) noexcept
+{
+	return { aRight.t + aLeft.t };
+}
+constexpr
+RotationX operator*( RotationX const& aLeft, RotationX const& aRight ) noexcept
+{
+	return { aLeft.c * aRight.c + -aLeft.s * aRight.s, aLeft.s * aRight.c + aLeft.c * aRight.s };
+}
+constexpr
+RotationY operator*( RotationY const& aLeft, RotationY const& aRight ) noexcept
+{
+	return { aLeft.c * aRight.c + aLeft.s * -aRight.s, aLeft.c * aRight.s + aLeft.s * aRight.c };
+}
+constexpr
+RotationZ operator*( RotationZ const& aLeft, RotationZ const& aRight ) noexcept
+{
+	return { aLeft.c * aRight.c + -aLeft.s * aRight.s, aLeft.s * aRight.c + aLeft.c * aRight.s };
+}
+constexpr
+Scale operator*( Scale const& aLeft, Scale const& aRight ) noexcept
+{
+	return { aLeft.x * aRight.x, aLeft.y * aRight.y, aLeft.z * aRight.z };
+}
+
+// Two typed transforms of different kinds. A translation on the left just
+// becomes the last column of the (purely linear) right-hand side.
+template< typename tLeft, typename tRight, std::enable_if_t< kIsTypedTransform<tLeft> && kIsTypedTransform<tRight>, int > = 0 >
+constexpr
+Affine34f operator*( tLeft const& aLeft, tRight const& aRight ) noexcept
+{
+	static_assert( !std::is_same_v<tLeft, tRight>, "Same kinds are handled by the overloads above" );
+
+	if constexpr( std::is_same_v<tLeft, Translation> )
+	{
+		auto const l = to_affine( aRight );
+		return { {
+			l(0,0), l(0,1), l(0,2), aLeft.t.x,
+			l(1,0), l(1,1), l(1,2), aLeft.t.y,
+			l(2,0), l(2,1), l(2,2), aLeft.t.z
+		} };
+	}
+	else
+	{
+		return to_affine( aLeft ) * aRight;
+	}
+}
+
+// With dense matrices:
+template< typename tType, std::enable_if_t< kIsTypedTransform<tType>, int > = 0 >
+constexpr
+Mat44f operator*( Mat44f const& aLeft, tType const& aRight ) noexcept
+{
+	return aLeft * to_mat44( aRight );
+}
+template< typename tType, std::enable_if_t< kIsTypedTransform<tType>, int > = 0 >
+constexpr
+Mat44f operator*( tType const& aLeft, Mat44f const& aRight ) noexcept
+{
+	return to_mat44( aLeft ) * aRight;
+}
+
+#endif // TYPED_TRANSFORM_HPP_B4E7196D_2C5A_4F38_9D06_E13A8F7C52B1